@@ -5,6 +5,11 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <pthread.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 #ifdef _WIN32
 #include <windows.h>
@@ -27,6 +32,567 @@ static char g_library_name[] = "SONAR Audio Engine";
 static short g_audio_buffer[BUFFER_SIZE];
 static int g_buffer_pos = 0;
 
+// Effects chain: rendering runs in fixed blocks through EQ -> pitch -> reverb
+#define EFFECT_BLOCK_FRAMES 512
+#define EFFECT_EQ_BANDS 4
+#define REVERB_FFT_SIZE (2 * EFFECT_BLOCK_FRAMES)
+#define REVERB_BINS (REVERB_FFT_SIZE / 2 + 1)
+#define REVERB_MAX_SECONDS 4.0
+#define REVERB_MIX 0.35f
+#define PITCH_FRAME_SIZE 1024
+#define PITCH_OVERSAMPLING 4
+
+enum { EQ_BASS, EQ_TREBLE, EQ_LOWPASS, EQ_HIGHPASS };
+
+typedef struct {
+    int size;
+    float *cos_table;
+    float *sin_table;
+    int *bitrev;
+} fft_plan_t;
+
+typedef struct {
+    int enabled;
+    double parameter;
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+} biquad_t;
+
+typedef struct {
+    int enabled;
+    double decay;
+    int partitions;
+    int head;
+    float *ir_re, *ir_im;     // partitions * REVERB_BINS
+    float *fdl_re, *fdl_im;   // frequency-domain delay line, partitions * REVERB_BINS
+    float *input;             // sliding input window, REVERB_FFT_SIZE
+    float *work_re, *work_im; // REVERB_FFT_SIZE
+    float *acc_re, *acc_im;   // REVERB_BINS
+} reverb_t;
+
+typedef struct {
+    int enabled;
+    double semitones;
+    double ratio;
+    int rover;
+    float *window;
+    float *in_fifo, *out_fifo;
+    float *work_re, *work_im;
+    float *last_phase, *sum_phase;
+    float *output_accum;
+    float *ana_freq, *ana_magn, *syn_freq, *syn_magn;
+} pitch_shift_t;
+
+typedef struct {
+    int prepared_rate;        // sample rate the state was built for, 0 if stale
+    biquad_t eq[EFFECT_EQ_BANDS];
+    reverb_t reverb;
+    pitch_shift_t pitch;
+    fft_plan_t reverb_fft;
+    fft_plan_t pitch_fft;
+    float block[EFFECT_BLOCK_FRAMES];
+    short pcm[EFFECT_BLOCK_FRAMES];
+} effects_chain_t;
+
+static effects_chain_t g_effects;
+
+// Build a radix-2 FFT plan (twiddles and bit-reversal table) for a power-of-two size
+static int fft_plan_init(fft_plan_t *plan, int size)
+{
+    int bits = 0;
+    while ((1 << bits) < size) bits++;
+
+    plan->size = size;
+    plan->cos_table = malloc(sizeof(float) * (size / 2));
+    plan->sin_table = malloc(sizeof(float) * (size / 2));
+    plan->bitrev = malloc(sizeof(int) * size);
+    if (!plan->cos_table || !plan->sin_table || !plan->bitrev) return -1;
+
+    for (int i = 0; i < size / 2; i++) {
+        plan->cos_table[i] = (float)cos(2.0 * M_PI * i / size);
+        plan->sin_table[i] = (float)sin(2.0 * M_PI * i / size);
+    }
+    for (int i = 0; i < size; i++) {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+        }
+        plan->bitrev[i] = reversed;
+    }
+    return 0;
+}
+
+static void fft_plan_free(fft_plan_t *plan)
+{
+    free(plan->cos_table);
+    free(plan->sin_table);
+    free(plan->bitrev);
+    memset(plan, 0, sizeof(*plan));
+}
+
+// In-place complex FFT on split real/imaginary arrays; inverse is scaled by 1/size
+static void fft_execute(const fft_plan_t *plan, float *re, float *im, int inverse)
+{
+    int n = plan->size;
+
+    for (int i = 0; i < n; i++) {
+        int j = plan->bitrev[i];
+        if (i < j) {
+            float tr = re[i], ti = im[i];
+            re[i] = re[j]; im[i] = im[j];
+            re[j] = tr; im[j] = ti;
+        }
+    }
+
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len / 2;
+        int step = n / len;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < half; k++) {
+                float wr = plan->cos_table[k * step];
+                float wi = inverse ? plan->sin_table[k * step] : -plan->sin_table[k * step];
+                int a = i + k, b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+
+    if (inverse) {
+        float scale = 1.0f / n;
+        for (int i = 0; i < n; i++) {
+            re[i] *= scale;
+            im[i] *= scale;
+        }
+    }
+}
+
+// RBJ audio EQ cookbook coefficients for one band
+static void biquad_configure(biquad_t *bq, int band, double parameter, int sample_rate)
+{
+    double freq, gain_db = 0.0, q = 0.7071;
+    switch (band) {
+    case EQ_BASS:     freq = 250.0;  gain_db = parameter; break;
+    case EQ_TREBLE:   freq = 4000.0; gain_db = parameter; break;
+    default:          freq = parameter; break;
+    }
+    if (freq >= sample_rate * 0.45) freq = sample_rate * 0.45;
+
+    double w0 = 2.0 * M_PI * freq / sample_rate;
+    double cw = cos(w0), sw = sin(w0);
+    double alpha = sw / (2.0 * q);
+    double a = pow(10.0, gain_db / 40.0);
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (band) {
+    case EQ_BASS: {
+        double sa = 2.0 * sqrt(a) * alpha;
+        b0 = a * ((a + 1) - (a - 1) * cw + sa);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cw);
+        b2 = a * ((a + 1) - (a - 1) * cw - sa);
+        a0 = (a + 1) + (a - 1) * cw + sa;
+        a1 = -2 * ((a - 1) + (a + 1) * cw);
+        a2 = (a + 1) + (a - 1) * cw - sa;
+        break;
+    }
+    case EQ_TREBLE: {
+        double sa = 2.0 * sqrt(a) * alpha;
+        b0 = a * ((a + 1) + (a - 1) * cw + sa);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cw);
+        b2 = a * ((a + 1) + (a - 1) * cw - sa);
+        a0 = (a + 1) - (a - 1) * cw + sa;
+        a1 = 2 * ((a - 1) - (a + 1) * cw);
+        a2 = (a + 1) - (a - 1) * cw - sa;
+        break;
+    }
+    case EQ_LOWPASS:
+        b0 = (1 - cw) / 2; b1 = 1 - cw; b2 = (1 - cw) / 2;
+        a0 = 1 + alpha; a1 = -2 * cw; a2 = 1 - alpha;
+        break;
+    default: // EQ_HIGHPASS
+        b0 = (1 + cw) / 2; b1 = -(1 + cw); b2 = (1 + cw) / 2;
+        a0 = 1 + alpha; a1 = -2 * cw; a2 = 1 - alpha;
+        break;
+    }
+
+    bq->b0 = (float)(b0 / a0);
+    bq->b1 = (float)(b1 / a0);
+    bq->b2 = (float)(b2 / a0);
+    bq->a1 = (float)(a1 / a0);
+    bq->a2 = (float)(a2 / a0);
+    bq->z1 = bq->z2 = 0.0f;
+}
+
+// Transposed direct form II biquad over one block
+static void biquad_process(biquad_t *bq, float *block, int frames)
+{
+    float b0 = bq->b0, b1 = bq->b1, b2 = bq->b2, a1 = bq->a1, a2 = bq->a2;
+    float z1 = bq->z1, z2 = bq->z2;
+
+    for (int i = 0; i < frames; i++) {
+        float x = block[i];
+        float y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        block[i] = y;
+    }
+
+    bq->z1 = z1;
+    bq->z2 = z2;
+}
+
+static void reverb_free(reverb_t *rv)
+{
+    free(rv->ir_re); free(rv->ir_im);
+    free(rv->fdl_re); free(rv->fdl_im);
+    free(rv->input);
+    free(rv->work_re); free(rv->work_im);
+    free(rv->acc_re); free(rv->acc_im);
+    rv->ir_re = rv->ir_im = rv->fdl_re = rv->fdl_im = NULL;
+    rv->input = rv->work_re = rv->work_im = rv->acc_re = rv->acc_im = NULL;
+    rv->partitions = 0;
+}
+
+// Synthesize an exponentially decaying noise impulse response and pre-transform its partitions
+static int reverb_prepare(reverb_t *rv, const fft_plan_t *fft, int sample_rate)
+{
+    double decay = rv->decay > REVERB_MAX_SECONDS ? REVERB_MAX_SECONDS : rv->decay;
+    int ir_length = (int)(decay * sample_rate);
+    if (ir_length < EFFECT_BLOCK_FRAMES) ir_length = EFFECT_BLOCK_FRAMES;
+
+    reverb_free(rv);
+    rv->partitions = (ir_length + EFFECT_BLOCK_FRAMES - 1) / EFFECT_BLOCK_FRAMES;
+    size_t spectra = (size_t)rv->partitions * REVERB_BINS;
+
+    rv->ir_re = calloc(spectra, sizeof(float));
+    rv->ir_im = calloc(spectra, sizeof(float));
+    rv->fdl_re = calloc(spectra, sizeof(float));
+    rv->fdl_im = calloc(spectra, sizeof(float));
+    rv->input = calloc(REVERB_FFT_SIZE, sizeof(float));
+    rv->work_re = calloc(REVERB_FFT_SIZE, sizeof(float));
+    rv->work_im = calloc(REVERB_FFT_SIZE, sizeof(float));
+    rv->acc_re = calloc(REVERB_BINS, sizeof(float));
+    rv->acc_im = calloc(REVERB_BINS, sizeof(float));
+    if (!rv->ir_re || !rv->ir_im || !rv->fdl_re || !rv->fdl_im || !rv->input ||
+        !rv->work_re || !rv->work_im || !rv->acc_re || !rv->acc_im) {
+        reverb_free(rv);
+        return -1;
+    }
+
+    // RT60 decay envelope over deterministic noise, normalized to unit energy
+    float *ir = malloc(sizeof(float) * rv->partitions * EFFECT_BLOCK_FRAMES);
+    if (!ir) {
+        reverb_free(rv);
+        return -1;
+    }
+    unsigned int seed = 0x5EED1234u;
+    double energy = 0.0;
+    for (int i = 0; i < rv->partitions * EFFECT_BLOCK_FRAMES; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        double noise = ((seed >> 8) / 8388608.0) - 1.0;
+        double envelope = i < ir_length ? exp(-6.9078 * i / (decay * sample_rate)) : 0.0;
+        ir[i] = (float)(noise * envelope);
+        energy += ir[i] * ir[i];
+    }
+    float norm = energy > 0.0 ? (float)(1.0 / sqrt(energy)) : 0.0f;
+
+    for (int p = 0; p < rv->partitions; p++) {
+        for (int i = 0; i < REVERB_FFT_SIZE; i++) {
+            rv->work_re[i] = i < EFFECT_BLOCK_FRAMES ? ir[p * EFFECT_BLOCK_FRAMES + i] * norm : 0.0f;
+            rv->work_im[i] = 0.0f;
+        }
+        fft_execute(fft, rv->work_re, rv->work_im, 0);
+        memcpy(rv->ir_re + (size_t)p * REVERB_BINS, rv->work_re, sizeof(float) * REVERB_BINS);
+        memcpy(rv->ir_im + (size_t)p * REVERB_BINS, rv->work_im, sizeof(float) * REVERB_BINS);
+    }
+
+    free(ir);
+    rv->head = 0;
+    return 0;
+}
+
+// Complex multiply-accumulate over one spectrum; split arrays keep this loop vectorizable
+static void spectrum_mac(float *restrict acc_re, float *restrict acc_im,
+                         const float *restrict x_re, const float *restrict x_im,
+                         const float *restrict h_re, const float *restrict h_im, int bins)
+{
+    for (int k = 0; k < bins; k++) {
+        acc_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+        acc_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+}
+
+// Uniformly partitioned overlap-save convolution of one full block
+static void reverb_process(reverb_t *rv, const fft_plan_t *fft, float *block)
+{
+    int b = EFFECT_BLOCK_FRAMES;
+
+    memmove(rv->input, rv->input + b, sizeof(float) * b);
+    memcpy(rv->input + b, block, sizeof(float) * b);
+    memcpy(rv->work_re, rv->input, sizeof(float) * REVERB_FFT_SIZE);
+    memset(rv->work_im, 0, sizeof(float) * REVERB_FFT_SIZE);
+    fft_execute(fft, rv->work_re, rv->work_im, 0);
+
+    memcpy(rv->fdl_re + (size_t)rv->head * REVERB_BINS, rv->work_re, sizeof(float) * REVERB_BINS);
+    memcpy(rv->fdl_im + (size_t)rv->head * REVERB_BINS, rv->work_im, sizeof(float) * REVERB_BINS);
+
+    memset(rv->acc_re, 0, sizeof(float) * REVERB_BINS);
+    memset(rv->acc_im, 0, sizeof(float) * REVERB_BINS);
+    for (int p = 0; p < rv->partitions; p++) {
+        int slot = (rv->head - p + rv->partitions) % rv->partitions;
+        spectrum_mac(rv->acc_re, rv->acc_im,
+                     rv->fdl_re + (size_t)slot * REVERB_BINS, rv->fdl_im + (size_t)slot * REVERB_BINS,
+                     rv->ir_re + (size_t)p * REVERB_BINS, rv->ir_im + (size_t)p * REVERB_BINS, REVERB_BINS);
+    }
+    rv->head = (rv->head + 1) % rv->partitions;
+
+    // Rebuild the full Hermitian spectrum and keep the last block (overlap-save)
+    for (int k = 0; k < REVERB_BINS; k++) {
+        rv->work_re[k] = rv->acc_re[k];
+        rv->work_im[k] = rv->acc_im[k];
+    }
+    for (int k = REVERB_BINS; k < REVERB_FFT_SIZE; k++) {
+        rv->work_re[k] = rv->acc_re[REVERB_FFT_SIZE - k];
+        rv->work_im[k] = -rv->acc_im[REVERB_FFT_SIZE - k];
+    }
+    fft_execute(fft, rv->work_re, rv->work_im, 1);
+
+    for (int i = 0; i < b; i++) {
+        block[i] += REVERB_MIX * rv->work_re[b + i];
+    }
+}
+
+static void pitch_shift_free(pitch_shift_t *ps)
+{
+    float **buffers[] = {&ps->window, &ps->in_fifo, &ps->out_fifo, &ps->work_re, &ps->work_im,
+                         &ps->last_phase, &ps->sum_phase, &ps->output_accum,
+                         &ps->ana_freq, &ps->ana_magn, &ps->syn_freq, &ps->syn_magn};
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        free(*buffers[i]);
+        *buffers[i] = NULL;
+    }
+}
+
+static void pitch_shift_reset(pitch_shift_t *ps)
+{
+    int n = PITCH_FRAME_SIZE;
+    int bins = n / 2 + 1;
+
+    memset(ps->in_fifo, 0, sizeof(float) * n);
+    memset(ps->out_fifo, 0, sizeof(float) * n);
+    memset(ps->output_accum, 0, sizeof(float) * 2 * n);
+    memset(ps->last_phase, 0, sizeof(float) * bins);
+    memset(ps->sum_phase, 0, sizeof(float) * bins);
+    ps->rover = 0;
+}
+
+static int pitch_shift_prepare(pitch_shift_t *ps)
+{
+    int n = PITCH_FRAME_SIZE;
+    int bins = n / 2 + 1;
+
+    pitch_shift_free(ps);
+    ps->window = calloc(n, sizeof(float));
+    ps->in_fifo = calloc(n, sizeof(float));
+    ps->out_fifo = calloc(n, sizeof(float));
+    ps->work_re = calloc(n, sizeof(float));
+    ps->work_im = calloc(n, sizeof(float));
+    ps->output_accum = calloc(2 * n, sizeof(float));
+    ps->last_phase = calloc(bins, sizeof(float));
+    ps->sum_phase = calloc(bins, sizeof(float));
+    ps->ana_freq = calloc(bins, sizeof(float));
+    ps->ana_magn = calloc(bins, sizeof(float));
+    ps->syn_freq = calloc(bins, sizeof(float));
+    ps->syn_magn = calloc(bins, sizeof(float));
+    if (!ps->window || !ps->in_fifo || !ps->out_fifo || !ps->work_re || !ps->work_im ||
+        !ps->output_accum || !ps->last_phase || !ps->sum_phase || !ps->ana_freq ||
+        !ps->ana_magn || !ps->syn_freq || !ps->syn_magn) {
+        pitch_shift_free(ps);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        ps->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / n));
+    }
+    ps->ratio = pow(2.0, ps->semitones / 12.0);
+    pitch_shift_reset(ps);
+    return 0;
+}
+
+// Analysis/resynthesis of one STFT frame with bins moved by the pitch ratio
+static void pitch_shift_frame(pitch_shift_t *ps, const fft_plan_t *fft, int sample_rate)
+{
+    int n = PITCH_FRAME_SIZE;
+    int half = n / 2;
+    int step = n / PITCH_OVERSAMPLING;
+    double freq_per_bin = (double)sample_rate / n;
+    double expected = 2.0 * M_PI * step / n;
+
+    for (int k = 0; k < n; k++) {
+        ps->work_re[k] = ps->in_fifo[k] * ps->window[k];
+        ps->work_im[k] = 0.0f;
+    }
+    fft_execute(fft, ps->work_re, ps->work_im, 0);
+
+    for (int k = 0; k <= half; k++) {
+        double re = ps->work_re[k], im = ps->work_im[k];
+        double phase = atan2(im, re);
+        double delta = phase - ps->last_phase[k] - k * expected;
+        ps->last_phase[k] = (float)phase;
+
+        long wraps = (long)(delta / M_PI);
+        wraps += wraps >= 0 ? (wraps & 1) : -(wraps & 1);
+        delta -= M_PI * wraps;
+
+        ps->ana_magn[k] = (float)(2.0 * sqrt(re * re + im * im));
+        ps->ana_freq[k] = (float)((k + delta * PITCH_OVERSAMPLING / (2.0 * M_PI)) * freq_per_bin);
+    }
+
+    memset(ps->syn_magn, 0, sizeof(float) * (half + 1));
+    memset(ps->syn_freq, 0, sizeof(float) * (half + 1));
+    for (int k = 0; k <= half; k++) {
+        int index = (int)(k * ps->ratio);
+        if (index > half) break;
+        ps->syn_magn[index] += ps->ana_magn[k];
+        ps->syn_freq[index] = (float)(ps->ana_freq[k] * ps->ratio);
+    }
+
+    for (int k = 0; k <= half; k++) {
+        double deviation = (ps->syn_freq[k] / freq_per_bin - k) * 2.0 * M_PI / PITCH_OVERSAMPLING;
+        ps->sum_phase[k] += (float)(deviation + k * expected);
+        ps->work_re[k] = ps->syn_magn[k] * cosf(ps->sum_phase[k]);
+        ps->work_im[k] = ps->syn_magn[k] * sinf(ps->sum_phase[k]);
+    }
+    for (int k = half + 1; k < n; k++) {
+        ps->work_re[k] = 0.0f;
+        ps->work_im[k] = 0.0f;
+    }
+    fft_execute(fft, ps->work_re, ps->work_im, 1);
+
+    for (int k = 0; k < n; k++) {
+        ps->output_accum[k] += 4.0f * ps->window[k] * ps->work_re[k] / PITCH_OVERSAMPLING;
+    }
+    memcpy(ps->out_fifo, ps->output_accum, sizeof(float) * step);
+    memmove(ps->output_accum, ps->output_accum + step, sizeof(float) * n);
+    memmove(ps->in_fifo, ps->in_fifo + step, sizeof(float) * (n - step));
+}
+
+// Streaming phase-vocoder pitch shift; adds a fixed latency of frame - hop samples
+static void pitch_shift_process(pitch_shift_t *ps, const fft_plan_t *fft, float *block, int frames, int sample_rate)
+{
+    int latency = PITCH_FRAME_SIZE - PITCH_FRAME_SIZE / PITCH_OVERSAMPLING;
+    if (ps->rover == 0) ps->rover = latency;
+
+    for (int i = 0; i < frames; i++) {
+        ps->in_fifo[ps->rover] = block[i];
+        block[i] = ps->out_fifo[ps->rover - latency];
+        ps->rover++;
+
+        if (ps->rover >= PITCH_FRAME_SIZE) {
+            ps->rover = latency;
+            pitch_shift_frame(ps, fft, sample_rate);
+        }
+    }
+}
+
+static void effects_release(void)
+{
+    reverb_free(&g_effects.reverb);
+    pitch_shift_free(&g_effects.pitch);
+    fft_plan_free(&g_effects.reverb_fft);
+    fft_plan_free(&g_effects.pitch_fft);
+    g_effects.prepared_rate = 0;
+}
+
+// Allocate and precompute all effect state once, outside the render loop
+static int effects_prepare(void)
+{
+    if (g_effects.prepared_rate == g_sample_rate) {
+        // Same configuration: only clear delay lines so renders are independent
+        for (int band = 0; band < EFFECT_EQ_BANDS; band++) {
+            g_effects.eq[band].z1 = g_effects.eq[band].z2 = 0.0f;
+        }
+        if (g_effects.reverb.enabled) {
+            size_t spectra = (size_t)g_effects.reverb.partitions * REVERB_BINS;
+            memset(g_effects.reverb.fdl_re, 0, sizeof(float) * spectra);
+            memset(g_effects.reverb.fdl_im, 0, sizeof(float) * spectra);
+            memset(g_effects.reverb.input, 0, sizeof(float) * REVERB_FFT_SIZE);
+            g_effects.reverb.head = 0;
+        }
+        if (g_effects.pitch.enabled) {
+            pitch_shift_reset(&g_effects.pitch);
+        }
+        return 0;
+    }
+
+    effects_release();
+
+    for (int band = 0; band < EFFECT_EQ_BANDS; band++) {
+        if (g_effects.eq[band].enabled) {
+            biquad_configure(&g_effects.eq[band], band, g_effects.eq[band].parameter, g_sample_rate);
+        }
+    }
+    if (g_effects.reverb.enabled) {
+        if (fft_plan_init(&g_effects.reverb_fft, REVERB_FFT_SIZE) != 0 ||
+            reverb_prepare(&g_effects.reverb, &g_effects.reverb_fft, g_sample_rate) != 0) {
+            effects_release();
+            return -1;
+        }
+    }
+    if (g_effects.pitch.enabled) {
+        if (fft_plan_init(&g_effects.pitch_fft, PITCH_FRAME_SIZE) != 0 ||
+            pitch_shift_prepare(&g_effects.pitch) != 0) {
+            effects_release();
+            return -1;
+        }
+    }
+
+    g_effects.prepared_rate = g_sample_rate;
+    return 0;
+}
+
+static int effects_active(void)
+{
+    for (int band = 0; band < EFFECT_EQ_BANDS; band++) {
+        if (g_effects.eq[band].enabled) return 1;
+    }
+    return g_effects.reverb.enabled || g_effects.pitch.enabled;
+}
+
+// Run the chain over one block, convert to 16-bit PCM and write it in one call
+static size_t effects_write_block(FILE *wav_file, int frames)
+{
+    float *block = g_effects.block;
+
+    if (frames < EFFECT_BLOCK_FRAMES) {
+        memset(block + frames, 0, sizeof(float) * (EFFECT_BLOCK_FRAMES - frames));
+    }
+
+    for (int band = 0; band < EFFECT_EQ_BANDS; band++) {
+        if (g_effects.eq[band].enabled) {
+            biquad_process(&g_effects.eq[band], block, EFFECT_BLOCK_FRAMES);
+        }
+    }
+    if (g_effects.pitch.enabled) {
+        pitch_shift_process(&g_effects.pitch, &g_effects.pitch_fft, block, EFFECT_BLOCK_FRAMES, g_sample_rate);
+    }
+    if (g_effects.reverb.enabled) {
+        reverb_process(&g_effects.reverb, &g_effects.reverb_fft, block);
+    }
+
+    for (int i = 0; i < frames; i++) {
+        float sample = block[i] * 32767.0f;
+        if (sample > 32767.0f) sample = 32767.0f;
+        if (sample < -32768.0f) sample = -32768.0f;
+        g_effects.pcm[i] = (short)sample;
+    }
+    return fwrite(g_effects.pcm, sizeof(short), frames, wav_file);
+}
+
 // Initialize audio system
 AUDIO_API int init_audio(int sample_rate)
 {
@@ -141,9 +707,20 @@ AUDIO_API int generate_wav(const char* filename, audio_sample_node_t* samples)
     fwrite("data", 1, 4, wav_file);
     fwrite(&data_size, 4, 1, wav_file);
     
-    // Generate enhanced PCM data with smooth transitions
+    // Effect state is allocated here, once, so the render loop never allocates
+    if (effects_prepare() != 0) {
+        printf("[AudioEngine] Error: Could not allocate effect buffers\n");
+        fclose(wav_file);
+        return -1;
+    }
+    if (effects_active()) {
+        printf("[AudioEngine] Effects chain active (%d-frame blocks)\n", EFFECT_BLOCK_FRAMES);
+    }
+    
+    // Generate enhanced PCM data with smooth transitions, rendered in blocks
     current = samples;
     double phase = 0.0;
+    int filled = 0;
     
     while (current) {
         int samples_for_this_note = (int)(current->duration * g_sample_rate);
@@ -167,8 +744,11 @@ AUDIO_API int generate_wav(const char* filename, audio_sample_node_t* samples)
             }
             
             double sample = amp * envelope * (fundamental + harmonic2 + harmonic3);
-            short pcm_sample = (short)(sample * 32767.0 * 0.8); // Prevent clipping
-            fwrite(&pcm_sample, 2, 1, wav_file);
+            g_effects.block[filled++] = (float)(sample * 0.8); // Prevent clipping
+            if (filled == EFFECT_BLOCK_FRAMES) {
+                effects_write_block(wav_file, filled);
+                filled = 0;
+            }
         }
         
         // Maintain phase continuity
@@ -176,6 +756,10 @@ AUDIO_API int generate_wav(const char* filename, audio_sample_node_t* samples)
         current = current->next;
     }
     
+    if (filled > 0) {
+        effects_write_block(wav_file, filled);
+    }
+    
     fclose(wav_file);
     printf("[AudioEngine] WAV file generated successfully\n");
     return 0;
@@ -214,7 +798,7 @@ AUDIO_API int set_master_volume(double volume)
     return 0;
 }
 
-// Apply audio effect (basic implementation)
+// Configure an effect in the block-processing chain applied by generate_wav
 AUDIO_API int apply_audio_effect(const char* effect_name, double parameter)
 {
     if (!effect_name) return -1;
@@ -224,17 +808,38 @@ AUDIO_API int apply_audio_effect(const char* effect_name, double parameter)
     if (strcmp(effect_name, "volume") == 0) {
         return set_master_volume(parameter);
     } else if (strcmp(effect_name, "pitch") == 0) {
-        // Pitch shift effect (placeholder)
+        // Phase-vocoder pitch shift in semitones, 0 disables
+        g_effects.pitch.enabled = parameter != 0.0;
+        g_effects.pitch.semitones = parameter;
         printf("[AudioEngine] Pitch shift by %.2f semitones\n", parameter);
-        return 0;
     } else if (strcmp(effect_name, "reverb") == 0) {
-        // Reverb effect (placeholder)
+        // Partitioned FFT-convolution reverb with the given RT60 decay in seconds, 0 disables
+        g_effects.reverb.enabled = parameter > 0.0;
+        g_effects.reverb.decay = parameter;
         printf("[AudioEngine] Reverb with %.2f decay\n", parameter);
-        return 0;
+    } else if (strcmp(effect_name, "bass") == 0 || strcmp(effect_name, "treble") == 0) {
+        // Shelving EQ gain in dB, 0 disables
+        int band = strcmp(effect_name, "bass") == 0 ? EQ_BASS : EQ_TREBLE;
+        g_effects.eq[band].enabled = parameter != 0.0;
+        g_effects.eq[band].parameter = parameter;
+    } else if (strcmp(effect_name, "lowpass") == 0 || strcmp(effect_name, "highpass") == 0) {
+        // Cutoff frequency in Hz, 0 disables
+        int band = strcmp(effect_name, "lowpass") == 0 ? EQ_LOWPASS : EQ_HIGHPASS;
+        g_effects.eq[band].enabled = parameter > 0.0;
+        g_effects.eq[band].parameter = parameter;
+    } else if (strcmp(effect_name, "reset") == 0) {
+        effects_release();
+        memset(g_effects.eq, 0, sizeof(g_effects.eq));
+        g_effects.pitch.enabled = 0;
+        g_effects.reverb.enabled = 0;
+    } else {
+        printf("[AudioEngine] Unknown effect: %s\n", effect_name);
+        return -1;
     }
     
-    printf("[AudioEngine] Unknown effect: %s\n", effect_name);
-    return -1;
+    // Rebuild effect state before the next render
+    g_effects.prepared_rate = 0;
+    return 0;
 }
 
 // Get audio devices (placeholder)
@@ -279,150 +884,594 @@ AUDIO_API const char* get_library_name(void)
     return g_library_name;
 }
 
-// Generate analysis report file
-AUDIO_API int generate_analysis_report(audio_sample_node_t* samples, const char* filename)
+// Buffered text output for the sidecar writers: avoids per-field printf/locale overhead.
+// Filled chunks are handed to a background I/O thread so formatting never waits on disk.
+#define TEXT_BUFFER_SIZE (1 << 18)
+#define IO_MAX_PENDING_CHUNKS 16
+
+typedef struct io_chunk {
+    struct io_chunk *next;
+    FILE *file;
+    size_t length;
+    char data[TEXT_BUFFER_SIZE];
+} io_chunk_t;
+
+// Single writer thread draining a FIFO of chunks; chunks for one file stay in order
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t drained;
+    io_chunk_t *head;
+    io_chunk_t *tail;
+    int pending;
+    int closing;
+    int error;
+} io_writer_t;
+
+typedef struct {
+    FILE *file;
+    io_writer_t *writer;
+    io_chunk_t *chunk;
+    io_chunk_t *held_head;   // chunks kept back until released (report body)
+    io_chunk_t *held_tail;
+    int hold;
+    int error;
+} text_buffer_t;
+
+static void *io_writer_main(void *arg)
 {
-    if (!samples || !filename) return -1;
-    
-    char report_filename[512];
-    snprintf(report_filename, sizeof(report_filename), "%s_analysis.txt", filename);
-    
-    FILE* report = fopen(report_filename, "w");
-    if (!report) {
-        printf("[AudioEngine] Error: Could not create analysis report\n");
+    io_writer_t *writer = (io_writer_t*)arg;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (!writer->head && !writer->closing) {
+            pthread_cond_wait(&writer->ready, &writer->lock);
+        }
+        io_chunk_t *chunk = writer->head;
+        if (!chunk) break;
+        writer->head = chunk->next;
+        if (!writer->head) writer->tail = NULL;
+        pthread_mutex_unlock(&writer->lock);
+
+        int failed = fwrite(chunk->data, 1, chunk->length, chunk->file) != chunk->length;
+        free(chunk);
+
+        pthread_mutex_lock(&writer->lock);
+        if (failed) writer->error = 1;
+        writer->pending--;
+        pthread_cond_signal(&writer->drained);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+static int io_writer_start(io_writer_t *writer)
+{
+    memset(writer, 0, sizeof(*writer));
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->ready, NULL);
+    pthread_cond_init(&writer->drained, NULL);
+    if (pthread_create(&writer->thread, NULL, io_writer_main, writer) != 0) {
+        pthread_cond_destroy(&writer->drained);
+        pthread_cond_destroy(&writer->ready);
+        pthread_mutex_destroy(&writer->lock);
         return -1;
     }
-    
-    fprintf(report, "SONAR Audio Analysis Report\n");
-    fprintf(report, "===========================\n\n");
-    fprintf(report, "Generated by: %s\n", get_library_name());
-    fprintf(report, "Version: %s\n\n", get_library_version());
-    
-    // Analyze samples
-    int sample_count = 0;
-    double total_freq = 0.0, min_freq = 999999.0, max_freq = 0.0;
-    double total_amp = 0.0, min_amp = 1.0, max_amp = 0.0;
-    
-    audio_sample_node_t* current = samples;
-    while (current) {
-        total_freq += current->frequency;
-        total_amp += current->amplitude;
-        
-        if (current->frequency < min_freq) min_freq = current->frequency;
-        if (current->frequency > max_freq) max_freq = current->frequency;
-        if (current->amplitude < min_amp) min_amp = current->amplitude;
-        if (current->amplitude > max_amp) max_amp = current->amplitude;
-        
-        sample_count++;
-        current = current->next;
+    return 0;
+}
+
+// Queue a chunk for writing; blocks while too many chunks are in flight
+static void io_writer_submit(io_writer_t *writer, io_chunk_t *chunk)
+{
+    chunk->next = NULL;
+    pthread_mutex_lock(&writer->lock);
+    while (writer->pending >= IO_MAX_PENDING_CHUNKS) {
+        pthread_cond_wait(&writer->drained, &writer->lock);
     }
-    
-    if (sample_count > 0) {
-        fprintf(report, "Sample Statistics:\n");
-        fprintf(report, "- Total samples: %d\n", sample_count);
-        fprintf(report, "- Average frequency: %.2f Hz\n", total_freq / sample_count);
-        fprintf(report, "- Frequency range: %.2f - %.2f Hz\n", min_freq, max_freq);
-        fprintf(report, "- Average amplitude: %.3f\n", total_amp / sample_count);
-        fprintf(report, "- Amplitude range: %.3f - %.3f\n\n", min_amp, max_amp);
-        
-        fprintf(report, "Detailed Sample Data:\n");
-        fprintf(report, "Byte\tFreq(Hz)\tAmp\tDuration(s)\n");
-        fprintf(report, "----\t--------\t---\t-----------\n");
-        
-        current = samples;
-        while (current) {
-            fprintf(report, "0x%02X\t%.2f\t\t%.3f\t%.3f\n", 
-                   current->source_byte, current->frequency, 
-                   current->amplitude, current->duration);
-            current = current->next;
+    if (writer->tail) writer->tail->next = chunk;
+    else writer->head = chunk;
+    writer->tail = chunk;
+    writer->pending++;
+    pthread_cond_signal(&writer->ready);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+// Write out everything still queued and stop the thread
+static int io_writer_finish(io_writer_t *writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    writer->closing = 1;
+    pthread_cond_signal(&writer->ready);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    pthread_cond_destroy(&writer->drained);
+    pthread_cond_destroy(&writer->ready);
+    pthread_mutex_destroy(&writer->lock);
+    return writer->error ? -1 : 0;
+}
+
+static const char g_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const double g_pow10[] = {1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0, 1000000.0};
+
+static io_chunk_t *text_new_chunk(text_buffer_t *out)
+{
+    io_chunk_t *chunk = malloc(sizeof(io_chunk_t));
+    if (chunk) {
+        chunk->next = NULL;
+        chunk->file = out->file;
+        chunk->length = 0;
+    }
+    return chunk;
+}
+
+static int text_open(text_buffer_t *out, FILE *file, io_writer_t *writer, int hold)
+{
+    out->file = file;
+    out->writer = writer;
+    out->held_head = NULL;
+    out->held_tail = NULL;
+    out->hold = hold;
+    out->error = 0;
+    out->chunk = text_new_chunk(out);
+    return out->chunk ? 0 : -1;
+}
+
+// Hand the current chunk over (to the I/O thread, the held list, or straight to disk)
+static void text_flush(text_buffer_t *out)
+{
+    io_chunk_t *chunk = out->chunk;
+    if (!chunk || chunk->length == 0) return;
+
+    if (out->hold) {
+        if (out->held_tail) out->held_tail->next = chunk;
+        else out->held_head = chunk;
+        out->held_tail = chunk;
+    } else if (out->writer) {
+        io_writer_submit(out->writer, chunk);
+    } else {
+        if (fwrite(chunk->data, 1, chunk->length, chunk->file) != chunk->length) out->error = 1;
+        chunk->length = 0;
+        return;
+    }
+
+    out->chunk = text_new_chunk(out);
+    if (!out->chunk) out->error = 1;
+}
+
+// Append all chunks held by another buffer (used to place the report body after its header)
+static void text_append_held(text_buffer_t *out, text_buffer_t *held)
+{
+    text_flush(held);
+    text_flush(out);
+    io_chunk_t *chunk = held->held_head;
+    held->held_head = held->held_tail = NULL;
+    while (chunk) {
+        io_chunk_t *next = chunk->next;
+        chunk->file = out->file;
+        if (out->writer) {
+            io_writer_submit(out->writer, chunk);
+        } else {
+            if (fwrite(chunk->data, 1, chunk->length, chunk->file) != chunk->length) out->error = 1;
+            free(chunk);
         }
+        chunk = next;
     }
-    
-    fclose(report);
-    printf("[AudioEngine] Analysis report saved: %s\n", report_filename);
-    return 0;
 }
 
-// Generate frequency data CSV file
-AUDIO_API int generate_frequency_data(audio_sample_node_t* samples, const char* filename)
+static int text_close(text_buffer_t *out)
 {
-    if (!samples || !filename) return -1;
-    
-    char csv_filename[512];
-    snprintf(csv_filename, sizeof(csv_filename), "%s_frequencies.csv", filename);
-    
-    FILE* csv = fopen(csv_filename, "w");
-    if (!csv) {
-        printf("[AudioEngine] Error: Could not create CSV file\n");
-        return -1;
+    int hold = out->hold;
+    out->hold = 0;
+    if (!hold) text_flush(out);
+    free(out->chunk);
+    out->chunk = NULL;
+    while (out->held_head) {
+        io_chunk_t *next = out->held_head->next;
+        free(out->held_head);
+        out->held_head = next;
     }
-    
-    fprintf(csv, "Sample,Byte_Hex,Byte_Dec,Frequency_Hz,Amplitude,Duration_s\n");
-    
-    audio_sample_node_t* current = samples;
-    int index = 0;
-    
-    while (current) {
-        fprintf(csv, "%d,0x%02X,%d,%.2f,%.3f,%.3f\n", 
-               index, current->source_byte, current->source_byte,
-               current->frequency, current->amplitude, current->duration);
-        current = current->next;
-        index++;
+    out->held_tail = NULL;
+    return out->error ? -1 : 0;
+}
+
+// Make room for at least n more bytes (n is always far below the buffer size)
+static char *text_reserve(text_buffer_t *out, size_t n)
+{
+    if (out->chunk && out->chunk->length + n > TEXT_BUFFER_SIZE) {
+        text_flush(out);
     }
-    
-    fclose(csv);
-    printf("[AudioEngine] Frequency data saved: %s\n", csv_filename);
-    return 0;
+    return out->chunk ? out->chunk->data + out->chunk->length : NULL;
 }
 
-// Generate audio metadata JSON file
-AUDIO_API int generate_metadata_json(audio_sample_node_t* samples, const char* filename)
+static void text_write(text_buffer_t *out, const char *s, size_t length)
+{
+    while (length > 0) {
+        if (!out->chunk) return;
+        size_t room = TEXT_BUFFER_SIZE - out->chunk->length;
+        if (room == 0) {
+            text_flush(out);
+            continue;
+        }
+        size_t n = length < room ? length : room;
+        memcpy(out->chunk->data + out->chunk->length, s, n);
+        out->chunk->length += n;
+        s += n;
+        length -= n;
+    }
+}
+
+static void text_str(text_buffer_t *out, const char *s)
+{
+    text_write(out, s, strlen(s));
+}
+
+static void text_uint(text_buffer_t *out, unsigned long long value)
+{
+    char digits[20];
+    int pos = sizeof(digits);
+
+    while (value >= 100) {
+        unsigned int pair = (unsigned int)(value % 100) * 2;
+        value /= 100;
+        digits[--pos] = g_digit_pairs[pair + 1];
+        digits[--pos] = g_digit_pairs[pair];
+    }
+    if (value >= 10) {
+        unsigned int pair = (unsigned int)value * 2;
+        digits[--pos] = g_digit_pairs[pair + 1];
+        digits[--pos] = g_digit_pairs[pair];
+    } else {
+        digits[--pos] = (char)('0' + value);
+    }
+
+    text_write(out, digits + pos, sizeof(digits) - pos);
+}
+
+static void text_int(text_buffer_t *out, long long value)
+{
+    if (value < 0) {
+        text_write(out, "-", 1);
+        text_uint(out, 0ULL - (unsigned long long)value);
+    } else {
+        text_uint(out, (unsigned long long)value);
+    }
+}
+
+// Equivalent of printf("%02X", value)
+static void text_hex2(text_buffer_t *out, unsigned char value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char *p = text_reserve(out, 2);
+    if (!p) return;
+    p[0] = hex[value >> 4];
+    p[1] = hex[value & 0x0F];
+    out->chunk->length += 2;
+}
+
+// Equivalent of printf("%.*f", decimals, value) for 0-6 decimals, via scaled integers.
+// Rounds on the exact binary value (ties to even), so output matches printf.
+static void text_fixed(text_buffer_t *out, double value, int decimals)
+{
+    if (decimals < 0) decimals = 0;
+    if (decimals > 6) decimals = 6;
+
+    double scale = g_pow10[decimals];
+    double magnitude = fabs(value);
+    if (!(magnitude * scale < 9.0e15)) {
+        // Out of exact integer range (or NaN/inf): defer to the C library
+        char fallback[512];
+        int length = snprintf(fallback, sizeof(fallback), "%.*f", decimals, value);
+        text_write(out, fallback, length > 0 ? (size_t)length : 0);
+        return;
+    }
+
+    double scaled = magnitude * scale;
+    double rounded = floor(scaled);
+    double fraction = scaled - rounded;
+    if (fraction > 0.5) {
+        rounded += 1.0;
+    } else if (fraction == 0.5) {
+        // The product may itself have been rounded onto the tie: use its exact residual
+        double residual = fma(magnitude, scale, -scaled);
+        if (residual > 0.0 || (residual == 0.0 && fmod(rounded, 2.0) != 0.0)) {
+            rounded += 1.0;
+        }
+    }
+
+    unsigned long long units = (unsigned long long)rounded;
+    unsigned long long divisor = (unsigned long long)scale;
+    if (signbit(value)) {
+        text_write(out, "-", 1);
+    }
+
+    text_uint(out, units / divisor);
+    if (decimals > 0) {
+        char *p = text_reserve(out, decimals + 1);
+        if (!p) return;
+        unsigned long long remainder = units % divisor;
+        p[0] = '.';
+        for (int i = decimals; i >= 1; i--) {
+            p[i] = (char)('0' + remainder % 10);
+            remainder /= 10;
+        }
+        out->chunk->length += decimals + 1;
+    }
+}
+
+// Single-pass sidecar emitter: one walk of the sample list feeds every requested format
+typedef struct {
+    int sample_count;
+    double total_freq, min_freq, max_freq;
+    double total_amp, min_amp, max_amp;
+} sidecar_stats_t;
+
+typedef struct {
+    int formats;
+    FILE *file[3];
+    char filename[3][512];
+    text_buffer_t out[3];
+    text_buffer_t report_body;
+} sidecar_job_t;
+
+enum { SIDECAR_SLOT_REPORT, SIDECAR_SLOT_CSV, SIDECAR_SLOT_JSON };
+
+static const char *g_sidecar_suffix[3] = {"_analysis.txt", "_frequencies.csv", "_metadata.json"};
+static const char *g_sidecar_error[3] = {"analysis report", "CSV file", "JSON file"};
+static const char *g_sidecar_saved[3] = {"Analysis report", "Frequency data", "Metadata"};
+
+static void sidecar_emit_report_row(text_buffer_t *out, const audio_sample_node_t *node)
+{
+    text_write(out, "0x", 2);
+    text_hex2(out, node->source_byte);
+    text_write(out, "\t", 1);
+    text_fixed(out, node->frequency, 2);
+    text_write(out, "\t\t", 2);
+    text_fixed(out, node->amplitude, 3);
+    text_write(out, "\t", 1);
+    text_fixed(out, node->duration, 3);
+    text_write(out, "\n", 1);
+}
+
+static void sidecar_emit_csv_row(text_buffer_t *out, const audio_sample_node_t *node, int index)
+{
+    text_int(out, index);
+    text_write(out, ",0x", 3);
+    text_hex2(out, node->source_byte);
+    text_write(out, ",", 1);
+    text_uint(out, node->source_byte);
+    text_write(out, ",", 1);
+    text_fixed(out, node->frequency, 2);
+    text_write(out, ",", 1);
+    text_fixed(out, node->amplitude, 3);
+    text_write(out, ",", 1);
+    text_fixed(out, node->duration, 3);
+    text_write(out, "\n", 1);
+}
+
+static void sidecar_emit_json_row(text_buffer_t *out, const audio_sample_node_t *node, int first)
+{
+    if (!first) text_write(out, ",\n", 2);
+    text_str(out, "    {\n      \"byte\": \"0x");
+    text_hex2(out, node->source_byte);
+    text_str(out, "\",\n      \"frequency\": ");
+    text_fixed(out, node->frequency, 2);
+    text_str(out, ",\n      \"amplitude\": ");
+    text_fixed(out, node->amplitude, 3);
+    text_str(out, ",\n      \"duration\": ");
+    text_fixed(out, node->duration, 3);
+    text_str(out, "\n    }");
+}
+
+// The report leads with statistics, so its rows are held back and appended after the header
+static void sidecar_emit_report(text_buffer_t *out, text_buffer_t *body, const sidecar_stats_t *stats)
+{
+    text_str(out, "SONAR Audio Analysis Report\n");
+    text_str(out, "===========================\n\n");
+    text_str(out, "Generated by: ");
+    text_str(out, get_library_name());
+    text_str(out, "\nVersion: ");
+    text_str(out, get_library_version());
+    text_str(out, "\n\n");
+
+    if (stats->sample_count > 0) {
+        text_str(out, "Sample Statistics:\n- Total samples: ");
+        text_int(out, stats->sample_count);
+        text_str(out, "\n- Average frequency: ");
+        text_fixed(out, stats->total_freq / stats->sample_count, 2);
+        text_str(out, " Hz\n- Frequency range: ");
+        text_fixed(out, stats->min_freq, 2);
+        text_str(out, " - ");
+        text_fixed(out, stats->max_freq, 2);
+        text_str(out, " Hz\n- Average amplitude: ");
+        text_fixed(out, stats->total_amp / stats->sample_count, 3);
+        text_str(out, "\n- Amplitude range: ");
+        text_fixed(out, stats->min_amp, 3);
+        text_str(out, " - ");
+        text_fixed(out, stats->max_amp, 3);
+        text_str(out, "\n\n");
+
+        text_str(out, "Detailed Sample Data:\n");
+        text_str(out, "Byte\tFreq(Hz)\tAmp\tDuration(s)\n");
+        text_str(out, "----\t--------\t---\t-----------\n");
+        text_append_held(out, body);
+    }
+}
+
+AUDIO_API int generate_sidecars(audio_sample_node_t* samples, const char* filename, int formats)
 {
     if (!samples || !filename) return -1;
-    
-    char json_filename[512];
-    snprintf(json_filename, sizeof(json_filename), "%s_metadata.json", filename);
-    
-    FILE* json = fopen(json_filename, "w");
-    if (!json) {
-        printf("[AudioEngine] Error: Could not create JSON file\n");
-        return -1;
+    formats &= AUDIO_SIDECAR_ALL;
+    if (!formats) return 0;
+
+    int status = 0;
+    sidecar_job_t job;
+    memset(&job, 0, sizeof(job));
+
+    for (int slot = 0; slot < 3; slot++) {
+        if (!(formats & (1 << slot))) continue;
+        snprintf(job.filename[slot], sizeof(job.filename[slot]), "%s%s", filename, g_sidecar_suffix[slot]);
+        job.file[slot] = fopen(job.filename[slot], "w");
+        if (!job.file[slot]) {
+            printf("[AudioEngine] Error: Could not create %s\n", g_sidecar_error[slot]);
+            status = -1;
+            continue;
+        }
+        job.formats |= 1 << slot;
     }
-    
-    fprintf(json, "{\n");
-    fprintf(json, "  \"audio_engine\": {\n");
-    fprintf(json, "    \"name\": \"%s\",\n", get_library_name());
-    fprintf(json, "    \"version\": \"%s\"\n", get_library_version());
-    fprintf(json, "  },\n");
-    fprintf(json, "  \"audio_config\": {\n");
-    fprintf(json, "    \"sample_rate\": %d,\n", g_sample_rate);
-    fprintf(json, "    \"master_volume\": %.2f\n", g_master_volume);
-    fprintf(json, "  },\n");
-    fprintf(json, "  \"samples\": [\n");
-    
-    audio_sample_node_t* current = samples;
-    int first = 1;
-    
-    while (current) {
-        if (!first) fprintf(json, ",\n");
-        fprintf(json, "    {\n");
-        fprintf(json, "      \"byte\": \"0x%02X\",\n", current->source_byte);
-        fprintf(json, "      \"frequency\": %.2f,\n", current->frequency);
-        fprintf(json, "      \"amplitude\": %.3f,\n", current->amplitude);
-        fprintf(json, "      \"duration\": %.3f\n", current->duration);
-        fprintf(json, "    }");
-        current = current->next;
-        first = 0;
+    if (!job.formats) return -1;
+
+    // Without a writer thread the buffers fall back to writing synchronously
+    io_writer_t writer;
+    io_writer_t *io = io_writer_start(&writer) == 0 ? &writer : NULL;
+
+    int open_failed = 0;
+    for (int slot = 0; slot < 3; slot++) {
+        if (job.formats & (1 << slot)) {
+            open_failed |= text_open(&job.out[slot], job.file[slot], io, 0);
+        }
     }
-    
-    fprintf(json, "\n  ]\n");
-    fprintf(json, "}\n");
-    
-    fclose(json);
-    printf("[AudioEngine] Metadata saved: %s\n", json_filename);
+    if (job.formats & AUDIO_SIDECAR_REPORT) {
+        open_failed |= text_open(&job.report_body, job.file[SIDECAR_SLOT_REPORT], io, 1);
+    }
+
+    if (!open_failed) {
+        sidecar_stats_t stats = {0, 0.0, 999999.0, 0.0, 0.0, 1.0, 0.0};
+        text_buffer_t *report = (job.formats & AUDIO_SIDECAR_REPORT) ? &job.report_body : NULL;
+        text_buffer_t *csv = (job.formats & AUDIO_SIDECAR_CSV) ? &job.out[SIDECAR_SLOT_CSV] : NULL;
+        text_buffer_t *json = (job.formats & AUDIO_SIDECAR_JSON) ? &job.out[SIDECAR_SLOT_JSON] : NULL;
+
+        if (csv) {
+            text_str(csv, "Sample,Byte_Hex,Byte_Dec,Frequency_Hz,Amplitude,Duration_s\n");
+        }
+        if (json) {
+            text_str(json, "{\n  \"audio_engine\": {\n    \"name\": \"");
+            text_str(json, get_library_name());
+            text_str(json, "\",\n    \"version\": \"");
+            text_str(json, get_library_version());
+            text_str(json, "\"\n  },\n  \"audio_config\": {\n    \"sample_rate\": ");
+            text_int(json, g_sample_rate);
+            text_str(json, ",\n    \"master_volume\": ");
+            text_fixed(json, g_master_volume, 2);
+            text_str(json, "\n  },\n  \"samples\": [\n");
+        }
+
+        for (const audio_sample_node_t* current = samples; current; current = current->next) {
+            stats.total_freq += current->frequency;
+            stats.total_amp += current->amplitude;
+            if (current->frequency < stats.min_freq) stats.min_freq = current->frequency;
+            if (current->frequency > stats.max_freq) stats.max_freq = current->frequency;
+            if (current->amplitude < stats.min_amp) stats.min_amp = current->amplitude;
+            if (current->amplitude > stats.max_amp) stats.max_amp = current->amplitude;
+
+            if (report) sidecar_emit_report_row(report, current);
+            if (csv) sidecar_emit_csv_row(csv, current, stats.sample_count);
+            if (json) sidecar_emit_json_row(json, current, stats.sample_count == 0);
+            stats.sample_count++;
+        }
+
+        if (json) text_str(json, "\n  ]\n}\n");
+        if (report) sidecar_emit_report(&job.out[SIDECAR_SLOT_REPORT], report, &stats);
+    } else {
+        status = -1;
+    }
+
+    int slot_status[3] = {0, 0, 0};
+    if (job.formats & AUDIO_SIDECAR_REPORT) {
+        slot_status[SIDECAR_SLOT_REPORT] |= text_close(&job.report_body);
+    }
+    for (int slot = 0; slot < 3; slot++) {
+        if (job.formats & (1 << slot)) slot_status[slot] |= text_close(&job.out[slot]);
+    }
+
+    // Drain the writer before closing the files it writes to
+    int io_status = io ? io_writer_finish(io) : 0;
+    for (int slot = 0; slot < 3; slot++) {
+        if (!(job.formats & (1 << slot))) continue;
+        if (fclose(job.file[slot]) != 0) slot_status[slot] = -1;
+        if (open_failed || slot_status[slot] != 0 || io_status != 0) {
+            printf("[AudioEngine] Error: Could not write %s\n", job.filename[slot]);
+            status = -1;
+        } else {
+            printf("[AudioEngine] %s saved: %s\n", g_sidecar_saved[slot], job.filename[slot]);
+        }
+    }
+
+    return status;
+}
+
+// Background sidecar job, so the caller can synthesize the WAV at the same time
+typedef struct {
+    pthread_t thread;
+    int active;
+    int status;
+    audio_sample_node_t* samples;
+    char filename[512];
+    int formats;
+} sidecar_task_t;
+
+static sidecar_task_t g_sidecar_task;
+
+static void *sidecar_task_main(void *arg)
+{
+    sidecar_task_t *task = (sidecar_task_t*)arg;
+    task->status = generate_sidecars(task->samples, task->filename, task->formats);
+    return NULL;
+}
+
+AUDIO_API int begin_sidecars(audio_sample_node_t* samples, const char* filename, int formats)
+{
+    if (!samples || !filename || g_sidecar_task.active) return -1;
+
+    g_sidecar_task.samples = samples;
+    g_sidecar_task.formats = formats;
+    g_sidecar_task.status = 0;
+    snprintf(g_sidecar_task.filename, sizeof(g_sidecar_task.filename), "%s", filename);
+
+    if (pthread_create(&g_sidecar_task.thread, NULL, sidecar_task_main, &g_sidecar_task) != 0) {
+        // No thread available: do the work now so end_sidecars still reports it
+        g_sidecar_task.status = generate_sidecars(samples, filename, formats);
+        g_sidecar_task.active = -1;
+        return 0;
+    }
+    g_sidecar_task.active = 1;
     return 0;
 }
 
+AUDIO_API int end_sidecars(void)
+{
+    if (!g_sidecar_task.active) return -1;
+    if (g_sidecar_task.active > 0) {
+        pthread_join(g_sidecar_task.thread, NULL);
+    }
+    g_sidecar_task.active = 0;
+    g_sidecar_task.samples = NULL;
+    return g_sidecar_task.status;
+}
+
+// Generate analysis report file
+AUDIO_API int generate_analysis_report(audio_sample_node_t* samples, const char* filename)
+{
+    return generate_sidecars(samples, filename, AUDIO_SIDECAR_REPORT);
+}
+
+// Generate frequency data CSV file
+AUDIO_API int generate_frequency_data(audio_sample_node_t* samples, const char* filename)
+{
+    return generate_sidecars(samples, filename, AUDIO_SIDECAR_CSV);
+}
+
+// Generate audio metadata JSON file
+AUDIO_API int generate_metadata_json(audio_sample_node_t* samples, const char* filename)
+{
+    return generate_sidecars(samples, filename, AUDIO_SIDECAR_JSON);
+}
+
 // Cleanup audio system
 AUDIO_API void cleanup_audio(void)
 {
@@ -434,6 +1483,7 @@ AUDIO_API void cleanup_audio(void)
     
     // Clear buffers
     memset(g_audio_buffer, 0, sizeof(g_audio_buffer));
+    effects_release();
     g_buffer_pos = 0;
     g_master_volume = 1.0;
     g_initialized = 0;
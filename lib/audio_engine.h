@@ -127,7 +127,17 @@ AUDIO_API int set_master_volume(double volume);
 /**
  * @brief Apply audio effect to output
  * 
- * Applies the specified audio effect with the given parameter.
+ * Configures an effect in the block-processing chain used by generate_wav.
+ * Rendering runs in 512-frame blocks through EQ, pitch shift and reverb;
+ * all effect buffers are allocated once before rendering starts.
+ * 
+ * Supported effects:
+ * - "volume": master volume (0.0 - 1.0)
+ * - "bass", "treble": shelving EQ gain in dB (0 disables)
+ * - "lowpass", "highpass": biquad cutoff frequency in Hz (0 disables)
+ * - "pitch": phase-vocoder pitch shift in semitones (0 disables)
+ * - "reverb": partitioned FFT-convolution reverb, RT60 decay in seconds (0 disables)
+ * - "reset": disable all effects except volume
  * 
  * @param effect_name Name of the effect to apply
  * @param parameter Effect parameter value
@@ -135,6 +145,51 @@ AUDIO_API int set_master_volume(double volume);
  */
 AUDIO_API int apply_audio_effect(const char* effect_name, double parameter);
 
+/** @name Sidecar formats
+ *  Flags selecting the files written by generate_sidecars()
+ *  @{ */
+#define AUDIO_SIDECAR_REPORT 0x1 /**< "<name>_analysis.txt" statistics and sample table */
+#define AUDIO_SIDECAR_CSV    0x2 /**< "<name>_frequencies.csv" per-sample frequency data */
+#define AUDIO_SIDECAR_JSON   0x4 /**< "<name>_metadata.json" engine, config and sample metadata */
+#define AUDIO_SIDECAR_ALL    0x7 /**< All sidecar formats */
+/** @} */
+
+/**
+ * @brief Generate sidecar files in a single pass
+ * 
+ * Walks the sample list once, accumulating report statistics and
+ * formatting every requested file in the same traversal. Formatted
+ * output is written by a background I/O thread.
+ * 
+ * @param samples Pointer to first node in audio sample linked list
+ * @param filename Base filename for the sidecars (without extension)
+ * @param formats Bitwise OR of AUDIO_SIDECAR_* flags
+ * @return 0 on success, negative value if any file could not be written
+ */
+AUDIO_API int generate_sidecars(audio_sample_node_t* samples, const char* filename, int formats);
+
+/**
+ * @brief Start sidecar generation in the background
+ * 
+ * Runs generate_sidecars() on a worker thread so that sidecar output
+ * overlaps with WAV synthesis. The sample list must stay unchanged until
+ * end_sidecars() returns. Only one background job may be active.
+ * 
+ * @param samples Pointer to first node in audio sample linked list
+ * @param filename Base filename for the sidecars (without extension)
+ * @param formats Bitwise OR of AUDIO_SIDECAR_* flags
+ * @return 0 if the job was started, negative value on error
+ */
+AUDIO_API int begin_sidecars(audio_sample_node_t* samples, const char* filename, int formats);
+
+/**
+ * @brief Wait for background sidecar generation to finish
+ * 
+ * @return Result of the background generate_sidecars() call, negative
+ *         value if no job was active
+ */
+AUDIO_API int end_sidecars(void);
+
 /**
  * @brief Generate detailed analysis report
  * 
@@ -1,6 +1,22 @@
 /* Mojibake 1.0.0a */
+#if defined(__linux__)
+#define _GNU_SOURCE // SEEK_DATA and SEEK_HOLE
+#endif
+#define _POSIX_C_SOURCE 200809L
 #include "mojibake.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <malloc.h>
+#define MOJIBAKE_FSEEK(f, o) _fseeki64((f), (long long)(o), SEEK_SET)
+#else
+#include <sys/resource.h>
+#include <errno.h>
+#include <unistd.h>
+#define MOJIBAKE_FSEEK(f, o) fseeko((f), (off_t)(o), SEEK_SET)
+#endif
+
 mojibake_partition_t *mojibake_partitionize(mojibake_target_t *target)
 {
     assert(target != NULL);
@@ -11,12 +27,88 @@ mojibake_partition_t *mojibake_partitionize(mojibake_target_t *target)
         malloc(sizeof(mojibake_partition_t) * target->partition_count);
     RETURN_NULL_IF(partitions == NULL);
 
+    // Holes overlapping each partition; the last partition also covers the extra bytes
+    unsigned int hole = 0;
     for (int i = 0; i < target->partition_count; i++)
+    {
+        size_t start = (size_t)i * target->partition_size;
+        size_t end = i == target->partition_count - 1 ? target->size : start + target->partition_size;
+
         partitions[i].index = i;
+        partitions[i].hole_count = 0;
+        partitions[i].zero_bytes = 0;
+        while (hole < target->hole_count &&
+               target->holes[hole].offset + target->holes[hole].length <= start)
+            hole++;
+        partitions[i].first_hole = hole;
+
+        for (unsigned int h = hole; h < target->hole_count && target->holes[h].offset < end; h++)
+        {
+            size_t from = target->holes[h].offset > start ? target->holes[h].offset : start;
+            size_t to = target->holes[h].offset + target->holes[h].length;
+            if (to > end)
+                to = end;
+            partitions[i].hole_count++;
+            partitions[i].zero_bytes += to - from;
+        }
+    }
 
     return partitions;
 }
 
+// Record the file's holes; a file system without hole reporting shows the whole file as data
+static void mojibake_find_holes(mojibake_target_t *target, FILE *handler)
+{
+    target->holes = NULL;
+    target->hole_count = 0;
+    target->hole_bytes = 0;
+
+#if !defined(_WIN32) && defined(SEEK_DATA) && defined(SEEK_HOLE)
+    int fd = fileno(handler);
+    off_t position = 0;
+    off_t size = (off_t)target->size;
+    unsigned int capacity = 0;
+
+    while (position < size && target->hole_count < MOJIBAKE_MAX_HOLES)
+    {
+        off_t data = lseek(fd, position, SEEK_DATA);
+        if (data < 0 && errno != ENXIO)
+            break; // No support for SEEK_DATA
+        if (data < 0 || data > size)
+            data = size; // Nothing but a hole after position
+
+        if (data > position)
+        {
+            if (target->hole_count == capacity)
+            {
+                capacity = capacity ? capacity * 2 : 16;
+                mojibake_extent_t *holes = realloc(target->holes, capacity * sizeof(mojibake_extent_t));
+                if (holes == NULL)
+                    break;
+                target->holes = holes;
+            }
+            target->holes[target->hole_count].offset = (size_t)position;
+            target->holes[target->hole_count].length = (size_t)(data - position);
+            target->hole_bytes += (size_t)(data - position);
+            target->hole_count++;
+        }
+        if (data >= size)
+            break;
+
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        if (hole <= data)
+            break;
+        position = hole;
+    }
+
+    // Reads go through the FILE*, which must not trust the descriptor's position
+    lseek(fd, 0, SEEK_SET);
+    rewind(handler);
+#else
+    (void)handler;
+#endif
+}
+
 void mojibake_departitionize(mojibake_partition_t *partitions)
 {
     if (partitions)
@@ -24,6 +116,11 @@ void mojibake_departitionize(mojibake_partition_t *partitions)
 }
 
 mojibake_target_t *mojibake_open(char *file_path, unsigned int partition_count)
+{
+    return mojibake_open_ex(file_path, partition_count, 0);
+}
+
+mojibake_target_t *mojibake_open_ex(char *file_path, unsigned int partition_count, size_t max_memory)
 {
     mojibake_target_t *target = NULL;
 
@@ -33,12 +130,16 @@ mojibake_target_t *mojibake_open(char *file_path, unsigned int partition_count)
     FILE *handler = NULL;
 
     RETURN_NULL_IF(file_path == NULL)
+    RETURN_NULL_IF(max_memory > 0 && max_memory < MOJIBAKE_MIN_MEMORY)
 
     if (partition_count == 0)
         tmp_partition_count = MOJIBAKE_DEFAULT_PARTITION_COUNT;
 
+    // With a memory budget the file is streamed, so only the stream limit applies
     RETURN_NULL_IF(stat(file_path, &info) != 0)
-    RETURN_NULL_IF((info.st_size == 0) || (info.st_size > MOJIBAKE_MAX_FILE_SIZE))
+    RETURN_NULL_IF((info.st_size == 0) ||
+                   ((unsigned long long)info.st_size >
+                    (max_memory > 0 ? MOJIBAKE_MAX_STREAM_SIZE : MOJIBAKE_MAX_FILE_SIZE)))
 
     handler = fopen(file_path, "rb");
     RETURN_NULL_IF(handler == NULL)
@@ -53,24 +154,64 @@ mojibake_target_t *mojibake_open(char *file_path, unsigned int partition_count)
     target->size = info.st_size;
     target->partition_count = tmp_partition_count;
     target->extra = target->size % target->partition_count;
+    target->max_memory = max_memory;
+    target->block = NULL;
+    target->block_aligned = false;
+    target->stream = NULL;
+    mojibake_find_holes(target, handler);
 
     if (target->extra > 0)
         target->partition_size = (target->size - target->extra) / target->partition_count;
     else
         target->partition_size = (target->size / target->partition_count);
 
-    target->block = malloc(target->size);
-    if (target->block == NULL)
+    if (max_memory > 0)
     {
-        free(target);
-        fclose(handler);
-        return NULL;
+        // Partitions are read on demand through mojibake_read
+        target->stream = handler;
     }
+    else
+    {
+        target->block = malloc(target->size);
+        if (target->block == NULL)
+        {
+            free(target->holes);
+            free(target);
+            fclose(handler);
+            return NULL;
+        }
 
-    read = fread(target->block,
-                 target->size, 1, handler);
-    // TODO: read condition
-    fclose(handler);
+        if (target->hole_count > 0)
+        {
+            // Holes are zero-filled; only the data between them is read
+            size_t position = 0;
+            while (position < target->size)
+            {
+                size_t end;
+                bool hole = mojibake_hole(target, position, &end);
+                if (hole)
+                    memset((unsigned char *)target->block + position, 0, end - position);
+                else if (MOJIBAKE_FSEEK(handler, position) != 0 ||
+                         fread((unsigned char *)target->block + position, end - position, 1, handler) != 1)
+                {
+                    // Data that cannot be read must not pass for a hole
+                    free(target->block);
+                    free(target->holes);
+                    free(target);
+                    fclose(handler);
+                    return NULL;
+                }
+                position = end;
+            }
+        }
+        else
+        {
+            read = fread(target->block,
+                         target->size, 1, handler);
+            // TODO: read condition
+        }
+        fclose(handler);
+    }
 
     target->version = MOJIBAKE_VERSION;
     target->partitions = mojibake_partitionize(target);
@@ -78,6 +219,129 @@ mojibake_target_t *mojibake_open(char *file_path, unsigned int partition_count)
     return target;
 }
 
+// Read at an offset without moving the stream's position, so worker threads can share the stream
+static size_t mojibake_pread(FILE *stream, size_t offset, void *buffer, size_t length)
+{
+    size_t done = 0;
+#ifdef _WIN32
+    HANDLE file = (HANDLE)_get_osfhandle(_fileno(stream));
+    while (done < length)
+    {
+        OVERLAPPED at = {0};
+        unsigned long long position = (unsigned long long)(offset + done);
+        at.Offset = (DWORD)position;
+        at.OffsetHigh = (DWORD)(position >> 32);
+        DWORD got = 0;
+        DWORD want = length - done > 0x40000000 ? 0x40000000 : (DWORD)(length - done);
+        if (!ReadFile(file, (unsigned char *)buffer + done, want, &got, &at) || got == 0)
+            break;
+        done += got;
+    }
+#else
+    int fd = fileno(stream);
+    while (done < length)
+    {
+        ssize_t got = pread(fd, (unsigned char *)buffer + done, length - done, (off_t)(offset + done));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        done += (size_t)got;
+    }
+#endif
+    return done;
+}
+
+size_t mojibake_read(mojibake_target_t *target, size_t offset, void *buffer, size_t length)
+{
+    if (target == NULL || buffer == NULL || offset >= target->size)
+        return 0;
+
+    if (length > target->size - offset)
+        length = target->size - offset;
+
+    if (target->block)
+    {
+        memcpy(buffer, (unsigned char *)target->block + offset, length);
+        return length;
+    }
+
+    if (target->stream == NULL)
+        return 0;
+
+    if (target->hole_count == 0)
+        return mojibake_pread(target->stream, offset, buffer, length);
+
+    // Holes are filled with zeros instead of being read
+    size_t done = 0;
+    while (done < length)
+    {
+        size_t position = offset + done;
+        size_t end;
+        bool hole = mojibake_hole(target, position, &end);
+        size_t run = end - position < length - done ? end - position : length - done;
+
+        if (hole)
+        {
+            memset((unsigned char *)buffer + done, 0, run);
+            done += run;
+            continue;
+        }
+        size_t got = mojibake_pread(target->stream, position, (unsigned char *)buffer + done, run);
+        done += got;
+        if (got < run)
+            break;
+    }
+    return done;
+}
+
+bool mojibake_hole(mojibake_target_t *target, size_t offset, size_t *end)
+{
+    if (target == NULL || offset >= target->size)
+    {
+        if (end)
+            *end = target ? target->size : 0;
+        return false;
+    }
+
+    // Last hole starting at or before offset
+    unsigned int low = 0, high = target->hole_count;
+    while (low < high)
+    {
+        unsigned int middle = low + (high - low) / 2;
+        if (target->holes[middle].offset <= offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low > 0 && offset < target->holes[low - 1].offset + target->holes[low - 1].length)
+    {
+        if (end)
+            *end = target->holes[low - 1].offset + target->holes[low - 1].length;
+        return true;
+    }
+    if (end)
+        *end = low < target->hole_count ? target->holes[low].offset : target->size;
+    return false;
+}
+
+size_t mojibake_peak_memory(void)
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
 void mojibake_close(mojibake_target_t *target)
 {
     if (target)
@@ -91,8 +355,19 @@ void mojibake_close(mojibake_target_t *target)
         mojibake_departitionize(target->partitions);
 
         if (target->block)
-            free(target->block);
+        {
+#ifdef _WIN32
+            if (target->block_aligned)
+                _aligned_free(target->block);
+            else
+#endif
+                free(target->block);
+        }
+
+        if (target->stream)
+            fclose(target->stream);
 
+        free(target->holes);
         free(target);
     }
 }
@@ -110,6 +385,12 @@ void mojibake_print(mojibake_target_t *target)
     printf("partition-extra: %u\n", target->extra);
     printf("\n\n");
 
+    if (ptr == NULL)
+    {
+        printf("streaming (memory budget %zu bytes)\n", target->max_memory);
+        return;
+    }
+
     for (int i = 0; i < target->size; i++)
         printf("%02x", ptr[i]);
     printf("\n\n");
@@ -14,6 +14,10 @@
 
 #define MOJIBAKE_DEFAULT_PARTITION_COUNT 8
 #define MOJIBAKE_MAX_FILE_SIZE 1024 * 1024 * 4
+#define MOJIBAKE_MAX_STREAM_SIZE 0xFFFFFFFFu
+#define MOJIBAKE_MIN_MEMORY (1024 * 1024)
+#define MOJIBAKE_READ_CHUNK 4096
+#define MOJIBAKE_MAX_HOLES 65536
 #define RETURN_NULL_IF(con) \
     if ((con))              \
     {                       \
@@ -25,11 +29,22 @@
 
 typedef struct mojibake_target_t mojibake_target_t;
 typedef struct mojibake_partition_t mojibake_partition_t;
+typedef struct mojibake_extent_t mojibake_extent_t;
 typedef bool (*mojibake_partition_callback_t)(mojibake_target_t *, unsigned int index, void *arg);
 
+// A hole of a sparse file: a range that reads as zeros and occupies no disk space
+struct mojibake_extent_t
+{
+    size_t offset;
+    size_t length;
+};
+
 struct mojibake_partition_t
 {
     unsigned int index;
+    unsigned int first_hole;  // first entry of target->holes overlapping the partition
+    unsigned int hole_count;  // holes overlapping the partition
+    size_t zero_bytes;        // bytes of the partition inside holes
 };
 
 struct mojibake_target_t
@@ -40,12 +55,23 @@ struct mojibake_target_t
     unsigned int extra;
     unsigned int size;
     void *block;
+    bool block_aligned; // block was replaced by an aligned allocation (mbx_numa_place); Windows frees those apart
     mojibake_partition_t *partitions;
+    FILE *stream;       // open file when block is NULL (memory-budget mode), read with positioned reads
+    size_t max_memory;  // 0 = unlimited
+    mojibake_extent_t *holes;  // holes found with SEEK_HOLE/SEEK_DATA, in file order (NULL if none)
+    unsigned int hole_count;
+    size_t hole_bytes;
 };
 
 mojibake_partition_t *mojibake_partitionize(mojibake_target_t *target);
 void mojibake_departitionize(mojibake_partition_t *partitions);
 mojibake_target_t *mojibake_open(char *file_path, unsigned int partition_count);
+mojibake_target_t *mojibake_open_ex(char *file_path, unsigned int partition_count, size_t max_memory);
+// Threads may read one target at once, streamed or not
+size_t mojibake_read(mojibake_target_t *target, size_t offset, void *buffer, size_t length);
+bool mojibake_hole(mojibake_target_t *target, size_t offset, size_t *end);
+size_t mojibake_peak_memory(void);
 void mojibake_close(mojibake_target_t *target);
 void mojibake_print(mojibake_target_t *target);
 bool mojibake_execute(mojibake_target_t *target, mojibake_partition_callback_t callback, void *arg);
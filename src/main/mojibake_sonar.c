@@ -15,7 +15,49 @@
 #include "mbx_textview.h"
 #include "mbx_sonar.h"
 #include "mbx_dsonar.h"
+#include "mbx_digest.h"
+#include "mbx_checkpoint.h"
+#include "mbx_freqplan.h"
+#include "mbx_synth.h"
+#include "mbx_qam.h"
+#include "mbx_entropy.h"
+#include "mbx_encoding.h"
+#include "mbx_search.h"
+#include "mbx_ngram.h"
+#include "mbx_similarity.h"
+#include "mbx_fingerprint.h"
+#include "mbx_diff.h"
+#include "mbx_numa.h"
+#include "mbx_autopart.h"
 #include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+
+/**
+ * @brief Prepare a checkpoint manifest for a new or resumed job
+ * 
+ * A resumed job keeps the partitions of a compatible manifest; otherwise
+ * the manifest is reset so stale entries from an earlier job are dropped.
+ * 
+ * @param checkpoint Initialized checkpoint
+ * @param resume Whether to reuse partitions completed by a previous run
+ */
+static void start_checkpoint(mbx_checkpoint_t* checkpoint, bool resume)
+{
+    if (resume) {
+        int completed = mbx_checkpoint_load(checkpoint);
+        if (completed >= 0) {
+            printf("[RESUME] %d of %u partitions checkpointed in %s\n\n",
+                   completed, checkpoint->partition_count, checkpoint->filename);
+            return;
+        }
+        printf("[RESUME] No compatible checkpoint in %s, starting from partition 0\n\n", checkpoint->filename);
+    }
+    
+    if (!mbx_checkpoint_save(checkpoint)) {
+        printf("[WARN] Could not write checkpoint manifest %s\n", checkpoint->filename);
+    }
+}
 
 /**
  * @brief Process single WAV file for dSONAR reconstruction
@@ -24,9 +66,15 @@
  * output filename based on input WAV filename and performing data reconstruction.
  * 
  * @param wav_filename Path to input WAV file
+ * @param run_quantum Run-merging quantum in seconds used by SONAR
+ * @param max_memory Memory budget in bytes (0 = unlimited); a budget streams the output to disk
+ * @param plan Frequency plan SONAR used (NULL = linear mapping)
+ * @param qam Coherent modulation SONAR used (NULL = one tone per byte)
+ * @param estimate Infer symbol length, frequency map and run quantum from the WAV first
  * @return true if processing successful, false otherwise
  */
-bool process_single_wav_file(const char* wav_filename)
+bool process_single_wav_file(const char* wav_filename, double run_quantum, size_t max_memory,
+                             const mbx_freqplan_t* plan, const mbx_qam_t* qam, bool estimate)
 {
     printf("=== Direct WAV-to-Data Reconstruction ===\n");
     printf("Input WAV file: %s\n\n", wav_filename);
@@ -36,7 +84,12 @@ bool process_single_wav_file(const char* wav_filename)
         .frequency_range = 2000.0,
         .tolerance = 5.0,
         .strict_mode = false,
-        .input_format = "wav"
+        .input_format = "wav",
+        .sample_duration = plan ? mbx_freqplan_symbol_duration(plan) : 0.05,
+        .run_quantum = run_quantum,
+        .max_memory = max_memory,
+        .plan = plan,
+        .qam = qam
     };
     
     // Check if WAV file exists
@@ -47,11 +100,9 @@ bool process_single_wav_file(const char* wav_filename)
     }
     fclose(test_file);
     
-    // Reconstruct from WAV
-    dsonar_result_t* result = reconstruct_from_wav(wav_filename, &config);
-    if (!result) {
-        printf("[ERROR] Failed to reconstruct from %s\n", wav_filename);
-        return false;
+    // Tone streams carry their own parameters; plans and coherent modes are configured explicitly
+    if (estimate && !plan && !qam) {
+        estimate_wav_parameters(wav_filename, &config);
     }
     
     // Generate output filename
@@ -68,13 +119,27 @@ bool process_single_wav_file(const char* wav_filename)
     if (dot) *dot = '\0';
     sprintf(output_filename, "dsonar_reconstructed_%s.bin", name_without_ext);
     
+    // Reconstruct from WAV; under a memory budget the data streams straight to the output file
+    dsonar_result_t* result = max_memory > 0 ?
+        reconstruct_from_wav_to_file(wav_filename, output_filename, &config) :
+        reconstruct_from_wav(wav_filename, &config);
+    if (!result) {
+        printf("[ERROR] Failed to reconstruct from %s\n", wav_filename);
+        return false;
+    }
+    
     // Save reconstructed data
-    if (save_reconstructed_data(output_filename, result)) {
+    if (result->streamed || save_reconstructed_data(output_filename, result)) {
         printf("[OK] Reconstructed %d bytes -> %s\n", result->data_length, output_filename);
         printf("   Confidence: %.1f%%, Success rate: %d/%d\n", 
                result->average_confidence * 100, result->successful_samples, result->total_samples);
         printf("   WAV format: %s\n", wav_filename);
         printf("   Output: %s\n", output_filename);
+        
+        // Verify against the digest recorded by SONAR, if present
+        char digest_filename[256];
+        mbx_digest_filename(wav_filename, digest_filename, sizeof(digest_filename));
+        verify_reconstruction_digest(result, digest_filename);
     } else {
         printf("[ERROR] Failed to save %s\n", output_filename);
         free_dsonar_result(result);
@@ -92,9 +157,16 @@ bool process_single_wav_file(const char* wav_filename)
  * and combines the results into a single output file.
  * 
  * @param partition_count Number of partition files to process
+ * @param run_quantum Run-merging quantum in seconds used by SONAR
+ * @param max_memory Memory budget in bytes (0 = unlimited); a budget streams the output to disk
+ * @param resume Skip partitions the checkpoint manifest lists as reconstructed
+ * @param plan Frequency plan SONAR used (NULL = linear mapping)
+ * @param qam Coherent modulation SONAR used (NULL = one tone per byte)
+ * @param estimate Infer symbol length, frequency map and run quantum from the first WAV
  * @return true if all partitions processed successfully, false otherwise
  */
-bool process_wav_files_only(int partition_count)
+bool process_wav_files_only(int partition_count, double run_quantum, size_t max_memory, bool resume,
+                            const mbx_freqplan_t* plan, const mbx_qam_t* qam, bool estimate)
 {
     printf("\n=== Standalone WAV-to-Data Reconstruction ===\n");
     printf("Processing %d WAV partition files...\n\n", partition_count);
@@ -104,14 +176,45 @@ bool process_wav_files_only(int partition_count)
         .frequency_range = 2000.0,
         .tolerance = 5.0,
         .strict_mode = false,
-        .input_format = "wav"
+        .input_format = "wav",
+        .sample_duration = plan ? mbx_freqplan_symbol_duration(plan) : 0.05,
+        .run_quantum = run_quantum,
+        .max_memory = max_memory,
+        .plan = plan,
+        .qam = qam
     };
     
+    // All partitions share the encoder's settings, so the first WAV stands for the job
+    if (estimate && !plan && !qam) {
+        estimate_wav_parameters("sonar_partition_0.wav", &config);
+    }
+    
+    // Each reconstructed partition is recorded in a manifest so an interrupted job can resume
+    char settings[256];
+    mbx_checkpoint_t checkpoint;
+    snprintf(settings, sizeof(settings), "base=%.3f;range=%.3f;duration=%.6f;run_quantum=%.6f;plan=%d;qam=%d",
+             config.base_frequency, config.frequency_range, config.sample_duration, config.run_quantum,
+             plan ? plan->symbol_samples : 0, qam ? qam->order : 0);
+    bool checkpointing = mbx_checkpoint_init(&checkpoint, MBX_CHECKPOINT_DSONAR_FILE, "dsonar",
+                                             settings, 0, partition_count);
+    if (checkpointing) start_checkpoint(&checkpoint, resume);
+    
     bool success = true;
     for (int i = 0; i < partition_count; i++) {
         char wav_filename[256];
         sprintf(wav_filename, "sonar_partition_%d.wav", i);
         
+        // Inputs are identified by the digest SONAR recorded for the partition
+        char digest_filename[256];
+        mbx_digest_t source;
+        sprintf(digest_filename, "sonar_partition_%d.digest", i);
+        bool has_source = mbx_digest_read(digest_filename, &source);
+        
+        if (checkpointing && resume && mbx_checkpoint_verify(&checkpoint, i, has_source ? &source : NULL)) {
+            printf("[RESUME] Partition %d already reconstructed, digests verified: skipping\n\n", i);
+            continue;
+        }
+        
         // Check if WAV file exists
         FILE* test_file = fopen(wav_filename, "rb");
         if (!test_file) {
@@ -128,19 +231,27 @@ bool process_wav_files_only(int partition_count)
         char csv_filename[256];
         sprintf(csv_filename, "sonar_partition_%d_frequencies.csv", i);
         
+        // Under a memory budget the data streams straight to the output file
+        char output_filename[256];
+        sprintf(output_filename, "dsonar_reconstructed_partition_%d.bin", i);
+        
         dsonar_result_t* result = NULL;
         FILE* csv_test = fopen(csv_filename, "r");
         if (csv_test) {
             fclose(csv_test);
             printf("Found CSV file: %s\n", csv_filename);
             printf("Using CSV frequency data for precise reconstruction...\n");
-            result = reconstruct_from_csv(csv_filename, &config);
+            result = max_memory > 0 ?
+                reconstruct_from_csv_to_file(csv_filename, output_filename, &config) :
+                reconstruct_from_csv(csv_filename, &config);
         }
         
         // Fallback to WAV if CSV not available
         if (!result) {
             printf("CSV not found, falling back to WAV analysis...\n");
-            result = reconstruct_from_wav(wav_filename, &config);
+            result = max_memory > 0 ?
+                reconstruct_from_wav_to_file(wav_filename, output_filename, &config) :
+                reconstruct_from_wav(wav_filename, &config);
             if (!result) {
                 printf("[ERROR] Failed to reconstruct from %s\n", wav_filename);
                 success = false;
@@ -149,13 +260,17 @@ bool process_wav_files_only(int partition_count)
         }
         
         // Save reconstructed data
-        char output_filename[256];
-        sprintf(output_filename, "dsonar_reconstructed_partition_%d.bin", i);
-        
-        if (save_reconstructed_data(output_filename, result)) {
+        if (result->streamed || save_reconstructed_data(output_filename, result)) {
             printf("[OK] Reconstructed %d bytes -> %s\n", result->data_length, output_filename);
             printf("   Confidence: %.1f%%, Success rate: %d/%d\n", 
                    result->average_confidence * 100, result->successful_samples, result->total_samples);
+            
+            verify_reconstruction_digest(result, digest_filename);
+            
+            if (checkpointing &&
+                mbx_checkpoint_commit(&checkpoint, i, has_source ? &source : NULL, output_filename)) {
+                printf("   Checkpoint: recorded in %s\n", checkpoint.filename);
+            }
         } else {
             printf("[ERROR] Failed to save %s\n", output_filename);
             success = false;
@@ -165,6 +280,8 @@ bool process_wav_files_only(int partition_count)
         printf("\n");
     }
     
+    if (checkpointing) mbx_checkpoint_free(&checkpoint);
+    
     if (success) {
         printf("[INFO] Combining all partitions into original file...\n");
         if (combine_partition_files(partition_count, "reconstructed_from_wav.bin")) {
@@ -178,6 +295,73 @@ bool process_wav_files_only(int partition_count)
     return success;
 }
 
+/**
+ * @brief Count the WAV files SONAR wrote for a partitioned file
+ * 
+ * @return Number of consecutive sonar_partition_<n>.wav files from partition 0
+ */
+static int count_partition_wavs(void)
+{
+    int count = 0;
+    for (;;) {
+        char wav_filename[64];
+        struct stat info;
+        snprintf(wav_filename, sizeof(wav_filename), "sonar_partition_%d.wav", count);
+        if (stat(wav_filename, &info) != 0) break;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Parse a memory size such as "512K", "64M" or "2G"
+ * 
+ * @param text Size in bytes with an optional K, M or G suffix (powers of 1024)
+ * @param bytes Pointer to store the size in bytes
+ * @return true if the size is a valid positive number, false otherwise
+ */
+static bool parse_memory_size(const char* text, size_t* bytes)
+{
+    char* end = NULL;
+    double value = strtod(text, &end);
+    if (end == text || value <= 0.0) return false;
+    
+    switch (toupper((unsigned char)*end)) {
+        case 'G': value *= 1024.0;  /* fall through */
+        case 'M': value *= 1024.0;  /* fall through */
+        case 'K': value *= 1024.0; end++; break;
+        case '\0': break;
+        default: return false;
+    }
+    if (*end != '\0' || value >= (double)SIZE_MAX) return false;
+    
+    *bytes = (size_t)value;
+    return true;
+}
+
+/**
+ * @brief Print peak resident memory, and compare it with the budget if one was set
+ * 
+ * The budget covers what the pipeline allocates, so growth over the resident
+ * size at startup (code, libc, thread stacks) is reported next to the peak.
+ * 
+ * @param startup Peak resident memory in bytes at program start
+ * @param max_memory Memory budget in bytes (0 = unlimited)
+ */
+static void report_peak_memory(size_t startup, size_t max_memory)
+{
+    size_t peak = mojibake_peak_memory();
+    if (peak == 0) return;
+    
+    double growth = peak > startup ? (peak - startup) / 1048576.0 : 0.0;
+    if (max_memory > 0) {
+        printf("Peak memory: %.1f MiB (+%.1f MiB over startup, budget %.1f MiB)\n",
+               peak / 1048576.0, growth, max_memory / 1048576.0);
+    } else {
+        printf("Peak memory: %.1f MiB (+%.1f MiB over startup)\n", peak / 1048576.0, growth);
+    }
+}
+
 /**
  * @brief Print program usage information
  * 
@@ -201,25 +385,71 @@ void print_usage(const char* program_name) {
     printf("\033[1;36m           v1.0.0a\033[0m\n\n");
     
     printf("\033[1;33mUSAGE:\033[0m\n");
-    printf("  %s \033[4m<filename>\033[0m [\033[4mmodule\033[0m] [\033[4mpartition_count\033[0m]\n\n", program_name);
+    printf("  %s \033[4m<filename>\033[0m [\033[4mmodule\033[0m] [\033[4mpartition_count\033[0m] [\033[4moptions\033[0m]\n\n", program_name);
     
     printf("\033[1;33mARGUMENTS:\033[0m\n");
     printf("  \033[1;37mfilename\033[0m        Path to the file you want to analyze\n");
     printf("  \033[1;37mmodule\033[0m          Analysis module (optional):\n");
     printf("                    \033[0;34mhex\033[0m      - Hexadecimal display (default)\n");
-    printf("                    \033[0;34mtext\033[0m     - Text preview with readable characters\n");
+    printf("                    \033[0;34mtext\033[0m     - Text preview decoded in the detected encoding\n");
     printf("                    \033[0;34mcount\033[0m    - Character frequency analysis\n");
+    printf("                    \033[0;34mentropy\033[0m  - Sliding-window entropy and randomness (encrypted/compressed regions)\n");
+    printf("                    \033[0;34mencoding\033[0m - Text encoding detection (ASCII, UTF-8, UTF-16, Shift-JIS, Latin-1)\n");
+    printf("                    \033[0;34msearch\033[0m   - Multi-pattern signature search (needs --patterns)\n");
+    printf("                    \033[0;34mngram\033[0m    - Byte pair and n-gram statistics (structural fingerprint)\n");
+    printf("                    \033[0;34msimilar\033[0m  - Similarity digests for near-duplicate detection (with --index)\n");
+    printf("                    \033[0;34mdiff\033[0m     - Differing regions of two files, as a delta report and stereo WAV (needs --against)\n");
     printf("                    \033[0;32msonar\033[0m    - Audio visualization\n");
     printf("                    \033[0;32mdsonar\033[0m   - Reverse audio to data \033[1;31m(NEW!)\033[0m\n");
-    printf("  \033[1;37mpartition_count\033[0m Number of partitions (optional, default: %d)\n\n", MOJIBAKE_DEFAULT_PARTITION_COUNT);
+    printf("                    \033[0;32mfingerprint\033[0m - Add a WAV recording to an audio fingerprint index (needs --index)\n");
+    printf("                    \033[0;32mlocate\033[0m   - Find the recording and offset a WAV clip was cut from (needs --index)\n");
+    printf("  \033[1;37mpartition_count\033[0m Number of partitions, or auto to size them for the file, CPUs and module\n");
+    printf("                    (optional, default: %d)\n\n", MOJIBAKE_DEFAULT_PARTITION_COUNT);
+    
+    printf("\033[1;33mOPTIONS:\033[0m\n");
+    printf("  \033[1;37m--merge-runs\033[0m        SONAR: merge runs of identical bytes into one tone\n");
+    printf("  \033[1;37m--run-quantum=<ms>\033[0m  Extra tone length per repeated byte (default: 1 ms)\n");
+    printf("  \033[1;37m--compress\033[0m          SONAR: LZ-compress partitions before sonification\n");
+    printf("  \033[1;37m--freq-plan[=<n>]\033[0m   Orthogonal tones on n-sample symbols (default: shortest that fits)\n");
+    printf("  \033[1;37m--qam[=<4|16>]\033[0m      Coherent QPSK/16-QAM on 16 carriers plus a pilot (default: 16)\n");
+    printf("  \033[1;37m--shaped[=<r>]\033[0m      SONAR: phase-continuous tones with raised-cosine ramps over r of a symbol (default: 0.1)\n");
+    printf("  \033[1;37m--engine=<file>\033[0m     SONAR: audio engine library (default: $MOJIBAKE_AUDIO_ENGINE, else %s beside the program)\n",
+           SONAR_ENGINE_NAME);
+    printf("  \033[1;37m--max-memory=<size>\033[0m Stream every stage within a memory budget (e.g. 64M, min 1M)\n");
+    printf("  \033[1;37m--no-estimate\033[0m       dSONAR: use the configured parameters instead of estimating them from the WAV\n");
+    printf("  \033[1;37m--window=<size>\033[0m     ENTROPY/ENCODING: window length (default: 4K)\n");
+    printf("  \033[1;37m--step=<size>\033[0m       ENTROPY: distance between windows (default: one window)\n");
+    printf("  \033[1;37m--patterns=<file>\033[0m   SEARCH: pattern file, one per line (text with \\xHH escapes, or hex:4D5A...)\n");
+    printf("  \033[1;37m--ngram=<n>\033[0m         NGRAM: length of the frequent n-grams, %d-%d (default: %d)\n",
+           MBX_NGRAM_MIN_N, MBX_NGRAM_MAX_N, MBX_NGRAM_DEFAULT_N);
+    printf("  \033[1;37m--index=<file>\033[0m      SIMILAR: list similar files in this index, then add the file to it\n");
+    printf("                      FINGERPRINT/LOCATE: audio fingerprint index to add to or search\n");
+    printf("  \033[1;37m--against=<file>\033[0m    DIFF: second file to compare with\n");
+    printf("  \033[1;37m--numa\033[0m              Parallel modules: pin workers to NUMA nodes and keep their partitions node-local\n");
+    printf("  \033[1;37m--resume\033[0m            Skip partitions finished by an interrupted run (see *_checkpoint.manifest)\n\n");
     
     printf("\033[1;33mEXAMPLES:\033[0m\n");
     printf("  \033[0;36mmojibake_sonar\033[0m myfile.txt\n");
     printf("  \033[0;36mmojibake_sonar\033[0m document.pdf \033[0;34mtext\033[0m\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m disk.img \033[0;34mentropy\033[0m 16 --window=64K --step=16K\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m subtitles.srt \033[0;34mencoding\033[0m 4\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m firmware.bin \033[0;34msearch\033[0m 8 --patterns=signatures.txt\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m firmware.bin \033[0;34mngram\033[0m 8 --ngram=4\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m capture.bin \033[0;34msimilar\033[0m 8 --index=captures.simidx\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m firmware_v1.bin \033[0;34mdiff\033[0m 8 --against=firmware_v2.bin\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m huge.img \033[0;34mentropy\033[0m 64 --max-memory=256M --numa\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m huge.img \033[0;34msearch\033[0m auto --patterns=signatures.txt --max-memory=256M\n");
     printf("  \033[0;36mmojibake_sonar\033[0m music.mp3 \033[0;32msonar\033[0m 4\n");
     printf("  \033[0;36mmojibake_sonar\033[0m binary.exe \033[0;32msonar\033[0m 16\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m disk.img \033[0;32msonar\033[0m 4 --merge-runs\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m data.bin \033[0;32msonar\033[0m 4 --freq-plan\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m data.bin \033[0;32msonar\033[0m 4 --qam\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m huge.img \033[0;32msonar\033[0m 64 --max-memory=32M\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m huge.img \033[0;32msonar\033[0m 64 --max-memory=32M --resume\n");
     printf("  \033[0;36mmojibake_sonar\033[0m sonar_partition_0.wav \033[0;32mdsonar\033[0m\n");
-    printf("  \033[0;36mmojibake_sonar\033[0m \"C:\\path\\to\\audio.wav\" \033[0;32mdsonar\033[0m\n\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m \"C:\\path\\to\\audio.wav\" \033[0;32mdsonar\033[0m\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m sonar_partition_0.wav \033[0;32mfingerprint\033[0m --index=recordings.afp\n");
+    printf("  \033[0;36mmojibake_sonar\033[0m clip.wav \033[0;32mlocate\033[0m --index=recordings.afp\n\n");
     
     printf("\033[1;35m[AUDIO] SONAR Extension Features:\033[0m\n");
     printf("  \033[0;37m-\033[0m Converts file bytes to audio frequencies\n");
@@ -233,6 +463,15 @@ void print_usage(const char* program_name) {
     printf("  \033[1;32m[OK]\033[0m    Hexadecimal viewer (built-in)\n");
     printf("  \033[1;32m[OK]\033[0m    Text content preview\n");
     printf("  \033[1;32m[OK]\033[0m    Character frequency counter\n");
+    printf("  \033[1;32m[OK]\033[0m    Entropy and randomness scanner\n");
+    printf("  \033[1;32m[OK]\033[0m    Vectorized text encoding detection\n");
+    printf("  \033[1;32m[OK]\033[0m    Multi-pattern signature search\n");
+    printf("  \033[1;32m[OK]\033[0m    Byte n-gram statistics\n");
+    printf("  \033[1;32m[OK]\033[0m    Similarity digests and near-duplicate index\n");
+    printf("  \033[1;32m[OK]\033[0m    Differential comparison of two files\n");
+    printf("  \033[1;32m[OK]\033[0m    Audio fingerprint index for locating WAV clips\n");
+    printf("  \033[1;32m[OK]\033[0m    NUMA-aware partition scheduling\n");
+    printf("  \033[1;32m[OK]\033[0m    Automatic partition sizing\n");
     printf("  \033[1;35m[AUDIO]\033[0m SONAR audio visualization \033[1;31m(NEW!)\033[0m\n");
     printf("  \033[1;34m[+]\033[0m     Easy to add more modules!\n\n");
 }
@@ -249,39 +488,232 @@ void print_usage(const char* program_name) {
  */
 int main(int argc, char *argv[])
 {
+    size_t startup_memory = mojibake_peak_memory();
+    
+    // Separate --options from positional arguments
+    char *positional[3] = {NULL, NULL, NULL};
+    int positional_count = 0;
+    bool merge_runs = false;
+    bool compress = false;
+    bool resume = false;
+    double run_quantum = 0.001;
+    size_t max_memory = 0;
+    int plan_samples = -1;  // -1 = linear mapping, 0 = shortest symbol that fits
+    double shape_rolloff = 0.0;
+    int qam_order = 0;      // 0 = one tone per byte
+    bool estimate = true;
+    size_t window_size = MBX_ENTROPY_DEFAULT_WINDOW;
+    size_t window_step = 0;  // 0 = one window
+    char *pattern_file = NULL;
+    int ngram_length = MBX_NGRAM_DEFAULT_N;
+    char *index_file = NULL;
+    char *against_file = NULL;
+    char *engine_file = NULL;
+    bool numa = false;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            if (positional_count < 3) {
+                positional[positional_count] = argv[i];
+            }
+            positional_count++;
+        } else if (strcmp(argv[i], "--merge-runs") == 0) {
+            merge_runs = true;
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            compress = true;
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = true;
+        } else if (strncmp(argv[i], "--run-quantum=", 14) == 0) {
+            run_quantum = atof(argv[i] + 14) / 1000.0;
+            if (run_quantum <= 0.0) {
+                printf("Error: Run quantum must be a positive number of milliseconds\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--freq-plan") == 0) {
+            plan_samples = 0;
+        } else if (strncmp(argv[i], "--freq-plan=", 12) == 0) {
+            plan_samples = atoi(argv[i] + 12);
+            if (plan_samples <= 0) {
+                printf("Error: Frequency plan symbol length must be a positive number of samples\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--numa") == 0) {
+            numa = true;
+        } else if (strcmp(argv[i], "--no-estimate") == 0) {
+            estimate = false;
+        } else if (strcmp(argv[i], "--qam") == 0) {
+            qam_order = 16;
+        } else if (strncmp(argv[i], "--qam=", 6) == 0) {
+            qam_order = atoi(argv[i] + 6);
+            if (qam_order != 4 && qam_order != 16) {
+                printf("Error: QAM order must be 4 (QPSK) or 16\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--shaped") == 0) {
+            shape_rolloff = MBX_SYNTH_DEFAULT_ROLLOFF;
+        } else if (strncmp(argv[i], "--shaped=", 9) == 0) {
+            shape_rolloff = atof(argv[i] + 9);
+            if (shape_rolloff <= 0.0 || shape_rolloff > MBX_SYNTH_MAX_ROLLOFF) {
+                printf("Error: Shaping rolloff must be between 0 and %.1f of a symbol\n", MBX_SYNTH_MAX_ROLLOFF);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--window=", 9) == 0) {
+            if (!parse_memory_size(argv[i] + 9, &window_size) ||
+                window_size < MBX_ENTROPY_MIN_WINDOW || window_size > MBX_ENTROPY_MAX_WINDOW) {
+                printf("Error: Window must be a size between %d and %dM\n",
+                       MBX_ENTROPY_MIN_WINDOW, MBX_ENTROPY_MAX_WINDOW >> 20);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--step=", 7) == 0) {
+            if (!parse_memory_size(argv[i] + 7, &window_step)) {
+                printf("Error: Window step must be a positive size (e.g. 1K)\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--patterns=", 11) == 0) {
+            pattern_file = argv[i] + 11;
+        } else if (strncmp(argv[i], "--index=", 8) == 0) {
+            index_file = argv[i] + 8;
+        } else if (strncmp(argv[i], "--against=", 10) == 0) {
+            against_file = argv[i] + 10;
+        } else if (strncmp(argv[i], "--engine=", 9) == 0) {
+            engine_file = argv[i] + 9;
+        } else if (strncmp(argv[i], "--ngram=", 8) == 0) {
+            ngram_length = atoi(argv[i] + 8);
+            if (ngram_length < MBX_NGRAM_MIN_N || ngram_length > MBX_NGRAM_MAX_N) {
+                printf("Error: N-gram length must be between %d and %d\n", MBX_NGRAM_MIN_N, MBX_NGRAM_MAX_N);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--max-memory=", 13) == 0) {
+            if (!parse_memory_size(argv[i] + 13, &max_memory) || max_memory < MOJIBAKE_MIN_MEMORY) {
+                printf("Error: Memory budget must be a size of at least 1M (e.g. 64M)\n");
+                return 1;
+            }
+        } else {
+            printf("Error: Unknown option '%s'\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
     // Check command line arguments
-    if (argc < 2) {
+    if (positional_count < 1) {
         print_usage(argv[0]);
         return 1;
     }
 
     // Get filename from command line
-    char *filename = argv[1];
+    char *filename = positional[0];
     
     // Get module type (optional)
     char *module_name = "hex"; // default
-    if (argc >= 3) {
-        module_name = argv[2];
+    if (positional_count >= 2) {
+        module_name = positional[1];
     }
     
     // Get partition count (optional)
     int partition_count = MOJIBAKE_DEFAULT_PARTITION_COUNT;
-    if (argc >= 4) {
-        partition_count = atoi(argv[3]);
+    bool auto_partitions = false;
+    if (positional_count >= 3 && strcmp(positional[2], "auto") == 0) {
+        auto_partitions = true;
+    } else if (positional_count >= 3) {
+        partition_count = atoi(positional[2]);
         if (partition_count <= 0) {
             printf("Error: Partition count must be a positive number\n");
             return 1;
         }
     }
 
+    // Orthogonal frequency plan: 256 bin-centered tones from the base frequency up to 0.45 Fs
+    int sample_rate = 44100;
+    double base_frequency = 220.0;
+    mbx_freqplan_t plan_storage;
+    mbx_freqplan_t *plan = NULL;
+    if (plan_samples >= 0) {
+        double max_frequency = MBX_FREQPLAN_MAX_FRACTION * sample_rate;
+        int min_samples = mbx_freqplan_min_symbol(sample_rate, base_frequency, max_frequency);
+        if (plan_samples == 0) plan_samples = min_samples;
+        if (plan_samples < min_samples ||
+            !mbx_freqplan_init(&plan_storage, sample_rate, plan_samples, base_frequency, max_frequency)) {
+            printf("Error: Frequency plan needs symbols of at least %d samples\n", min_samples);
+            return 1;
+        }
+        plan = &plan_storage;
+    }
+
+    // Coherent multi-carrier modulation replaces per-byte tones inside the usual 220-2220 Hz band
+    mbx_qam_t qam_storage;
+    mbx_qam_t *qam = NULL;
+    if (qam_order > 0) {
+        if (merge_runs || plan || shape_rolloff > 0.0) {
+            printf("Error: --qam cannot be combined with --merge-runs, --freq-plan or --shaped\n");
+            return 1;
+        }
+        if (!mbx_qam_init(&qam_storage, sample_rate, qam_order, base_frequency, base_frequency + 2000.0)) {
+            printf("Error: Could not set up %d-QAM carriers\n", qam_order);
+            return 1;
+        }
+        qam = &qam_storage;
+    }
+
     // Select the appropriate module
-    mojibake_partition_callback_t selected_module;
+    mojibake_partition_callback_t selected_module = NULL;  // diff has no single-target callback
     sonar_config_t sonar_config = {
-        .sample_rate = 44100,
-        .base_frequency = 220.0,
+        .sample_rate = sample_rate,
+        .base_frequency = base_frequency,
         .frequency_range = 2000.0,
-        .sample_duration = 0.05,
-        .use_dynamic_lib = true  // Enable shared library by default
+        .sample_duration = plan ? mbx_freqplan_symbol_duration(plan) : 0.05,
+        .use_dynamic_lib = true,  // Enable shared library by default
+        .merge_runs = merge_runs,
+        .run_quantum = run_quantum,
+        .compress = compress,
+        .checkpoint = NULL,
+        .resume = resume,
+        .plan = plan,
+        .shape_rolloff = shape_rolloff,
+        .qam = qam,
+        .engine_path = engine_file
+    };
+    
+    mbx_entropy_config_t entropy_config = {
+        .window = window_size,
+        .step = window_step > 0 ? window_step : window_size,
+        .threads = 0,  // One per online CPU
+        .numa = numa,
+        .write_series = true
+    };
+    
+    mbx_encoding_config_t encoding_config = {
+        .window = window_size
+    };
+    
+    mbx_search_matcher_t matcher;
+    mbx_search_init(&matcher);
+    mbx_search_config_t search_config = {
+        .matcher = &matcher,
+        .threads = 0,  // One per online CPU
+        .numa = numa,
+        .write_matches = true
+    };
+    
+    mbx_ngram_config_t ngram_config = {
+        .n = (unsigned int)ngram_length,
+        .threads = 0,  // One per online CPU
+        .numa = numa
+    };
+    
+    mbx_similarity_config_t similarity_config = {
+        .threads = 0,  // One per online CPU
+        .numa = numa,
+        .index_file = index_file,
+        .path = filename
+    };
+    
+    mbx_diff_config_t diff_config = {
+        .threads = 0,  // One per online CPU
+        .numa = numa,
+        .name = filename,
+        .other_name = against_file,
+        .sonar = &sonar_config
     };
     
     void *module_arg = NULL;
@@ -295,21 +727,118 @@ int main(int argc, char *argv[])
     } else if (strcmp(module_name, "count") == 0) {
         selected_module = mbx_charcount;
         printf("[COUNT] Using module: Character Counter\n");
+    } else if (strcmp(module_name, "entropy") == 0) {
+        selected_module = mbx_entropy;
+        module_arg = &entropy_config;
+        printf("[ENTROPY] Using module: Sliding-Window Entropy\n");
+        printf("   - Window: %zu bytes, step %zu bytes\n", entropy_config.window, entropy_config.step);
+    } else if (strcmp(module_name, "encoding") == 0) {
+        selected_module = mbx_encoding;
+        module_arg = &encoding_config;
+        printf("[ENCODING] Using module: Text Encoding Detection\n");
+        printf("   - Window: %zu bytes\n", encoding_config.window);
+    } else if (strcmp(module_name, "search") == 0) {
+        if (pattern_file == NULL) {
+            printf("Error: The search module needs a pattern file (--patterns=<file>)\n");
+            return 1;
+        }
+        if (!mbx_search_load(pattern_file, &matcher)) {
+            return 1;
+        }
+        selected_module = mbx_search;
+        module_arg = &search_config;
+        printf("[SEARCH] Using module: Multi-Pattern Search\n");
+        printf("   - Patterns: %zu from %s (longest %zu bytes)\n", matcher.pattern_count, pattern_file,
+               matcher.max_length);
+    } else if (strcmp(module_name, "ngram") == 0) {
+        selected_module = mbx_ngram;
+        module_arg = &ngram_config;
+        printf("[NGRAM] Using module: Byte N-gram Statistics\n");
+        printf("   - Exact bigrams, frequent %u-grams from a %d x %d sketch\n", ngram_config.n,
+               MBX_NGRAM_SKETCH_DEPTH, MBX_NGRAM_SKETCH_WIDTH);
+    } else if (strcmp(module_name, "similar") == 0) {
+        selected_module = mbx_similarity;
+        printf("[SIMILAR] Using module: Similarity Digests\n");
+        if (index_file) {
+            printf("   - Index: %s\n", index_file);
+        }
+    } else if (strcmp(module_name, "diff") == 0) {
+        if (!against_file) {
+            printf("Error: The diff module needs --against=<file>\n");
+            return 1;
+        }
+        printf("[DIFF] Using module: Differential Comparison\n");
+        printf("   - Against: %s\n", against_file);
+        printf("   - Audio: stereo, %.0f ms per byte, first %d bytes of each region\n",
+               sonar_config.sample_duration * 1000, MBX_DIFF_AUDIO_BYTES);
     } else if (strcmp(module_name, "sonar") == 0) {
         selected_module = mbx_sonar;
         module_arg = &sonar_config;
         printf("[AUDIO] Using module: SONAR Audio Visualization\n");
         printf("   - Sample Rate: %d Hz\n", sonar_config.sample_rate);
-        printf("   - Frequency Range: %.0f - %.0f Hz\n", 
-               sonar_config.base_frequency, 
-               sonar_config.base_frequency + sonar_config.frequency_range);
-        printf("   - Sample Duration: %.0f ms per byte\n", sonar_config.sample_duration * 1000);
+        if (qam) {
+            printf("   - Modulation: coherent %d-%s, %d carriers + pilot at %.0f - %.0f Hz\n",
+                   qam->order, qam->order == 4 ? "PSK" : "QAM", MBX_QAM_CARRIERS,
+                   (double)qam->bins[0] * qam->sample_rate / qam->symbol_samples,
+                   (double)qam->bins[MBX_QAM_CARRIERS - 1] * qam->sample_rate / qam->symbol_samples);
+            printf("   - Symbol Length: %d samples (%d bytes per %.0f ms)\n", qam->symbol_samples,
+                   qam->symbol_bytes, qam->symbol_samples * 1000.0 / qam->sample_rate);
+        } else if (plan) {
+            printf("   - Frequency Plan: %.1f - %.1f Hz, %d orthogonal tones\n",
+                   plan->frequency[0], plan->frequency[MBX_FREQPLAN_TONES - 1], MBX_FREQPLAN_TONES);
+            printf("   - Symbol Length: %d samples (%.1f ms per byte)\n",
+                   plan->symbol_samples, plan->symbol_samples * 1000.0 / plan->sample_rate);
+        } else {
+            printf("   - Frequency Range: %.0f - %.0f Hz\n", 
+                   sonar_config.base_frequency, 
+                   sonar_config.base_frequency + sonar_config.frequency_range);
+            printf("   - Sample Duration: %.0f ms per byte\n", sonar_config.sample_duration * 1000);
+        }
+        if (sonar_config.merge_runs) {
+            printf("   - Run Merging: +%.1f ms per repeated byte\n", sonar_config.run_quantum * 1000);
+        }
+        if (sonar_config.compress) {
+            printf("   - Compression: LZ before sonification\n");
+        }
+        if (sonar_config.shape_rolloff > 0.0) {
+            printf("   - Synthesis: phase-continuous, raised-cosine ramps over %.0f%% of a symbol\n",
+                   sonar_config.shape_rolloff * 100);
+        }
+    } else if (strcmp(module_name, "fingerprint") == 0 || strcmp(module_name, "locate") == 0) {
+        // Fingerprinting reads WAV files directly, like dSONAR
+        bool adding = strcmp(module_name, "fingerprint") == 0;
+        if (!index_file) {
+            printf("Error: The %s module needs --index=<file>\n", module_name);
+            return 1;
+        }
+        printf("[FINGERPRINT] Using module: %s\n", adding ? "Audio Fingerprint Index" : "Audio Fingerprint Lookup");
+        printf("   - Spectrogram: %d-point FFT, hop %d, %d peaks per frame\n", MBX_FINGERPRINT_FFT_SIZE,
+               MBX_FINGERPRINT_HOP, MBX_FINGERPRINT_PEAKS_PER_FRAME);
+        printf("   - Index: %s\n\n", index_file);
+
+        bool ok = adding ? mbx_fingerprint_add_wav(filename, index_file) : mbx_fingerprint_locate_wav(filename, index_file);
+        if (ok) {
+            printf("\n[OK] Analysis complete!\n");
+        } else {
+            printf("\n[ERROR] Fingerprint %s failed\n", adding ? "indexing" : "lookup");
+        }
+        mbx_freqplan_free(plan);
+        mbx_qam_free(qam);
+        report_peak_memory(startup_memory, max_memory);
+        return ok ? 0 : 1;
     } else if (strcmp(module_name, "dsonar") == 0) {
         // dSONAR works with WAV files directly - filename should be WAV pattern
         printf("[REVERSE] Using module: dSONAR Reverse Audio Analysis\n");
-        printf("   - Base Frequency: 220 Hz\n");
-        printf("   - Frequency Range: 2000 Hz\n");
-        printf("   - Tolerance: 5.0 Hz\n");
+        if (qam) {
+            printf("   - Modulation: coherent %d-%s, pilot-referenced demodulation\n",
+                   qam->order, qam->order == 4 ? "PSK" : "QAM");
+        } else if (plan) {
+            printf("   - Frequency Plan: %d-sample symbols, Goertzel detection\n", plan->symbol_samples);
+        } else {
+            printf("   - Base Frequency: 220 Hz\n");
+            printf("   - Frequency Range: 2000 Hz\n");
+            printf("   - Tolerance: 5.0 Hz\n");
+        }
         printf("   - Mode: Flexible\n");
         printf("   - Input: WAV files directly\n");
         
@@ -319,14 +848,22 @@ int main(int argc, char *argv[])
             printf("\n=== Single WAV File Mode ===\n");
             printf("Processing: %s\n\n", filename);
             
-            if (process_single_wav_file(filename)) {
+            if (process_single_wav_file(filename, run_quantum, max_memory, plan, qam, estimate)) {
                 printf("[OK] WAV-to-data reconstruction complete!\n");
             } else {
                 printf("[ERROR] Failed to process WAV file\n");
             }
         } else {
             // Multi-partition WAV mode (legacy)
-            if (process_wav_files_only(partition_count)) {
+            if (auto_partitions) {
+                partition_count = count_partition_wavs();
+                if (partition_count == 0) {
+                    printf("Error: No sonar_partition_0.wav to reconstruct\n");
+                    return 1;
+                }
+                printf("\nPartition count: %d (auto: sonar_partition_*.wav files found)\n", partition_count);
+            }
+            if (process_wav_files_only(partition_count, run_quantum, max_memory, resume, plan, qam, estimate)) {
                 printf("[OK] WAV-to-data reconstruction complete!\n");
             } else {
                 printf("[ERROR] Failed to process WAV files\n");
@@ -334,31 +871,124 @@ int main(int argc, char *argv[])
         }
         
         printf("\n[OK] Analysis complete!\n");
+        mbx_freqplan_free(plan);
+        mbx_qam_free(qam);
+        report_peak_memory(startup_memory, max_memory);
         return 0;
     } else {
         printf("Error: Unknown module '%s'\n", module_name);
-        printf("Available modules: hex, text, count, sonar, dsonar\n");
+        printf("Available modules: hex, text, count, entropy, encoding, search, ngram, similar, diff, sonar, dsonar, fingerprint, locate\n");
         return 1;
     }
 
     printf("Analyzing file: %s\n", filename);
-    printf("Partition count: %d\n\n", partition_count);
+    struct stat file_info;
+    mbx_autopart_t autopart;
+    bool sized = false;
+    if (auto_partitions && stat(filename, &file_info) == 0 && file_info.st_size > 0) {
+        // Entropy and encoding partitions hold many windows; SONAR writes 16-bit mono samples for every byte
+        bool windowed = strcmp(module_name, "entropy") == 0 || strcmp(module_name, "encoding") == 0;
+        double output_per_byte = strcmp(module_name, "sonar") == 0
+                                     ? sonar_config.sample_rate * sonar_config.sample_duration * 2.0
+                                     : 0.0;
+        sized = mbx_autopart_choose(module_name, (uint64_t)file_info.st_size, windowed ? window_size : 0,
+                                    output_per_byte, &autopart);
+    }
+    if (sized) {
+        partition_count = (int)autopart.partition_count;
+        printf("Partition count: %d (auto: %s)\n", partition_count, autopart.reason);
+        printf("Hardware: %d CPU%s, L2 cache %zu KiB%s\n\n", autopart.hardware.cpus, autopart.hardware.cpus == 1 ? "" : "s",
+               autopart.hardware.l2_cache / 1024, autopart.hardware.l2_known ? "" : " (assumed)");
+    } else {
+        printf("Partition count: %d\n\n", partition_count);
+    }
 
-    mojibake_target_t *target = mojibake_open(filename, partition_count);
+    mojibake_target_t *target = mojibake_open_ex(filename, partition_count, max_memory);
     if (target == NULL) {
         printf("Error: Could not open file '%s'\n", filename);
         printf("Please check if the file exists and is readable.\n");
         return 1;
     }
 
-    printf("File size: %d bytes\n", target->size);
-    printf("Partition size: %d bytes each\n\n", target->partition_size);
+    printf("File size: %u bytes\n", target->size);
+    printf("Partition size: %u bytes each\n", target->partition_size);
+    if (target->hole_count > 0) {
+        printf("Sparse file: %u holes, %zu bytes (%.1f%%) read as zeros without I/O\n", target->hole_count,
+               target->hole_bytes, 100.0 * target->hole_bytes / target->size);
+    }
+    if (max_memory > 0) {
+        printf("Memory budget: %zu bytes (streaming)\n", max_memory);
+    }
+    if (numa) {
+        // In-memory files are spread over the nodes; streamed partitions are read into each worker's own buffers
+        const mbx_numa_topology_t *topology = mbx_numa_topology();
+        if (topology->node_count > 1) {
+            printf("NUMA: %d nodes, workers pinned", topology->node_count);
+            if (target->block) {
+                printf(", file spread over %d nodes", mbx_numa_place(target));
+            }
+            printf("\n");
+        } else {
+            printf("NUMA: single node, scheduling unchanged\n");
+        }
+    }
+    printf("\n");
 
-    // Only execute for non-dSONAR modules
-    if (strcmp(module_name, "dsonar") != 0) {
+    // SONAR records finished partitions so an interrupted run can be resumed
+    mbx_checkpoint_t checkpoint;
+    bool checkpointing = false;
+    if (strcmp(module_name, "sonar") == 0) {
+        char settings[256];
+        snprintf(settings, sizeof(settings),
+                 "sample_rate=%d;base=%.3f;range=%.3f;duration=%.6f;merge_runs=%d;run_quantum=%.6f;compress=%d;plan=%d;shape=%.3f;qam=%d",
+                 sonar_config.sample_rate, sonar_config.base_frequency, sonar_config.frequency_range,
+                 sonar_config.sample_duration, sonar_config.merge_runs, sonar_config.run_quantum,
+                 sonar_config.compress, plan ? plan->symbol_samples : 0, sonar_config.shape_rolloff,
+                 qam ? qam->order : 0);
+        checkpointing = mbx_checkpoint_init(&checkpoint, MBX_CHECKPOINT_SONAR_FILE, "sonar", settings,
+                                            target->size, target->partition_count);
+        if (checkpointing) {
+            start_checkpoint(&checkpoint, resume);
+            sonar_config.checkpoint = &checkpoint;
+        }
+    }
+
+    // Only execute for non-dSONAR modules; entropy, search, ngram, similar and diff process their partitions in parallel
+    int status = 0;
+    if (strcmp(module_name, "entropy") == 0) {
+        if (!mbx_entropy_batch(target, &entropy_config))
+            printf("Execution error\n");
+    } else if (strcmp(module_name, "search") == 0) {
+        if (!mbx_search_batch(target, &search_config))
+            printf("Execution error\n");
+    } else if (strcmp(module_name, "ngram") == 0) {
+        if (!mbx_ngram_batch(target, &ngram_config))
+            printf("Execution error\n");
+    } else if (strcmp(module_name, "similar") == 0) {
+        if (!mbx_similarity_batch(target, &similarity_config))
+            printf("Execution error\n");
+    } else if (strcmp(module_name, "diff") == 0) {
+        mojibake_target_t *other = mojibake_open_ex(against_file, partition_count, max_memory);
+        if (other == NULL) {
+            printf("Error: Could not open file '%s'\n", against_file);
+            printf("Please check if the file exists and is readable.\n");
+            status = 1;
+        } else {
+            if (numa) {
+                mbx_numa_place(other);
+            }
+            if (!mbx_diff_batch(target, other, &diff_config))
+                printf("Execution error\n");
+            mojibake_close(other);
+        }
+    } else if (strcmp(module_name, "dsonar") != 0) {
         if (!mojibake_execute(target, selected_module, module_arg))
             printf("Execution error\n");
     }
+    
+    if (checkpointing) {
+        mbx_checkpoint_free(&checkpoint);
+    }
 
     if (strcmp(module_name, "sonar") == 0) {
         printf("[INFO] SONAR Analysis Complete!\n");
@@ -367,7 +997,13 @@ int main(int argc, char *argv[])
     }
     // dSONAR processing is handled separately above
 
-    printf("\n[OK] Analysis complete!\n");
+    if (status == 0) {
+        printf("\n[OK] Analysis complete!\n");
+    }
     mojibake_close(target);
-    return 0;
+    mbx_search_free(&matcher);
+    mbx_freqplan_free(plan);
+    mbx_qam_free(qam);
+    report_peak_memory(startup_memory, max_memory);
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_autopart.h"
+#include "mbx_parallel.h"
+#include "mojibake/mojibake.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// What a partition costs each module besides its bytes
+typedef struct {
+    const char *module;
+    bool parallel;             // partitions run on worker threads
+    bool memory_bound;         // one pass over memory: a partition should fill a worker's L2 cache
+    size_t min_partition;      // smallest partition worth its fixed cost (0 = as few partitions as possible)
+    unsigned int per_cpu;      // partitions per worker, so uneven partitions balance out
+} cost_model_t;
+
+static const cost_model_t models[] = {
+    // Sequential modules print a report per partition
+    {"hex", false, false, 4096, 0},
+    {"text", false, false, 4096, 0},
+    {"count", false, false, 64 * 1024, 0},
+    {"encoding", false, false, 64 * 1024, 0},
+    // One WAV per partition; the output limit decides
+    {"sonar", false, false, 0, 0},
+    {"entropy", true, true, 64 * 1024, 4},
+    // Matches spanning a boundary are rescanned from the previous partition
+    {"search", true, true, 256 * 1024, 4},
+    // Each partition resets and merges half a megabyte of count tables
+    {"ngram", true, false, 1024 * 1024, 4},
+    // Each partition adds a digest to the index, so fewer but still balanced
+    {"similar", true, false, 256 * 1024, 2},
+    {"diff", true, true, 1024 * 1024, 4},
+};
+
+static const cost_model_t *find_model(const char *module)
+{
+    for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++) {
+        if (strcmp(models[i].module, module) == 0) return &models[i];
+    }
+    return NULL;
+}
+
+#ifndef _WIN32
+// Size of the first L2 data or unified cache in sysfs, as "2048K"
+static size_t read_sysfs_l2(void)
+{
+    for (int index = 0; index < 8; index++) {
+        char path[96], text[32];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        FILE *file = fopen(path, "r");
+        if (!file) break;
+        int level = fgets(text, sizeof(text), file) ? atoi(text) : 0;
+        fclose(file);
+        if (level != 2) continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        file = fopen(path, "r");
+        bool instruction = file && fgets(text, sizeof(text), file) && strncmp(text, "Instruction", 11) == 0;
+        if (file) fclose(file);
+        if (instruction) continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        file = fopen(path, "r");
+        if (!file) continue;
+        size_t size = 0;
+        if (fgets(text, sizeof(text), file)) {
+            char *end;
+            size = strtoul(text, &end, 10);
+            if (*end == 'K') size *= 1024;
+            else if (*end == 'M') size *= 1024 * 1024;
+        }
+        fclose(file);
+        if (size > 0) return size;
+    }
+    return 0;
+}
+#endif
+
+void mbx_autopart_hardware(mbx_autopart_hardware_t *hardware)
+{
+    // The same count the worker pool sizes itself by
+    hardware->cpus = mbx_parallel_cpus();
+    hardware->l2_cache = 0;
+#ifndef _WIN32
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 > 0) hardware->l2_cache = (size_t)l2;
+#endif
+    if (hardware->l2_cache == 0) hardware->l2_cache = read_sysfs_l2();
+#endif
+    hardware->l2_known = hardware->l2_cache > 0;
+    if (!hardware->l2_known) hardware->l2_cache = MBX_AUTOPART_DEFAULT_L2;
+}
+
+static void format_size(uint64_t bytes, char *text, size_t size)
+{
+    if (bytes >= 1024 * 1024) {
+        snprintf(text, size, "%.1f MiB", bytes / 1048576.0);
+    } else {
+        snprintf(text, size, "%.1f KiB", bytes / 1024.0);
+    }
+}
+
+bool mbx_autopart_choose(const char *module, uint64_t file_size, size_t unit, double output_per_byte,
+                         mbx_autopart_t *plan)
+{
+    const cost_model_t *model = module ? find_model(module) : NULL;
+    if (model == NULL || file_size == 0) return false;
+
+    mbx_autopart_hardware(&plan->hardware);
+    const mbx_autopart_hardware_t *hardware = &plan->hardware;
+
+    uint64_t min_partition = model->min_partition;
+    if (unit > 0 && (uint64_t)unit * MBX_AUTOPART_UNITS > min_partition) {
+        min_partition = (uint64_t)unit * MBX_AUTOPART_UNITS;
+    }
+    if (model->memory_bound && hardware->l2_cache > min_partition) {
+        min_partition = hardware->l2_cache;
+    }
+    char min_text[32];
+    format_size(min_partition, min_text, sizeof(min_text));
+
+    const char *cpus_plural = hardware->cpus == 1 ? "" : "s";
+    uint64_t count;
+    if (model->parallel) {
+        // A single worker has nothing to balance
+        unsigned int per_cpu = hardware->cpus > 1 ? model->per_cpu : 1;
+        count = (uint64_t)hardware->cpus * per_cpu;
+        if (file_size / count >= min_partition) {
+            snprintf(plan->reason, sizeof(plan->reason), "%d CPU%s x %u partition%s each", hardware->cpus,
+                     cpus_plural, per_cpu, per_cpu == 1 ? "" : "s");
+        } else {
+            count = file_size / min_partition;
+            snprintf(plan->reason, sizeof(plan->reason), "%d CPU%s, but no partition under %s%s", hardware->cpus,
+                     cpus_plural, min_text,
+                     model->memory_bound && min_partition == hardware->l2_cache ? " (L2 cache)" : "");
+        }
+    } else if (min_partition > 0) {
+        count = file_size / min_partition;
+        if (count >= MOJIBAKE_DEFAULT_PARTITION_COUNT) {
+            count = MOJIBAKE_DEFAULT_PARTITION_COUNT;
+            snprintf(plan->reason, sizeof(plan->reason), "sequential, default count");
+        } else {
+            snprintf(plan->reason, sizeof(plan->reason), "sequential, no partition under %s", min_text);
+        }
+    } else {
+        count = 1;
+        snprintf(plan->reason, sizeof(plan->reason), "sequential, as few partitions as possible");
+    }
+    if (count == 0) count = 1;
+
+    // Every partition's output file must stay addressable; the last partition also takes the remainder
+    if (output_per_byte > 0.0) {
+        uint64_t max_bytes = (uint64_t)((double)(MBX_AUTOPART_MAX_OUTPUT - 1024) / output_per_byte);
+        if (max_bytes == 0) max_bytes = 1;
+        uint64_t needed = (file_size + max_bytes - 1) / max_bytes;
+        while (needed < file_size && file_size / needed + file_size % needed > max_bytes) {
+            needed++;
+        }
+        if (needed > count) {
+            count = needed;
+            snprintf(plan->reason, sizeof(plan->reason), "one output file under 2 GiB per partition (%.0f bytes per byte)",
+                     output_per_byte);
+        }
+    }
+
+    if (count > file_size) count = file_size;
+    if (count > UINT32_MAX) count = UINT32_MAX;
+    plan->partition_count = (unsigned int)count;
+    plan->partition_size = file_size / count;
+    return true;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file mbx_autopart.h
+ * @brief Automatic partition count from file size, hardware and module cost
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * The right number of partitions depends on the module. The parallel
+ * modules want a few partitions per CPU, so uneven partitions balance
+ * out, but no partition so small that its fixed cost (tables reset and
+ * merged, a digest added to the index, a boundary rescanned) rivals its
+ * work; scans that make one pass over memory also want every partition to
+ * fill at least a worker's L2 cache. The sequential modules report per
+ * partition, so they take the default count or fewer for small files.
+ * SONAR writes one WAV per partition and WAV sizes are signed 32-bit, so
+ * it takes as few partitions as keep every WAV under that limit.
+ *
+ * The choice depends only on the file size, the module settings and the
+ * host, so a rerun on the same host picks the same partitions (and
+ * --resume finds its checkpoint).
+ */
+
+#ifndef MBX_AUTOPART_H
+#define MBX_AUTOPART_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBX_AUTOPART_MAX_OUTPUT 0x7FFFFFFFull /**< Largest output file of one partition (signed 32-bit WAV size) */
+#define MBX_AUTOPART_UNITS 16            /**< Module units (e.g. entropy windows) a partition holds at least */
+#define MBX_AUTOPART_DEFAULT_L2 (256 * 1024) /**< L2 cache size assumed when the host does not tell */
+
+/**
+ * @brief What the host offers
+ */
+typedef struct {
+    int cpus;                  /**< Online CPUs */
+    size_t l2_cache;           /**< L2 cache per core in bytes */
+    bool l2_known;             /**< l2_cache was read from the host rather than assumed */
+} mbx_autopart_hardware_t;
+
+/**
+ * @brief Chosen partitioning
+ */
+typedef struct {
+    unsigned int partition_count; /**< Partitions to open the file with */
+    uint64_t partition_size;   /**< Bytes per partition (the last one also takes the remainder) */
+    mbx_autopart_hardware_t hardware; /**< Host the choice was made for */
+    char reason[160];          /**< Why, for the report */
+} mbx_autopart_t;
+
+/**
+ * @brief Read the CPU count and L2 cache size of the host
+ *
+ * @param hardware Output
+ */
+void mbx_autopart_hardware(mbx_autopart_hardware_t *hardware);
+
+/**
+ * @brief Choose the partition count for a module and file
+ *
+ * @param module Module name as given on the command line
+ * @param file_size Bytes in the file
+ * @param unit Bytes the module works in (entropy and encoding window), 0 if none
+ * @param output_per_byte Bytes the module writes per input byte into one partition's file, 0 if none
+ * @param plan Output
+ * @return true if the module splits its input into partitions, false (plan unchanged) otherwise
+ */
+bool mbx_autopart_choose(const char *module, uint64_t file_size, size_t unit, double output_per_byte,
+                         mbx_autopart_t *plan);
+
+#endif
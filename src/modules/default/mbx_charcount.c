@@ -4,29 +4,49 @@
 
 bool mbx_charcount(mojibake_target_t *target, unsigned int index, void *arg)
 {
-    if (target == NULL || target->block == NULL || index >= target->partition_count)
+    if (target == NULL || index >= target->partition_count)
         return false;
 
-    unsigned char *partition = MOJIBAKE_BLOCK_OFFSET(target, index);
+    unsigned char chunk[MOJIBAKE_READ_CHUNK];
+    size_t offset = (size_t)index * target->partition_size;
+    size_t remaining = target->partition_size;
     char_stats_t stats = {0, 0, 0, 0, 0};
     
     printf("=== Partition %d Character Analysis ===\n", index);
     
-    // Analyze each character in this partition
-    for (int i = 0; i < target->partition_size; i++) {
-        unsigned char ch = partition[i];
+    // Analyze each character in this partition, one chunk at a time
+    while (remaining > 0) {
+        // A hole of a sparse file is all zero bytes, which count as others
+        size_t end;
+        if (mojibake_hole(target, offset, &end)) {
+            size_t zeros = end - offset < remaining ? end - offset : remaining;
+            stats.others += zeros;
+            offset += zeros;
+            remaining -= zeros;
+            continue;
+        }
+        
+        size_t want = end - offset < sizeof(chunk) ? end - offset : sizeof(chunk);
+        size_t length = mojibake_read(target, offset, chunk, remaining < want ? remaining : want);
+        if (length == 0) return false;
         
-        if (isalpha(ch)) {
-            stats.letters++;
-        } else if (isdigit(ch)) {
-            stats.digits++;
-        } else if (isspace(ch)) {
-            stats.spaces++;
-        } else if (ispunct(ch)) {
-            stats.punctuation++;
-        } else {
-            stats.others++;
+        for (size_t i = 0; i < length; i++) {
+            unsigned char ch = chunk[i];
+            
+            if (isalpha(ch)) {
+                stats.letters++;
+            } else if (isdigit(ch)) {
+                stats.digits++;
+            } else if (isspace(ch)) {
+                stats.spaces++;
+            } else if (ispunct(ch)) {
+                stats.punctuation++;
+            } else {
+                stats.others++;
+            }
         }
+        offset += length;
+        remaining -= length;
     }
     
     // Display statistics
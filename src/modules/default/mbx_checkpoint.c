@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static void copy_string(char *dst, size_t size, const char *src)
+{
+    snprintf(dst, size, "%s", src ? src : "");
+}
+
+// Flush an open stream's data through to the device
+static bool sync_stream(FILE *file)
+{
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Make a completed rename durable by syncing the directory holding the manifest
+static void sync_parent_directory(const char *filename)
+{
+#ifndef _WIN32
+    char directory[256];
+    const char *slash = strrchr(filename, '/');
+    if (slash) {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(slash - filename + 1), filename);
+    } else {
+        copy_string(directory, sizeof(directory), ".");
+    }
+
+    int fd = open(directory, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#else
+    (void)filename;
+#endif
+}
+
+bool mbx_checkpoint_replace_file(const char *from, const char *to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+bool mbx_checkpoint_init(mbx_checkpoint_t *checkpoint, const char *filename, const char *mode,
+                         const char *config, unsigned int source_size, unsigned int partition_count)
+{
+    if (!checkpoint || !filename || partition_count == 0) return false;
+
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->entries = calloc(partition_count, sizeof(mbx_checkpoint_entry_t));
+    if (!checkpoint->entries) return false;
+
+    copy_string(checkpoint->filename, sizeof(checkpoint->filename), filename);
+    copy_string(checkpoint->mode, sizeof(checkpoint->mode), mode);
+    copy_string(checkpoint->config, sizeof(checkpoint->config), config);
+    checkpoint->source_size = source_size;
+    checkpoint->partition_count = partition_count;
+    return true;
+}
+
+// Parse "partition=<i> source=<len>:<crc>:<xxh> output=<len>:<crc>:<xxh> file=<name>"; the name is the
+// rest of the line, so it may contain spaces
+static bool parse_entry(const char *line, mbx_checkpoint_t *checkpoint)
+{
+    unsigned int index, source_length, output_length, source_crc, output_crc;
+    unsigned long long source_xxh, output_xxh;
+    int name_start = -1;
+
+    if (sscanf(line, "partition=%u source=%u:%8X:%16llX output=%u:%8X:%16llX file=%n",
+               &index, &source_length, &source_crc, &source_xxh,
+               &output_length, &output_crc, &output_xxh, &name_start) != 7 ||
+        name_start < 0 || line[name_start] == '\0' || index >= checkpoint->partition_count) {
+        return false;
+    }
+    const char *name = line + name_start;
+
+    mbx_checkpoint_entry_t *entry = &checkpoint->entries[index];
+    entry->done = true;
+    entry->source.length = source_length;
+    entry->source.crc32c = source_crc;
+    entry->source.xxh64 = source_xxh;
+    entry->output.length = output_length;
+    entry->output.crc32c = output_crc;
+    entry->output.xxh64 = output_xxh;
+    copy_string(entry->output_filename, sizeof(entry->output_filename), name);
+    return true;
+}
+
+int mbx_checkpoint_load(mbx_checkpoint_t *checkpoint)
+{
+    if (!checkpoint || !checkpoint->entries) return -1;
+
+    FILE *file = fopen(checkpoint->filename, "r");
+    if (!file) return -1;
+
+    char line[512];
+    char expected[300];
+    int header = 0;
+    int loaded = 0;
+    bool compatible = true;
+
+    while (compatible && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (strncmp(line, "version=", 8) == 0) {
+            compatible = strtoul(line + 8, NULL, 10) == MBX_CHECKPOINT_VERSION;
+            header |= 1;
+        } else if (strncmp(line, "mode=", 5) == 0) {
+            compatible = strcmp(line + 5, checkpoint->mode) == 0;
+            header |= 2;
+        } else if (strncmp(line, "config=", 7) == 0) {
+            compatible = strcmp(line + 7, checkpoint->config) == 0;
+            header |= 4;
+        } else if (strncmp(line, "source_size=", 12) == 0) {
+            compatible = strtoul(line + 12, NULL, 10) == checkpoint->source_size;
+            header |= 8;
+        } else if (strncmp(line, "partition_count=", 16) == 0) {
+            snprintf(expected, sizeof(expected), "%u", checkpoint->partition_count);
+            compatible = strcmp(line + 16, expected) == 0;
+            header |= 16;
+        } else if (strncmp(line, "partition=", 10) == 0) {
+            // Entries follow the header, so they are only trusted once it has matched
+            if (header == 31 && parse_entry(line, checkpoint)) loaded++;
+        }
+    }
+
+    fclose(file);
+
+    if (!compatible || header != 31) {
+        for (unsigned int i = 0; i < checkpoint->partition_count; i++)
+            checkpoint->entries[i].done = false;
+        return -1;
+    }
+    return loaded;
+}
+
+bool mbx_checkpoint_save(const mbx_checkpoint_t *checkpoint)
+{
+    if (!checkpoint || !checkpoint->entries) return false;
+
+    char temp_filename[272];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", checkpoint->filename);
+
+    FILE *file = fopen(temp_filename, "w");
+    if (!file) return false;
+
+    fprintf(file, "# SONAR checkpoint manifest\n");
+    fprintf(file, "version=%d\n", MBX_CHECKPOINT_VERSION);
+    fprintf(file, "mode=%s\n", checkpoint->mode);
+    fprintf(file, "config=%s\n", checkpoint->config);
+    fprintf(file, "source_size=%u\n", checkpoint->source_size);
+    fprintf(file, "partition_count=%u\n", checkpoint->partition_count);
+
+    for (unsigned int i = 0; i < checkpoint->partition_count; i++) {
+        const mbx_checkpoint_entry_t *entry = &checkpoint->entries[i];
+        if (!entry->done) continue;
+
+        fprintf(file, "partition=%u source=%u:%08X:%016llX output=%u:%08X:%016llX file=%s\n", i,
+                entry->source.length, (unsigned int)entry->source.crc32c,
+                (unsigned long long)entry->source.xxh64,
+                entry->output.length, (unsigned int)entry->output.crc32c,
+                (unsigned long long)entry->output.xxh64, entry->output_filename);
+    }
+
+    // The old manifest stays in place until the new one is fully on disk
+    bool ok = !ferror(file) && sync_stream(file);
+    if (fclose(file) != 0) ok = false;
+    if (ok) ok = mbx_checkpoint_replace_file(temp_filename, checkpoint->filename);
+
+    if (ok) {
+        sync_parent_directory(checkpoint->filename);
+    } else {
+        remove(temp_filename);
+    }
+    return ok;
+}
+
+bool mbx_checkpoint_commit(mbx_checkpoint_t *checkpoint, unsigned int index,
+                           const mbx_digest_t *source, const char *output_filename)
+{
+    if (!checkpoint || !checkpoint->entries || index >= checkpoint->partition_count || !output_filename)
+        return false;
+
+    mbx_checkpoint_entry_t *entry = &checkpoint->entries[index];
+    if (!mbx_checkpoint_sync_file(output_filename) || !mbx_digest_file(output_filename, &entry->output)) {
+        printf("[CHECKPOINT] Could not sync %s, partition %u not recorded\n", output_filename, index);
+        return false;
+    }
+
+    if (source) {
+        entry->source = *source;
+    } else {
+        memset(&entry->source, 0, sizeof(entry->source));
+    }
+    copy_string(entry->output_filename, sizeof(entry->output_filename), output_filename);
+    entry->done = true;
+
+    if (!mbx_checkpoint_save(checkpoint)) {
+        printf("[CHECKPOINT] Could not update %s\n", checkpoint->filename);
+        entry->done = false;
+        return false;
+    }
+    return true;
+}
+
+bool mbx_checkpoint_verify(const mbx_checkpoint_t *checkpoint, unsigned int index, const mbx_digest_t *source)
+{
+    if (!checkpoint || !checkpoint->entries || index >= checkpoint->partition_count) return false;
+
+    const mbx_checkpoint_entry_t *entry = &checkpoint->entries[index];
+    if (!entry->done) return false;
+
+    if (source && !mbx_digest_equal(source, &entry->source)) {
+        printf("[RESUME] Partition %u input changed since it was checkpointed\n", index);
+        return false;
+    }
+
+    mbx_digest_t output;
+    if (!mbx_digest_file(entry->output_filename, &output) || !mbx_digest_equal(&output, &entry->output)) {
+        printf("[RESUME] Partition %u output %s is missing or modified\n", index, entry->output_filename);
+        return false;
+    }
+    return true;
+}
+
+bool mbx_checkpoint_sync_file(const char *filename)
+{
+    if (!filename) return false;
+
+    FILE *file = fopen(filename, "r+b");
+    if (!file) return false;
+
+    bool ok = sync_stream(file);
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+void mbx_checkpoint_free(mbx_checkpoint_t *checkpoint)
+{
+    if (!checkpoint) return;
+
+    free(checkpoint->entries);
+    checkpoint->entries = NULL;
+    checkpoint->partition_count = 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file mbx_checkpoint.h
+ * @brief Checkpoint manifests for resuming SONAR/dSONAR jobs
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * A job records every partition whose outputs are durably on disk in a
+ * small text manifest. Output files are synced before the manifest
+ * mentions them, and the manifest itself is replaced atomically (written to
+ * a temporary file, synced, then renamed), so after a crash it only ever
+ * lists partitions that are really complete. A resumed job skips those
+ * partitions after re-verifying their digests.
+ *
+ * Manifest layout:
+ * - "# SONAR checkpoint manifest" comment line
+ * - version=1, mode=<sonar|dsonar>, config=<settings string>
+ * - source_size=<bytes>, partition_count=<n>
+ * - one "partition=<i> ..." line per completed partition with the source
+ *   and output digests and the output filename, which runs to the end of
+ *   the line (it may contain spaces)
+ */
+
+#ifndef MBX_CHECKPOINT_H
+#define MBX_CHECKPOINT_H
+#include <stdbool.h>
+#include "mbx_digest.h"
+
+#define MBX_CHECKPOINT_VERSION 1
+#define MBX_CHECKPOINT_SONAR_FILE "sonar_checkpoint.manifest"   /**< Manifest written by SONAR jobs */
+#define MBX_CHECKPOINT_DSONAR_FILE "dsonar_checkpoint.manifest" /**< Manifest written by dSONAR jobs */
+
+/**
+ * @brief Completion record of one partition
+ */
+typedef struct {
+    bool done;                 /**< Partition outputs are complete and synced */
+    mbx_digest_t source;       /**< Digest of the partition input (length 0 if not tracked) */
+    mbx_digest_t output;       /**< Digest of the partition's primary output file */
+    char output_filename[256]; /**< Primary output file (WAV for SONAR, reconstructed data for dSONAR) */
+} mbx_checkpoint_entry_t;
+
+/**
+ * @brief Checkpoint state of a job
+ */
+typedef struct {
+    char filename[256];        /**< Manifest path */
+    char mode[16];             /**< Job kind ("sonar" or "dsonar") */
+    char config[256];          /**< Settings that shape the outputs; a resume requires an exact match */
+    unsigned int source_size;  /**< Size of the job input in bytes (0 if not tracked) */
+    unsigned int partition_count; /**< Number of partitions in the job */
+    mbx_checkpoint_entry_t *entries; /**< One record per partition */
+} mbx_checkpoint_t;
+
+/**
+ * @brief Start a checkpoint for a job with no completed partitions
+ *
+ * @param checkpoint Pointer to checkpoint to initialize
+ * @param filename Manifest path
+ * @param mode Job kind ("sonar" or "dsonar")
+ * @param config Settings string; outputs are only reused under identical settings
+ * @param source_size Size of the job input in bytes (0 if not tracked)
+ * @param partition_count Number of partitions in the job
+ * @return true on success, false if memory allocation failed
+ */
+bool mbx_checkpoint_init(mbx_checkpoint_t *checkpoint, const char *filename, const char *mode,
+                         const char *config, unsigned int source_size, unsigned int partition_count);
+
+/**
+ * @brief Load the completed partitions of a previous run
+ *
+ * The existing manifest is only used if its mode, settings, source size and
+ * partition count all match the initialized checkpoint.
+ *
+ * @param checkpoint Initialized checkpoint
+ * @return Number of completed partitions loaded, -1 if the manifest is missing or incompatible
+ */
+int mbx_checkpoint_load(mbx_checkpoint_t *checkpoint);
+
+/**
+ * @brief Atomically replace the manifest with the current state
+ *
+ * @param checkpoint Pointer to checkpoint
+ * @return true if the manifest was written, synced and renamed into place
+ */
+bool mbx_checkpoint_save(const mbx_checkpoint_t *checkpoint);
+
+/**
+ * @brief Record a finished partition
+ *
+ * Syncs the output file, records its digest, and saves the manifest.
+ * Files written alongside the output should be synced with
+ * mbx_checkpoint_sync_file first.
+ *
+ * @param checkpoint Pointer to checkpoint
+ * @param index Partition index
+ * @param source Digest of the partition input, NULL if not tracked
+ * @param output_filename Primary output file of the partition
+ * @return true if the partition is durably recorded
+ */
+bool mbx_checkpoint_commit(mbx_checkpoint_t *checkpoint, unsigned int index,
+                           const mbx_digest_t *source, const char *output_filename);
+
+/**
+ * @brief Check whether a partition can be skipped on resume
+ *
+ * Re-verifies the recorded digests: the output file must still hash to the
+ * recorded value and, if given, the input must match the recorded source.
+ *
+ * @param checkpoint Pointer to checkpoint
+ * @param index Partition index
+ * @param source Digest of the current partition input, NULL to skip the input check
+ * @return true if the partition is complete and its digests verify
+ */
+bool mbx_checkpoint_verify(const mbx_checkpoint_t *checkpoint, unsigned int index, const mbx_digest_t *source);
+
+/**
+ * @brief Flush a file's data to stable storage
+ *
+ * @param filename Path of a file that has been written and closed
+ * @return true if the file exists and was synced
+ */
+bool mbx_checkpoint_sync_file(const char *filename);
+
+/**
+ * @brief Move a file over another in one step
+ *
+ * Write the new contents to a temporary file, sync it with
+ * mbx_checkpoint_sync_file, then replace the old file with it, so a crash
+ * leaves either the old or the new file, never a torn one.
+ *
+ * @param from Path of the new file
+ * @param to Path of the file to replace (need not exist)
+ * @return true if the file was replaced
+ */
+bool mbx_checkpoint_replace_file(const char *from, const char *to);
+
+/**
+ * @brief Release checkpoint storage
+ *
+ * @param checkpoint Pointer to checkpoint
+ */
+void mbx_checkpoint_free(mbx_checkpoint_t *checkpoint);
+
+#endif
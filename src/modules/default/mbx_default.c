@@ -1,12 +1,23 @@
 #include "mbx_default.h"
 bool mbx_default(mojibake_target_t *target, unsigned int index, void *arg)
 {
-    if (target == NULL || target->block == NULL || index >= target->partition_count)
+    if (target == NULL || index >= target->partition_count)
         return false;
 
-    unsigned char *partition = MOJIBAKE_BLOCK_OFFSET(target, index);
-    for (int i = 0; i < target->partition_size; i++)
-        printf("%#02x ", partition[i]);
+    unsigned char chunk[MOJIBAKE_READ_CHUNK];
+    size_t offset = (size_t)index * target->partition_size;
+    size_t remaining = target->partition_size;
+    while (remaining > 0)
+    {
+        size_t length = mojibake_read(target, offset, chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (length == 0)
+            return false;
+
+        for (size_t i = 0; i < length; i++)
+            printf("%#02x ", chunk[i]);
+        offset += length;
+        remaining -= length;
+    }
     printf("\n\n");
     return true;
 }
\ No newline at end of file
@@ -0,0 +1,414 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_diff.h"
+#include "mbx_parallel.h"
+#include "mbx_synth.h"
+#include "mbx_endian.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#include <emmintrin.h>
+#define MBX_DIFF_SSE2
+#endif
+
+// Bytes read from each input per refill when either is streamed
+#define DIFF_READ_CHUNK (64 * 1024)
+
+// Samples rendered per channel at a time
+#define DIFF_AUDIO_BLOCK 512
+
+#if defined(MBX_DIFF_SSE2)
+// Bit i set where byte i of the two 16-byte blocks is equal
+static unsigned int equal_mask(const unsigned char *a, const unsigned char *b)
+{
+    __m128i x = _mm_loadu_si128((const __m128i *)a);
+    __m128i y = _mm_loadu_si128((const __m128i *)b);
+    return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+}
+#endif
+
+size_t mbx_diff_equal_span(const unsigned char *a, const unsigned char *b, size_t length)
+{
+    size_t i = 0;
+#if defined(MBX_DIFF_SSE2)
+    // Four blocks per test keep the loop at load throughput while everything matches
+    for (; i + 64 <= length; i += 64) {
+        __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                                    _mm_loadu_si128((const __m128i *)(b + i)));
+        __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 16)),
+                                    _mm_loadu_si128((const __m128i *)(b + i + 16)));
+        __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 32)),
+                                    _mm_loadu_si128((const __m128i *)(b + i + 32)));
+        __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 48)),
+                                    _mm_loadu_si128((const __m128i *)(b + i + 48)));
+        __m128i all = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+        if (_mm_movemask_epi8(all) != 0xFFFF) break;
+    }
+    for (; i + 16 <= length; i += 16) {
+        unsigned int mask = equal_mask(a + i, b + i);
+        if (mask != 0xFFFF) return i + (size_t)__builtin_ctz(~mask);
+    }
+#else
+    for (; i + 8 <= length; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        if (x != y) break;
+    }
+#endif
+    while (i < length && a[i] == b[i]) i++;
+    return i;
+}
+
+size_t mbx_diff_differing_span(const unsigned char *a, const unsigned char *b, size_t length)
+{
+    size_t i = 0;
+#if defined(MBX_DIFF_SSE2)
+    for (; i + 16 <= length; i += 16) {
+        unsigned int mask = equal_mask(a + i, b + i);
+        if (mask != 0) return i + (size_t)__builtin_ctz(mask);
+    }
+#endif
+    while (i < length && a[i] != b[i]) i++;
+    return i;
+}
+
+// Move the current region into the list (up to limit entries)
+static bool close_region(mbx_diff_summary_t *summary, size_t limit)
+{
+    if (summary->listed >= limit) return true;
+
+    if (summary->listed % 64 == 0) {
+        mbx_diff_region_t *regions = realloc(summary->regions, (summary->listed + 64) * sizeof(*regions));
+        if (!regions) return false;
+        summary->regions = regions;
+    }
+    summary->regions[summary->listed++] = summary->last;
+    return true;
+}
+
+// Add a differing range; one that starts within MBX_DIFF_MERGE_GAP of the current region extends it
+static bool add_region(mbx_diff_summary_t *summary, const mbx_diff_region_t *region, size_t limit)
+{
+    mbx_diff_region_t *last = &summary->last;
+    if (summary->region_count > 0 && region->offset - (last->offset + last->length) < MBX_DIFF_MERGE_GAP) {
+        last->length = region->offset + region->length - last->offset;
+        last->differing += region->differing;
+        return true;
+    }
+    if (summary->region_count > 0 && !close_region(summary, limit)) return false;
+    *last = *region;
+    summary->region_count++;
+    return true;
+}
+
+static size_t common_size(const mojibake_target_t *target, const mojibake_target_t *other)
+{
+    return target->size < other->size ? target->size : other->size;
+}
+
+bool mbx_diff_partition(mojibake_target_t *target, mojibake_target_t *other, unsigned int index,
+                        mbx_diff_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    if (target == NULL || other == NULL || index >= target->partition_count) return false;
+
+    size_t common = common_size(target, other);
+    size_t part = common / target->partition_count;
+    summary->offset = index * part;
+    summary->length = index + 1 == target->partition_count ? common - summary->offset : part;
+
+    // Loaded inputs are compared in place; streamed ones through a buffer per side
+    bool in_memory = target->block && other->block;
+    unsigned char *buffer = in_memory ? NULL : malloc(2 * DIFF_READ_CHUNK);
+    if (!in_memory && !buffer) return false;
+
+    bool ok = true;
+    size_t done = 0;
+    while (ok && done < summary->length) {
+        size_t offset = summary->offset + done;
+        size_t chunk = summary->length - done;
+
+        // Ranges that are holes in both inputs match without being read; otherwise a chunk
+        // stops where either input enters or leaves a hole, so the next one is checked again
+        size_t end, other_end;
+        bool hole = mojibake_hole(target, offset, &end);
+        bool other_hole = mojibake_hole(other, offset, &other_end);
+        if (other_end < end) end = other_end;
+        if (end - offset < chunk) chunk = end - offset;
+        if (hole && other_hole) {
+            done += chunk;
+            continue;
+        }
+
+        const unsigned char *a, *b;
+        if (in_memory) {
+            a = (const unsigned char *)target->block + offset;
+            b = (const unsigned char *)other->block + offset;
+        } else {
+            if (chunk > DIFF_READ_CHUNK) chunk = DIFF_READ_CHUNK;
+            ok = mojibake_read(target, offset, buffer, chunk) == chunk &&
+                 mojibake_read(other, offset, buffer + DIFF_READ_CHUNK, chunk) == chunk;
+            a = buffer;
+            b = buffer + DIFF_READ_CHUNK;
+        }
+
+        size_t i = 0;
+        while (ok && i < chunk) {
+            i += mbx_diff_equal_span(a + i, b + i, chunk - i);
+            if (i == chunk) break;
+            size_t run = mbx_diff_differing_span(a + i, b + i, chunk - i);
+            mbx_diff_region_t region = {offset + i, run, run};
+            summary->differing += run;
+            ok = add_region(summary, &region, MBX_DIFF_LIST_REGIONS);
+            i += run;
+        }
+        done += chunk;
+    }
+    if (ok && summary->region_count > 0) ok = close_region(summary, MBX_DIFF_LIST_REGIONS);
+
+    free(buffer);
+    summary->ok = ok;
+    return ok;
+}
+
+void mbx_diff_summary_free(mbx_diff_summary_t *summary)
+{
+    free(summary->regions);
+    summary->regions = NULL;
+    summary->listed = 0;
+}
+
+typedef struct {
+    mojibake_target_t *target;
+    mojibake_target_t *other;
+    mbx_diff_summary_t *summaries;
+} diff_batch_t;
+
+static void diff_job(void *arg, unsigned int index, int worker)
+{
+    diff_batch_t *batch = arg;
+    (void)worker;
+    mbx_diff_partition(batch->target, batch->other, index, &batch->summaries[index]);
+}
+
+// Up to MBX_DIFF_PREVIEW_BYTES of an input at an offset as hexadecimal ("-" past its end)
+static void format_preview(mojibake_target_t *target, uint64_t offset, uint64_t length, const char *separator,
+                           char *text)
+{
+    unsigned char bytes[MBX_DIFF_PREVIEW_BYTES];
+    size_t count = length < MBX_DIFF_PREVIEW_BYTES ? (size_t)length : MBX_DIFF_PREVIEW_BYTES;
+    size_t got = offset < target->size ? mojibake_read(target, (size_t)offset, bytes, count) : 0;
+    if (got == 0) {
+        strcpy(text, "-");
+        return;
+    }
+    char *out = text;
+    for (size_t i = 0; i < got; i++) out += sprintf(out, "%s%02x", i > 0 ? separator : "", bytes[i]);
+}
+
+static bool write_report(mojibake_target_t *target, mojibake_target_t *other, const mbx_diff_region_t *regions,
+                         size_t count)
+{
+    FILE *file = fopen(MBX_DIFF_REPORT_FILE, "w");
+    if (!file) {
+        printf("Error: Could not create %s\n", MBX_DIFF_REPORT_FILE);
+        return false;
+    }
+    fprintf(file, "offset,length,differing,first,second\n");
+    char first[MBX_DIFF_PREVIEW_BYTES * 3 + 1], second[MBX_DIFF_PREVIEW_BYTES * 3 + 1];
+    for (size_t i = 0; i < count; i++) {
+        format_preview(target, regions[i].offset, regions[i].length, "", first);
+        format_preview(other, regions[i].offset, regions[i].length, "", second);
+        fprintf(file, "%llu,%llu,%llu,%s,%s\n", (unsigned long long)regions[i].offset,
+                (unsigned long long)regions[i].length, (unsigned long long)regions[i].differing, first, second);
+    }
+    return fclose(file) == 0;
+}
+
+// WAV header (44 bytes) for stereo 16-bit PCM
+static bool write_stereo_header(FILE *file, int sample_rate, uint32_t data_size)
+{
+    unsigned char header[44];
+    memcpy(header, "RIFF", 4);
+    mbx_put_le32(header + 4, data_size + 36);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    mbx_put_le32(header + 16, 16);
+    mbx_put_le16(header + 20, 1);  // PCM
+    mbx_put_le16(header + 22, 2);  // Channels
+    mbx_put_le32(header + 24, (uint32_t)sample_rate);
+    mbx_put_le32(header + 28, (uint32_t)sample_rate * 4);
+    mbx_put_le16(header + 32, 4);  // Block align
+    mbx_put_le16(header + 34, 16); // Bits per sample
+    memcpy(header + 36, "data", 4);
+    mbx_put_le32(header + 40, data_size);
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+// Render the current tone of both synthesizers as interleaved stereo; returns the frames written
+static uint32_t render_tones(mbx_synth_t *left, mbx_synth_t *right, FILE *file, bool *ok)
+{
+    double left_block[DIFF_AUDIO_BLOCK], right_block[DIFF_AUDIO_BLOCK];
+    short pcm[2 * DIFF_AUDIO_BLOCK];
+    uint32_t frames = 0;
+    int count;
+    while (*ok && (count = mbx_synth_render(left, left_block, DIFF_AUDIO_BLOCK)) > 0) {
+        mbx_synth_render(right, right_block, count);
+        for (int i = 0; i < count; i++) {
+            pcm[2 * i] = (short)(left_block[i] * 32767.0);
+            pcm[2 * i + 1] = (short)(right_block[i] * 32767.0);
+        }
+        *ok = fwrite(pcm, sizeof(short), 2 * (size_t)count, file) == 2 * (size_t)count;
+        frames += (uint32_t)count;
+    }
+    return frames;
+}
+
+// Start a tone for a byte, or silence past the end of its input
+static void start_tone(mbx_synth_t *synth, sonar_config_t *sonar, const unsigned char *byte, int samples)
+{
+    if (byte) {
+        mbx_synth_start(synth, map_byte_to_frequency(*byte, sonar), map_byte_to_amplitude(*byte), samples);
+    } else {
+        mbx_synth_start(synth, 0.0, 0.0, samples);
+    }
+}
+
+// The first bytes of each region, one tone per byte: the first input left, the second right.
+// Silences between regions count against the tone budget too.
+static bool write_audio(mojibake_target_t *target, mojibake_target_t *other, const mbx_diff_region_t *regions,
+                        size_t count, sonar_config_t *sonar, double *seconds)
+{
+    FILE *file = fopen(MBX_DIFF_WAV_FILE, "wb");
+    if (!file) {
+        printf("Error: Could not create %s\n", MBX_DIFF_WAV_FILE);
+        return false;
+    }
+    bool ok = write_stereo_header(file, sonar->sample_rate, 0);
+
+    int tone = (int)(sonar->sample_duration * sonar->sample_rate + 0.5);
+    mbx_synth_t left, right;
+    mbx_synth_init(&left, sonar->sample_rate, sonar->sample_duration, sonar->shape_rolloff);
+    mbx_synth_init(&right, sonar->sample_rate, sonar->sample_duration, sonar->shape_rolloff);
+
+    uint64_t frames = 0;
+    size_t budget = MBX_DIFF_AUDIO_LIMIT;
+    for (size_t r = 0; ok && r < count && budget > 0; r++) {
+        unsigned char a[MBX_DIFF_AUDIO_BYTES], b[MBX_DIFF_AUDIO_BYTES];
+        size_t bytes = regions[r].length < MBX_DIFF_AUDIO_BYTES ? (size_t)regions[r].length : MBX_DIFF_AUDIO_BYTES;
+        if (bytes > budget) bytes = budget;
+        budget -= bytes;
+        size_t offset = (size_t)regions[r].offset;
+        size_t got_a = offset < target->size ? mojibake_read(target, offset, a, bytes) : 0;
+        size_t got_b = offset < other->size ? mojibake_read(other, offset, b, bytes) : 0;
+
+        for (size_t k = 0; ok && k < bytes; k++) {
+            start_tone(&left, sonar, k < got_a ? &a[k] : NULL, tone);
+            start_tone(&right, sonar, k < got_b ? &b[k] : NULL, tone);
+            frames += render_tones(&left, &right, file, &ok);
+        }
+        start_tone(&left, sonar, NULL, MBX_DIFF_AUDIO_GAP * tone);
+        start_tone(&right, sonar, NULL, MBX_DIFF_AUDIO_GAP * tone);
+        frames += render_tones(&left, &right, file, &ok);
+        budget -= budget < MBX_DIFF_AUDIO_GAP ? budget : MBX_DIFF_AUDIO_GAP;
+    }
+
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && write_stereo_header(file, sonar->sample_rate, (uint32_t)(frames * 4));
+    if (fclose(file) != 0) ok = false;
+    if (!ok) printf("Error: Could not write %s\n", MBX_DIFF_WAV_FILE);
+    *seconds = (double)frames / sonar->sample_rate;
+    return ok;
+}
+
+bool mbx_diff_batch(mojibake_target_t *target, mojibake_target_t *other, const mbx_diff_config_t *config)
+{
+    if (target == NULL || other == NULL || config == NULL) return false;
+
+    diff_batch_t batch = {.target = target, .other = other};
+    batch.summaries = calloc(target->partition_count, sizeof(mbx_diff_summary_t));
+    if (!batch.summaries) return false;
+
+    mbx_parallel_job_t job = {.threads = config->threads, .numa = config->numa,
+                              .partition = diff_job, .arg = &batch};
+    int threads = mbx_parallel_run(target, &job);
+    printf("[DIFF] %u partitions on %d threads\n\n", target->partition_count, threads);
+
+    // Regions are stitched across partition boundaries; a partition whose list is full
+    // still hands over its last region, so boundary regions come out whole
+    bool ok = true;
+    bool truncated = false;
+    uint64_t unlisted = 0, differing = 0;
+    mbx_diff_summary_t total;
+    memset(&total, 0, sizeof(total));
+    for (unsigned int i = 0; i < target->partition_count; i++) {
+        const mbx_diff_summary_t *summary = &batch.summaries[i];
+        ok = ok && summary->ok;
+        differing += summary->differing;
+        for (size_t r = 0; ok && r < summary->listed; r++) ok = add_region(&total, &summary->regions[r], SIZE_MAX);
+        if (ok && summary->listed < summary->region_count) {
+            truncated = true;
+            unlisted += summary->region_count - summary->listed - 1;
+            ok = add_region(&total, &summary->last, SIZE_MAX);
+        }
+    }
+
+    // Bytes past the end of the shorter input differ from nothing
+    size_t common = common_size(target, other);
+    size_t longest = target->size > other->size ? target->size : other->size;
+    if (ok && longest > common) {
+        mbx_diff_region_t tail = {common, longest - common, longest - common};
+        differing += tail.differing;
+        ok = add_region(&total, &tail, SIZE_MAX);
+    }
+    if (ok && total.region_count > 0) ok = close_region(&total, SIZE_MAX);
+
+    if (ok) {
+        printf("=== Differential Comparison ===\n");
+        printf("First:  %s (%u bytes)\n", config->name, target->size);
+        printf("Second: %s (%u bytes)\n", config->other_name, other->size);
+        if (target->size != other->size) {
+            printf("Only in %s: %zu bytes from offset %zu\n",
+                   target->size > other->size ? config->name : config->other_name, longest - common, common);
+        }
+        printf("Differing bytes: %llu of %zu (%.3f%%)\n", (unsigned long long)differing, longest,
+               longest > 0 ? 100.0 * differing / longest : 0.0);
+        printf("Regions: %llu (runs fewer than %d bytes apart merged)\n",
+               (unsigned long long)(total.region_count + unlisted), MBX_DIFF_MERGE_GAP);
+
+        char first[MBX_DIFF_PREVIEW_BYTES * 3 + 1], second[MBX_DIFF_PREVIEW_BYTES * 3 + 1];
+        for (size_t r = 0; r < total.listed && r < MBX_DIFF_PRINT_REGIONS; r++) {
+            const mbx_diff_region_t *region = &total.regions[r];
+            format_preview(target, region->offset, region->length, " ", first);
+            format_preview(other, region->offset, region->length, " ", second);
+            printf("\n  0x%08llx  %llu bytes, %llu differ\n    < %s\n    > %s\n", (unsigned long long)region->offset,
+                   (unsigned long long)region->length, (unsigned long long)region->differing, first, second);
+        }
+        if (total.listed > MBX_DIFF_PRINT_REGIONS) {
+            printf("\n  ... %zu more regions in %s\n", total.listed - MBX_DIFF_PRINT_REGIONS, MBX_DIFF_REPORT_FILE);
+        }
+        if (truncated) {
+            printf("\n  Only the first %d regions of each partition are listed\n", MBX_DIFF_LIST_REGIONS);
+        }
+        printf("\n");
+    }
+
+    ok = ok && write_report(target, other, total.regions, total.listed);
+    if (ok) printf("[OK] Delta report: %s (%zu regions)\n", MBX_DIFF_REPORT_FILE, total.listed);
+
+    if (ok && config->sonar && total.listed > 0) {
+        double seconds;
+        ok = write_audio(target, other, total.regions, total.listed, config->sonar, &seconds);
+        if (ok) {
+            printf("[OK] Comparison audio: %s (left %s, right %s, %.1f s)\n", MBX_DIFF_WAV_FILE, config->name,
+                   config->other_name, seconds);
+        }
+    } else if (ok && total.listed == 0) {
+        printf("[OK] The inputs are identical\n");
+    }
+
+    mbx_diff_summary_free(&total);
+    for (unsigned int i = 0; i < target->partition_count; i++) mbx_diff_summary_free(&batch.summaries[i]);
+    free(batch.summaries);
+    return ok;
+}
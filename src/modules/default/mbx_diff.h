@@ -0,0 +1,128 @@
+/**
+ * @file mbx_diff.h
+ * @brief Differential comparison of two inputs
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Compares two files block by block and reports only where they differ.
+ * The compare runs 64 bytes at a time (SSE2 where available, eight-byte
+ * words otherwise) and stops only at differing bytes, so mostly identical
+ * files cost one pass at memory speed. Partitions are compared in parallel.
+ *
+ * Differing bytes are grouped into regions; runs separated by fewer than
+ * MBX_DIFF_MERGE_GAP equal bytes count as one region. Bytes past the end of
+ * the shorter file differ by definition. The regions go to a compact delta
+ * report, and their first bytes are rendered as a stereo WAV: the first
+ * input on the left channel and the second on the right, with the SONAR
+ * tone mapping, so a listener hears the two sides drift apart.
+ */
+
+#ifndef MBX_DIFF_H
+#define MBX_DIFF_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mojibake/mojibake.h"
+#include "mbx_sonar.h"
+
+#define MBX_DIFF_MERGE_GAP 16          /**< Fewer equal bytes than this join two differing runs */
+#define MBX_DIFF_LIST_REGIONS 4096     /**< Regions listed per partition (all are counted) */
+#define MBX_DIFF_PRINT_REGIONS 20      /**< Regions printed to the console */
+#define MBX_DIFF_PREVIEW_BYTES 16      /**< Bytes of each side shown per region */
+#define MBX_DIFF_AUDIO_BYTES 64        /**< Bytes of each region rendered as audio */
+#define MBX_DIFF_AUDIO_LIMIT 4096      /**< Tones rendered in total, silences included */
+#define MBX_DIFF_AUDIO_GAP 4           /**< Silent tones between regions */
+#define MBX_DIFF_REPORT_FILE "diff_regions.csv"
+#define MBX_DIFF_WAV_FILE "diff_regions.wav"
+
+/**
+ * @brief A range where the inputs differ
+ */
+typedef struct {
+    uint64_t offset;           /**< File offset of the first differing byte */
+    uint64_t length;           /**< Bytes up to and including the last differing byte */
+    uint64_t differing;        /**< Differing bytes in the range */
+} mbx_diff_region_t;
+
+/**
+ * @brief Module settings
+ */
+typedef struct {
+    int threads;               /**< Worker threads (0 = one per online CPU) */
+    bool numa;                 /**< Pin workers to NUMA nodes and prefer node-local partitions */
+    const char *name;          /**< Name of the first input in reports */
+    const char *other_name;    /**< Name of the second input in reports */
+    sonar_config_t *sonar;     /**< Tone mapping for the comparison WAV (NULL = no audio) */
+} mbx_diff_config_t;
+
+/**
+ * @brief Per-partition result
+ */
+typedef struct {
+    size_t offset;             /**< File offset of the compared range */
+    size_t length;             /**< Bytes compared */
+    mbx_diff_region_t *regions; /**< First regions of the range, in order */
+    size_t listed;             /**< Regions in the list */
+    uint64_t region_count;     /**< Regions in the range, listed or not */
+    uint64_t differing;        /**< Differing bytes in the range */
+    mbx_diff_region_t last;    /**< Last region (valid if region_count > 0) */
+    bool ok;                   /**< Range was read completely from both inputs */
+} mbx_diff_summary_t;
+
+/**
+ * @brief Count the equal bytes at the start of two buffers
+ *
+ * @param a First buffer
+ * @param b Second buffer
+ * @param length Bytes in each buffer
+ * @return Offset of the first differing byte, or length if the buffers match
+ */
+size_t mbx_diff_equal_span(const unsigned char *a, const unsigned char *b, size_t length);
+
+/**
+ * @brief Count the differing bytes at the start of two buffers
+ *
+ * @param a First buffer
+ * @param b Second buffer
+ * @param length Bytes in each buffer
+ * @return Offset of the first equal byte, or length if every byte differs
+ */
+size_t mbx_diff_differing_span(const unsigned char *a, const unsigned char *b, size_t length);
+
+/**
+ * @brief Compare one partition of the common length of two inputs
+ *
+ * The common length is split into as many ranges as the first input has
+ * partitions. Safe to call from several threads on the same targets.
+ *
+ * @param target First input
+ * @param other Second input
+ * @param index Partition index
+ * @param summary Output result (release with mbx_diff_summary_free)
+ * @return true if the range was read completely from both inputs
+ */
+bool mbx_diff_partition(mojibake_target_t *target, mojibake_target_t *other, unsigned int index,
+                        mbx_diff_summary_t *summary);
+
+/**
+ * @brief Release the region list of a summary
+ *
+ * @param summary Pointer to summary
+ */
+void mbx_diff_summary_free(mbx_diff_summary_t *summary);
+
+/**
+ * @brief Compare two inputs in parallel and write the delta report and comparison WAV
+ *
+ * Prints the totals and first regions, writes every listed region to
+ * MBX_DIFF_REPORT_FILE and, with a tone mapping and any differences,
+ * renders the regions to MBX_DIFF_WAV_FILE.
+ *
+ * @param target First input
+ * @param other Second input
+ * @param config Module settings
+ * @return true if both inputs were compared and the outputs written
+ */
+bool mbx_diff_batch(mojibake_target_t *target, mojibake_target_t *other, const mbx_diff_config_t *config);
+
+#endif
@@ -0,0 +1,408 @@
+#include "mbx_digest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define MBX_CRC32C_SSE42
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define MBX_CRC32C_ARMV8
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// CRC32C (Castagnoli, reflected polynomial 0x82F63B78) lookup table
+static const uint32_t crc32c_table[256] = {
+    0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4, 0xC79A971F, 0x35F1141C,
+    0x26A1E7E8, 0xD4CA64EB, 0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B,
+    0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24, 0x105EC76F, 0xE235446C,
+    0xF165B798, 0x030E349B, 0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
+    0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54, 0x5D1D08BF, 0xAF768BBC,
+    0xBC267848, 0x4E4DFB4B, 0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A,
+    0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35, 0xAA64D611, 0x580F5512,
+    0x4B5FA6E6, 0xB93425E5, 0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
+    0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45, 0xF779DEAE, 0x05125DAD,
+    0x1642AE59, 0xE4292D5A, 0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A,
+    0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595, 0x417B1DBC, 0xB3109EBF,
+    0xA0406D4B, 0x522BEE48, 0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
+    0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687, 0x0C38D26C, 0xFE53516F,
+    0xED03A29B, 0x1F682198, 0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927,
+    0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38, 0xDBFC821C, 0x2997011F,
+    0x3AC7F2EB, 0xC8AC71E8, 0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
+    0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096, 0xA65C047D, 0x5437877E,
+    0x4767748A, 0xB50CF789, 0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859,
+    0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46, 0x7198540D, 0x83F3D70E,
+    0x90A324FA, 0x62C8A7F9, 0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
+    0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36, 0x3CDB9BDD, 0xCEB018DE,
+    0xDDE0EB2A, 0x2F8B6829, 0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C,
+    0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93, 0x082F63B7, 0xFA44E0B4,
+    0xE9141340, 0x1B7F9043, 0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
+    0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3, 0x55326B08, 0xA759E80B,
+    0xB4091BFF, 0x466298FC, 0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C,
+    0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033, 0xA24BB5A6, 0x502036A5,
+    0x4370C551, 0xB11B4652, 0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
+    0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D, 0xEF087A76, 0x1D63F975,
+    0x0E330A81, 0xFC588982, 0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D,
+    0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622, 0x38CC2A06, 0xCAA7A905,
+    0xD9F75AF1, 0x2B9CD9F2, 0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
+    0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530, 0x0417B1DB, 0xF67C32D8,
+    0xE52CC12C, 0x1747422F, 0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF,
+    0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0, 0xD3D3E1AB, 0x21B862A8,
+    0x32E8915C, 0xC083125F, 0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
+    0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90, 0x9E902E7B, 0x6CFBAD78,
+    0x7FAB5E8C, 0x8DC0DD8F, 0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE,
+    0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1, 0x69E9F0D5, 0x9B8273D6,
+    0x88D28022, 0x7AB90321, 0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
+    0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81, 0x34F4F86A, 0xC69F7B69,
+    0xD5CF889D, 0x27A40B9E, 0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E,
+    0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351
+};
+
+// XXH64 primes
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t length)
+{
+    while (length--)
+        crc = crc32c_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(MBX_CRC32C_SSE42)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t length)
+{
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+    while (length >= 4) {
+        uint32_t word;
+        memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+        p += 4;
+        length -= 4;
+    }
+    while (length--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+
+static bool crc32c_hw_available(void)
+{
+    static int available = -1;
+    if (available < 0)
+        available = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    return available == 1;
+}
+#elif defined(MBX_CRC32C_ARMV8)
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t length)
+{
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+        p += 8;
+        length -= 8;
+    }
+    while (length--)
+        crc = __crc32cb(crc, *p++);
+    return crc;
+}
+
+static bool crc32c_hw_available(void)
+{
+    return true;
+}
+#endif
+
+uint32_t mbx_crc32c(uint32_t crc, const void *data, size_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    if (!p || length == 0) return crc;
+
+    crc = ~crc;
+#if defined(MBX_CRC32C_SSE42) || defined(MBX_CRC32C_ARMV8)
+    if (crc32c_hw_available())
+        return ~crc32c_hw(crc, p, length);
+#endif
+    return ~crc32c_sw(crc, p, length);
+}
+
+static uint64_t xxh_rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t xxh_read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint32_t xxh_read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static uint64_t xxh64_merge_round(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void xxh64_consume_stripe(uint64_t acc[4], const unsigned char *p)
+{
+    acc[0] = xxh64_round(acc[0], xxh_read64(p));
+    acc[1] = xxh64_round(acc[1], xxh_read64(p + 8));
+    acc[2] = xxh64_round(acc[2], xxh_read64(p + 16));
+    acc[3] = xxh64_round(acc[3], xxh_read64(p + 24));
+}
+
+void mbx_digest_init(mbx_digest_state_t *state)
+{
+    if (!state) return;
+
+    memset(state, 0, sizeof(*state));
+    state->acc[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+    state->acc[1] = XXH_PRIME64_2;
+    state->acc[2] = 0;
+    state->acc[3] = 0 - XXH_PRIME64_1;
+}
+
+void mbx_digest_update(mbx_digest_state_t *state, const void *data, size_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    if (!state || !p || length == 0) return;
+
+    state->crc = mbx_crc32c(state->crc, p, length);
+    state->length += (unsigned int)length;
+
+    // Complete a partially buffered stripe first
+    if (state->buffered > 0) {
+        size_t fill = sizeof(state->buffer) - state->buffered;
+        if (fill > length) fill = length;
+        memcpy(state->buffer + state->buffered, p, fill);
+        state->buffered += (unsigned int)fill;
+        p += fill;
+        length -= fill;
+
+        if (state->buffered < sizeof(state->buffer)) return;
+        xxh64_consume_stripe(state->acc, state->buffer);
+        state->buffered = 0;
+    }
+
+    while (length >= 32) {
+        xxh64_consume_stripe(state->acc, p);
+        p += 32;
+        length -= 32;
+    }
+
+    if (length > 0) {
+        memcpy(state->buffer, p, length);
+        state->buffered = (unsigned int)length;
+    }
+}
+
+void mbx_digest_final(const mbx_digest_state_t *state, mbx_digest_t *digest)
+{
+    if (!state || !digest) return;
+
+    uint64_t h;
+    if (state->length >= 32) {
+        h = xxh_rotl64(state->acc[0], 1) + xxh_rotl64(state->acc[1], 7) +
+            xxh_rotl64(state->acc[2], 12) + xxh_rotl64(state->acc[3], 18);
+        h = xxh64_merge_round(h, state->acc[0]);
+        h = xxh64_merge_round(h, state->acc[1]);
+        h = xxh64_merge_round(h, state->acc[2]);
+        h = xxh64_merge_round(h, state->acc[3]);
+    } else {
+        h = state->acc[2] + XXH_PRIME64_5; // acc[2] holds the seed
+    }
+    h += (uint64_t)state->length;
+
+    const unsigned char *p = state->buffer;
+    unsigned int remaining = state->buffered;
+    while (remaining >= 8) {
+        h ^= xxh64_round(0, xxh_read64(p));
+        h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4) {
+        h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+        h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+        remaining -= 4;
+    }
+    while (remaining--) {
+        h ^= (*p++) * XXH_PRIME64_5;
+        h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    digest->length = state->length;
+    digest->crc32c = state->crc;
+    digest->xxh64 = h;
+}
+
+void mbx_digest_compute(const void *data, size_t length, mbx_digest_t *digest)
+{
+    mbx_digest_state_t state;
+    mbx_digest_init(&state);
+    mbx_digest_update(&state, data, length);
+    mbx_digest_final(&state, digest);
+}
+
+bool mbx_digest_equal(const mbx_digest_t *a, const mbx_digest_t *b)
+{
+    if (!a || !b) return false;
+    return a->length == b->length && a->crc32c == b->crc32c && a->xxh64 == b->xxh64;
+}
+
+bool mbx_digest_file(const char *filename, mbx_digest_t *digest)
+{
+    if (!filename || !digest) return false;
+
+    FILE *file = fopen(filename, "rb");
+    if (!file) return false;
+
+    mbx_digest_state_t state;
+    unsigned char buffer[64 * 1024];
+    size_t got;
+
+    mbx_digest_init(&state);
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        mbx_digest_update(&state, buffer, got);
+
+    bool ok = !ferror(file);
+    fclose(file);
+    if (ok)
+        mbx_digest_final(&state, digest);
+    return ok;
+}
+
+bool mbx_digest_write(const char *filename, const mbx_digest_t *digest)
+{
+    if (!filename || !digest) return false;
+
+    FILE *file = fopen(filename, "w");
+    if (!file) return false;
+
+    fprintf(file, "# SONAR partition digest\n");
+    fprintf(file, "length=%u\n", digest->length);
+    fprintf(file, "crc32c=%08X\n", (unsigned int)digest->crc32c);
+    fprintf(file, "xxh64=%016llX\n", (unsigned long long)digest->xxh64);
+
+    return fclose(file) == 0;
+}
+
+bool mbx_digest_read(const char *filename, mbx_digest_t *digest)
+{
+    if (!filename || !digest) return false;
+
+    FILE *file = fopen(filename, "r");
+    if (!file) return false;
+
+    char line[128];
+    int found = 0;
+    memset(digest, 0, sizeof(*digest));
+
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "length=", 7) == 0) {
+            digest->length = (unsigned int)strtoul(line + 7, NULL, 10);
+            found |= 1;
+        } else if (strncmp(line, "crc32c=", 7) == 0) {
+            digest->crc32c = (uint32_t)strtoul(line + 7, NULL, 16);
+            found |= 2;
+        } else if (strncmp(line, "xxh64=", 6) == 0) {
+            digest->xxh64 = (uint64_t)strtoull(line + 6, NULL, 16);
+            found |= 4;
+        }
+    }
+
+    fclose(file);
+    return found == 7;
+}
+
+void mbx_digest_filename(const char *wav_filename, char *digest_filename, size_t size)
+{
+    if (!wav_filename || !digest_filename || size == 0) return;
+
+    size_t length = strlen(wav_filename);
+    if (length >= 4 && strcmp(wav_filename + length - 4, ".wav") == 0)
+        length -= 4;
+
+    snprintf(digest_filename, size, "%.*s.digest", (int)length, wav_filename);
+}
+
+static void record_mismatches(const unsigned char *a, const unsigned char *b, size_t offset,
+                              size_t count, unsigned int base_offset, mbx_compare_result_t *result)
+{
+    for (size_t i = offset; i < offset + count; i++) {
+        if (a[i] == b[i]) continue;
+
+        unsigned int position = base_offset + (unsigned int)i;
+        if (result->mismatches == 0)
+            result->first_mismatch = position;
+        if (result->position_count < sizeof(result->positions) / sizeof(result->positions[0]))
+            result->positions[result->position_count++] = position;
+        result->mismatches++;
+    }
+}
+
+void mbx_compare_blocks(const unsigned char *a, const unsigned char *b, size_t length,
+                        unsigned int base_offset, mbx_compare_result_t *result)
+{
+    if (!a || !b || !result) return;
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= length; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF)
+            record_mismatches(a, b, i, 16, base_offset, result);
+    }
+#else
+    for (; i + 8 <= length; i += 8) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        if (wa != wb)
+            record_mismatches(a, b, i, 8, base_offset, result);
+    }
+#endif
+    record_mismatches(a, b, i, length - i, base_offset, result);
+    result->compared += (unsigned int)length;
+}
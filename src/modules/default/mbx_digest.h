@@ -0,0 +1,163 @@
+/**
+ * @file mbx_digest.h
+ * @brief Partition digests and block comparison for SONAR/dSONAR
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Provides CRC32C (hardware accelerated on SSE4.2 and ARMv8 CRC targets)
+ * and XXH64 digests that SONAR records for every partition at encode time,
+ * so dSONAR can verify a reconstruction without the original file. Also
+ * provides a word-at-a-time block comparison used when the original is
+ * available.
+ */
+
+#ifndef MBX_DIGEST_H
+#define MBX_DIGEST_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mojibake/mojibake.h"
+
+/**
+ * @brief Digest of a single data partition
+ */
+typedef struct {
+    unsigned int length;       /**< Number of bytes covered by the digest */
+    uint32_t crc32c;           /**< CRC32C (Castagnoli) of the data */
+    uint64_t xxh64;            /**< XXH64 (seed 0) of the data */
+} mbx_digest_t;
+
+/**
+ * @brief Streaming digest state
+ *
+ * Allows digests to be computed incrementally so that verification
+ * needs O(1) memory regardless of the data length.
+ */
+typedef struct {
+    unsigned int length;       /**< Total bytes consumed so far */
+    uint32_t crc;              /**< Running (inverted) CRC32C value */
+    uint64_t acc[4];           /**< XXH64 stripe accumulators */
+    unsigned char buffer[32];  /**< Pending bytes of an incomplete stripe */
+    unsigned int buffered;     /**< Number of valid bytes in buffer */
+} mbx_digest_state_t;
+
+/**
+ * @brief Result of comparing a reconstruction against its original
+ */
+typedef struct {
+    unsigned int compared;     /**< Number of bytes compared */
+    unsigned int mismatches;   /**< Number of differing bytes */
+    unsigned int first_mismatch; /**< Offset of first differing byte (valid if mismatches > 0) */
+    unsigned int positions[16]; /**< Offsets of the first differing bytes */
+    unsigned int position_count; /**< Number of valid entries in positions */
+} mbx_compare_result_t;
+
+/**
+ * @brief Initialize a streaming digest state
+ *
+ * @param state Pointer to digest state to initialize
+ */
+void mbx_digest_init(mbx_digest_state_t *state);
+
+/**
+ * @brief Feed data into a streaming digest
+ *
+ * @param state Pointer to initialized digest state
+ * @param data Pointer to data
+ * @param length Number of bytes to consume
+ */
+void mbx_digest_update(mbx_digest_state_t *state, const void *data, size_t length);
+
+/**
+ * @brief Finish a streaming digest
+ *
+ * @param state Pointer to digest state (left unchanged)
+ * @param digest Pointer to store the final digest
+ */
+void mbx_digest_final(const mbx_digest_state_t *state, mbx_digest_t *digest);
+
+/**
+ * @brief Compute the digest of a memory block in one call
+ *
+ * @param data Pointer to data
+ * @param length Number of bytes
+ * @param digest Pointer to store the digest
+ */
+void mbx_digest_compute(const void *data, size_t length, mbx_digest_t *digest);
+
+/**
+ * @brief Compute the digest of a file in fixed-size chunks
+ *
+ * @param filename Path of the file to hash
+ * @param digest Pointer to store the digest
+ * @return true if the whole file was read, false otherwise
+ */
+bool mbx_digest_file(const char *filename, mbx_digest_t *digest);
+
+/**
+ * @brief Compute CRC32C of a memory block
+ *
+ * Uses the SSE4.2 or ARMv8 CRC32 instructions when available and a
+ * table-driven implementation otherwise.
+ *
+ * @param crc Previous CRC value (0 for a new computation)
+ * @param data Pointer to data
+ * @param length Number of bytes
+ * @return Updated CRC32C value
+ */
+uint32_t mbx_crc32c(uint32_t crc, const void *data, size_t length);
+
+/**
+ * @brief Check whether two digests describe the same data
+ *
+ * @param a First digest
+ * @param b Second digest
+ * @return true if length, CRC32C and XXH64 all match
+ */
+bool mbx_digest_equal(const mbx_digest_t *a, const mbx_digest_t *b);
+
+/**
+ * @brief Write a digest sidecar file
+ *
+ * @param filename Path of the digest file (e.g. "sonar_partition_0.digest")
+ * @param digest Pointer to digest to store
+ * @return true if written successfully, false otherwise
+ */
+bool mbx_digest_write(const char *filename, const mbx_digest_t *digest);
+
+/**
+ * @brief Read a digest sidecar file
+ *
+ * @param filename Path of the digest file
+ * @param digest Pointer to store the parsed digest
+ * @return true if the file exists and parsed correctly, false otherwise
+ */
+bool mbx_digest_read(const char *filename, mbx_digest_t *digest);
+
+/**
+ * @brief Build the digest sidecar filename for an audio file
+ *
+ * Replaces a trailing ".wav" with ".digest", or appends ".digest".
+ *
+ * @param wav_filename Path of the audio file
+ * @param digest_filename Buffer for the resulting filename
+ * @param size Size of digest_filename in bytes
+ */
+void mbx_digest_filename(const char *wav_filename, char *digest_filename, size_t size);
+
+/**
+ * @brief Compare two memory blocks word-at-a-time
+ *
+ * Compares 16 bytes per step using SSE2 (or 8-byte words elsewhere) and
+ * only falls back to byte comparison inside differing words.
+ *
+ * @param a First block
+ * @param b Second block
+ * @param length Number of bytes to compare
+ * @param base_offset Offset added to reported positions
+ * @param result Pointer to compare result to accumulate into
+ */
+void mbx_compare_blocks(const unsigned char *a, const unsigned char *b, size_t length,
+                        unsigned int base_offset, mbx_compare_result_t *result);
+
+#endif
@@ -1,4 +1,7 @@
 #include "mbx_dsonar.h"
+#include "mbx_digest.h"
+#include "mbx_lz.h"
+#include "mbx_estimate.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -65,9 +68,166 @@ static dsonar_config_t default_dsonar_config = {
     .frequency_range = 2000.0,
     .tolerance = 5.0,  // 5 Hz tolerance
     .strict_mode = false,
-    .input_format = "auto"
+    .input_format = "auto",
+    .sample_duration = 0.05,
+    .run_quantum = 0.001,
+    .max_memory = 0,
+    .plan = NULL,
+    .qam = NULL
 };
 
+// Samples with |x| at or below this level count as silence in merged WAV streams
+#define DSONAR_SILENCE_LEVEL 8
+
+// Output buffer size for streaming reconstruction under a memory budget
+#define DSONAR_STREAM_BUFFER (64 * 1024)
+
+// Samples of audio examined by the blind parameter estimate (about 6 s at 44.1 kHz)
+#define DSONAR_ESTIMATE_SAMPLES (1 << 18)
+
+// Blind estimates below this confidence never override configured parameters
+#define DSONAR_ESTIMATE_MIN_CONFIDENCE 0.8
+
+// A configured run quantum gives way only to an estimate this many of its errors away
+// (its error is about one sample over the longest run seen)
+#define DSONAR_QUANTUM_TOLERANCE 2.0
+
+// Initial decode buffer capacity when the input gives no size hint
+#define DSONAR_DECODE_INITIAL 4096
+
+// Confidence reported for bytes decoded from tones, which zero-crossing detection resolves only approximately
+#define DSONAR_TONE_CONFIDENCE 0.7
+
+// Fixed-size output buffer for streaming reconstruction; the digest is accumulated on the way out
+typedef struct {
+    FILE* output;
+    unsigned char* buffer;
+    size_t fill;
+    size_t length;
+    unsigned char prefix[MBX_LZ_HEADER_SIZE];
+    size_t prefix_length;
+    mbx_digest_state_t digest;
+    bool error;
+    dsonar_config_t* config;
+} dsonar_stream_t;
+
+static bool stream_open(dsonar_stream_t* stream, const char* output_filename, dsonar_config_t* config)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->config = config;
+    stream->buffer = malloc(DSONAR_STREAM_BUFFER);
+    stream->output = stream->buffer ? fopen(output_filename, "wb") : NULL;
+    if (!stream->output) {
+        printf("[dSONAR] Error: Could not create %s\n", output_filename);
+        free(stream->buffer);
+        return false;
+    }
+    mbx_digest_init(&stream->digest);
+    return true;
+}
+
+static bool stream_flush(dsonar_stream_t* stream)
+{
+    if (stream->fill == 0 || stream->error) return !stream->error;
+    
+    // Keep the start of the payload to recognize compressed streams afterwards
+    if (stream->length == 0) {
+        stream->prefix_length = stream->fill < MBX_LZ_HEADER_SIZE ? stream->fill : MBX_LZ_HEADER_SIZE;
+        memcpy(stream->prefix, stream->buffer, stream->prefix_length);
+    }
+    
+    mbx_digest_update(&stream->digest, stream->buffer, stream->fill);
+    if (fwrite(stream->buffer, 1, stream->fill, stream->output) != stream->fill) {
+        stream->error = true;
+        return false;
+    }
+    stream->length += stream->fill;
+    stream->fill = 0;
+    return true;
+}
+
+static bool stream_put_run(dsonar_stream_t* stream, unsigned char byte, unsigned int run_length)
+{
+    while (run_length > 0) {
+        if (stream->fill == DSONAR_STREAM_BUFFER && !stream_flush(stream)) return false;
+        
+        size_t count = DSONAR_STREAM_BUFFER - stream->fill;
+        if (count > run_length) count = run_length;
+        memset(stream->buffer + stream->fill, byte, count);
+        stream->fill += count;
+        run_length -= (unsigned int)count;
+    }
+    return true;
+}
+
+static bool wav_stream_sink(void* ctx, double frequency, unsigned int run_length)
+{
+    dsonar_stream_t* stream = ctx;
+    return stream_put_run(stream, frequency_to_byte(frequency, stream->config), run_length);
+}
+
+// Expand a compressed streamed payload in place when the budget leaves room for both copies
+static void stream_expand_output(dsonar_stream_t* stream, const char* output_filename, dsonar_result_t* result)
+{
+    if (!mbx_lz_is_compressed(stream->prefix, stream->prefix_length)) return;
+    
+    size_t original = mbx_lz_original_length(stream->prefix, stream->prefix_length);
+    size_t max_memory = stream->config->max_memory;
+    if (max_memory > 0 && stream->length + original > max_memory) {
+        printf("[dSONAR] Warning: Compressed payload would exceed the memory budget, keeping raw bytes\n");
+        return;
+    }
+    
+    unsigned char* packed = malloc(stream->length > 0 ? stream->length : 1);
+    FILE* input = packed ? fopen(output_filename, "rb") : NULL;
+    bool loaded = input && fread(packed, 1, stream->length, input) == stream->length;
+    if (input) fclose(input);
+    
+    size_t expanded_length = 0;
+    unsigned char* expanded = loaded ? mbx_lz_decompress(packed, stream->length, &expanded_length) : NULL;
+    free(packed);
+    if (!expanded) {
+        printf("[dSONAR] Warning: Compressed payload is damaged, keeping raw bytes\n");
+        return;
+    }
+    
+    FILE* output = fopen(output_filename, "wb");
+    bool written = output && fwrite(expanded, 1, expanded_length, output) == expanded_length;
+    if (output && fclose(output) != 0) written = false;
+    
+    if (written) {
+        printf("[dSONAR] Decompressed payload: %d -> %zu bytes\n", result->data_length, expanded_length);
+        mbx_digest_compute(expanded, expanded_length, &result->digest);
+        result->data_length = (int)expanded_length;
+    } else {
+        printf("[dSONAR] Error: Could not rewrite %s\n", output_filename);
+        result->data_length = 0;
+    }
+    free(expanded);
+}
+
+// Flush and close a stream, and describe it in a result without a data buffer
+static dsonar_result_t* stream_finish(dsonar_stream_t* stream, const char* output_filename)
+{
+    stream_flush(stream);
+    if (fclose(stream->output) != 0) stream->error = true;
+    free(stream->buffer);
+    
+    if (stream->error) {
+        printf("[dSONAR] Error: Failed writing %s\n", output_filename);
+        return NULL;
+    }
+    
+    dsonar_result_t* result = calloc(1, sizeof(dsonar_result_t));
+    if (!result) return NULL;
+    
+    result->streamed = true;
+    result->data_length = (int)stream->length;
+    mbx_digest_final(&stream->digest, &result->digest);
+    stream_expand_output(stream, output_filename, result);
+    return result;
+}
+
 bool mbx_dsonar(mojibake_target_t *target, unsigned int index, void *arg)
 {
     if (target == NULL) return false;
@@ -157,7 +317,17 @@ bool mbx_dsonar(mojibake_target_t *target, unsigned int index, void *arg)
                 min(target->partition_size, result->data_length)
             );
             printf("Reconstruction accuracy: %.2f%%\n", accuracy * 100.0);
+            
+            dsonar_error_stats_t errors;
+            analyze_reconstruction_errors(original_partition, result->reconstructed_data, result->confidence,
+                                          min(target->partition_size, result->data_length), &errors);
+            print_error_analysis(&errors);
         }
+        
+        // Verify against the digest recorded by SONAR
+        char digest_filename[256];
+        sprintf(digest_filename, "sonar_partition_%d.digest", index);
+        verify_reconstruction_digest(result, digest_filename);
     }
     
     free_dsonar_result(result);
@@ -200,41 +370,29 @@ dsonar_result_t* reconstruct_from_json(const char* json_filename, dsonar_config_
     
     printf("[dSONAR] Parsing JSON metadata...\n");
     
-    reverse_sample_node_t* samples = NULL;
-    if (!parse_json_metadata(json_filename, &samples, config)) {
-        fclose(json_file);
-        return NULL;
-    }
     fclose(json_file);
     
-    // Convert samples to result
-    dsonar_result_t* result = malloc(sizeof(dsonar_result_t));
-    if (!result) {
-        free_reverse_samples(samples);
+    dsonar_decode_buffer_t buffer;
+    if (!init_decode_buffer(&buffer, 0, 0.5, config->max_memory)) {
         return NULL;
     }
-    
-    result->reconstructed_data = samples_to_bytes(samples, &result->data_length);
-    
-    // Calculate statistics
-    result->total_samples = 0;
-    result->successful_samples = 0;
-    double total_confidence = 0.0;
-    
-    reverse_sample_node_t* current = samples;
-    while (current) {
-        result->total_samples++;
-        if (current->confidence_score > 0.5) {
-            result->successful_samples++;
+    if (!parse_json_metadata(json_filename, &buffer, config) || buffer.over_budget) {
+        if (buffer.over_budget) {
+            printf("[dSONAR] Error: Decoded bytes exceed the %zu byte memory budget\n", config->max_memory);
         }
-        total_confidence += current->confidence_score;
-        current = current->next;
+        free_decode_buffer(&buffer);
+        return NULL;
     }
     
-    result->average_confidence = result->total_samples > 0 ? 
-        total_confidence / result->total_samples : 0.0;
+    // Convert decoded bytes to result
+    dsonar_result_t* result = calloc(1, sizeof(dsonar_result_t));
+    if (!result) {
+        free_decode_buffer(&buffer);
+        return NULL;
+    }
     
-    free_reverse_samples(samples);
+    decode_buffer_to_result(&buffer, result);
+    decompress_reconstruction(result);
     return result;
 }
 
@@ -256,31 +414,44 @@ dsonar_result_t* reconstruct_from_csv(const char* csv_filename, dsonar_config_t*
         return NULL;
     }
     
-    // Count lines to determine data size
+    // Count decoded bytes (merged tones expand to their run length) to determine data size
     long pos = ftell(csv_file);
     int sample_count = 0;
+    int gap_count = 0;
+    int byte_count = 0;
     while (fgets(line, sizeof(line), csv_file)) {
+        int sample_num, byte_dec;
+        char byte_hex[8];
+        double frequency, amplitude, duration;
         sample_count++;
+        if (sscanf(line, "%d,%7[^,],%d,%lf,%lf,%lf",
+                   &sample_num, byte_hex, &byte_dec, &frequency, &amplitude, &duration) == 6) {
+            if (amplitude > 0.0) byte_count += duration_to_run_length(duration, config);
+            else gap_count++;
+        }
     }
     fseek(csv_file, pos, SEEK_SET);
     
-    if (sample_count == 0) {
+    if (sample_count == 0 || byte_count == 0) {
         printf("[dSONAR] Error: No data found in CSV file\n");
         fclose(csv_file);
         return NULL;
     }
     
-    printf("[dSONAR] Found %d frequency samples in CSV\n", sample_count);
-    
-    // Allocate result structure
-    dsonar_result_t* result = malloc(sizeof(dsonar_result_t));
-    if (!result) {
+    // Each decoded byte costs its value and its confidence
+    if (config->max_memory > 0 && (size_t)byte_count * 2 > config->max_memory) {
+        printf("[dSONAR] Error: %d bytes exceed the %zu byte memory budget, use reconstruct_from_csv_to_file\n",
+               byte_count, config->max_memory);
         fclose(csv_file);
         return NULL;
     }
     
-    result->reconstructed_data = malloc(sample_count);
-    if (!result->reconstructed_data) {
+    printf("[dSONAR] Found %d frequency samples in CSV\n", sample_count);
+    
+    // Allocate result structure
+    dsonar_result_t* result = calloc(1, sizeof(dsonar_result_t));
+    dsonar_decode_buffer_t buffer;
+    if (!result || !init_decode_buffer(&buffer, byte_count, 0.0, config->max_memory)) {
         free(result);
         fclose(csv_file);
         return NULL;
@@ -288,10 +459,11 @@ dsonar_result_t* reconstruct_from_csv(const char* csv_filename, dsonar_config_t*
     
     // Read CSV data and reconstruct bytes
     int bytes_read = 0;
+    int line_number = 0;
     int successful_samples = 0;
     double total_confidence = 0.0;
     
-    while (fgets(line, sizeof(line), csv_file) && bytes_read < sample_count) {
+    while (fgets(line, sizeof(line), csv_file) && bytes_read < byte_count) {
         int sample_num;
         char byte_hex[8];
         int byte_dec;
@@ -299,36 +471,116 @@ dsonar_result_t* reconstruct_from_csv(const char* csv_filename, dsonar_config_t*
         double amplitude;
         double duration;
         
+        line_number++;
+        
         // Parse CSV line: Sample,Byte_Hex,Byte_Dec,Frequency_Hz,Amplitude,Duration_s
         int parsed = sscanf(line, "%d,%7[^,],%d,%lf,%lf,%lf", 
                            &sample_num, byte_hex, &byte_dec, &frequency, &amplitude, &duration);
         
         if (parsed == 6) {
+            // Zero-amplitude rows are the gaps that delimit merged runs
+            if (amplitude <= 0.0) continue;
+            
             // Use the byte_dec value directly from CSV (most accurate)
-            result->reconstructed_data[bytes_read] = (unsigned char)byte_dec;
+            int run_length = (int)duration_to_run_length(duration, config);
+            if (run_length > byte_count - bytes_read) run_length = byte_count - bytes_read;
             
             // Calculate confidence based on amplitude (higher amplitude = higher confidence)
             double confidence = amplitude; // Amplitude is already normalized 0-1
+            append_decoded_run(&buffer, (unsigned char)byte_dec, run_length, confidence);
             total_confidence += confidence;
             successful_samples++;
             
-            bytes_read++;
+            bytes_read += run_length;
         } else {
-            printf("[dSONAR] Warning: Could not parse CSV line %d\n", bytes_read + 1);
+            printf("[dSONAR] Warning: Could not parse CSV line %d\n", line_number);
         }
     }
     
     fclose(csv_file);
     
-    // Fill result structure
-    result->data_length = bytes_read;
-    result->total_samples = sample_count;
+    // Fill result structure; statistics are per tone rather than per byte
+    decode_buffer_to_result(&buffer, result);
+    result->total_samples = sample_count - gap_count;
     result->successful_samples = successful_samples;
     result->average_confidence = successful_samples > 0 ? total_confidence / successful_samples : 0.0;
     
     printf("[dSONAR] Successfully reconstructed %d bytes from CSV data\n", bytes_read);
     printf("[dSONAR] Average confidence: %.3f\n", result->average_confidence);
     
+    decompress_reconstruction(result);
+    return result;
+}
+
+dsonar_result_t* reconstruct_from_csv_to_file(const char* csv_filename, const char* output_filename, dsonar_config_t* config)
+{
+    FILE* csv_file = fopen(csv_filename, "r");
+    if (!csv_file) {
+        printf("[dSONAR] Error: Could not open CSV file %s\n", csv_filename);
+        return NULL;
+    }
+    
+    printf("[dSONAR] Streaming CSV reconstruction to %s...\n", output_filename);
+    
+    // Skip header line
+    char line[512];
+    if (!fgets(line, sizeof(line), csv_file)) {
+        printf("[dSONAR] Error: Could not read CSV header\n");
+        fclose(csv_file);
+        return NULL;
+    }
+    
+    dsonar_stream_t stream;
+    if (!stream_open(&stream, output_filename, config)) {
+        fclose(csv_file);
+        return NULL;
+    }
+    
+    int line_number = 0;
+    int tone_count = 0;
+    int successful_samples = 0;
+    double total_confidence = 0.0;
+    
+    // One pass: rows are expanded straight into the output buffer
+    while (!stream.error && fgets(line, sizeof(line), csv_file)) {
+        int sample_num, byte_dec;
+        char byte_hex[8];
+        double frequency, amplitude, duration;
+        
+        line_number++;
+        if (sscanf(line, "%d,%7[^,],%d,%lf,%lf,%lf",
+                   &sample_num, byte_hex, &byte_dec, &frequency, &amplitude, &duration) != 6) {
+            printf("[dSONAR] Warning: Could not parse CSV line %d\n", line_number);
+            continue;
+        }
+        
+        // Zero-amplitude rows are the gaps that delimit merged runs
+        if (amplitude <= 0.0) continue;
+        tone_count++;
+        
+        if (stream_put_run(&stream, (unsigned char)byte_dec, duration_to_run_length(duration, config))) {
+            total_confidence += amplitude;
+            successful_samples++;
+        }
+    }
+    
+    fclose(csv_file);
+    
+    dsonar_result_t* result = stream_finish(&stream, output_filename);
+    if (!result) return NULL;
+    
+    if (result->data_length == 0) {
+        printf("[dSONAR] Error: No data found in CSV file\n");
+        free_dsonar_result(result);
+        return NULL;
+    }
+    
+    result->total_samples = tone_count;
+    result->successful_samples = successful_samples;
+    result->average_confidence = successful_samples > 0 ? total_confidence / successful_samples : 0.0;
+    
+    printf("[dSONAR] Successfully reconstructed %d bytes from CSV data\n", result->data_length);
+    printf("[dSONAR] Average confidence: %.3f\n", result->average_confidence);
     return result;
 }
 
@@ -336,42 +588,365 @@ dsonar_result_t* reconstruct_from_analysis(const char* analysis_filename, dsonar
 {
     printf("[dSONAR] Parsing analysis report...\n");
     
-    reverse_sample_node_t* samples = NULL;
-    if (!parse_analysis_report(analysis_filename, &samples, config)) {
+    dsonar_decode_buffer_t buffer;
+    if (!init_decode_buffer(&buffer, 0, 0.6, config->max_memory)) {
+        return NULL;
+    }
+    if (!parse_analysis_report(analysis_filename, &buffer, config) || buffer.over_budget) {
+        if (buffer.over_budget) {
+            printf("[dSONAR] Error: Decoded bytes exceed the %zu byte memory budget\n", config->max_memory);
+        }
+        free_decode_buffer(&buffer);
         return NULL;
     }
     
     // Convert to result
-    dsonar_result_t* result = malloc(sizeof(dsonar_result_t));
+    dsonar_result_t* result = calloc(1, sizeof(dsonar_result_t));
     if (!result) {
-        free_reverse_samples(samples);
+        free_decode_buffer(&buffer);
         return NULL;
     }
     
-    result->reconstructed_data = samples_to_bytes(samples, &result->data_length);
+    decode_buffer_to_result(&buffer, result);
+    decompress_reconstruction(result);
+    return result;
+}
+
+// Samples between the current position (the start of the data chunk) and the end of the file
+static size_t wav_data_samples(FILE* wav_file)
+{
+    long start = ftell(wav_file);
+    if (start < 0 || fseek(wav_file, 0, SEEK_END) != 0) return 0;
+    long end = ftell(wav_file);
+    fseek(wav_file, start, SEEK_SET);
+    return end > start ? (size_t)(end - start) / sizeof(short) : 0;
+}
+
+// Bin-centered plan tones are separated exactly by the plan's Goertzel bank
+static double detect_tone(dsonar_config_t* config, short* audio_buffer, int count, int sample_rate)
+{
+    if (config->plan) {
+        return mbx_freqplan_detect(config->plan, audio_buffer, count);
+    }
+    return detect_dominant_frequency(audio_buffer, count, sample_rate);
+}
+
+// Receives each decoded tone; returning false stops decoding
+typedef bool (*wav_tone_sink_t)(void* ctx, double frequency, unsigned int run_length);
+
+// Decode the tones of a WAV data chunk in fixed-size blocks, independent of the file length
+static bool decode_wav_tones(FILE* wav_file, int sample_rate, dsonar_config_t* config,
+                             wav_tone_sink_t sink, void* ctx, int* tone_count)
+{
+    // Each unmerged tone spans one symbol; merged tones are symbol + (run - 1) quanta, then a gap
+    int symbol_samples = (int)(config->sample_duration * sample_rate);
+    int quantum_samples = (int)(config->run_quantum * sample_rate);
+    int silence_samples = quantum_samples / 2 > 4 ? quantum_samples / 2 : 4;
+    if (symbol_samples < 10) {
+        printf("[dSONAR] Error: Sample duration too short for %d Hz audio\n", sample_rate);
+        return false;
+    }
     
-    // Calculate statistics
-    result->total_samples = 0;
-    result->successful_samples = 0;
-    double total_confidence = 0.0;
+    short* audio_buffer = malloc(symbol_samples * sizeof(short));
+    if (!audio_buffer) return false;
+    
+    // Merged streams begin with a silent gap; unmerged tones start at full swing within a few samples
+    long data_start = ftell(wav_file);
+    int lead = quantum_samples > silence_samples ? quantum_samples : silence_samples;
+    bool merged = quantum_samples > 0 && lead <= symbol_samples &&
+                  fread(audio_buffer, sizeof(short), lead, wav_file) == (size_t)lead;
+    for (int i = 0; merged && i < lead; i++) {
+        if (abs(audio_buffer[i]) > DSONAR_SILENCE_LEVEL) merged = false;
+    }
+    fseek(wav_file, data_start, SEEK_SET);
+    
+    bool running = true;
+    *tone_count = 0;
+    
+    if (merged) {
+        printf("[dSONAR] Run-merged stream detected, decoding variable-length tones\n");
+        
+        short block[4096];
+        size_t got;
+        bool in_tone = false;
+        int tone_length = 0, tone_fill = 0, zero_run = 0;
+        
+        // Tones are delimited by silence; only their first symbol is needed for frequency detection
+        while (running && (got = fread(block, sizeof(short), sizeof(block) / sizeof(block[0]), wav_file)) > 0) {
+            for (size_t i = 0; running && i < got; i++) {
+                bool silent = abs(block[i]) <= DSONAR_SILENCE_LEVEL;
+                zero_run = silent ? zero_run + 1 : 0;
+                
+                if (!in_tone) {
+                    if (silent) continue;
+                    in_tone = true;
+                    tone_length = tone_fill = 0;
+                }
+                
+                tone_length++;
+                if (tone_fill < symbol_samples) audio_buffer[tone_fill++] = block[i];
+                
+                if (zero_run >= silence_samples) {
+                    int length = tone_length - zero_run;
+                    double frequency = detect_tone(config, audio_buffer, min(tone_fill, length), sample_rate);
+                    if (frequency > 0) {
+                        unsigned int run = duration_to_run_length((double)length / sample_rate, config);
+                        running = sink(ctx, frequency, run);
+                        if (running) (*tone_count)++;
+                    }
+                    in_tone = false;
+                }
+            }
+        }
+        
+        if (running && in_tone) {
+            int length = tone_length - zero_run;
+            double frequency = detect_tone(config, audio_buffer, min(tone_fill, length), sample_rate);
+            if (frequency > 0) {
+                unsigned int run = duration_to_run_length((double)length / sample_rate, config);
+                if (sink(ctx, frequency, run)) (*tone_count)++;
+            }
+        }
+    } else {
+        // Read audio data in chunks (each chunk represents one byte's frequency)
+        while (running && fread(audio_buffer, sizeof(short), symbol_samples, wav_file) == (size_t)symbol_samples) {
+            // Zero-crossing analysis, or the plan's filter bank
+            double estimated_frequency = detect_tone(config, audio_buffer, symbol_samples, sample_rate);
+            
+            if (estimated_frequency > 0) {
+                running = sink(ctx, estimated_frequency, 1);
+                if (running) (*tone_count)++;
+            }
+        }
+    }
+    
+    free(audio_buffer);
+    return true;
+}
+
+// Receives decoded payload bytes and the quality of their symbol; returning false stops decoding
+typedef bool (*wav_byte_sink_t)(void* ctx, const unsigned char* bytes, size_t count, double quality);
+
+// Demodulate coherent PSK/QAM symbols: the first bytes announce the payload length, padding is dropped
+static bool decode_wav_qam(FILE* wav_file, int sample_rate, dsonar_config_t* config,
+                           wav_byte_sink_t sink, void* ctx, int* symbol_count, double* quality)
+{
+    const mbx_qam_t* qam = config->qam;
+    *symbol_count = 0;
+    *quality = 0.0;
+    if (sample_rate != qam->sample_rate) {
+        printf("[dSONAR] Error: Coherent stream expected at %d Hz, WAV is %d Hz\n", qam->sample_rate, sample_rate);
+        return false;
+    }
     
-    reverse_sample_node_t* current = samples;
-    while (current) {
-        result->total_samples++;
-        if (current->confidence_score > 0.6) {
-            result->successful_samples++;
+    short* audio_buffer = malloc(qam->symbol_samples * sizeof(short));
+    if (!audio_buffer) return false;
+    
+    unsigned char bytes[MBX_QAM_MAX_SYMBOL_BYTES];
+    unsigned char prefix[MBX_QAM_LENGTH_PREFIX];
+    int prefix_fill = 0;
+    unsigned int remaining = 0;
+    double total_quality = 0.0;
+    bool running = true;
+    
+    while (running && (prefix_fill < MBX_QAM_LENGTH_PREFIX || remaining > 0) &&
+           fread(audio_buffer, sizeof(short), qam->symbol_samples, wav_file) == (size_t)qam->symbol_samples) {
+        double symbol_quality = mbx_qam_demodulate(qam, audio_buffer, bytes);
+        total_quality += symbol_quality;
+        (*symbol_count)++;
+        
+        int offset = 0;
+        while (prefix_fill < MBX_QAM_LENGTH_PREFIX && offset < qam->symbol_bytes) {
+            prefix[prefix_fill++] = bytes[offset++];
+            if (prefix_fill == MBX_QAM_LENGTH_PREFIX) {
+                remaining = prefix[0] | (prefix[1] << 8) | (prefix[2] << 16) | ((unsigned int)prefix[3] << 24);
+            }
+        }
+        
+        unsigned int count = qam->symbol_bytes - offset;
+        if (count > remaining) count = remaining;
+        if (count > 0) {
+            running = sink(ctx, bytes + offset, count, symbol_quality);
+            remaining -= count;
         }
-        total_confidence += current->confidence_score;
-        current = current->next;
     }
     
-    result->average_confidence = result->total_samples > 0 ? 
-        total_confidence / result->total_samples : 0.0;
+    if (running && remaining > 0) {
+        printf("[dSONAR] Warning: WAV ends %u bytes short of the announced payload\n", remaining);
+    }
+    if (*symbol_count > 0) *quality = total_quality / *symbol_count;
     
-    free_reverse_samples(samples);
+    free(audio_buffer);
+    return true;
+}
+
+static bool wav_buffer_bytes(void* ctx, const unsigned char* bytes, size_t count, double quality)
+{
+    dsonar_decode_buffer_t* buffer = ctx;
+    for (size_t i = 0; i < count; i++) {
+        if (!append_decoded_run(buffer, bytes[i], 1, quality)) return false;
+    }
+    return true;
+}
+
+static bool wav_stream_bytes(void* ctx, const unsigned char* bytes, size_t count, double quality)
+{
+    (void)quality;
+    dsonar_stream_t* stream = ctx;
+    for (size_t i = 0; i < count; i++) {
+        if (!stream_put_run(stream, bytes[i], 1)) return false;
+    }
+    return true;
+}
+
+// In-memory coherent reconstruction of an open WAV positioned at its data
+static dsonar_result_t* reconstruct_qam(FILE* wav_file, int sample_rate, dsonar_config_t* config)
+{
+    // Every whole symbol of the data chunk carries symbol_bytes bytes, the length prefix included
+    const mbx_qam_t* qam = config->qam;
+    size_t expected = wav_data_samples(wav_file) / qam->symbol_samples * qam->symbol_bytes;
+    
+    dsonar_decode_buffer_t buffer;
+    if (!init_decode_buffer(&buffer, expected, 0.5, config->max_memory)) {
+        return NULL;
+    }
+    
+    int symbol_count = 0;
+    double quality = 0.0;
+    bool decoded = decode_wav_qam(wav_file, sample_rate, config, wav_buffer_bytes, &buffer, &symbol_count, &quality);
+    
+    if (buffer.over_budget) {
+        printf("[dSONAR] Error: Decoded bytes exceed the %zu byte memory budget, use reconstruct_from_wav_to_file\n",
+               config->max_memory);
+        free_decode_buffer(&buffer);
+        return NULL;
+    }
+    
+    if (!decoded || buffer.length == 0) {
+        if (decoded) printf("[dSONAR] No coherent symbols decoded from WAV file\n");
+        free_decode_buffer(&buffer);
+        return NULL;
+    }
+    
+    dsonar_result_t* result = calloc(1, sizeof(dsonar_result_t));
+    if (!result) {
+        free_decode_buffer(&buffer);
+        return NULL;
+    }
+    
+    decode_buffer_to_result(&buffer, result);
+    result->total_samples = symbol_count;
+    result->successful_samples = symbol_count;
+    result->average_confidence = quality;
+    
+    printf("[dSONAR] Reconstructed %d bytes from %d coherent symbols (quality %.3f)\n",
+           result->data_length, symbol_count, quality);
+    
+    decompress_reconstruction(result);
     return result;
 }
 
+typedef struct {
+    dsonar_decode_buffer_t* buffer;
+    dsonar_config_t* config;
+} wav_decode_sink_t;
+
+static bool wav_decode_sink(void* ctx, double frequency, unsigned int run_length)
+{
+    wav_decode_sink_t* sink = ctx;
+    return append_decoded_run(sink->buffer, frequency_to_byte(frequency, sink->config),
+                              run_length, DSONAR_TONE_CONFIDENCE);
+}
+
+bool estimate_wav_parameters(const char* wav_filename, dsonar_config_t* config)
+{
+    FILE* wav_file = fopen(wav_filename, "rb");
+    if (!wav_file) return false;
+    
+    int sample_rate, channels, bits_per_sample;
+    if (!read_wav_header(wav_file, &sample_rate, &channels, &bits_per_sample)) {
+        fclose(wav_file);
+        return false;
+    }
+    
+    // The prefix is a small, fixed share of any memory budget
+    size_t capacity = DSONAR_ESTIMATE_SAMPLES;
+    if (config->max_memory > 0 && capacity * sizeof(short) > config->max_memory / 4) {
+        capacity = config->max_memory / 4 / sizeof(short);
+    }
+    short* prefix = malloc(capacity * sizeof(short));
+    if (!prefix) {
+        fclose(wav_file);
+        return false;
+    }
+    int count = (int)fread(prefix, sizeof(short), capacity, wav_file);
+    fclose(wav_file);
+    
+    mbx_estimate_t estimate;
+    bool found = mbx_estimate_tones(prefix, count, sample_rate, &estimate);
+    free(prefix);
+    
+    if (!found) {
+        printf("[dSONAR] Blind estimate: no symbol structure found, keeping configured parameters\n");
+        return false;
+    }
+    
+    printf("[dSONAR] Blind estimate from %d samples (%d symbols, confidence %.2f):\n",
+           count, estimate.symbols_used, estimate.confidence);
+    printf("   - Symbol length: %d samples (%.1f ms)%s\n", estimate.symbol_samples,
+           estimate.symbol_samples * 1000.0 / sample_rate, estimate.merged ? ", run-merged" : "");
+    if (estimate.merged && estimate.quantum_samples > 0) {
+        printf("   - Run quantum: %.2f +/- %.2f samples (%.3f ms)\n", estimate.quantum_samples,
+               estimate.quantum_error, estimate.quantum_samples * 1000.0 / sample_rate);
+    }
+    printf("   - Occupied band: %.0f - %.0f Hz, harmonic ratio %.3f\n",
+           estimate.low_frequency, estimate.high_frequency, estimate.harmonic_ratio);
+    if (estimate.mapping_found) {
+        printf("   - Frequency map: %.2f Hz + byte * %.2f / 255 Hz\n",
+               estimate.base_frequency, estimate.frequency_range);
+    }
+    
+    // Configured values stand unless a confident estimate shows the stream cannot have been made with them
+    if (estimate.confidence < DSONAR_ESTIMATE_MIN_CONFIDENCE) {
+        printf("[dSONAR] Estimate too uncertain, keeping configured parameters\n");
+        return false;
+    }
+    bool changed = false;
+    if (estimate.merged && estimate.quantum_samples > 0) {
+        // Short tones leave the quantum loosely known; a close configured value is the better one for long runs
+        double configured = config->run_quantum * sample_rate;
+        if (fabs(estimate.quantum_samples - configured) > DSONAR_QUANTUM_TOLERANCE * estimate.quantum_error) {
+            config->run_quantum = estimate.quantum_samples / sample_rate;
+            changed = true;
+        } else if (fabs(estimate.quantum_samples - configured) > 0.005) {
+            printf("[dSONAR] Run quantum estimate is within its error of the configured %.2f samples, keeping it\n",
+                   configured);
+        }
+    }
+    if (!mbx_estimate_fits(&estimate, config->sample_duration * sample_rate)) {
+        config->sample_duration = (estimate.symbol_samples + 0.5) / sample_rate;
+        changed = true;
+    }
+    if (estimate.mapping_found) {
+        double step = config->frequency_range / 255.0;
+        if (fabs(estimate.base_frequency - config->base_frequency) > step / 4 ||
+            fabs(estimate.frequency_range - config->frequency_range) > config->frequency_range * 0.01) {
+            config->base_frequency = estimate.base_frequency;
+            config->frequency_range = estimate.frequency_range;
+            changed = true;
+        }
+    }
+    
+    if (changed) {
+        printf("[dSONAR] Using estimated parameters: %.1f ms symbols, %.2f - %.2f Hz, %.3f ms run quantum\n",
+               config->sample_duration * 1000, config->base_frequency,
+               config->base_frequency + config->frequency_range, config->run_quantum * 1000);
+    } else {
+        printf("[dSONAR] Estimate matches the configured parameters\n");
+    }
+    return changed;
+}
+
 dsonar_result_t* reconstruct_from_wav(const char* wav_filename, dsonar_config_t* config)
 {
     printf("[dSONAR] Analyzing WAV file for frequency reconstruction...\n");
@@ -392,119 +967,159 @@ dsonar_result_t* reconstruct_from_wav(const char* wav_filename, dsonar_config_t*
     
     printf("[dSONAR] WAV format: %d Hz, %d channels, %d bits\n", sample_rate, channels, bits_per_sample);
     
-    // Simple frequency detection by analyzing audio segments
-    reverse_sample_node_t* samples = NULL;
-    int sample_index = 0;
+    if (config->qam) {
+        dsonar_result_t* result = reconstruct_qam(wav_file, sample_rate, config);
+        fclose(wav_file);
+        return result;
+    }
     
-    // Read audio data in chunks (each chunk represents one byte's frequency)
-    int chunk_size = (int)(config->base_frequency * 0.05); // 50ms chunks
-    short* audio_buffer = malloc(chunk_size * sizeof(short));
+    // Unmerged streams hold exactly one byte per symbol; merged streams grow the buffer past that
+    size_t expected = 0;
+    int symbol_samples = (int)(config->sample_duration * sample_rate);
+    if (symbol_samples > 0) expected = wav_data_samples(wav_file) / symbol_samples;
     
-    if (!audio_buffer) {
+    dsonar_decode_buffer_t buffer;
+    if (!init_decode_buffer(&buffer, expected, 0.5, config->max_memory)) {
         fclose(wav_file);
         return NULL;
     }
     
-    while (fread(audio_buffer, sizeof(short), chunk_size, wav_file) == chunk_size) {
-        // Simple frequency detection using zero-crossing analysis
-        double estimated_frequency = detect_dominant_frequency(audio_buffer, chunk_size, sample_rate);
-        
-        if (estimated_frequency > 0) {
-            reverse_sample_node_t* sample = create_reverse_sample(estimated_frequency, sample_index, config);
-            if (sample) {
-                // Lower confidence for WAV reconstruction due to complexity
-                sample->confidence_score = 0.7;
-                add_reverse_sample(&samples, sample);
-                sample_index++;
-            }
-        }
-    }
-    
-    free(audio_buffer);
+    wav_decode_sink_t sink = {&buffer, config};
+    int tone_count = 0;
+    bool decoded = decode_wav_tones(wav_file, sample_rate, config, wav_decode_sink, &sink, &tone_count);
     fclose(wav_file);
     
-    if (sample_index == 0) {
-        printf("[dSONAR] No frequencies detected in WAV file\n");
+    if (buffer.over_budget) {
+        printf("[dSONAR] Error: Decoded samples exceed the %zu byte memory budget, use reconstruct_from_wav_to_file\n",
+               config->max_memory);
+        free_decode_buffer(&buffer);
+        return NULL;
+    }
+    
+    if (!decoded || buffer.length == 0) {
+        if (decoded) printf("[dSONAR] No frequencies detected in WAV file\n");
+        free_decode_buffer(&buffer);
         return NULL;
     }
     
     // Convert to result
-    dsonar_result_t* result = malloc(sizeof(dsonar_result_t));
+    dsonar_result_t* result = calloc(1, sizeof(dsonar_result_t));
     if (!result) {
-        free_reverse_samples(samples);
+        free_decode_buffer(&buffer);
         return NULL;
     }
     
-    result->reconstructed_data = samples_to_bytes(samples, &result->data_length);
-    result->total_samples = sample_index;
-    result->successful_samples = sample_index;
-    result->average_confidence = 0.7;
+    decode_buffer_to_result(&buffer, result);
+    result->total_samples = tone_count;
+    result->successful_samples = tone_count;
     
     printf("[dSONAR] Reconstructed %d bytes from WAV audio analysis\n", result->data_length);
     
-    free_reverse_samples(samples);
+    decompress_reconstruction(result);
+    return result;
+}
+
+dsonar_result_t* reconstruct_from_wav_to_file(const char* wav_filename, const char* output_filename, dsonar_config_t* config)
+{
+    printf("[dSONAR] Streaming WAV reconstruction to %s...\n", output_filename);
+    
+    FILE* wav_file = fopen(wav_filename, "rb");
+    if (!wav_file) {
+        printf("[dSONAR] Error: Could not open WAV file\n");
+        return NULL;
+    }
+    
+    int sample_rate, channels, bits_per_sample;
+    if (!read_wav_header(wav_file, &sample_rate, &channels, &bits_per_sample)) {
+        printf("[dSONAR] Error: Invalid WAV header\n");
+        fclose(wav_file);
+        return NULL;
+    }
+    
+    printf("[dSONAR] WAV format: %d Hz, %d channels, %d bits\n", sample_rate, channels, bits_per_sample);
+    
+    dsonar_stream_t stream;
+    if (!stream_open(&stream, output_filename, config)) {
+        fclose(wav_file);
+        return NULL;
+    }
+    
+    int tone_count = 0;
+    double quality = DSONAR_TONE_CONFIDENCE;
+    bool decoded = config->qam ?
+        decode_wav_qam(wav_file, sample_rate, config, wav_stream_bytes, &stream, &tone_count, &quality) :
+        decode_wav_tones(wav_file, sample_rate, config, wav_stream_sink, &stream, &tone_count);
+    fclose(wav_file);
+    if (!decoded) stream.error = true;
+    
+    dsonar_result_t* result = stream_finish(&stream, output_filename);
+    if (!result) return NULL;
+    
+    if (result->data_length == 0) {
+        printf("[dSONAR] No frequencies detected in WAV file\n");
+        free_dsonar_result(result);
+        return NULL;
+    }
+    
+    result->total_samples = tone_count;
+    result->successful_samples = tone_count;
+    result->average_confidence = quality;
+    
+    printf("[dSONAR] Reconstructed %d bytes from WAV audio analysis\n", result->data_length);
     return result;
 }
 
-bool parse_json_metadata(const char* filename, reverse_sample_node_t** samples, dsonar_config_t* config)
+bool parse_json_metadata(const char* filename, dsonar_decode_buffer_t* buffer, dsonar_config_t* config)
 {
     FILE* file = fopen(filename, "r");
     if (!file) return false;
     
     char line[1024];
-    int sample_index = 0;
     
-    // Simple JSON parsing (looking for frequency and byte values)
+    // Simple JSON parsing: each sample object lists byte, frequency, amplitude and duration in order
+    unsigned int byte_val = 0;
+    double frequency = 0.0, amplitude = 0.0, duration = 0.0;
+    bool have_frequency = false;
+    
     while (fgets(line, sizeof(line), file)) {
-        if (strstr(line, "\"frequency\":")) {
-            double frequency;
-            if (sscanf(line, " \"frequency\": %lf,", &frequency) == 1) {
-                // Look for corresponding byte in next few lines
-                char byte_line[1024];
-                unsigned int byte_val = 0;
-                
-                // Read previous lines to find byte value
-                long pos = ftell(file);
-                fseek(file, pos - 200, SEEK_SET); // Go back a bit
-                
-                while (fgets(byte_line, sizeof(byte_line), file) && ftell(file) <= pos + 100) {
-                    if (strstr(byte_line, "\"byte\":")) {
-                        if (sscanf(byte_line, " \"byte\": \"0x%X\",", &byte_val) == 1) {
-                            break;
-                        }
-                    }
-                }
-                
-                fseek(file, pos, SEEK_SET); // Restore position
-                
-                // Create reverse sample
-                reverse_sample_node_t* sample = create_reverse_sample(frequency, sample_index, config);
-                if (sample) {
-                    // Verify reconstruction accuracy
-                    unsigned char reconstructed = frequency_to_byte(frequency, config);
-                    if (byte_val > 0 && reconstructed == (unsigned char)byte_val) {
-                        sample->confidence_score = 1.0; // Perfect match
-                    } else {
-                        sample->confidence_score = 0.8; // Good match
-                    }
-                    add_reverse_sample(samples, sample);
-                    sample_index++;
-                }
+        if (strstr(line, "\"byte\":")) {
+            byte_val = 0;
+            have_frequency = false;
+            sscanf(line, " \"byte\": \"0x%X\",", &byte_val);
+        } else if (strstr(line, "\"frequency\":")) {
+            have_frequency = sscanf(line, " \"frequency\": %lf,", &frequency) == 1;
+            amplitude = 1.0;
+        } else if (strstr(line, "\"amplitude\":")) {
+            sscanf(line, " \"amplitude\": %lf,", &amplitude);
+        } else if (have_frequency && strstr(line, "\"duration\":")) {
+            have_frequency = false;
+            if (sscanf(line, " \"duration\": %lf", &duration) != 1) duration = config->sample_duration;
+            
+            // Zero-amplitude samples are the gaps that delimit merged runs
+            if (amplitude <= 0.0) continue;
+            
+            // Verify reconstruction accuracy
+            unsigned char reconstructed = frequency_to_byte(frequency, config);
+            double confidence = (byte_val > 0 && reconstructed == (unsigned char)byte_val) ?
+                1.0 : // Perfect match
+                0.8;  // Good match
+            
+            if (!append_decoded_run(buffer, reconstructed, duration_to_run_length(duration, config), confidence)) {
+                break;
             }
         }
     }
     
     fclose(file);
-    return sample_index > 0;
+    return buffer->length > 0;
 }
 
-bool parse_csv_frequency_data(const char* filename, reverse_sample_node_t** samples, dsonar_config_t* config)
+bool parse_csv_frequency_data(const char* filename, dsonar_decode_buffer_t* buffer, dsonar_config_t* config)
 {
     FILE* file = fopen(filename, "r");
     if (!file) return false;
     
     char line[512];
-    int sample_index = 0;
     
     // Skip header line
     if (fgets(line, sizeof(line), file)) {
@@ -516,29 +1131,27 @@ bool parse_csv_frequency_data(const char* filename, reverse_sample_node_t** samp
             
             if (sscanf(line, "%d,%7[^,],%d,%lf,%lf,%lf", 
                       &sample_num, byte_hex, &byte_dec, &frequency, &amplitude, &duration) == 6) {
+                if (amplitude <= 0.0) continue; // Run-merging gap
                 
-                reverse_sample_node_t* sample = create_reverse_sample(frequency, sample_index, config);
-                if (sample) {
-                    // High confidence since we have exact frequency data
-                    sample->confidence_score = 0.95;
-                    add_reverse_sample(samples, sample);
-                    sample_index++;
+                // High confidence since we have exact frequency data
+                if (!append_decoded_run(buffer, frequency_to_byte(frequency, config),
+                                        duration_to_run_length(duration, config), 0.95)) {
+                    break;
                 }
             }
         }
     }
     
     fclose(file);
-    return sample_index > 0;
+    return buffer->length > 0;
 }
 
-bool parse_analysis_report(const char* filename, reverse_sample_node_t** samples, dsonar_config_t* config)
+bool parse_analysis_report(const char* filename, dsonar_decode_buffer_t* buffer, dsonar_config_t* config)
 {
     FILE* file = fopen(filename, "r");
     if (!file) return false;
     
     char line[512];
-    int sample_index = 0;
     bool in_data_section = false;
     
     // Look for "Detailed Sample Data" section
@@ -556,51 +1169,140 @@ bool parse_analysis_report(const char* filename, reverse_sample_node_t** samples
             
             // Parse: 0x48	784.71		0.354	0.050
             if (sscanf(line, "0x%X\t%lf\t\t%lf\t%lf", &byte_val, &frequency, &amplitude, &duration) == 4) {
-                reverse_sample_node_t* sample = create_reverse_sample(frequency, sample_index, config);
-                if (sample) {
-                    sample->confidence_score = 0.85; // Good confidence from analysis
-                    add_reverse_sample(samples, sample);
-                    sample_index++;
+                if (amplitude <= 0.0) continue; // Run-merging gap
+                
+                // Good confidence from analysis
+                if (!append_decoded_run(buffer, frequency_to_byte(frequency, config),
+                                        duration_to_run_length(duration, config), 0.85)) {
+                    break;
                 }
             }
         }
     }
     
     fclose(file);
-    return sample_index > 0;
+    return buffer->length > 0;
 }
 
-reverse_sample_node_t* create_reverse_sample(double frequency, int index, dsonar_config_t* config)
+bool init_decode_buffer(dsonar_decode_buffer_t* buffer, size_t expected_length,
+                        double success_threshold, size_t max_memory)
 {
-    reverse_sample_node_t* sample = malloc(sizeof(reverse_sample_node_t));
-    if (!sample) return NULL;
+    if (!buffer) return false;
+    
+    memset(buffer, 0, sizeof(dsonar_decode_buffer_t));
+    buffer->success_threshold = success_threshold;
+    buffer->max_memory = max_memory;
     
-    sample->source_frequency = frequency;
-    sample->sample_index = index;
-    sample->reconstructed_byte = frequency_to_byte(frequency, config);
-    sample->confidence_score = 0.5; // Default confidence
-    sample->next = NULL;
+    // The size hint is only a starting point; the budget always wins
+    size_t capacity = expected_length > 0 ? expected_length : DSONAR_DECODE_INITIAL;
+    if (max_memory > 0 && capacity > max_memory / 2) capacity = max_memory / 2;
+    if (capacity == 0) return true;
     
-    return sample;
+    buffer->data = malloc(capacity);
+    buffer->confidence = malloc(capacity);
+    if (!buffer->data || !buffer->confidence) {
+        free_decode_buffer(buffer);
+        return false;
+    }
+    buffer->capacity = capacity;
+    return true;
 }
 
-void add_reverse_sample(reverse_sample_node_t** head, reverse_sample_node_t* sample)
+// Grow both arrays geometrically so appends stay amortized O(1)
+static bool grow_decode_buffer(dsonar_decode_buffer_t* buffer, size_t needed)
 {
-    if (!head || !sample) return;
+    size_t limit = buffer->max_memory > 0 ? buffer->max_memory / 2 : (size_t)-1;
+    if (needed > limit) {
+        buffer->over_budget = true;
+        return false;
+    }
     
-    if (*head == NULL) {
-        *head = sample;
-    } else {
-        reverse_sample_node_t* current = *head;
-        while (current->next) {
-            current = current->next;
-        }
-        current->next = sample;
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity * 2 : DSONAR_DECODE_INITIAL;
+    if (capacity < needed) capacity = needed;
+    if (capacity > limit) capacity = limit;
+    
+    unsigned char* data = realloc(buffer->data, capacity);
+    if (!data) return false;
+    buffer->data = data;
+    
+    unsigned char* confidence = realloc(buffer->confidence, capacity);
+    if (!confidence) return false;
+    buffer->confidence = confidence;
+    
+    buffer->capacity = capacity;
+    return true;
+}
+
+bool append_decoded_run(dsonar_decode_buffer_t* buffer, unsigned char byte,
+                        unsigned int run_length, double confidence)
+{
+    if (!buffer) return false;
+    if (run_length == 0) return true;
+    
+    if (buffer->length + run_length > buffer->capacity &&
+        !grow_decode_buffer(buffer, buffer->length + run_length)) {
+        return false;
+    }
+    
+    if (confidence < 0.0) confidence = 0.0;
+    if (confidence > 1.0) confidence = 1.0;
+    
+    memset(buffer->data + buffer->length, byte, run_length);
+    memset(buffer->confidence + buffer->length, (int)(confidence * 255.0 + 0.5), run_length);
+    buffer->length += run_length;
+    
+    buffer->confidence_sum += confidence * run_length;
+    if (confidence > buffer->success_threshold) {
+        buffer->successful_samples += run_length;
     }
+    return true;
+}
+
+void decode_buffer_to_result(dsonar_decode_buffer_t* buffer, dsonar_result_t* result)
+{
+    if (!buffer || !result) return;
+    
+    // Hand back the slack of an oversized size hint
+    if (buffer->length > 0 && buffer->length < buffer->capacity) {
+        unsigned char* data = realloc(buffer->data, buffer->length);
+        if (data) buffer->data = data;
+        unsigned char* confidence = realloc(buffer->confidence, buffer->length);
+        if (confidence) buffer->confidence = confidence;
+    }
+    
+    result->reconstructed_data = buffer->length > 0 ? buffer->data : NULL;
+    result->confidence = buffer->length > 0 ? buffer->confidence : NULL;
+    result->data_length = (int)buffer->length;
+    result->total_samples = (int)buffer->length;
+    result->successful_samples = buffer->successful_samples;
+    result->average_confidence = buffer->length > 0 ? buffer->confidence_sum / buffer->length : 0.0;
+    
+    if (buffer->length == 0) {
+        free(buffer->data);
+        free(buffer->confidence);
+    }
+    memset(buffer, 0, sizeof(dsonar_decode_buffer_t));
+}
+
+void free_decode_buffer(dsonar_decode_buffer_t* buffer)
+{
+    if (!buffer) return;
+    
+    free(buffer->data);
+    free(buffer->confidence);
+    buffer->data = NULL;
+    buffer->confidence = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
 }
 
 unsigned char frequency_to_byte(double frequency, dsonar_config_t* config)
 {
+    // Planned tones resolve through the plan's precomputed inverse table
+    if (config->plan) {
+        return mbx_freqplan_byte(config->plan, frequency);
+    }
+    
     // Reverse the SONAR frequency mapping
     // Original: frequency = base_freq + (byte/255.0) * freq_range
     // Reverse: byte = ((frequency - base_freq) / freq_range) * 255.0
@@ -612,38 +1314,39 @@ unsigned char frequency_to_byte(double frequency, dsonar_config_t* config)
     return (unsigned char)(normalized * 255.0 + 0.5); // Round to nearest
 }
 
-unsigned char* samples_to_bytes(reverse_sample_node_t* head, int* length)
+unsigned int duration_to_run_length(double duration, dsonar_config_t* config)
 {
-    if (!head || !length) return NULL;
-    
-    // Count samples
-    int count = 0;
-    reverse_sample_node_t* current = head;
-    while (current) {
-        count++;
-        current = current->next;
-    }
+    // Reverse the SONAR run merging
+    // Original: duration = sample_duration + (run - 1) * run_quantum
+    if (config->run_quantum <= 0.0 || duration <= config->sample_duration) return 1;
     
-    if (count == 0) {
-        *length = 0;
-        return NULL;
+    double extra = (duration - config->sample_duration) / config->run_quantum;
+    return 1 + (unsigned int)(extra + 0.5); // Round to nearest
+}
+
+bool decompress_reconstruction(dsonar_result_t* result)
+{
+    if (!result || !result->reconstructed_data ||
+        !mbx_lz_is_compressed(result->reconstructed_data, result->data_length)) {
+        return false;
     }
     
-    // Allocate and fill byte array
-    unsigned char* bytes = malloc(count);
-    if (!bytes) {
-        *length = 0;
-        return NULL;
+    size_t expanded_length = 0;
+    unsigned char* expanded = mbx_lz_decompress(result->reconstructed_data, result->data_length, &expanded_length);
+    if (!expanded) {
+        printf("[dSONAR] Warning: Compressed payload is damaged, keeping raw bytes\n");
+        return false;
     }
     
-    current = head;
-    for (int i = 0; i < count && current; i++) {
-        bytes[i] = current->reconstructed_byte;
-        current = current->next;
-    }
+    printf("[dSONAR] Decompressed payload: %d -> %zu bytes\n", result->data_length, expanded_length);
+    free(result->reconstructed_data);
+    result->reconstructed_data = expanded;
     
-    *length = count;
-    return bytes;
+    // Confidence belongs to the compressed bytes and has no counterpart in the expansion
+    free(result->confidence);
+    result->confidence = NULL;
+    result->data_length = (int)expanded_length;
+    return true;
 }
 
 bool save_reconstructed_data(const char* output_filename, dsonar_result_t* result)
@@ -683,31 +1386,269 @@ double calculate_reconstruction_accuracy(const unsigned char* original, const un
 {
     if (!original || !reconstructed || length <= 0) return 0.0;
     
-    int matches = 0;
-    for (int i = 0; i < length; i++) {
-        if (original[i] == reconstructed[i]) {
-            matches++;
+    mbx_compare_result_t compare = {0};
+    mbx_compare_blocks(original, reconstructed, length, 0, &compare);
+    
+    return (double)(length - compare.mismatches) / length;
+}
+
+static void close_error_run(dsonar_error_stats_t* stats)
+{
+    if (stats->current_run == 0) return;
+    
+    int bucket = 0;
+    unsigned long long run = stats->current_run;
+    while (run > 1 && bucket < DSONAR_ERROR_RUN_BUCKETS - 1) {
+        run >>= 1;
+        bucket++;
+    }
+    
+    stats->run_histogram[bucket]++;
+    stats->run_count++;
+    if (stats->current_run > stats->longest_run) {
+        stats->longest_run = stats->current_run;
+    }
+    stats->current_run = 0;
+}
+
+static void accumulate_error_byte(dsonar_error_stats_t* stats, unsigned char original,
+                                  unsigned char reconstructed, const unsigned char* confidence)
+{
+    if (original == reconstructed) {
+        close_error_run(stats);
+        return;
+    }
+    
+    int magnitude = abs((int)original - (int)reconstructed);
+    stats->byte_errors++;
+    stats->magnitude_histogram[magnitude]++;
+    stats->magnitude_sum += magnitude;
+    stats->current_run++;
+    if (confidence) {
+        stats->confidence_error_sum += *confidence / 255.0;
+    }
+}
+
+void init_error_analysis(dsonar_error_stats_t* stats)
+{
+    if (stats) {
+        memset(stats, 0, sizeof(dsonar_error_stats_t));
+    }
+}
+
+void accumulate_error_analysis(dsonar_error_stats_t* stats, const unsigned char* original,
+                               const unsigned char* reconstructed, const unsigned char* confidence, int length)
+{
+    if (!stats || !original || !reconstructed || length <= 0) return;
+    
+    // XOR 8 bytes at a time; identical words only need to close the open run
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word_a, word_b;
+        memcpy(&word_a, original + i, 8);
+        memcpy(&word_b, reconstructed + i, 8);
+        
+        uint64_t diff = word_a ^ word_b;
+        if (diff == 0) {
+            close_error_run(stats);
+            continue;
+        }
+        
+        stats->bit_errors += __builtin_popcountll(diff);
+        for (int j = i; j < i + 8; j++) {
+            accumulate_error_byte(stats, original[j], reconstructed[j], confidence ? confidence + j : NULL);
+        }
+    }
+    for (; i < length; i++) {
+        stats->bit_errors += __builtin_popcount(original[i] ^ reconstructed[i]);
+        accumulate_error_byte(stats, original[i], reconstructed[i], confidence ? confidence + i : NULL);
+    }
+    
+    if (confidence) {
+        unsigned long long sum = 0, sq_sum = 0;
+        for (i = 0; i < length; i++) {
+            sum += confidence[i];
+            sq_sum += (unsigned int)confidence[i] * confidence[i];
         }
+        stats->has_confidence = true;
+        stats->confidence_sum += sum / 255.0;
+        stats->confidence_sq_sum += sq_sum / (255.0 * 255.0);
     }
     
-    return (double)matches / length;
+    stats->compared += length;
 }
 
-void free_reverse_samples(reverse_sample_node_t* head)
+void finish_error_analysis(dsonar_error_stats_t* stats)
 {
-    while (head) {
-        reverse_sample_node_t* temp = head;
-        head = head->next;
-        free(temp);
+    if (!stats) return;
+    
+    close_error_run(stats);
+    
+    stats->bit_error_rate = stats->compared > 0 ?
+        (double)stats->bit_errors / (stats->compared * 8.0) : 0.0;
+    stats->mean_error_magnitude = stats->byte_errors > 0 ?
+        (double)stats->magnitude_sum / stats->byte_errors : 0.0;
+    
+    // Point-biserial correlation between confidence and the error indicator
+    stats->confidence_error_correlation = 0.0;
+    if (stats->has_confidence && stats->compared > 0) {
+        double n = (double)stats->compared;
+        double error_rate = stats->byte_errors / n;
+        double mean_confidence = stats->confidence_sum / n;
+        double variance = stats->confidence_sq_sum / n - mean_confidence * mean_confidence;
+        double covariance = stats->confidence_error_sum / n - mean_confidence * error_rate;
+        double denominator = sqrt(variance * error_rate * (1.0 - error_rate));
+        if (variance > 0.0 && denominator > 0.0) {
+            stats->confidence_error_correlation = covariance / denominator;
+        }
     }
 }
 
+void analyze_reconstruction_errors(const unsigned char* original, const unsigned char* reconstructed,
+                                   const unsigned char* confidence, int length, dsonar_error_stats_t* stats)
+{
+    init_error_analysis(stats);
+    accumulate_error_analysis(stats, original, reconstructed, confidence, length);
+    finish_error_analysis(stats);
+}
+
+void print_error_analysis(const dsonar_error_stats_t* stats)
+{
+    if (!stats || stats->compared == 0) return;
+    
+    printf("\nBit-level Error Analysis:\n");
+    printf("Bytes compared: %llu, byte errors: %llu (%.3f%%)\n", stats->compared, stats->byte_errors,
+           stats->byte_errors * 100.0 / stats->compared);
+    printf("Bit errors: %llu, bit error rate: %.3e\n", stats->bit_errors, stats->bit_error_rate);
+    
+    if (stats->byte_errors > 0) {
+        // Group magnitudes: quantization-step errors vs. gross decoding failures
+        static const int bucket_limits[] = {1, 3, 15, 63, 255};
+        static const char* bucket_names[] = {"1", "2-3", "4-15", "16-63", "64-255"};
+        unsigned long long bucket_counts[5] = {0};
+        for (int magnitude = 1, bucket = 0; magnitude < 256; magnitude++) {
+            while (magnitude > bucket_limits[bucket]) bucket++;
+            bucket_counts[bucket] += stats->magnitude_histogram[magnitude];
+        }
+        
+        printf("Mean error magnitude: %.2f\n", stats->mean_error_magnitude);
+        printf("Error magnitude histogram:\n");
+        for (int bucket = 0; bucket < 5; bucket++) {
+            printf("  |diff| %-7s %llu (%.1f%%)\n", bucket_names[bucket], bucket_counts[bucket],
+                   bucket_counts[bucket] * 100.0 / stats->byte_errors);
+        }
+        
+        printf("Error runs: %llu, longest: %llu bytes\n", stats->run_count, stats->longest_run);
+        printf("Error run lengths:\n");
+        for (int bucket = 0; bucket < DSONAR_ERROR_RUN_BUCKETS; bucket++) {
+            if (stats->run_histogram[bucket] == 0) continue;
+            printf("  %llu-%llu bytes: %llu\n", 1ULL << bucket, (2ULL << bucket) - 1, stats->run_histogram[bucket]);
+        }
+    }
+    
+    if (stats->has_confidence) {
+        printf("Confidence/error correlation: %.3f\n", stats->confidence_error_correlation);
+    } else {
+        printf("Confidence/error correlation: n/a (no per-symbol confidence)\n");
+    }
+}
+
+bool validate_reconstruction(dsonar_result_t* result, const char* original_filename)
+{
+    if (!result || !result->reconstructed_data || !original_filename) return false;
+    
+    FILE* original = fopen(original_filename, "rb");
+    if (!original) {
+        printf("[dSONAR] Error: Could not open original file %s\n", original_filename);
+        return false;
+    }
+    
+    // Compare in fixed-size chunks so the original never has to be fully loaded
+    unsigned char buffer[65536];
+    mbx_compare_result_t compare = {0};
+    dsonar_error_stats_t errors;
+    unsigned int offset = 0;
+    unsigned int original_length = 0;
+    size_t bytes_read;
+    
+    init_error_analysis(&errors);
+    while ((bytes_read = fread(buffer, 1, sizeof(buffer), original)) > 0) {
+        original_length += (unsigned int)bytes_read;
+        if (offset < (unsigned int)result->data_length) {
+            size_t count = min((int)bytes_read, result->data_length - (int)offset);
+            mbx_compare_blocks(buffer, result->reconstructed_data + offset, count, offset, &compare);
+            accumulate_error_analysis(&errors, buffer, result->reconstructed_data + offset,
+                                      result->confidence ? result->confidence + offset : NULL, (int)count);
+        }
+        offset += (unsigned int)bytes_read;
+    }
+    fclose(original);
+    finish_error_analysis(&errors);
+    
+    printf("\ndSONAR Validation Report:\n");
+    printf("Original file: %s (%u bytes)\n", original_filename, original_length);
+    printf("Reconstructed: %d bytes\n", result->data_length);
+    printf("Compared: %u bytes, mismatches: %u\n", compare.compared, compare.mismatches);
+    
+    if (compare.mismatches > 0) {
+        printf("First mismatch at offset %u\n", compare.first_mismatch);
+        printf("Mismatch positions:");
+        for (unsigned int i = 0; i < compare.position_count; i++) {
+            printf(" %u", compare.positions[i]);
+        }
+        if (compare.mismatches > compare.position_count) {
+            printf(" ...");
+        }
+        printf("\n");
+        print_error_analysis(&errors);
+    }
+    
+    if (original_length != (unsigned int)result->data_length) {
+        printf("Length mismatch: original %u bytes, reconstructed %d bytes\n",
+               original_length, result->data_length);
+        return false;
+    }
+    
+    return compare.mismatches == 0;
+}
+
+bool verify_reconstruction_digest(dsonar_result_t* result, const char* digest_filename)
+{
+    if (!result || (!result->reconstructed_data && !result->streamed) || !digest_filename) return false;
+    
+    mbx_digest_t expected;
+    if (!mbx_digest_read(digest_filename, &expected)) {
+        return false;
+    }
+    
+    mbx_digest_t actual;
+    if (result->streamed) {
+        actual = result->digest;
+    } else {
+        mbx_digest_compute(result->reconstructed_data, result->data_length, &actual);
+    }
+    
+    if (mbx_digest_equal(&expected, &actual)) {
+        printf("[dSONAR] Digest verified: %s (CRC32C %08X, XXH64 %016llX)\n", digest_filename,
+               (unsigned int)actual.crc32c, (unsigned long long)actual.xxh64);
+        return true;
+    }
+    
+    printf("[dSONAR] Digest mismatch: %s\n", digest_filename);
+    printf("   Expected: %u bytes, CRC32C %08X, XXH64 %016llX\n", expected.length,
+           (unsigned int)expected.crc32c, (unsigned long long)expected.xxh64);
+    printf("   Actual:   %u bytes, CRC32C %08X, XXH64 %016llX\n", actual.length,
+           (unsigned int)actual.crc32c, (unsigned long long)actual.xxh64);
+    return false;
+}
+
 void free_dsonar_result(dsonar_result_t* result)
 {
     if (result) {
         if (result->reconstructed_data) {
             free(result->reconstructed_data);
         }
+        free(result->confidence);
         free(result);
     }
 }
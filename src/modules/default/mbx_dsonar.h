@@ -13,20 +13,9 @@
 #define MBX_DSONAR_H
 #include <stdbool.h>
 #include "mojibake/mojibake.h"
-
-/**
- * @brief Reverse audio sample node for reconstruction
- * 
- * Represents a single reconstructed sample with confidence scoring
- * and position tracking for accurate data reconstruction.
- */
-typedef struct reverse_sample_node {
-    unsigned char reconstructed_byte;  /**< Reconstructed byte value (0-255) */
-    double source_frequency;          /**< Original frequency from audio in Hz */
-    double confidence_score;          /**< Reconstruction confidence (0.0-1.0) */
-    int sample_index;                 /**< Position in original sequence */
-    struct reverse_sample_node *next; /**< Pointer to next node in linked list */
-} reverse_sample_node_t;
+#include "mbx_digest.h"
+#include "mbx_freqplan.h"
+#include "mbx_qam.h"
 
 /**
  * @brief dSONAR configuration structure
@@ -40,6 +29,11 @@ typedef struct {
     double tolerance;                 /**< Frequency matching tolerance in Hz */
     bool strict_mode;                 /**< Enable strict frequency matching */
     char* input_format;               /**< Input format: "wav", "csv", "json", "auto" */
+    double sample_duration;           /**< Duration of a single-byte tone in seconds (e.g., 0.05) */
+    double run_quantum;               /**< Extra tone duration per repeated byte in merged streams (e.g., 0.001) */
+    size_t max_memory;                /**< Memory budget in bytes for in-memory decoding (0 = unlimited) */
+    const mbx_freqplan_t* plan;       /**< Frequency plan SONAR used (NULL = linear mapping); enables Goertzel detection */
+    const mbx_qam_t* qam;             /**< Coherent PSK/QAM modulation SONAR used (NULL = one tone per byte) */
 } dsonar_config_t;
 
 /**
@@ -67,8 +61,66 @@ typedef struct {
     double average_confidence;        /**< Average reconstruction confidence (0.0-1.0) */
     int successful_samples;           /**< Number of successfully reconstructed samples */
     int total_samples;                /**< Total number of samples processed */
+    unsigned char* confidence;        /**< Per-byte confidence parallel to reconstructed_data (0-255 maps to 0.0-1.0), NULL if unknown */
+    bool streamed;                    /**< Data was written straight to a file; reconstructed_data is NULL */
+    mbx_digest_t digest;              /**< Digest of the written data (streamed results only) */
 } dsonar_result_t;
 
+/**
+ * @brief Decode output buffer
+ * 
+ * Decoders append runs of bytes straight into two parallel arrays, the
+ * bytes and their confidence, instead of allocating a node per byte.
+ * The arrays are sized up front from the input (WAV data length, CSV row
+ * count) and only grow geometrically when that estimate falls short, so
+ * decoding costs 2 bytes per decoded byte with no per-byte allocation.
+ * Result statistics are accumulated as runs arrive.
+ */
+typedef struct {
+    unsigned char* data;              /**< Decoded bytes */
+    unsigned char* confidence;        /**< Per-byte confidence (0-255 maps to 0.0-1.0) */
+    size_t length;                    /**< Number of bytes decoded so far */
+    size_t capacity;                  /**< Allocated length of both arrays */
+    size_t max_memory;                /**< Budget for both arrays together in bytes (0 = unlimited) */
+    bool over_budget;                 /**< An append was refused because of max_memory */
+    double success_threshold;         /**< Bytes with a higher confidence count as successful */
+    int successful_samples;           /**< Number of bytes above success_threshold */
+    double confidence_sum;            /**< Sum of per-byte confidences (0.0-1.0) */
+} dsonar_decode_buffer_t;
+
+/**
+ * @brief Number of run-length buckets in the error analysis
+ * 
+ * Bucket k counts error runs of length [2^k, 2^(k+1)).
+ */
+#define DSONAR_ERROR_RUN_BUCKETS 16
+
+/**
+ * @brief Bit-level error analysis of a reconstruction
+ * 
+ * Accumulates bit error rate, byte-space error magnitudes, error run lengths
+ * and the correlation between per-symbol confidence and errors. Can be fed
+ * incrementally, chunk by chunk, so originals need not be fully loaded.
+ */
+typedef struct {
+    unsigned long long compared;       /**< Number of bytes compared */
+    unsigned long long byte_errors;    /**< Number of differing bytes */
+    unsigned long long bit_errors;     /**< Number of differing bits (XOR popcount) */
+    unsigned long long magnitude_histogram[256]; /**< Count of |original - reconstructed| per value */
+    unsigned long long magnitude_sum;  /**< Sum of error magnitudes over differing bytes */
+    unsigned long long run_histogram[DSONAR_ERROR_RUN_BUCKETS]; /**< Error run lengths in log2 buckets */
+    unsigned long long run_count;      /**< Number of maximal error runs */
+    unsigned long long longest_run;    /**< Longest error run in bytes */
+    unsigned long long current_run;    /**< Length of the run still open at the end of the last chunk */
+    bool has_confidence;               /**< Whether confidence values were supplied */
+    double confidence_sum;             /**< Sum of confidences (0.0-1.0) */
+    double confidence_sq_sum;          /**< Sum of squared confidences */
+    double confidence_error_sum;       /**< Sum of confidences over erroneous bytes */
+    double bit_error_rate;             /**< Bit errors / compared bits (set by finish) */
+    double mean_error_magnitude;       /**< Mean magnitude over erroneous bytes (set by finish) */
+    double confidence_error_correlation; /**< Pearson correlation of confidence and error indicator (set by finish) */
+} dsonar_error_stats_t;
+
 /**
  * @brief Main dSONAR module function
  * 
@@ -86,7 +138,9 @@ bool mbx_dsonar(mojibake_target_t *target, unsigned int index, void *arg);
  * @brief Reconstruct data from WAV audio file
  * 
  * Analyzes WAV audio file and reconstructs original binary data using
- * frequency analysis and zero-crossing detection algorithms.
+ * frequency analysis and zero-crossing detection algorithms. Streams that
+ * start with a silent gap were encoded with run merging; their tones are
+ * delimited by silence and decoded as variable-length runs.
  * 
  * @param wav_filename Path to input WAV file
  * @param config Pointer to dSONAR configuration structure
@@ -94,6 +148,21 @@ bool mbx_dsonar(mojibake_target_t *target, unsigned int index, void *arg);
  */
 dsonar_result_t* reconstruct_from_wav(const char* wav_filename, dsonar_config_t* config);
 
+/**
+ * @brief Infer SONAR parameters from a WAV file alone
+ * 
+ * Runs one pass of mbx_estimate_tones over a prefix of the audio and
+ * replaces the symbol length, run quantum and frequency map in config
+ * wherever the estimate disagrees with them. Values the estimate confirms
+ * are left untouched. Frequency plans and coherent modulation are not
+ * estimated; callers skip this when either is configured.
+ * 
+ * @param wav_filename Path to input WAV file
+ * @param config Pointer to dSONAR configuration structure to update
+ * @return true if any parameter was replaced by its estimate
+ */
+bool estimate_wav_parameters(const char* wav_filename, dsonar_config_t* config);
+
 /**
  * @brief Reconstruct data from CSV frequency file
  * 
@@ -106,6 +175,34 @@ dsonar_result_t* reconstruct_from_wav(const char* wav_filename, dsonar_config_t*
  */
 dsonar_result_t* reconstruct_from_csv(const char* csv_filename, dsonar_config_t* config);
 
+/**
+ * @brief Reconstruct data from WAV audio file straight to an output file
+ * 
+ * Memory-budget variant of reconstruct_from_wav: decoded bytes go through a
+ * fixed-size buffer to output_filename instead of an in-memory decode
+ * buffer, and the digest is computed on the way out. Compressed payloads are only
+ * expanded if both copies fit within config->max_memory.
+ * 
+ * @param wav_filename Path to input WAV file
+ * @param output_filename Path of the file receiving the reconstructed data
+ * @param config Pointer to dSONAR configuration structure
+ * @return Streamed result without a data buffer (see dsonar_result_t::streamed), NULL on failure
+ */
+dsonar_result_t* reconstruct_from_wav_to_file(const char* wav_filename, const char* output_filename, dsonar_config_t* config);
+
+/**
+ * @brief Reconstruct data from CSV frequency file straight to an output file
+ * 
+ * Memory-budget variant of reconstruct_from_csv that expands rows in a
+ * single pass through a fixed-size buffer.
+ * 
+ * @param csv_filename Path to input CSV frequency file
+ * @param output_filename Path of the file receiving the reconstructed data
+ * @param config Pointer to dSONAR configuration structure
+ * @return Streamed result without a data buffer (see dsonar_result_t::streamed), NULL on failure
+ */
+dsonar_result_t* reconstruct_from_csv_to_file(const char* csv_filename, const char* output_filename, dsonar_config_t* config);
+
 /**
  * @brief Reconstruct data from JSON metadata file
  * 
@@ -148,6 +245,19 @@ double extract_frequency_from_wav(const char* wav_filename, int sample_index);
  */
 unsigned char frequency_to_byte(double frequency, dsonar_config_t* config);
 
+/**
+ * @brief Convert tone duration back to run length
+ * 
+ * Reverses SONAR run merging: a tone lasting sample_duration +
+ * (n - 1) * run_quantum encodes n repetitions of its byte. Unmerged
+ * tones decode as a run length of 1.
+ * 
+ * @param duration Tone duration in seconds
+ * @param config Pointer to dSONAR configuration structure
+ * @return Run length (at least 1)
+ */
+unsigned int duration_to_run_length(double duration, dsonar_config_t* config);
+
 /**
  * @brief Calculate reconstruction confidence score
  * 
@@ -159,38 +269,47 @@ unsigned char frequency_to_byte(double frequency, dsonar_config_t* config);
 double calculate_confidence(double target_freq, double actual_freq, double tolerance);
 
 /**
- * @brief Create reverse sample node
+ * @brief Initialize a decode buffer
  * 
- * @param frequency Source frequency in Hz
- * @param index Sample index in sequence
- * @param config Pointer to dSONAR configuration structure
- * @return Pointer to new reverse sample node, NULL on failure
+ * @param buffer Pointer to buffer to initialize
+ * @param expected_length Expected number of decoded bytes (0 if unknown); capped by max_memory
+ * @param success_threshold Confidence above which a byte counts as successful
+ * @param max_memory Budget for both arrays together in bytes (0 = unlimited)
+ * @return true on success, false if allocation failed
  */
-reverse_sample_node_t* create_reverse_sample(double frequency, int index, dsonar_config_t* config);
+bool init_decode_buffer(dsonar_decode_buffer_t* buffer, size_t expected_length,
+                        double success_threshold, size_t max_memory);
 
 /**
- * @brief Add reverse sample to linked list
+ * @brief Append run_length copies of a decoded byte
  * 
- * @param head Pointer to pointer of list head (may be modified)
- * @param sample Pointer to reverse sample to add
+ * @param buffer Pointer to initialized decode buffer
+ * @param byte Decoded byte value
+ * @param run_length Number of copies
+ * @param confidence Confidence of the byte (0.0-1.0)
+ * @return true on success, false if allocation failed or the budget was exceeded (see over_budget)
  */
-void add_reverse_sample(reverse_sample_node_t** head, reverse_sample_node_t* sample);
+bool append_decoded_run(dsonar_decode_buffer_t* buffer, unsigned char byte,
+                        unsigned int run_length, double confidence);
 
 /**
- * @brief Convert reverse sample list to byte array
+ * @brief Move decoded bytes and statistics into a result
+ * 
+ * The result takes ownership of both arrays and the buffer is left empty.
+ * Sets data_length, total_samples (one per byte), successful_samples and
+ * average_confidence.
  * 
- * @param head Pointer to first node in reverse sample list
- * @param length Pointer to store output array length
- * @return Pointer to allocated byte array, NULL on failure
+ * @param buffer Pointer to decode buffer
+ * @param result Pointer to result receiving the data
  */
-unsigned char* samples_to_bytes(reverse_sample_node_t* head, int* length);
+void decode_buffer_to_result(dsonar_decode_buffer_t* buffer, dsonar_result_t* result);
 
 /**
- * @brief Free reverse sample linked list
+ * @brief Release decode buffer storage
  * 
- * @param head Pointer to first node in list to free
+ * @param buffer Pointer to decode buffer
  */
-void free_reverse_samples(reverse_sample_node_t* head);
+void free_decode_buffer(dsonar_decode_buffer_t* buffer);
 
 /**
  * @brief Free dSONAR result structure
@@ -211,41 +330,41 @@ dsonar_input_type_t detect_input_format(const char* filename);
  * @brief Parse CSV frequency data file
  * 
  * @param filename Path to CSV file
- * @param samples Pointer to store parsed samples
+ * @param buffer Pointer to initialized decode buffer receiving the bytes
  * @param config Pointer to dSONAR configuration structure
  * @return true if parsing successful, false otherwise
  */
-bool parse_csv_frequency_data(const char* filename, reverse_sample_node_t** samples, dsonar_config_t* config);
+bool parse_csv_frequency_data(const char* filename, dsonar_decode_buffer_t* buffer, dsonar_config_t* config);
 
 /**
  * @brief Parse JSON metadata file
  * 
  * @param filename Path to JSON file
- * @param samples Pointer to store parsed samples
+ * @param buffer Pointer to initialized decode buffer receiving the bytes
  * @param config Pointer to dSONAR configuration structure
  * @return true if parsing successful, false otherwise
  */
-bool parse_json_metadata(const char* filename, reverse_sample_node_t** samples, dsonar_config_t* config);
+bool parse_json_metadata(const char* filename, dsonar_decode_buffer_t* buffer, dsonar_config_t* config);
 
 /**
  * @brief Parse analysis report file
  * 
  * @param filename Path to analysis report file
- * @param samples Pointer to store parsed samples
+ * @param buffer Pointer to initialized decode buffer receiving the bytes
  * @param config Pointer to dSONAR configuration structure
  * @return true if parsing successful, false otherwise
  */
-bool parse_analysis_report(const char* filename, reverse_sample_node_t** samples, dsonar_config_t* config);
+bool parse_analysis_report(const char* filename, dsonar_decode_buffer_t* buffer, dsonar_config_t* config);
 
 /**
  * @brief Analyze WAV file frequencies
  * 
  * @param filename Path to WAV file
- * @param samples Pointer to store analyzed samples
+ * @param buffer Pointer to initialized decode buffer receiving the bytes
  * @param config Pointer to dSONAR configuration structure
  * @return true if analysis successful, false otherwise
  */
-bool analyze_wav_frequencies(const char* filename, reverse_sample_node_t** samples, dsonar_config_t* config);
+bool analyze_wav_frequencies(const char* filename, dsonar_decode_buffer_t* buffer, dsonar_config_t* config);
 
 /**
  * @brief Read WAV file header information
@@ -267,6 +386,18 @@ int read_wav_header(FILE* wav_file, int* sample_rate, int* channels, int* bits_p
  */
 double* extract_frequency_spectrum(const char* wav_filename, int* spectrum_length);
 
+/**
+ * @brief Expand a compressed SONAR payload in place
+ * 
+ * Called by every reconstruct_* function. If the reconstructed bytes start
+ * with an mbx_lz payload header (SONAR --compress), they are replaced by
+ * the decompressed data; otherwise the result is left untouched.
+ * 
+ * @param result Pointer to reconstruction result to update
+ * @return true if the payload was decompressed, false otherwise
+ */
+bool decompress_reconstruction(dsonar_result_t* result);
+
 /**
  * @brief Save reconstructed data to file
  * 
@@ -279,12 +410,28 @@ bool save_reconstructed_data(const char* output_filename, dsonar_result_t* resul
 /**
  * @brief Validate reconstruction against original file
  * 
+ * Streams the original file in fixed-size chunks and compares it with the
+ * reconstructed data, reporting the mismatch count and first positions.
+ * 
  * @param result Pointer to reconstruction result
  * @param original_filename Path to original file for comparison
  * @return true if validation successful, false otherwise
  */
 bool validate_reconstruction(dsonar_result_t* result, const char* original_filename);
 
+/**
+ * @brief Verify reconstruction against a SONAR digest sidecar
+ * 
+ * Recomputes CRC32C and XXH64 over the reconstructed data (or uses the digest
+ * accumulated while streaming) and compares them with the digest recorded at
+ * encode time. Needs no access to the original.
+ * 
+ * @param result Pointer to reconstruction result
+ * @param digest_filename Path to digest file (e.g. "sonar_partition_0.digest")
+ * @return true if the digest file exists and matches, false otherwise
+ */
+bool verify_reconstruction_digest(dsonar_result_t* result, const char* digest_filename);
+
 /**
  * @brief Print detailed reconstruction report
  * 
@@ -323,6 +470,53 @@ bool batch_reconstruct_partitions(const char* partition_pattern, const char* out
  */
 double calculate_reconstruction_accuracy(const unsigned char* original, const unsigned char* reconstructed, int length);
 
+/**
+ * @brief Reset an error analysis accumulator
+ * 
+ * @param stats Pointer to error statistics to reset
+ */
+void init_error_analysis(dsonar_error_stats_t* stats);
+
+/**
+ * @brief Accumulate bit-level errors of one chunk
+ * 
+ * Chunks must be fed in order; error runs spanning chunk boundaries are joined.
+ * 
+ * @param stats Pointer to error statistics accumulator
+ * @param original Pointer to original data chunk
+ * @param reconstructed Pointer to reconstructed data chunk
+ * @param confidence Per-byte confidence (0-255 maps to 0.0-1.0), or NULL
+ * @param length Number of bytes in the chunk
+ */
+void accumulate_error_analysis(dsonar_error_stats_t* stats, const unsigned char* original,
+                               const unsigned char* reconstructed, const unsigned char* confidence, int length);
+
+/**
+ * @brief Close open runs and compute derived error metrics
+ * 
+ * @param stats Pointer to error statistics accumulator
+ */
+void finish_error_analysis(dsonar_error_stats_t* stats);
+
+/**
+ * @brief Analyze reconstruction errors in a single call
+ * 
+ * @param original Pointer to original data
+ * @param reconstructed Pointer to reconstructed data
+ * @param confidence Per-byte confidence (0-255 maps to 0.0-1.0), or NULL
+ * @param length Length of data to compare
+ * @param stats Pointer to store error statistics
+ */
+void analyze_reconstruction_errors(const unsigned char* original, const unsigned char* reconstructed,
+                                   const unsigned char* confidence, int length, dsonar_error_stats_t* stats);
+
+/**
+ * @brief Print bit-level error analysis report
+ * 
+ * @param stats Pointer to finished error statistics
+ */
+void print_error_analysis(const dsonar_error_stats_t* stats);
+
 /**
  * @brief Combine multiple partition files into single file
  * 
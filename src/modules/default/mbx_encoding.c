@@ -0,0 +1,880 @@
+#include "mbx_encoding.h"
+#include "mbx_sjis.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define MBX_UTF8_SSSE3
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Bytes 0x80-0x9F of Latin-1 text decoded as Windows-1252 (0 = unassigned, left as a C1 control)
+static const uint16_t windows_1252[32] = {
+    0x20AC, 0x0000, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x0000, 0x017D, 0x0000,
+    0x0000, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x0000, 0x017E, 0x0178
+};
+
+static const char *encoding_names[] = {
+    "ASCII", "UTF-8", "UTF-16LE", "UTF-16BE", "Shift-JIS", "Latin-1", "binary"
+};
+
+const char *mbx_encoding_name(mbx_encoding_t encoding)
+{
+    return encoding <= MBX_ENCODING_BINARY ? encoding_names[encoding] : "unknown";
+}
+
+bool mbx_encoding_is_text(uint32_t codepoint)
+{
+    if (codepoint < 0x20) return codepoint >= 0x09 && codepoint <= 0x0D;
+    if (codepoint >= 0x7F && codepoint <= 0x9F) return false;
+    if (codepoint >= 0xD800 && codepoint <= 0xDFFF) return false;
+    if (codepoint == 0xFFFE || codepoint == 0xFFFF) return false;
+    return codepoint <= 0x10FFFF;
+}
+
+size_t mbx_encoding_to_utf8(uint32_t codepoint, unsigned char *out)
+{
+    if (codepoint < 0x80) {
+        out[0] = (unsigned char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = (unsigned char)(0xC0 | (codepoint >> 6));
+        out[1] = (unsigned char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = (unsigned char)(0xE0 | (codepoint >> 12));
+        out[1] = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (unsigned char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = (unsigned char)(0xF0 | (codepoint >> 18));
+    out[1] = (unsigned char)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (unsigned char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+size_t mbx_encoding_bom(const unsigned char *bytes, size_t length, mbx_encoding_t *encoding)
+{
+    if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+        *encoding = MBX_ENCODING_UTF8;
+        return 3;
+    }
+    if (length >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE) {
+        *encoding = MBX_ENCODING_UTF16LE;
+        return 2;
+    }
+    if (length >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF) {
+        *encoding = MBX_ENCODING_UTF16BE;
+        return 2;
+    }
+    return 0;
+}
+
+static size_t utf8_decode(const unsigned char *bytes, size_t length, uint32_t *codepoint)
+{
+    unsigned char lead = bytes[0];
+    *codepoint = MBX_ENCODING_INVALID;
+    if (lead < 0x80) {
+        *codepoint = lead;
+        return 1;
+    }
+
+    // Second-byte limits rule out overlong forms, surrogates and code points above U+10FFFF
+    size_t continuations;
+    uint32_t value;
+    unsigned char low = 0x80, high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        continuations = 1;
+        value = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        continuations = 2;
+        value = lead & 0x0F;
+        if (lead == 0xE0) low = 0xA0;
+        if (lead == 0xED) high = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        continuations = 3;
+        value = lead & 0x07;
+        if (lead == 0xF0) low = 0x90;
+        if (lead == 0xF4) high = 0x8F;
+    } else {
+        return 1;
+    }
+
+    for (size_t k = 1; k <= continuations; k++) {
+        if (k >= length) return 0;
+        if (bytes[k] < low || bytes[k] > high) return 1;
+        low = 0x80;
+        high = 0xBF;
+        value = (value << 6) | (bytes[k] & 0x3F);
+    }
+    *codepoint = value;
+    return continuations + 1;
+}
+
+static uint32_t utf16_unit(const unsigned char *bytes, bool big_endian)
+{
+    return big_endian ? (uint32_t)(bytes[0] << 8 | bytes[1]) : (uint32_t)(bytes[1] << 8 | bytes[0]);
+}
+
+static size_t utf16_decode(const unsigned char *bytes, size_t length, bool big_endian, uint32_t *codepoint)
+{
+    *codepoint = MBX_ENCODING_INVALID;
+    if (length < 2) return 0;
+
+    uint32_t unit = utf16_unit(bytes, big_endian);
+    if (unit < 0xD800 || unit > 0xDFFF) {
+        *codepoint = unit;
+        return 2;
+    }
+    if (unit >= 0xDC00) return 2;
+    if (length < 4) return 0;
+
+    uint32_t low = utf16_unit(bytes + 2, big_endian);
+    if (low < 0xDC00 || low > 0xDFFF) return 2;
+    *codepoint = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+    return 4;
+}
+
+static bool sjis_is_lead(unsigned char byte)
+{
+    return (byte >= 0x81 && byte <= 0x9F) || (byte >= 0xE0 && byte <= 0xFC);
+}
+
+static size_t sjis_decode(const unsigned char *bytes, size_t length, uint32_t *codepoint)
+{
+    unsigned char lead = bytes[0];
+    *codepoint = MBX_ENCODING_INVALID;
+    if (lead < 0x80) {
+        *codepoint = lead;
+        return 1;
+    }
+    if (lead >= 0xA1 && lead <= 0xDF) {
+        // Half-width katakana
+        *codepoint = 0xFF61 + (lead - 0xA1);
+        return 1;
+    }
+    if (!sjis_is_lead(lead)) return 1;
+    if (length < 2) return 0;
+
+    uint16_t value = mbx_sjis_to_unicode(lead, bytes[1]);
+    if (value == 0) return 1;
+    *codepoint = value;
+    return 2;
+}
+
+size_t mbx_encoding_decode(mbx_encoding_t encoding, const unsigned char *bytes, size_t length,
+                           uint32_t *codepoint)
+{
+    *codepoint = MBX_ENCODING_INVALID;
+    if (bytes == NULL || length == 0) return 0;
+
+    switch (encoding) {
+    case MBX_ENCODING_UTF8:
+        return utf8_decode(bytes, length, codepoint);
+    case MBX_ENCODING_UTF16LE:
+        return utf16_decode(bytes, length, false, codepoint);
+    case MBX_ENCODING_UTF16BE:
+        return utf16_decode(bytes, length, true, codepoint);
+    case MBX_ENCODING_SHIFT_JIS:
+        return sjis_decode(bytes, length, codepoint);
+    case MBX_ENCODING_LATIN1:
+        *codepoint = bytes[0];
+        if (bytes[0] >= 0x80 && bytes[0] <= 0x9F && windows_1252[bytes[0] - 0x80] != 0)
+            *codepoint = windows_1252[bytes[0] - 0x80];
+        return 1;
+    default:
+        if (bytes[0] < 0x80) *codepoint = bytes[0];
+        return 1;
+    }
+}
+
+static void add_character(mbx_encoding_stats_t *stats, uint32_t codepoint, size_t length)
+{
+    if (codepoint == MBX_ENCODING_INVALID) {
+        stats->invalid += length;
+        return;
+    }
+    stats->characters++;
+    if (codepoint > 0x7F) stats->non_ascii++;
+    if (mbx_encoding_is_text(codepoint)) stats->text_bytes += length;
+}
+
+static void add_stats(mbx_encoding_stats_t *total, const mbx_encoding_stats_t *part)
+{
+    total->bytes += part->bytes;
+    total->invalid += part->invalid;
+    total->characters += part->characters;
+    total->non_ascii += part->non_ascii;
+    total->text_bytes += part->text_bytes;
+}
+
+// An encoding is given up once a range has more invalid bytes than the text
+// threshold leaves room for, but never before this many
+#define GIVE_UP_MIN_INVALID 64
+
+// Scale counts from the bytes examined before giving up to the whole range
+static void extrapolate(mbx_encoding_stats_t *stats, size_t total)
+{
+    if (stats->bytes == 0 || stats->bytes >= total) return;
+    double scale = (double)total / stats->bytes;
+    stats->bytes = total;
+    stats->invalid = (uint64_t)(stats->invalid * scale + 0.5);
+    stats->characters = (uint64_t)(stats->characters * scale + 0.5);
+    stats->non_ascii = (uint64_t)(stats->non_ascii * scale + 0.5);
+    stats->text_bytes = (uint64_t)(stats->text_bytes * scale + 0.5);
+}
+
+#if defined(__SSE2__)
+// Byte lanes count matches by subtracting comparison masks; a lane overflows
+// after 255 blocks, so counters are summed at least that often
+#define COUNTER_BLOCKS 255
+
+static uint64_t sum_counters(__m128i counters)
+{
+    __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+    return (uint64_t)_mm_cvtsi128_si32(sums) + (uint64_t)_mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+}
+
+// Bytes that are C0 controls other than tab to carriage return, or DEL
+static __m128i control_bytes(__m128i v)
+{
+    __m128i below_space = _mm_and_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+                                        _mm_cmpgt_epi8(v, _mm_set1_epi8(-1)));
+    __m128i whitespace = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x08)),
+                                       _mm_cmplt_epi8(v, _mm_set1_epi8(0x0E)));
+    return _mm_or_si128(_mm_andnot_si128(whitespace, below_space),
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+}
+#endif
+
+// Length of the leading 16-byte blocks that are all ASCII; adds their control bytes
+static size_t ascii_run(const unsigned char *bytes, size_t length, uint64_t *controls)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i counters = _mm_setzero_si128();
+    int blocks = 0;
+    while (i + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+        if (_mm_movemask_epi8(v) != 0) break;
+        counters = _mm_sub_epi8(counters, control_bytes(v));
+        i += 16;
+        if (++blocks == COUNTER_BLOCKS) {
+            *controls += sum_counters(counters);
+            counters = _mm_setzero_si128();
+            blocks = 0;
+        }
+    }
+    if (blocks > 0) *controls += sum_counters(counters);
+#else
+    (void)bytes;
+    (void)length;
+    (void)controls;
+#endif
+    return i;
+}
+
+// ASCII and Latin-1 in one pass: every byte is one character
+static void single_byte_stats(const unsigned char *bytes, size_t length, mbx_encoding_stats_t *ascii,
+                              mbx_encoding_stats_t *latin1)
+{
+    uint64_t controls = 0, unassigned = 0, high = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i control_lanes = zero, high_lanes = zero, unassigned_lanes = zero;
+    int blocks = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+        __m128i holes = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)0x81)),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0x8D)));
+        holes = _mm_or_si128(holes, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0x8F)));
+        holes = _mm_or_si128(holes, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0x90)));
+        holes = _mm_or_si128(holes, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0x9D)));
+        control_lanes = _mm_sub_epi8(control_lanes, control_bytes(v));
+        high_lanes = _mm_sub_epi8(high_lanes, _mm_cmplt_epi8(v, zero));
+        unassigned_lanes = _mm_sub_epi8(unassigned_lanes, holes);
+        if (++blocks == COUNTER_BLOCKS) {
+            controls += sum_counters(control_lanes);
+            high += sum_counters(high_lanes);
+            unassigned += sum_counters(unassigned_lanes);
+            control_lanes = high_lanes = unassigned_lanes = zero;
+            blocks = 0;
+        }
+    }
+    controls += sum_counters(control_lanes);
+    high += sum_counters(high_lanes);
+    unassigned += sum_counters(unassigned_lanes);
+#endif
+    for (; i < length; i++) {
+        unsigned char byte = bytes[i];
+        if (byte >= 0x80) {
+            high++;
+            if (byte <= 0x9F && windows_1252[byte - 0x80] == 0) unassigned++;
+        } else if (!mbx_encoding_is_text(byte)) {
+            controls++;
+        }
+    }
+
+    ascii->bytes += length;
+    ascii->invalid += high;
+    ascii->characters += length - high;
+    ascii->text_bytes += length - high - controls;
+
+    latin1->bytes += length;
+    latin1->characters += length;
+    latin1->non_ascii += high;
+    latin1->text_bytes += length - controls - unassigned;
+}
+
+#if defined(MBX_UTF8_SSSE3)
+// Error bits of the lookup validator (Keiser and Lemire, "Validating UTF-8 in
+// less than one instruction per byte"): each names a pattern of the two
+// nibbles of a byte and the high nibble of the byte after it
+#define UTF8_TOO_SHORT (1 << 0)   // Lead or ASCII followed by lead or ASCII where a continuation is due
+#define UTF8_TOO_LONG (1 << 1)    // ASCII followed by a continuation
+#define UTF8_OVERLONG_3 (1 << 2)  // E0 followed by 80-9F
+#define UTF8_TOO_LARGE (1 << 3)   // F4 followed by 90-BF, or F5 and above
+#define UTF8_SURROGATE (1 << 4)   // ED followed by A0-BF
+#define UTF8_OVERLONG_2 (1 << 5)  // C0 or C1
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)  // F0 followed by 80-8F
+#define UTF8_TWO_CONTS (1 << 7)   // Two continuations, the second not due
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+static bool utf8_ssse3_available(void)
+{
+    static int available = -1;
+    if (available < 0)
+        available = __builtin_cpu_supports("ssse3") ? 1 : 0;
+    return available == 1;
+}
+
+static __m128i high_nibbles(__m128i v)
+{
+    return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+}
+
+static const unsigned char utf8_byte_1_high[16] = {
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+static const unsigned char utf8_byte_1_low[16] = {
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+    UTF8_CARRY | UTF8_OVERLONG_2,
+    UTF8_CARRY,
+    UTF8_CARRY,
+    UTF8_CARRY | UTF8_TOO_LARGE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+static const unsigned char utf8_byte_2_high[16] = {
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+// A lead byte this close to the end of a block continues into the next one
+static const unsigned char utf8_incomplete_limit[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+};
+
+/*
+ * Validate 16-byte blocks until one fails and count the characters of the
+ * valid prefix. Returns the length of that prefix, which ends at a character
+ * boundary; *resume is the end of the block that failed (or of the last
+ * block examined), from where the caller decodes one character at a time.
+ *
+ * Byte lanes count the blocks since the last flush; a copy taken at each
+ * character boundary is what gets flushed, so blocks past the prefix are
+ * never counted.
+ */
+__attribute__((target("ssse3")))
+static size_t utf8_valid_prefix(const unsigned char *bytes, size_t length, mbx_encoding_stats_t *stats,
+                                size_t *resume)
+{
+    const __m128i byte_1_high = _mm_loadu_si128((const __m128i *)utf8_byte_1_high);
+    const __m128i byte_1_low = _mm_loadu_si128((const __m128i *)utf8_byte_1_low);
+    const __m128i byte_2_high = _mm_loadu_si128((const __m128i *)utf8_byte_2_high);
+    const __m128i incomplete_limit = _mm_loadu_si128((const __m128i *)utf8_incomplete_limit);
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i previous = zero, incomplete = zero;
+    __m128i controls = zero, upper = zero, continuations = zero, c1 = zero, nonchars = zero;
+    __m128i controls_at = zero, upper_at = zero, continuations_at = zero, c1_at = zero, nonchars_at = zero;
+    uint64_t total_controls = 0, total_upper = 0, total_continuations = 0, total_c1 = 0, total_nonchars = 0;
+    size_t valid = 0, flushed = 0, i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        if (i - flushed == COUNTER_BLOCKS * 16) {
+            // No character boundary to flush at: let the caller take over
+            if (valid == flushed) break;
+            total_controls += sum_counters(controls_at);
+            total_upper += sum_counters(upper_at);
+            total_continuations += sum_counters(continuations_at);
+            total_c1 += sum_counters(c1_at);
+            total_nonchars += sum_counters(nonchars_at);
+            controls = _mm_sub_epi8(controls, controls_at);
+            upper = _mm_sub_epi8(upper, upper_at);
+            continuations = _mm_sub_epi8(continuations, continuations_at);
+            c1 = _mm_sub_epi8(c1, c1_at);
+            nonchars = _mm_sub_epi8(nonchars, nonchars_at);
+            controls_at = upper_at = continuations_at = c1_at = nonchars_at = zero;
+            flushed = valid;
+        }
+
+        __m128i input = _mm_loadu_si128((const __m128i *)(bytes + i));
+        controls = _mm_sub_epi8(controls, control_bytes(input));
+
+        if (_mm_movemask_epi8(input) == 0) {
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(incomplete, zero)) != 0xFFFF) {
+                i += 16;
+                break;
+            }
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+            __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+            __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+
+            __m128i special = _mm_and_si128(
+                _mm_and_si128(_mm_shuffle_epi8(byte_1_high, high_nibbles(prev1)),
+                              _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, _mm_set1_epi8(0x0F)))),
+                _mm_shuffle_epi8(byte_2_high, high_nibbles(input)));
+            // Third and fourth bytes of three- and four-byte characters must be continuations
+            __m128i must_continue = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80))),
+                                                 _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80))));
+            __m128i error = _mm_xor_si128(_mm_and_si128(must_continue, _mm_set1_epi8((char)0x80)), special);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xFFFF) {
+                i += 16;
+                break;
+            }
+
+            upper = _mm_sub_epi8(upper, _mm_cmplt_epi8(input, zero));
+            continuations = _mm_sub_epi8(continuations, _mm_cmplt_epi8(input, _mm_set1_epi8((char)0xC0)));
+            // U+0080-U+009F (C2 80-9F) and U+FFFE/U+FFFF (EF BF BE/BF) are not text
+            c1 = _mm_sub_epi8(c1, _mm_and_si128(_mm_cmpeq_epi8(prev1, _mm_set1_epi8((char)0xC2)),
+                                                _mm_cmplt_epi8(input, _mm_set1_epi8((char)0xA0))));
+            nonchars = _mm_sub_epi8(nonchars, _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(prev2, _mm_set1_epi8((char)0xEF)),
+                              _mm_cmpeq_epi8(prev1, _mm_set1_epi8((char)0xBF))),
+                _mm_cmpeq_epi8(_mm_or_si128(input, _mm_set1_epi8(1)), _mm_set1_epi8((char)0xBF))));
+        }
+
+        previous = input;
+        incomplete = _mm_subs_epu8(input, incomplete_limit);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(incomplete, zero)) == 0xFFFF) {
+            controls_at = controls;
+            upper_at = upper;
+            continuations_at = continuations;
+            c1_at = c1;
+            nonchars_at = nonchars;
+            valid = i + 16;
+        }
+    }
+
+    *resume = i;
+    if (valid == 0) return 0;
+
+    total_controls += sum_counters(controls_at);
+    total_upper += sum_counters(upper_at);
+    total_continuations += sum_counters(continuations_at);
+    total_c1 += sum_counters(c1_at);
+    total_nonchars += sum_counters(nonchars_at);
+
+    stats->bytes += valid;
+    stats->characters += valid - total_continuations;
+    stats->non_ascii += total_upper - total_continuations;
+    stats->text_bytes += valid - total_controls - 2 * total_c1 - 3 * total_nonchars;
+    return valid;
+}
+#endif
+
+static void utf8_stats(const unsigned char *bytes, size_t length, size_t offset, uint64_t limit,
+                       mbx_encoding_stats_t *stats)
+{
+    mbx_encoding_stats_t local = {0, 0, 0, 0, 0};
+    size_t i = 0;
+
+    // A window that starts inside a character skips its continuation bytes
+    if (offset > 0) {
+        while (i < length && i < 3 && (bytes[i] & 0xC0) == 0x80) i++;
+    }
+    size_t start = i;
+
+    while (i < length && local.invalid <= limit) {
+        size_t resume = i;
+#if defined(MBX_UTF8_SSSE3)
+        if (utf8_ssse3_available()) {
+            size_t valid = utf8_valid_prefix(bytes + i, length - i, &local, &resume);
+            resume += i;
+            i += valid;
+        }
+#endif
+        if (resume == i && i < length && bytes[i] < 0x80) {
+            uint64_t controls = 0;
+            size_t run = ascii_run(bytes + i, length - i, &controls);
+            local.characters += run;
+            local.text_bytes += run - controls;
+            i += run;
+        }
+
+        // One character at a time through the block that failed (at least one character)
+        do {
+            if (i >= length) break;
+            uint32_t codepoint;
+            size_t used = utf8_decode(bytes + i, length - i, &codepoint);
+            if (used == 0) {
+                length = i;
+                break;
+            }
+            add_character(&local, codepoint, used);
+            i += used;
+        } while (i < resume && local.invalid <= limit);
+    }
+
+    local.bytes = i - start;
+    if (local.invalid > limit) extrapolate(&local, length - start);
+    add_stats(stats, &local);
+}
+
+static void utf16_stats(const unsigned char *bytes, size_t length, size_t offset, bool big_endian,
+                        uint64_t limit, mbx_encoding_stats_t *stats)
+{
+    mbx_encoding_stats_t local = {0, 0, 0, 0, 0};
+
+    // Code units start at even file offsets; a window may start on the second half of a pair
+    size_t i = offset & 1;
+    if (offset + i > 0 && i + 2 <= length) {
+        uint32_t unit = utf16_unit(bytes + i, big_endian);
+        if (unit >= 0xDC00 && unit <= 0xDFFF) i += 2;
+    }
+    size_t start = i;
+
+#if defined(__SSE2__)
+    // Blocks of eight code units without surrogates; two lanes per code unit
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ascii_lanes = zero, other_lanes = zero;
+    uint64_t blocks = 0, ascii_bytes = 0, other_bytes = 0;
+    int pending = 0;
+#endif
+    while (i < length && local.invalid <= limit) {
+#if defined(__SSE2__)
+        if (i + 16 <= length) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+            if (big_endian) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            __m128i surrogates = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xF800)),
+                                                 _mm_set1_epi16((short)0xD800));
+            if (_mm_movemask_epi8(surrogates) == 0) {
+                __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xFF80)), zero);
+                __m128i latin = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xFF00)), zero);
+                __m128i below_space = _mm_cmplt_epi16(v, _mm_set1_epi16(0x20));
+                __m128i whitespace = _mm_and_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16(0x08)),
+                                                   _mm_cmplt_epi16(v, _mm_set1_epi16(0x0E)));
+                __m128i del_c1 = _mm_and_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16(0x7E)),
+                                               _mm_cmplt_epi16(v, _mm_set1_epi16(0xA0)));
+                __m128i controls = _mm_and_si128(latin, _mm_or_si128(_mm_andnot_si128(whitespace, below_space), del_c1));
+                __m128i nonchars = _mm_cmpeq_epi16(_mm_or_si128(v, _mm_set1_epi16(1)), _mm_set1_epi16(-1));
+
+                ascii_lanes = _mm_sub_epi8(ascii_lanes, ascii);
+                other_lanes = _mm_sub_epi8(other_lanes, _mm_or_si128(controls, nonchars));
+                blocks++;
+                if (++pending == COUNTER_BLOCKS) {
+                    ascii_bytes += sum_counters(ascii_lanes);
+                    other_bytes += sum_counters(other_lanes);
+                    ascii_lanes = other_lanes = zero;
+                    pending = 0;
+                }
+                i += 16;
+                continue;
+            }
+        }
+#endif
+        uint32_t codepoint;
+        size_t used = utf16_decode(bytes + i, length - i, big_endian, &codepoint);
+        if (used == 0) break;
+        add_character(&local, codepoint, used);
+        i += used;
+    }
+#if defined(__SSE2__)
+    ascii_bytes += sum_counters(ascii_lanes);
+    other_bytes += sum_counters(other_lanes);
+    local.characters += 8 * blocks;
+    local.non_ascii += 8 * blocks - ascii_bytes / 2;
+    local.text_bytes += 16 * blocks - other_bytes;
+#endif
+
+    local.bytes = i - start;
+    if (local.invalid > limit) extrapolate(&local, length - start);
+    add_stats(stats, &local);
+}
+
+static void sjis_stats(const unsigned char *bytes, size_t length, uint64_t limit, mbx_encoding_stats_t *stats)
+{
+    mbx_encoding_stats_t local = {0, 0, 0, 0, 0};
+    size_t i = 0;
+
+    while (i < length && local.invalid <= limit) {
+        if (bytes[i] < 0x80) {
+            uint64_t controls = 0;
+            size_t run = ascii_run(bytes + i, length - i, &controls);
+            local.characters += run;
+            local.text_bytes += run - controls;
+            i += run;
+        }
+
+        // One character at a time through the next block; single bytes are
+        // counted without branches, which binary data would mispredict
+        size_t end = length - i > 16 ? i + 16 : length;
+        while (i < end && local.invalid <= limit) {
+            unsigned char lead = bytes[i];
+            if (sjis_is_lead(lead)) {
+                if (i + 1 == length) {
+                    length = i;
+                    break;
+                }
+                // Every assigned double-byte character is non-ASCII text
+                if (mbx_sjis_to_unicode(lead, bytes[i + 1]) != 0) {
+                    local.characters++;
+                    local.non_ascii++;
+                    local.text_bytes += 2;
+                    i += 2;
+                } else {
+                    local.invalid++;
+                    i++;
+                }
+            } else {
+                // ASCII, half-width katakana or a byte that is no character
+                int kana = lead >= 0xA1 && lead <= 0xDF;
+                int ascii = lead < 0x80;
+                int text = kana | (ascii & ((lead >= 0x20 && lead != 0x7F) | (lead >= 0x09 && lead <= 0x0D)));
+                local.characters += kana | ascii;
+                local.non_ascii += kana;
+                local.text_bytes += text;
+                local.invalid += 1 - (kana | ascii);
+                i++;
+            }
+        }
+    }
+
+    local.bytes = i;
+    if (local.invalid > limit) extrapolate(&local, length);
+    add_stats(stats, &local);
+}
+
+void mbx_encoding_measure(const unsigned char *bytes, size_t length, size_t offset,
+                          mbx_encoding_stats_t stats[MBX_ENCODING_COUNT])
+{
+    if (bytes == NULL || stats == NULL || length == 0) return;
+
+    uint64_t limit = (uint64_t)((1.0 - MBX_ENCODING_TEXT_THRESHOLD) * length);
+    if (limit < GIVE_UP_MIN_INVALID) limit = GIVE_UP_MIN_INVALID;
+
+    single_byte_stats(bytes, length, &stats[MBX_ENCODING_ASCII], &stats[MBX_ENCODING_LATIN1]);
+    utf8_stats(bytes, length, offset, limit, &stats[MBX_ENCODING_UTF8]);
+    utf16_stats(bytes, length, offset, false, limit, &stats[MBX_ENCODING_UTF16LE]);
+    utf16_stats(bytes, length, offset, true, limit, &stats[MBX_ENCODING_UTF16BE]);
+    sjis_stats(bytes, length, limit, &stats[MBX_ENCODING_SHIFT_JIS]);
+}
+
+static double text_share(const mbx_encoding_stats_t *stats)
+{
+    return stats->bytes > 0 ? (double)stats->text_bytes / stats->bytes : 0.0;
+}
+
+// Almost any pair of bytes is a valid UTF-16 code unit, and Latin text read with
+// the wrong byte order is valid CJK. Without a byte order mark, UTF-16 must show
+// some ASCII (spaces, digits, line breaks) and next to no broken surrogates.
+static bool plausible(const mbx_encoding_stats_t *stats, mbx_encoding_t encoding, mbx_encoding_t bom)
+{
+    if (stats->bytes == 0) return false;
+    if (encoding != MBX_ENCODING_UTF16LE && encoding != MBX_ENCODING_UTF16BE) return true;
+    if (encoding == bom) return true;
+    return stats->characters > 0 && stats->invalid * 100 <= stats->bytes &&
+           (double)(stats->characters - stats->non_ascii) / stats->characters >= MBX_ENCODING_UTF16_MIN_ASCII;
+}
+
+void mbx_encoding_choose(const mbx_encoding_stats_t stats[MBX_ENCODING_COUNT], mbx_encoding_t bom,
+                         mbx_encoding_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    memcpy(result->stats, stats, sizeof(result->stats));
+    result->encoding = MBX_ENCODING_BINARY;
+    result->runner_up = MBX_ENCODING_BINARY;
+
+    // Best and second best; the earlier encoding wins a tie
+    mbx_encoding_t best = MBX_ENCODING_BINARY;
+    double best_score = -1.0, second_score = -1.0;
+    for (int e = 0; e < MBX_ENCODING_COUNT; e++) {
+        if (!plausible(&stats[e], (mbx_encoding_t)e, bom)) continue;
+        double score = text_share(&stats[e]);
+        if (score > best_score) {
+            result->runner_up = best;
+            second_score = best_score;
+            best = (mbx_encoding_t)e;
+            best_score = score;
+        } else if (score > second_score) {
+            result->runner_up = (mbx_encoding_t)e;
+            second_score = score;
+        }
+    }
+    result->runner_up_score = second_score > 0.0 ? second_score : 0.0;
+
+    if (bom < MBX_ENCODING_COUNT && text_share(&stats[bom]) >= MBX_ENCODING_TEXT_THRESHOLD) {
+        result->encoding = bom;
+        result->score = text_share(&stats[bom]);
+        result->bom = true;
+        if (best == bom) return;
+        result->runner_up = best;
+        result->runner_up_score = best_score;
+        return;
+    }
+
+    if (best_score >= MBX_ENCODING_TEXT_THRESHOLD) {
+        result->encoding = best;
+        result->score = best_score;
+    } else if (best != MBX_ENCODING_BINARY) {
+        // Binary: the closest text encoding is the runner-up
+        result->score = best_score;
+        result->runner_up = best;
+        result->runner_up_score = best_score;
+    }
+}
+
+void mbx_encoding_detect(const unsigned char *bytes, size_t length, size_t offset,
+                         mbx_encoding_result_t *result)
+{
+    mbx_encoding_stats_t stats[MBX_ENCODING_COUNT];
+    memset(stats, 0, sizeof(stats));
+
+    mbx_encoding_t bom = MBX_ENCODING_BINARY;
+    size_t skip = offset == 0 && bytes ? mbx_encoding_bom(bytes, length, &bom) : 0;
+    if (bytes) mbx_encoding_measure(bytes + skip, length - skip, offset + skip, stats);
+
+    mbx_encoding_choose(stats, bom, result);
+    result->bom_length = result->bom ? skip : 0;
+}
+
+bool mbx_encoding_scan(mojibake_target_t *target, size_t offset, size_t length, size_t window,
+                       mbx_encoding_result_t *result, size_t *window_counts)
+{
+    mbx_encoding_stats_t stats[MBX_ENCODING_COUNT];
+    memset(stats, 0, sizeof(stats));
+    if (window_counts) memset(window_counts, 0, (MBX_ENCODING_COUNT + 1) * sizeof(size_t));
+    if (window == 0) window = MBX_ENCODING_DEFAULT_WINDOW;
+    if (window > length && length > 0) window = length;
+
+    unsigned char *buffer = malloc(window > 0 ? window : 1);
+    if (!buffer) return false;
+
+    mbx_encoding_t bom = MBX_ENCODING_BINARY;
+    size_t bom_length = 0;
+    bool ok = true;
+    for (size_t position = 0; position < length; position += window) {
+        size_t count = length - position < window ? length - position : window;
+        if (mojibake_read(target, offset + position, buffer, count) != count) {
+            ok = false;
+            break;
+        }
+
+        size_t skip = 0;
+        if (offset + position == 0) skip = bom_length = mbx_encoding_bom(buffer, count, &bom);
+
+        mbx_encoding_stats_t window_stats[MBX_ENCODING_COUNT];
+        memset(window_stats, 0, sizeof(window_stats));
+        mbx_encoding_measure(buffer + skip, count - skip, offset + position + skip, window_stats);
+        for (int e = 0; e < MBX_ENCODING_COUNT; e++) add_stats(&stats[e], &window_stats[e]);
+
+        if (window_counts) {
+            mbx_encoding_result_t window_result;
+            mbx_encoding_choose(window_stats, bom, &window_result);
+            window_counts[window_result.encoding]++;
+        }
+    }
+    free(buffer);
+
+    mbx_encoding_choose(stats, bom, result);
+    result->bom_length = result->bom ? bom_length : 0;
+    return ok;
+}
+
+bool mbx_encoding(mojibake_target_t *target, unsigned int index, void *arg)
+{
+    if (target == NULL || index >= target->partition_count)
+        return false;
+
+    const mbx_encoding_config_t *config = (const mbx_encoding_config_t *)arg;
+    size_t window = config && config->window > 0 ? config->window : MBX_ENCODING_DEFAULT_WINDOW;
+
+    // The last partition also covers the bytes left over by the partition size
+    size_t offset = (size_t)index * target->partition_size;
+    size_t length = target->partition_size;
+    if (index == target->partition_count - 1) length = target->size - offset;
+
+    mbx_encoding_result_t result;
+    size_t window_counts[MBX_ENCODING_COUNT + 1];
+    if (!mbx_encoding_scan(target, offset, length, window, &result, window_counts)) {
+        printf("Error: Could not read partition %u\n", index);
+        return false;
+    }
+
+    printf("=== Partition %u Encoding Analysis ===\n", index);
+    printf("Range: %zu - %zu (%zu bytes)\n", offset, offset + length, length);
+    if (result.encoding == MBX_ENCODING_BINARY) {
+        printf("Encoding: binary (closest: %s, %.1f%% text)\n",
+               mbx_encoding_name(result.runner_up), result.runner_up_score * 100.0);
+    } else {
+        printf("Encoding: %s (%.1f%% text%s)\n", mbx_encoding_name(result.encoding),
+               result.score * 100.0, result.bom ? ", byte order mark" : "");
+        if (result.runner_up != MBX_ENCODING_BINARY)
+            printf("Runner-up: %s (%.1f%% text)\n", mbx_encoding_name(result.runner_up),
+                   result.runner_up_score * 100.0);
+    }
+
+    printf("Windows of %zu bytes:", window);
+    for (int e = 0; e <= MBX_ENCODING_COUNT; e++) {
+        if (window_counts[e] > 0) printf(" %s %zu", mbx_encoding_name((mbx_encoding_t)e), window_counts[e]);
+    }
+    printf("\n");
+
+    for (int e = 0; e < MBX_ENCODING_COUNT; e++) {
+        const mbx_encoding_stats_t *stats = &result.stats[e];
+        printf("  %-10s %5.1f%% text, %llu characters (%llu non-ASCII), %llu invalid bytes\n",
+               mbx_encoding_name((mbx_encoding_t)e), text_share(stats) * 100.0,
+               (unsigned long long)stats->characters, (unsigned long long)stats->non_ascii,
+               (unsigned long long)stats->invalid);
+    }
+    printf("\n");
+    return true;
+}
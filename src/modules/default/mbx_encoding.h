@@ -0,0 +1,195 @@
+/**
+ * @file mbx_encoding.h
+ * @brief Text encoding detection and decoding
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Scores a byte range against ASCII, UTF-8, UTF-16LE, UTF-16BE, Shift-JIS
+ * (code page 932) and Latin-1 (ISO-8859-1, with bytes 0x80-0x9F decoded as
+ * Windows-1252 as web browsers do). For each encoding one pass counts
+ * the bytes that do not form valid characters and the bytes of characters
+ * that are printable or whitespace. The encoding whose characters cover the
+ * most bytes with text wins; below MBX_ENCODING_TEXT_THRESHOLD the range is
+ * reported as binary.
+ *
+ * The validators are vectorized: UTF-8 uses the SSSE3 lookup algorithm of
+ * Keiser and Lemire when the CPU supports it, and UTF-16, ASCII and Latin-1
+ * use SSE2. Invalid regions and Shift-JIS double-byte characters are decoded
+ * one character at a time.
+ */
+
+#ifndef MBX_ENCODING_H
+#define MBX_ENCODING_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mojibake/mojibake.h"
+
+#define MBX_ENCODING_TEXT_THRESHOLD 0.9      /**< Share of bytes in text characters needed to call a range text */
+#define MBX_ENCODING_UTF16_MIN_ASCII 0.01    /**< Share of ASCII characters UTF-16 needs without a byte order mark */
+#define MBX_ENCODING_DEFAULT_WINDOW 4096     /**< Default scoring window in bytes */
+#define MBX_ENCODING_INVALID 0xFFFFFFFFu     /**< Code point returned for bytes that are not a valid character */
+
+/**
+ * @brief Encodings, in order of preference when scores tie
+ */
+typedef enum {
+    MBX_ENCODING_ASCII,
+    MBX_ENCODING_UTF8,
+    MBX_ENCODING_UTF16LE,
+    MBX_ENCODING_UTF16BE,
+    MBX_ENCODING_SHIFT_JIS,
+    MBX_ENCODING_LATIN1,
+    MBX_ENCODING_COUNT,        /**< Number of text encodings */
+    MBX_ENCODING_BINARY = MBX_ENCODING_COUNT /**< Not text in any supported encoding */
+} mbx_encoding_t;
+
+/**
+ * @brief Counts gathered while validating a range against one encoding
+ *
+ * Counts add up across ranges, so windows can be combined into partitions.
+ */
+typedef struct {
+    uint64_t bytes;            /**< Bytes examined */
+    uint64_t invalid;          /**< Bytes not part of a valid character */
+    uint64_t characters;       /**< Valid characters */
+    uint64_t non_ascii;        /**< Valid characters above U+007F */
+    uint64_t text_bytes;       /**< Bytes of printable or whitespace characters */
+} mbx_encoding_stats_t;
+
+/**
+ * @brief Detection result
+ */
+typedef struct {
+    mbx_encoding_t encoding;   /**< Detected encoding, or MBX_ENCODING_BINARY */
+    double score;              /**< Share of bytes in text characters for the detected encoding (0.0-1.0) */
+    mbx_encoding_t runner_up;  /**< Best other text encoding */
+    double runner_up_score;    /**< Its share of bytes in text characters */
+    bool bom;                  /**< A byte order mark selected the encoding */
+    size_t bom_length;         /**< Length of the byte order mark in bytes (0 if none) */
+    mbx_encoding_stats_t stats[MBX_ENCODING_COUNT]; /**< Counts for every encoding */
+} mbx_encoding_result_t;
+
+/**
+ * @brief Settings of the encoding module
+ */
+typedef struct {
+    size_t window;             /**< Scoring window in bytes */
+} mbx_encoding_config_t;
+
+/**
+ * @brief Display name of an encoding
+ *
+ * @param encoding Encoding
+ * @return Name such as "UTF-8"
+ */
+const char *mbx_encoding_name(mbx_encoding_t encoding);
+
+/**
+ * @brief Recognise a byte order mark
+ *
+ * @param bytes Bytes at the start of a file
+ * @param length Number of bytes
+ * @param encoding Output encoding the mark selects
+ * @return Length of the mark in bytes, 0 if there is none
+ */
+size_t mbx_encoding_bom(const unsigned char *bytes, size_t length, mbx_encoding_t *encoding);
+
+/**
+ * @brief Validate a range against every encoding and add to the counts
+ *
+ * Characters cut off at either end of the range are skipped rather than
+ * counted as invalid, so consecutive windows score like the whole range.
+ * Once an encoding has more invalid bytes than MBX_ENCODING_TEXT_THRESHOLD
+ * leaves room for, it cannot win the range: validation stops early and its
+ * counts are scaled up from the part examined.
+ *
+ * @param bytes Bytes to examine
+ * @param length Number of bytes
+ * @param offset File offset of bytes[0] (aligns UTF-16 code units to even offsets)
+ * @param stats Counts to add to, one per encoding
+ */
+void mbx_encoding_measure(const unsigned char *bytes, size_t length, size_t offset,
+                          mbx_encoding_stats_t stats[MBX_ENCODING_COUNT]);
+
+/**
+ * @brief Pick the encoding that best explains the counts
+ *
+ * @param stats Counts, one per encoding
+ * @param bom Encoding selected by a byte order mark, or MBX_ENCODING_BINARY if none
+ * @param result Output result (stats are copied into it)
+ */
+void mbx_encoding_choose(const mbx_encoding_stats_t stats[MBX_ENCODING_COUNT], mbx_encoding_t bom,
+                         mbx_encoding_result_t *result);
+
+/**
+ * @brief Detect the encoding of a buffer
+ *
+ * @param bytes Bytes to examine
+ * @param length Number of bytes
+ * @param offset File offset of bytes[0] (a byte order mark is only honoured at 0)
+ * @param result Output result
+ */
+void mbx_encoding_detect(const unsigned char *bytes, size_t length, size_t offset,
+                         mbx_encoding_result_t *result);
+
+/**
+ * @brief Detect the encoding of a range of a target, window by window
+ *
+ * @param target Pointer to mojibake target
+ * @param offset File offset of the range
+ * @param length Length of the range in bytes
+ * @param window Scoring window in bytes
+ * @param result Output result for the whole range
+ * @param window_counts Optional output: windows detected as each encoding, indexed
+ *        by mbx_encoding_t (MBX_ENCODING_COUNT + 1 entries, binary last)
+ * @return true if the range was read completely
+ */
+bool mbx_encoding_scan(mojibake_target_t *target, size_t offset, size_t length, size_t window,
+                       mbx_encoding_result_t *result, size_t *window_counts);
+
+/**
+ * @brief Decode one character
+ *
+ * Binary data decodes like ASCII: bytes above 0x7F are invalid.
+ *
+ * @param encoding Encoding
+ * @param bytes Bytes starting at a character boundary
+ * @param length Number of bytes available
+ * @param codepoint Output code point, MBX_ENCODING_INVALID if the bytes are not a character
+ * @return Bytes consumed (invalid input consumes one code unit), 0 if the
+ *         character is cut off by the end of the buffer
+ */
+size_t mbx_encoding_decode(mbx_encoding_t encoding, const unsigned char *bytes, size_t length,
+                           uint32_t *codepoint);
+
+/**
+ * @brief Check whether a code point is printable or whitespace
+ *
+ * @param codepoint Unicode code point
+ * @return false for C0 and C1 controls (other than tab, line feed, vertical
+ *         tab, form feed and carriage return), DEL, surrogates, U+FFFE/U+FFFF
+ *         and invalid code points
+ */
+bool mbx_encoding_is_text(uint32_t codepoint);
+
+/**
+ * @brief Encode a code point as UTF-8
+ *
+ * @param codepoint Unicode code point (at most U+10FFFF, not a surrogate)
+ * @param out Output buffer of at least 4 bytes
+ * @return Number of bytes written
+ */
+size_t mbx_encoding_to_utf8(uint32_t codepoint, unsigned char *out);
+
+/**
+ * @brief Encoding module function
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index to process
+ * @param arg Pointer to mbx_encoding_config_t (NULL for defaults)
+ * @return true if the partition was analysed
+ */
+bool mbx_encoding(mojibake_target_t *target, unsigned int index, void *arg);
+
+#endif
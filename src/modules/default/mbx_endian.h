@@ -0,0 +1,45 @@
+/**
+ * @file mbx_endian.h
+ * @brief Little-endian integers in byte buffers
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * The on-disk formats written by the modules (WAV headers, LZ frames,
+ * similarity and fingerprint indexes) store integers little-endian
+ * whatever the host order. These read and write them byte by byte, so
+ * buffers need no alignment. They sit in index lookups and header loops,
+ * so they are inline.
+ */
+
+#ifndef MBX_ENDIAN_H
+#define MBX_ENDIAN_H
+#include <stdint.h>
+
+static inline uint32_t mbx_get_le32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static inline uint64_t mbx_get_le64(const uint8_t *bytes)
+{
+    return (uint64_t)mbx_get_le32(bytes) | (uint64_t)mbx_get_le32(bytes + 4) << 32;
+}
+
+static inline void mbx_put_le16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+}
+
+static inline void mbx_put_le32(uint8_t *bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) bytes[i] = (uint8_t)(value >> (8 * i));
+}
+
+static inline void mbx_put_le64(uint8_t *bytes, uint64_t value)
+{
+    mbx_put_le32(bytes, (uint32_t)value);
+    mbx_put_le32(bytes + 4, (uint32_t)(value >> 32));
+}
+
+#endif
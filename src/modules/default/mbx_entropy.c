@@ -0,0 +1,481 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_entropy.h"
+#include "mbx_parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Bytes read per refill beyond the window itself
+#define ENTROPY_READ_CHUNK (64 * 1024)
+
+// Pushes at least this long build the histogram in four interleaved copies
+#define ENTROPY_SPLIT_HISTOGRAM 1024
+
+// Chi-square of uniform bytes: 255 degrees of freedom, standard deviation sqrt(2 * 255)
+#define ENTROPY_CHI_DF 255.0
+#define ENTROPY_CHI_SIGMAS 4.0
+#define ENTROPY_SCC_SIGMAS 4.0
+
+static const char *class_names[] = {"structured", "dense", "random"};
+
+// Sum, sum of squares and adjacent-pair products of a block (pairs inside the block only)
+static void block_sums(const unsigned char *bytes, size_t length, uint64_t *sum,
+                       uint64_t *sum_squares, uint64_t *sum_products)
+{
+    uint64_t s = 0, sq = 0, products = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // Each 32-bit lane gains at most 2 * 255^2 per step; flush well before it can overflow
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 17 <= length) {
+        __m128i acc_sum = zero, acc_squares = zero, acc_products = zero;
+        size_t stop = length - 16;
+        if (stop > i + 4096 * 16) stop = i + 4096 * 16;
+        for (; i + 1 <= stop; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+            __m128i w = _mm_loadu_si128((const __m128i *)(bytes + i + 1));
+            __m128i v_low = _mm_unpacklo_epi8(v, zero), v_high = _mm_unpackhi_epi8(v, zero);
+            __m128i w_low = _mm_unpacklo_epi8(w, zero), w_high = _mm_unpackhi_epi8(w, zero);
+            acc_sum = _mm_add_epi64(acc_sum, _mm_sad_epu8(v, zero));
+            acc_squares = _mm_add_epi32(acc_squares, _mm_madd_epi16(v_low, v_low));
+            acc_squares = _mm_add_epi32(acc_squares, _mm_madd_epi16(v_high, v_high));
+            acc_products = _mm_add_epi32(acc_products, _mm_madd_epi16(v_low, w_low));
+            acc_products = _mm_add_epi32(acc_products, _mm_madd_epi16(v_high, w_high));
+        }
+
+        uint64_t lanes64[2];
+        uint32_t lanes32[4];
+        _mm_storeu_si128((__m128i *)lanes64, acc_sum);
+        s += lanes64[0] + lanes64[1];
+        _mm_storeu_si128((__m128i *)lanes32, acc_squares);
+        sq += (uint64_t)lanes32[0] + lanes32[1] + lanes32[2] + lanes32[3];
+        _mm_storeu_si128((__m128i *)lanes32, acc_products);
+        products += (uint64_t)lanes32[0] + lanes32[1] + lanes32[2] + lanes32[3];
+    }
+#endif
+
+    for (; i < length; i++) {
+        unsigned int x = bytes[i];
+        s += x;
+        sq += x * x;
+        if (i + 1 < length) products += x * bytes[i + 1];
+    }
+
+    *sum = s;
+    *sum_squares = sq;
+    *sum_products = products;
+}
+
+void mbx_entropy_reset(mbx_entropy_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+}
+
+void mbx_entropy_push(mbx_entropy_state_t *state, const unsigned char *bytes, size_t length)
+{
+    if (length == 0) return;
+
+    if (length >= ENTROPY_SPLIT_HISTOGRAM) {
+        // Interleaved copies break the store-to-load chain on runs of equal bytes
+        uint32_t split[4][256];
+        memset(split, 0, sizeof(split));
+        size_t i = 0;
+        for (; i + 4 <= length; i += 4) {
+            split[0][bytes[i]]++;
+            split[1][bytes[i + 1]]++;
+            split[2][bytes[i + 2]]++;
+            split[3][bytes[i + 3]]++;
+        }
+        for (; i < length; i++) split[0][bytes[i]]++;
+        for (int b = 0; b < 256; b++) {
+            state->counts[b] += split[0][b] + split[1][b] + split[2][b] + split[3][b];
+        }
+    } else {
+        for (size_t i = 0; i < length; i++) state->counts[bytes[i]]++;
+    }
+
+    uint64_t sum, sum_squares, sum_products;
+    block_sums(bytes, length, &sum, &sum_squares, &sum_products);
+    state->sum += sum;
+    state->sum_squares += sum_squares;
+    state->sum_products += sum_products;
+
+    // Join the new block to the old end of the window
+    if (state->length > 0) {
+        state->sum_products += (uint64_t)state->last * bytes[0];
+    } else {
+        state->first = bytes[0];
+    }
+    state->last = bytes[length - 1];
+    state->length += length;
+}
+
+void mbx_entropy_pop(mbx_entropy_state_t *state, const unsigned char *bytes, size_t length)
+{
+    if (length == 0) return;
+    if (length >= state->length) {
+        mbx_entropy_reset(state);
+        return;
+    }
+
+    for (size_t i = 0; i < length; i++) state->counts[bytes[i]]--;
+
+    // Sums over the removed bytes plus the new first byte cover every pair that leaves
+    uint64_t sum, sum_squares, sum_products;
+    block_sums(bytes, length + 1, &sum, &sum_squares, &sum_products);
+    unsigned int next = bytes[length];
+    state->sum -= sum - next;
+    state->sum_squares -= sum_squares - next * next;
+    state->sum_products -= sum_products;
+
+    state->first = bytes[length];
+    state->length -= length;
+}
+
+void mbx_entropy_measure(const mbx_entropy_state_t *state, mbx_entropy_window_t *window)
+{
+    memset(window, 0, sizeof(*window));
+    if (state->length == 0) return;
+
+    // H = log2(n) - sum(c log2 c) / n and chi^2 = 256 sum(c^2) / n - n, both from the histogram
+    double n = (double)state->length;
+    double weighted = 0.0;
+    uint64_t count_squares = 0;
+    for (int b = 0; b < 256; b++) {
+        uint32_t c = state->counts[b];
+        if (c > 1) weighted += c * log2((double)c);
+        count_squares += (uint64_t)c * c;
+    }
+    window->entropy = (float)(log2(n) - weighted / n);
+    window->chi_square = (float)(256.0 * (double)count_squares / n - n);
+
+    // Cyclic serial correlation: the last byte pairs with the first, as in ent(1)
+    double mean = state->sum / n;
+    double products = (state->sum_products + (double)state->last * state->first) / n;
+    double variance = state->sum_squares / n - mean * mean;
+    window->serial_correlation = variance > 1e-9 ? (float)((products - mean * mean) / variance) : 1.0f;
+}
+
+mbx_entropy_class_t mbx_entropy_classify(const mbx_entropy_window_t *window, size_t length)
+{
+    if (length == 0) return MBX_ENTROPY_STRUCTURED;
+
+    // Uniform bytes keep chi-square within a few deviations of 255 and correlation near 0
+    double chi_limit = ENTROPY_CHI_DF + ENTROPY_CHI_SIGMAS * sqrt(2.0 * ENTROPY_CHI_DF);
+    double scc_limit = ENTROPY_SCC_SIGMAS / sqrt((double)length);
+    if (window->chi_square <= chi_limit && fabs(window->serial_correlation) <= scc_limit) {
+        return MBX_ENTROPY_RANDOM;
+    }
+    return window->entropy >= MBX_ENTROPY_DENSE_BITS ? MBX_ENTROPY_DENSE : MBX_ENTROPY_STRUCTURED;
+}
+
+// Sliding view of a partition: buffer holds file bytes [start, start + fill)
+typedef struct {
+    mojibake_target_t *target;
+    unsigned char *buffer;
+    size_t capacity;
+    size_t start;
+    size_t fill;
+    size_t end;
+} entropy_reader_t;
+
+// Make [from, to) available in the buffer, keeping bytes already read
+static const unsigned char *reader_view(entropy_reader_t *reader, size_t from, size_t to)
+{
+    if (from < reader->start || from > reader->start + reader->fill) {
+        reader->start = from;
+        reader->fill = 0;
+    } else if (to > reader->start + reader->capacity) {
+        size_t keep = reader->start + reader->fill - from;
+        memmove(reader->buffer, reader->buffer + (from - reader->start), keep);
+        reader->start = from;
+        reader->fill = keep;
+    }
+
+    while (reader->start + reader->fill < to) {
+        size_t position = reader->start + reader->fill;
+        size_t length = reader->capacity - reader->fill;
+        if (length > reader->end - position) length = reader->end - position;
+        size_t got = mojibake_read(reader->target, position, reader->buffer + reader->fill, length);
+        if (got == 0) return NULL;
+        reader->fill += got;
+    }
+    return reader->buffer + (from - reader->start);
+}
+
+// Store a finished region in the summary and start a new one
+static void close_region(mbx_entropy_summary_t *summary, mbx_entropy_region_t *region)
+{
+    if (region->windows == 0) return;
+
+    region->type = region->random_windows >= MBX_ENTROPY_RANDOM_SHARE * region->windows ?
+                   MBX_ENTROPY_RANDOM : MBX_ENTROPY_DENSE;
+    if (summary->region_count < MBX_ENTROPY_MAX_REGIONS) {
+        summary->regions[summary->region_count++] = *region;
+    }
+    summary->total_regions++;
+    memset(region, 0, sizeof(*region));
+}
+
+// Fold one window into the summary and the series file
+static void record_window(mbx_entropy_summary_t *summary, FILE *series, size_t offset, size_t length,
+                          const mbx_entropy_window_t *window, mbx_entropy_region_t *open_region)
+{
+    mbx_entropy_class_t type = mbx_entropy_classify(window, length);
+
+    if (summary->windows == 0 || window->entropy < summary->min_entropy) summary->min_entropy = window->entropy;
+    if (summary->windows == 0 || window->entropy > summary->max_entropy) summary->max_entropy = window->entropy;
+    summary->windows++;
+    summary->mean_entropy += window->entropy;
+    summary->mean_chi_square += window->chi_square;
+    summary->mean_serial_correlation += window->serial_correlation;
+    if (type == MBX_ENTROPY_RANDOM) summary->random_windows++;
+    if (type == MBX_ENTROPY_DENSE) summary->dense_windows++;
+
+    if (series) {
+        fprintf(series, "%zu,%zu,%.4f,%.2f,%.5f,%s\n", offset, length, window->entropy,
+                window->chi_square, window->serial_correlation, class_names[type]);
+    }
+
+    // Consecutive random or dense windows form one region
+    if (type == MBX_ENTROPY_STRUCTURED) {
+        close_region(summary, open_region);
+        return;
+    }
+    if (open_region->windows == 0) open_region->offset = offset;
+    open_region->length = offset + length - open_region->offset;
+    open_region->windows++;
+    if (type == MBX_ENTROPY_RANDOM) open_region->random_windows++;
+}
+
+bool mbx_entropy_partition(mojibake_target_t *target, unsigned int index,
+                           const mbx_entropy_config_t *config, mbx_entropy_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    if (target == NULL || config == NULL || index >= target->partition_count) return false;
+
+    size_t offset = (size_t)index * target->partition_size;
+    size_t length = target->partition_size;
+    if (index == target->partition_count - 1) length = target->size - offset;
+    summary->offset = offset;
+    summary->length = length;
+    if (length == 0) {
+        summary->ok = true;
+        return true;
+    }
+
+    size_t window = config->window < length ? config->window : length;
+    size_t step = config->step > 0 ? config->step : window;
+
+    // Sliding by less than half a window is cheaper than measuring afresh
+    bool incremental = step * 2 < window;
+    entropy_reader_t reader = {target, NULL, window + ENTROPY_READ_CHUNK + (incremental ? step : 0), 0, 0, offset + length};
+    reader.buffer = malloc(reader.capacity);
+    if (!reader.buffer) return false;
+
+    FILE *series = NULL;
+    if (config->write_series) {
+        char filename[256];
+        snprintf(filename, sizeof(filename), "entropy_partition_%u.csv", index);
+        series = fopen(filename, "w");
+        if (!series) {
+            printf("Error: Could not create %s\n", filename);
+            free(reader.buffer);
+            return false;
+        }
+        fprintf(series, "Offset,Length,Entropy,Chi_Square,Serial_Correlation,Class\n");
+    }
+
+    mbx_entropy_state_t state;
+    mbx_entropy_window_t measured;
+    mbx_entropy_region_t open_region = {0, 0, 0, 0, MBX_ENTROPY_STRUCTURED};
+    mbx_entropy_reset(&state);
+    bool ok = true;
+    size_t end = offset + length;
+    size_t position = offset;
+    size_t covered = offset;
+
+    // Windows inside a hole of a sparse file are all zeros and measure the same
+    mbx_entropy_window_t zeros;
+    bool zeros_measured = false;
+
+    while (ok && position + window <= end) {
+        size_t hole_end;
+        if (mojibake_hole(target, position, &hole_end) && hole_end >= position + window) {
+            if (!zeros_measured) {
+                mbx_entropy_state_t zero_state;
+                mbx_entropy_reset(&zero_state);
+                zero_state.counts[0] = (uint32_t)window;
+                zero_state.length = window;
+                mbx_entropy_measure(&zero_state, &zeros);
+                zeros_measured = true;
+            }
+            record_window(summary, series, position, window, &zeros, &open_region);
+            covered = position + window;
+            mbx_entropy_reset(&state);
+            position += step;
+            continue;
+        }
+
+        if (state.length == 0) {
+            const unsigned char *bytes = reader_view(&reader, position, position + window);
+            if (!bytes) {
+                ok = false;
+                break;
+            }
+            mbx_entropy_push(&state, bytes, window);
+        }
+
+        mbx_entropy_measure(&state, &measured);
+        record_window(summary, series, position, window, &measured, &open_region);
+        covered = position + window;
+
+        size_t next = position + step;
+        if (incremental && next + window <= end) {
+            const unsigned char *bytes = reader_view(&reader, position, next + window);
+            if (!bytes) {
+                ok = false;
+                break;
+            }
+            mbx_entropy_pop(&state, bytes, step);
+            mbx_entropy_push(&state, bytes + window, step);
+        } else {
+            mbx_entropy_reset(&state);
+        }
+        position = next;
+    }
+
+    // A last window aligned to the end covers bytes the step left out
+    if (ok && covered < end) {
+        size_t start = end - window;
+        const unsigned char *bytes = reader_view(&reader, start, end);
+        if (bytes) {
+            mbx_entropy_reset(&state);
+            mbx_entropy_push(&state, bytes, window);
+            mbx_entropy_measure(&state, &measured);
+            record_window(summary, series, start, window, &measured, &open_region);
+        } else {
+            ok = false;
+        }
+    }
+
+    close_region(summary, &open_region);
+    if (summary->windows > 0) {
+        summary->mean_entropy /= summary->windows;
+        summary->mean_chi_square /= summary->windows;
+        summary->mean_serial_correlation /= summary->windows;
+    }
+
+    if (series && fclose(series) != 0) ok = false;
+    free(reader.buffer);
+    summary->ok = ok;
+    return ok;
+}
+
+static void print_summary(unsigned int index, const mbx_entropy_summary_t *summary, const mbx_entropy_config_t *config)
+{
+    printf("=== Partition %u Entropy Analysis ===\n", index);
+    if (!summary->ok) {
+        printf("Error: Could not analyse partition %u\n\n", index);
+        return;
+    }
+
+    printf("Range: %zu - %zu (%zu bytes)\n", summary->offset, summary->offset + summary->length, summary->length);
+    if (summary->windows == 0) {
+        printf("No data\n\n");
+        return;
+    }
+
+    size_t window = config->window < summary->length ? config->window : summary->length;
+    printf("Windows: %zu x %zu bytes, step %zu\n", summary->windows, window,
+           config->step > 0 ? config->step : window);
+    printf("Entropy: min %.3f, mean %.3f, max %.3f bits/byte\n",
+           summary->min_entropy, summary->mean_entropy, summary->max_entropy);
+    printf("Chi-square: mean %.1f (uniform: 255 +/- 22.6)\n", summary->mean_chi_square);
+    printf("Serial correlation: mean %.4f\n", summary->mean_serial_correlation);
+    printf("Random windows: %zu (%.1f%%), dense windows: %zu (%.1f%%)\n",
+           summary->random_windows, summary->random_windows * 100.0 / summary->windows,
+           summary->dense_windows, summary->dense_windows * 100.0 / summary->windows);
+
+    for (int i = 0; i < summary->region_count; i++) {
+        const mbx_entropy_region_t *region = &summary->regions[i];
+        printf("  %-6s %zu - %zu (%zu bytes, %zu/%zu windows random)\n", class_names[region->type],
+               region->offset, region->offset + region->length, region->length,
+               region->random_windows, region->windows);
+    }
+    if (summary->total_regions > (size_t)summary->region_count) {
+        printf("  ... %zu more regions\n", summary->total_regions - summary->region_count);
+    }
+    if (config->write_series) {
+        printf("Series: entropy_partition_%u.csv\n", index);
+    }
+    printf("\n");
+}
+
+typedef struct {
+    mojibake_target_t *target;
+    const mbx_entropy_config_t *config;
+    mbx_entropy_summary_t *summaries;
+} entropy_batch_t;
+
+static void entropy_job(void *arg, unsigned int index, int worker)
+{
+    entropy_batch_t *batch = arg;
+    (void)worker;
+    mbx_entropy_partition(batch->target, index, batch->config, &batch->summaries[index]);
+}
+
+bool mbx_entropy_batch(mojibake_target_t *target, const mbx_entropy_config_t *config)
+{
+    if (target == NULL || config == NULL) return false;
+
+    entropy_batch_t batch = {.target = target, .config = config};
+    batch.summaries = calloc(target->partition_count, sizeof(mbx_entropy_summary_t));
+    if (!batch.summaries) return false;
+
+    mbx_parallel_job_t job = {.threads = config->threads, .numa = config->numa,
+                              .partition = entropy_job, .arg = &batch};
+    int threads = mbx_parallel_run(target, &job);
+    printf("[ENTROPY] %u partitions on %d threads\n\n", target->partition_count, threads);
+
+    bool ok = true;
+    size_t windows = 0, random_windows = 0, dense_windows = 0;
+    double entropy_sum = 0.0;
+    for (unsigned int i = 0; i < target->partition_count; i++) {
+        const mbx_entropy_summary_t *summary = &batch.summaries[i];
+        print_summary(i, summary, config);
+        ok = ok && summary->ok;
+        windows += summary->windows;
+        random_windows += summary->random_windows;
+        dense_windows += summary->dense_windows;
+        entropy_sum += summary->mean_entropy * summary->windows;
+    }
+
+    if (windows > 0) {
+        printf("=== File Entropy Summary ===\n");
+        printf("Windows: %zu, mean entropy %.3f bits/byte\n", windows, entropy_sum / windows);
+        printf("Random: %.1f%%, dense: %.1f%%, structured: %.1f%%\n\n",
+               random_windows * 100.0 / windows, dense_windows * 100.0 / windows,
+               (windows - random_windows - dense_windows) * 100.0 / windows);
+    }
+
+    free(batch.summaries);
+    return ok;
+}
+
+bool mbx_entropy(mojibake_target_t *target, unsigned int index, void *arg)
+{
+    mbx_entropy_config_t defaults = {MBX_ENTROPY_DEFAULT_WINDOW, MBX_ENTROPY_DEFAULT_WINDOW, 1, false, true};
+    const mbx_entropy_config_t *config = arg ? (const mbx_entropy_config_t *)arg : &defaults;
+
+    mbx_entropy_summary_t summary;
+    bool ok = mbx_entropy_partition(target, index, config, &summary);
+    print_summary(index, &summary, config);
+    return ok;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file mbx_entropy.h
+ * @brief Sliding-window entropy and randomness analysis
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Spots encrypted and compressed regions by measuring, over a window that
+ * slides through each partition:
+ *
+ * - Shannon entropy in bits per byte (0-8)
+ * - Chi-square statistic of the byte histogram against a uniform
+ *   distribution (255 degrees of freedom: mean 255, deviation 22.6)
+ * - Serial correlation coefficient of adjacent bytes (-1 to 1)
+ *
+ * The window keeps its histogram and byte sums up to date incrementally:
+ * sliding by s bytes costs O(s), not O(window). Block sums use SSE2 where
+ * available.
+ *
+ * Each window is classified as random (indistinguishable from uniform
+ * bytes: encrypted or well compressed), dense (high entropy but measurably
+ * non-uniform: compressed, packed or media data) or structured. Partitions
+ * are analysed in parallel, one worker thread per online CPU. Each writes
+ * its series to entropy_partition_<n>.csv, and the summaries are printed
+ * in partition order.
+ */
+
+#ifndef MBX_ENTROPY_H
+#define MBX_ENTROPY_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mojibake/mojibake.h"
+
+#define MBX_ENTROPY_DEFAULT_WINDOW 4096      /**< Default window length in bytes */
+#define MBX_ENTROPY_MIN_WINDOW 64            /**< Shortest window with meaningful statistics */
+#define MBX_ENTROPY_MAX_WINDOW (1 << 24)     /**< Longest window (keeps the sums exact in 64 bits) */
+#define MBX_ENTROPY_DENSE_BITS 7.0           /**< Entropy at or above which a window is dense */
+#define MBX_ENTROPY_MAX_REGIONS 16           /**< Random/dense regions kept per partition summary */
+#define MBX_ENTROPY_RANDOM_SHARE 0.9         /**< Share of random windows that makes a region random */
+
+/**
+ * @brief Window classification
+ */
+typedef enum {
+    MBX_ENTROPY_STRUCTURED, /**< Text, code, tables or other redundant data */
+    MBX_ENTROPY_DENSE,      /**< High entropy but measurably non-uniform (compressed, packed, media) */
+    MBX_ENTROPY_RANDOM      /**< Passes the chi-square and serial correlation tests (encrypted or well compressed) */
+} mbx_entropy_class_t;
+
+/**
+ * @brief Incrementally maintained statistics of the bytes in a window
+ */
+typedef struct {
+    uint32_t counts[256];      /**< Byte histogram */
+    size_t length;             /**< Bytes in the window */
+    uint64_t sum;              /**< Sum of byte values */
+    uint64_t sum_squares;      /**< Sum of squared byte values */
+    uint64_t sum_products;     /**< Sum of products of adjacent bytes inside the window */
+    unsigned char first;       /**< First byte in the window */
+    unsigned char last;        /**< Last byte in the window */
+} mbx_entropy_state_t;
+
+/**
+ * @brief Measurements of one window (one entry of the per-window series)
+ */
+typedef struct {
+    float entropy;             /**< Shannon entropy in bits per byte (0-8) */
+    float chi_square;          /**< Chi-square statistic against uniform bytes */
+    float serial_correlation;  /**< Serial correlation of adjacent bytes, cyclic as in ent(1); 1 for constant data */
+} mbx_entropy_window_t;
+
+/**
+ * @brief Contiguous run of random or dense windows
+ *
+ * Compressed data drifts in and out of the randomness tests window by
+ * window, so both classes join one region. The region counts as random
+ * when at least MBX_ENTROPY_RANDOM_SHARE of its windows are random.
+ */
+typedef struct {
+    size_t offset;             /**< File offset of the first byte */
+    size_t length;             /**< Length in bytes */
+    size_t windows;            /**< Windows in the region */
+    size_t random_windows;     /**< Random windows in the region */
+    mbx_entropy_class_t type;  /**< MBX_ENTROPY_RANDOM or MBX_ENTROPY_DENSE */
+} mbx_entropy_region_t;
+
+/**
+ * @brief Analysis settings
+ */
+typedef struct {
+    size_t window;             /**< Window length in bytes */
+    size_t step;               /**< Distance between window starts in bytes (window = non-overlapping) */
+    int threads;               /**< Worker threads (0 = one per online CPU) */
+    bool numa;                 /**< Pin workers to NUMA nodes and prefer node-local partitions */
+    bool write_series;         /**< Write entropy_partition_<n>.csv */
+} mbx_entropy_config_t;
+
+/**
+ * @brief Per-partition summary
+ */
+typedef struct {
+    size_t offset;             /**< File offset of the partition */
+    size_t length;             /**< Partition length in bytes */
+    size_t windows;            /**< Windows measured */
+    size_t random_windows;     /**< Windows classified random */
+    size_t dense_windows;      /**< Windows classified dense */
+    double min_entropy;        /**< Lowest window entropy */
+    double max_entropy;        /**< Highest window entropy */
+    double mean_entropy;       /**< Mean window entropy */
+    double mean_chi_square;    /**< Mean chi-square statistic */
+    double mean_serial_correlation; /**< Mean serial correlation */
+    mbx_entropy_region_t regions[MBX_ENTROPY_MAX_REGIONS]; /**< First random/dense regions */
+    int region_count;          /**< Regions stored in regions */
+    size_t total_regions;      /**< All regions found, including those not stored */
+    bool ok;                   /**< Partition was read and analysed completely */
+} mbx_entropy_summary_t;
+
+/**
+ * @brief Empty a window
+ *
+ * @param state Pointer to window state
+ */
+void mbx_entropy_reset(mbx_entropy_state_t *state);
+
+/**
+ * @brief Append bytes at the end of a window
+ *
+ * @param state Pointer to window state
+ * @param bytes Bytes to append
+ * @param length Number of bytes
+ */
+void mbx_entropy_push(mbx_entropy_state_t *state, const unsigned char *bytes, size_t length);
+
+/**
+ * @brief Remove bytes from the start of a window
+ *
+ * @param state Pointer to window state
+ * @param bytes The window's contents from its start: the length bytes to
+ *        remove, followed by the byte that becomes the new first byte
+ *        (unless the window is emptied)
+ * @param length Number of bytes to remove
+ */
+void mbx_entropy_pop(mbx_entropy_state_t *state, const unsigned char *bytes, size_t length);
+
+/**
+ * @brief Measure the current window
+ *
+ * @param state Pointer to window state
+ * @param window Output measurements
+ */
+void mbx_entropy_measure(const mbx_entropy_state_t *state, mbx_entropy_window_t *window);
+
+/**
+ * @brief Classify a measured window
+ *
+ * @param window Window measurements
+ * @param length Window length in bytes
+ * @return Window class
+ */
+mbx_entropy_class_t mbx_entropy_classify(const mbx_entropy_window_t *window, size_t length);
+
+/**
+ * @brief Analyse one partition
+ *
+ * The last partition also covers the bytes left over by the partition
+ * size. Safe to call from several threads on the same target.
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index
+ * @param config Analysis settings
+ * @param summary Output summary
+ * @return true if the partition was analysed, false on read or write failure
+ */
+bool mbx_entropy_partition(mojibake_target_t *target, unsigned int index,
+                           const mbx_entropy_config_t *config, mbx_entropy_summary_t *summary);
+
+/**
+ * @brief Analyse all partitions in parallel and print their summaries
+ *
+ * @param target Pointer to mojibake target
+ * @param config Analysis settings
+ * @return true if every partition was analysed
+ */
+bool mbx_entropy_batch(mojibake_target_t *target, const mbx_entropy_config_t *config);
+
+/**
+ * @brief Entropy module function (one partition, for mojibake_execute)
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index to process
+ * @param arg Pointer to mbx_entropy_config_t (NULL for defaults)
+ * @return true if the partition was analysed
+ */
+bool mbx_entropy(mojibake_target_t *target, unsigned int index, void *arg);
+
+#endif
@@ -0,0 +1,419 @@
+#include "mbx_estimate.h"
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define ESTIMATE_WINDOW 32             // Samples in the sliding recurrence fit
+#define ESTIMATE_MAX_BREAKS 256        // Tone restarts scored against candidate lattices
+#define ESTIMATE_MAX_SEGMENTS 1024     // Silence-delimited tones examined in merged streams
+#define ESTIMATE_MIN_SYMBOL 32         // Shortest symbol considered
+#define ESTIMATE_SILENCE_LEVEL 8       // Matches dSONAR's silence threshold
+#define ESTIMATE_MIN_GAP 4             // Shortest silent run that separates merged tones
+#define ESTIMATE_CLUSTER_SHARE 20      // A tone length needs 1/20 of the tones (at least 2) to count
+#define ESTIMATE_LENGTH_ERROR 2.0      // Truncation and edge error of a merged tone's length in samples
+#define ESTIMATE_PURE_RESIDUAL 1e-4    // Recurrence residual power of a pure tone, relative to its power
+#define ESTIMATE_COARSE_SAMPLES 1024   // Samples in the coarse spectrum scan
+#define ESTIMATE_HISTOGRAM_HZ 50.0     // Width of a coarse spectrum histogram bin
+
+// Positions where the signal stops following the recurrence of the tone before it
+static int find_breaks(const short *x, int count, int *breaks, int max_breaks)
+{
+    double ring_xy[ESTIMATE_WINDOW], ring_xx[ESTIMATE_WINDOW];
+    double sum_xy = 0.0, sum_xx = 0.0;
+    int filled = 0, head = 0, start = 0, found = 0;
+
+    for (int n = 2; n < count && found < max_breaks; n++) {
+        if (n - start < 2) continue;
+
+        if (filled >= ESTIMATE_WINDOW / 2 && sum_xx > 0.0) {
+            double c = sum_xy / sum_xx;
+            double residual = fabs(x[n] - c * x[n - 1] + x[n - 2]);
+            double amplitude = sqrt(2.0 * sum_xx / filled);
+            if (residual > ESTIMATE_SILENCE_LEVEL + 0.02 * amplitude) {
+                breaks[found++] = n;
+                start = n;
+                sum_xy = sum_xx = 0.0;
+                filled = head = 0;
+                continue;
+            }
+        }
+
+        double xy = (double)x[n - 1] * (x[n] + x[n - 2]);
+        double xx = (double)x[n - 1] * x[n - 1];
+        if (filled == ESTIMATE_WINDOW) {
+            sum_xy -= ring_xy[head];
+            sum_xx -= ring_xx[head];
+        } else {
+            filled++;
+        }
+        ring_xy[head] = xy;
+        ring_xx[head] = xx;
+        head = (head + 1) % ESTIMATE_WINDOW;
+        sum_xy += xy;
+        sum_xx += xx;
+    }
+    return found;
+}
+
+// Largest symbol length whose lattice k * N explains nearly as many breaks as the best one
+static int lattice_symbol(const int *breaks, int break_count, int max_symbol, double *confidence)
+{
+    if (break_count < 4 || max_symbol < ESTIMATE_MIN_SYMBOL) return 0;
+
+    int *scores = calloc(max_symbol + 1, sizeof(int));
+    if (!scores) return 0;
+
+    int best = 0;
+    for (int n = ESTIMATE_MIN_SYMBOL; n <= max_symbol; n++) {
+        for (int i = 0; i < break_count; i++) {
+            int r = breaks[i] % n;
+            if (r <= 1 || r == n - 1) scores[n]++;
+        }
+        if (scores[n] > best) best = scores[n];
+    }
+
+    // Divisors of the true length score as well as it does, so take the largest
+    int symbol = 0;
+    for (int n = max_symbol; n >= ESTIMATE_MIN_SYMBOL; n--) {
+        if (scores[n] * 10 >= best * 9) {
+            symbol = n;
+            break;
+        }
+    }
+    free(scores);
+
+    *confidence = (double)best / break_count;
+    return *confidence >= 0.8 ? symbol : 0;
+}
+
+static int compare_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Most common value, counting neighbours within one sample together
+static int mode_of(int *values, int count)
+{
+    qsort(values, count, sizeof(int), compare_int);
+    int best = values[0], best_count = 0;
+    for (int i = 0, j = 0; i < count; i++) {
+        while (values[i] - values[j] > 2) j++;
+        if (i - j + 1 > best_count) {
+            best_count = i - j + 1;
+            best = values[(i + j) / 2];
+        }
+    }
+    return best;
+}
+
+// Shortest length that at least min_support values share (within two samples), or 0
+static int shortest_cluster(int *values, int count, int min_support)
+{
+    qsort(values, count, sizeof(int), compare_int);
+    for (int i = 0, j = 0; i < count; i++) {
+        while (j < count && values[j] - values[i] <= 2) j++;
+        if (j - i >= min_support) return values[(i + j - 1) / 2];
+    }
+    return 0;
+}
+
+// Power of a single frequency (radians per sample) over a block
+static double goertzel_power(const short *x, int n, double w)
+{
+    double coefficient = 2.0 * cos(w);
+    double s1 = 0.0, s2 = 0.0;
+    for (int i = 0; i < n; i++) {
+        double s0 = x[i] + coefficient * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    return s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+}
+
+// Strongest frequency from a coarse DFT scan, refined by ternary search over the whole block
+static double coarse_peak(const short *x, int n)
+{
+    int m = n < ESTIMATE_COARSE_SAMPLES ? n : ESTIMATE_COARSE_SAMPLES;
+    int best_bin = 1;
+    double best_power = -1.0;
+    for (int k = 1; k < m / 2; k++) {
+        double power = goertzel_power(x, m, 2.0 * M_PI * k / m);
+        if (power > best_power) {
+            best_power = power;
+            best_bin = k;
+        }
+    }
+
+    double low = 2.0 * M_PI * (best_bin - 1) / m;
+    double high = 2.0 * M_PI * (best_bin + 1) / m;
+    for (int i = 0; i < 40; i++) {
+        double a = low + (high - low) / 3.0, b = high - (high - low) / 3.0;
+        if (goertzel_power(x, n, a) < goertzel_power(x, n, b)) low = a;
+        else high = b;
+    }
+    return (low + high) / 2.0;
+}
+
+// Frequency (radians per sample), amplitude and harmonic ratio of one symbol
+static bool analyse_symbol(const short *x, int n, double *w, double *amplitude, double *harmonics)
+{
+    double sum_xy = 0.0, sum_xx = 0.0;
+    for (int i = 2; i < n; i++) {
+        sum_xy += (double)x[i - 1] * (x[i] + x[i - 2]);
+        sum_xx += (double)x[i - 1] * x[i - 1];
+    }
+    if (sum_xx <= 0.0) return false;
+
+    double c = sum_xy / sum_xx;
+    if (c > 2.0) c = 2.0;
+    if (c < -2.0) c = -2.0;
+
+    double residual = 0.0;
+    for (int i = 2; i < n; i++) {
+        double e = x[i] - c * x[i - 1] + x[i - 2];
+        residual += e * e;
+    }
+    *w = residual / sum_xx > ESTIMATE_PURE_RESIDUAL ? coarse_peak(x, n) : acos(c / 2.0);
+    if (*w <= 0.0) return false;
+
+    // Least-squares fit of a cos + b sin at the found frequency
+    double cc = 0.0, ss = 0.0, cs = 0.0, xc = 0.0, xs = 0.0;
+    for (int i = 0; i < n; i++) {
+        double co = cos(*w * i), si = sin(*w * i);
+        cc += co * co;
+        ss += si * si;
+        cs += co * si;
+        xc += x[i] * co;
+        xs += x[i] * si;
+    }
+    double det = cc * ss - cs * cs;
+    if (fabs(det) < 1e-9) return false;
+    double a = (xc * ss - xs * cs) / det;
+    double b = (xs * cc - xc * cs) / det;
+    *amplitude = sqrt(a * a + b * b);
+
+    double fundamental = goertzel_power(x, n, *w);
+    double overtones = 0.0;
+    for (int h = 2; h <= 3 && *w * h < M_PI; h++) {
+        overtones += goertzel_power(x, n, *w * h);
+    }
+    *harmonics = fundamental > 0.0 ? overtones / fundamental : 0.0;
+    return true;
+}
+
+// Split a merged stream into silence-delimited tones; returns tone count, fills gap lengths
+static int find_segments(const short *x, int count, int *starts, int *lengths, int *gaps, int *gap_count)
+{
+    int segments = 0, silent = 0, start = -1;
+    *gap_count = 0;
+
+    for (int i = 0; i < count && segments < ESTIMATE_MAX_SEGMENTS; i++) {
+        if (abs(x[i]) <= ESTIMATE_SILENCE_LEVEL) {
+            silent++;
+            if (start >= 0 && silent == ESTIMATE_MIN_GAP) {
+                starts[segments] = start;
+                lengths[segments] = i - ESTIMATE_MIN_GAP + 1 - start;
+                segments++;
+                start = -1;
+            }
+            continue;
+        }
+        if (start < 0) {
+            if (silent >= ESTIMATE_MIN_GAP && i > silent) gaps[(*gap_count)++] = silent;
+            start = i;
+        }
+        silent = 0;
+    }
+    return segments; // A tone cut off by the end of the prefix is not counted
+}
+
+bool mbx_estimate_tones(const short *samples, int count, int sample_rate, mbx_estimate_t *estimate)
+{
+    memset(estimate, 0, sizeof(*estimate));
+    if (!samples || count < 4 * ESTIMATE_MIN_SYMBOL || sample_rate <= 0) return false;
+
+    int *starts = malloc(ESTIMATE_MAX_SEGMENTS * sizeof(int));
+    int *lengths = malloc(ESTIMATE_MAX_SEGMENTS * sizeof(int));
+    int *gaps = malloc(ESTIMATE_MAX_SEGMENTS * sizeof(int));
+    int *breaks = malloc(ESTIMATE_MAX_BREAKS * sizeof(int));
+    if (!starts || !lengths || !gaps || !breaks) {
+        free(starts);
+        free(lengths);
+        free(gaps);
+        free(breaks);
+        return false;
+    }
+
+    // Merged streams open with a silent gap
+    bool leading_gap = true;
+    for (int i = 0; i < ESTIMATE_MIN_GAP; i++) {
+        if (abs(samples[i]) > ESTIMATE_SILENCE_LEVEL) leading_gap = false;
+    }
+
+    int gap_count = 0;
+    int segments = leading_gap ? find_segments(samples, count, starts, lengths, gaps, &gap_count) : 0;
+    int symbol_count = 0;
+
+    if (segments >= 2 && gap_count >= 1) {
+        estimate->merged = true;
+
+        // Run-1 tones are the shortest; longer runs only add quanta. Each tone lost its first (zero)
+        // sample to the silence. A few stray short segments must not pass for a cluster.
+        int *sorted = malloc(segments * sizeof(int));
+        if (sorted) {
+            memcpy(sorted, lengths, segments * sizeof(int));
+            int support = segments / ESTIMATE_CLUSTER_SHARE > 2 ? segments / ESTIMATE_CLUSTER_SHARE : 2;
+            int tone = shortest_cluster(sorted, segments, support);
+            if (tone == 0) tone = mode_of(sorted, segments);
+            int gap = mode_of(gaps, gap_count) - 1;
+
+            estimate->symbol_samples = tone + 1;
+
+            // The encoder truncates each tone to floor(D + k Q) samples, so a tone k quanta longer than
+            // the shortest one is within a sample or two of k Q. Each such tone narrows the interval Q must lie
+            // in; taking them shortest first keeps the step count of the longer ones unambiguous.
+            double low = 0.0, high = 0.0;
+            int consistent = 0;
+            for (int i = 0; i < segments; i++) {
+                double extra = sorted[i] - tone;
+                double quantum = high > 0.0 ? (low + high) / 2.0 : gap + 0.5;
+                int steps = quantum > 0.0 ? (int)floor(extra / quantum + 0.5) : 0;
+                if (steps <= 0) {
+                    if (fabs(extra) <= 2.0) consistent++;
+                    continue;
+                }
+                double step_low = (extra - ESTIMATE_LENGTH_ERROR) / steps;
+                double step_high = (extra + ESTIMATE_LENGTH_ERROR) / steps;
+                if (high > 0.0 && (step_high < low || step_low > high)) continue;
+                if (high == 0.0 || step_low > low) low = step_low;
+                if (high == 0.0 || step_high < high) high = step_high;
+                consistent++;
+            }
+
+            // A gap is floor(Q) silent samples and the next tone's zero first sample, so Q is in [gap, gap + 1).
+            // Ramped tones lengthen the gaps, so the gap only counts where the tones agree with it.
+            if (gap > 0 && (high == 0.0 || (low < gap + 1 && high > gap))) {
+                if (high == 0.0 || low < gap) low = gap;
+                if (high == 0.0 || high > gap + 1) high = gap + 1;
+            }
+            if (high > 0.0) {
+                estimate->quantum_samples = (low + high) / 2.0;
+                estimate->quantum_error = (high - low) / 2.0;
+            }
+            estimate->confidence = (double)consistent / segments;
+            free(sorted);
+        }
+        symbol_count = segments;
+    } else {
+        int break_count = find_breaks(samples, count, breaks, ESTIMATE_MAX_BREAKS);
+        int max_symbol = count / 2 < sample_rate ? count / 2 : sample_rate;
+        estimate->symbol_samples = lattice_symbol(breaks, break_count, max_symbol, &estimate->confidence);
+        if (estimate->symbol_samples > 0) symbol_count = count / estimate->symbol_samples;
+    }
+
+    if (estimate->symbol_samples <= 0) {
+        free(starts);
+        free(lengths);
+        free(gaps);
+        free(breaks);
+        return false;
+    }
+
+    // Per-symbol frequency and amplitude; the amplitude encodes the byte as 0.1 + 0.9 * byte / 255
+    double f[MBX_ESTIMATE_MAX_SYMBOLS];
+    int bytes[MBX_ESTIMATE_MAX_SYMBOLS];
+    int histogram_bins = (int)(sample_rate / 2 / ESTIMATE_HISTOGRAM_HZ) + 1;
+    int *histogram = calloc(histogram_bins, sizeof(int));
+    int mapped = 0;
+    double harmonics_total = 0.0;
+
+    for (int s = 0; s < symbol_count && estimate->symbols_used < MBX_ESTIMATE_MAX_SYMBOLS; s++) {
+        const short *x;
+        int n;
+        if (estimate->merged) {
+            x = samples + starts[s];
+            n = estimate->symbol_samples - 1;
+        } else {
+            x = samples + (size_t)s * estimate->symbol_samples;
+            n = estimate->symbol_samples;
+        }
+
+        double w, amplitude, harmonics;
+        if (!analyse_symbol(x, n, &w, &amplitude, &harmonics)) continue;
+
+        double frequency = w * sample_rate / (2.0 * M_PI);
+        harmonics_total += harmonics;
+        if (histogram) histogram[(int)(frequency / ESTIMATE_HISTOGRAM_HZ)]++;
+
+        double value = (amplitude / 32767.0 - 0.1) / 0.9 * 255.0;
+        int byte = (int)floor(value + 0.5);
+        if (byte >= 0 && byte <= 255 && fabs(value - byte) < 0.35) {
+            f[mapped] = frequency;
+            bytes[mapped] = byte;
+            mapped++;
+        }
+        estimate->symbols_used++;
+    }
+
+    if (estimate->symbols_used > 0) {
+        estimate->harmonic_ratio = harmonics_total / estimate->symbols_used;
+    }
+    if (histogram) {
+        for (int i = 0; i < histogram_bins; i++) {
+            if (!histogram[i]) continue;
+            if (estimate->high_frequency == 0.0) estimate->low_frequency = i * ESTIMATE_HISTOGRAM_HZ;
+            estimate->high_frequency = (i + 1) * ESTIMATE_HISTOGRAM_HZ;
+        }
+        free(histogram);
+    }
+
+    // Frequency is linear in the byte value: regress to find byte 0 and the 0-255 span
+    int low_byte = 256, high_byte = -1;
+    double sb = 0.0, sf = 0.0, sbb = 0.0, sbf = 0.0;
+    for (int i = 0; i < mapped; i++) {
+        if (bytes[i] < low_byte) low_byte = bytes[i];
+        if (bytes[i] > high_byte) high_byte = bytes[i];
+        sb += bytes[i];
+        sf += f[i];
+        sbb += (double)bytes[i] * bytes[i];
+        sbf += bytes[i] * f[i];
+    }
+    if (mapped >= 4 && high_byte - low_byte >= 4) {
+        double slope = (mapped * sbf - sb * sf) / (mapped * sbb - sb * sb);
+        double base = (sf - slope * sb) / mapped;
+
+        int inliers = 0;
+        double tolerance = fabs(slope) / 2.0;
+        for (int i = 0; i < mapped; i++) {
+            if (fabs(f[i] - (base + slope * bytes[i])) <= tolerance) inliers++;
+        }
+        if (slope > 0.0 && inliers * 10 >= mapped * 8) {
+            estimate->mapping_found = true;
+            estimate->base_frequency = base;
+            estimate->frequency_range = slope * 255.0;
+            estimate->confidence *= (double)inliers / mapped;
+        }
+    }
+
+    free(starts);
+    free(lengths);
+    free(gaps);
+    free(breaks);
+    return true;
+}
+
+bool mbx_estimate_fits(const mbx_estimate_t *estimate, double symbol_samples)
+{
+    double difference = estimate->symbol_samples - symbol_samples;
+    if (fabs(difference) <= 1.0) return true;
+    if (!estimate->merged || estimate->quantum_samples < 2.0 || difference < 0.0) return false;
+
+    double steps = floor(difference / estimate->quantum_samples + 0.5);
+    return fabs(difference - steps * estimate->quantum_samples) <= 1.5;
+}
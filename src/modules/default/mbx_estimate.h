@@ -0,0 +1,81 @@
+/**
+ * @file mbx_estimate.h
+ * @brief Blind estimation of SONAR tone parameters from audio alone
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * dSONAR needs the encoder's symbol length, frequency map and run quantum
+ * to decode a WAV. When those are not known, one pass over a prefix of the
+ * audio recovers them:
+ *
+ * - Symbol length: plain streams restart every tone, which breaks the
+ *   two-term recurrence x[n] = c x[n-1] - x[n-2] that a pure tone obeys.
+ *   Break positions are scored against candidate lattices k * N. Run-merged
+ *   streams are segmented at their silent gaps instead: the shortest
+ *   recurring tone length gives the symbol length. The encoder truncates
+ *   each tone to whole samples, so a tone k quanta longer pins the run
+ *   quantum down to within about a sample / k; the longest tones of the
+ *   prefix set the final interval (the gap length stands in when there
+ *   are none). A prefix without single-byte tones gives a length that is
+ *   a whole number of quanta too long, so callers should keep a symbol
+ *   length that fits the k * quantum lattice (mbx_estimate_fits).
+ * - Frequency map: each symbol's frequency comes from a least-squares fit
+ *   of the recurrence (or the peak of a coarse spectrum scan if the tone
+ *   has harmonics), and its amplitude from a least-squares sinusoid fit.
+ *   SONAR derives the amplitude from the byte value, so the amplitudes give
+ *   byte values, and a linear regression of frequency on byte value gives
+ *   the base frequency and range.
+ * - Harmonic structure: energy at twice and three times each symbol's
+ *   frequency relative to the fundamental.
+ */
+
+#ifndef MBX_ESTIMATE_H
+#define MBX_ESTIMATE_H
+#include <stdbool.h>
+
+#define MBX_ESTIMATE_MAX_SYMBOLS 64  /**< Symbols analysed for the frequency map */
+
+/**
+ * @brief Parameters recovered from a prefix of SONAR audio
+ */
+typedef struct {
+    bool merged;               /**< Run-merged stream (tones separated by silent gaps) */
+    int symbol_samples;        /**< Samples per symbol, 0 if not found */
+    double quantum_samples;    /**< Extra samples per repeated byte in merged streams (0 if unknown) */
+    double quantum_error;      /**< Half-width of the interval quantum_samples is known to within */
+    bool mapping_found;        /**< base_frequency and frequency_range were solved */
+    double base_frequency;     /**< Frequency of byte 0 in Hz */
+    double frequency_range;    /**< Frequency span from byte 0 to byte 255 in Hz */
+    double low_frequency;      /**< Lowest occupied frequency in the coarse spectrum histogram in Hz */
+    double high_frequency;     /**< Highest occupied frequency in the coarse spectrum histogram in Hz */
+    double harmonic_ratio;     /**< Mean power at 2f and 3f relative to the fundamental */
+    int symbols_used;          /**< Symbols analysed */
+    double confidence;         /**< Fraction of observations consistent with the estimate (0.0-1.0) */
+} mbx_estimate_t;
+
+/**
+ * @brief Estimate tone parameters from 16-bit mono PCM
+ *
+ * @param samples PCM samples from the start of the audio data
+ * @param count Number of samples
+ * @param sample_rate Sample rate in Hz
+ * @param estimate Output parameters
+ * @return true if at least the symbol length was found
+ */
+bool mbx_estimate_tones(const short *samples, int count, int sample_rate, mbx_estimate_t *estimate);
+
+/**
+ * @brief Check whether a symbol length could have produced the estimated stream
+ *
+ * Plain streams need the estimated length (within a sample). Merged
+ * streams also accept a shorter length that differs from the estimate by
+ * a whole number of run quanta, since the prefix may hold no single-byte
+ * tone.
+ *
+ * @param estimate Result of mbx_estimate_tones
+ * @param symbol_samples Symbol length to check in samples
+ * @return true if the stream is consistent with the length
+ */
+bool mbx_estimate_fits(const mbx_estimate_t *estimate, double symbol_samples);
+
+#endif
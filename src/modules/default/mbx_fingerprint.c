@@ -0,0 +1,785 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_fingerprint.h"
+#include "mbx_dsonar.h"
+#include "mbx_checkpoint.h"
+#include "mbx_endian.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// A peak is the loudest point within PEAK_BINS bins, and ONSET_DB louder than
+// that neighbourhood was in each of the PEAK_FRAMES frames before it
+#define PEAK_FRAMES 2
+#define PEAK_BINS 3
+#define PEAK_RING (PEAK_FRAMES + 1)
+#define ONSET_DB 6.0
+// Peaks more than this far below the frame's loudest point are ignored
+#define PEAK_RANGE_DB 40.0
+
+// Samples read from a WAV file at a time (per channel)
+#define WAV_BLOCK 4096
+
+#define INDEX_HEADER_BYTES 32
+#define INDEX_DIRECTORY_ENTRIES 65537
+#define INDEX_POSTING_BYTES 12
+#define INDEX_FILE_BYTES 16
+
+typedef struct {
+    uint32_t frame;
+    uint16_t bin;
+    float level;
+} spectral_peak_t;
+
+// Spectrogram state: the window of samples being framed and the last few frames' levels
+typedef struct {
+    double window[MBX_FINGERPRINT_FFT_SIZE];
+    double cosines[MBX_FINGERPRINT_FFT_SIZE / 2];
+    double sines[MBX_FINGERPRINT_FFT_SIZE / 2];
+    unsigned short reverse[MBX_FINGERPRINT_FFT_SIZE];
+    double re[MBX_FINGERPRINT_FFT_SIZE];
+    double im[MBX_FINGERPRINT_FFT_SIZE];
+    float level[PEAK_RING][MBX_FINGERPRINT_BINS];  /**< dB relative to a full-scale sine */
+    float nearby[PEAK_RING][MBX_FINGERPRINT_BINS]; /**< Loudest level within PEAK_BINS bins */
+    short samples[MBX_FINGERPRINT_FFT_SIZE];
+    size_t filled;
+    uint32_t frames;
+    double reference;
+    spectral_peak_t *peaks;
+    size_t peak_count;
+    size_t peak_capacity;
+    bool failed;
+} extractor_t;
+
+static extractor_t *extractor_create(void)
+{
+    extractor_t *ex = calloc(1, sizeof(extractor_t));
+    if (!ex) return NULL;
+
+    const int n = MBX_FINGERPRINT_FFT_SIZE;
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+    double window_sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        ex->window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / n);
+        window_sum += ex->window[i];
+        unsigned int r = 0;
+        for (int b = 0; b < bits; b++) r |= ((i >> b) & 1u) << (bits - 1 - b);
+        ex->reverse[i] = (unsigned short)r;
+    }
+    for (int k = 0; k < n / 2; k++) {
+        ex->cosines[k] = cos(2.0 * M_PI * k / n);
+        ex->sines[k] = sin(2.0 * M_PI * k / n);
+    }
+    // A full-scale sine at a bin centre has magnitude 32767 * (window sum) / 2
+    ex->reference = 20.0 * log10(32767.0 * window_sum / 2.0);
+    return ex;
+}
+
+static void extractor_free(extractor_t *ex)
+{
+    if (!ex) return;
+    free(ex->peaks);
+    free(ex);
+}
+
+// Iterative radix-2 FFT of re/im in place
+static void transform(extractor_t *ex)
+{
+    const int n = MBX_FINGERPRINT_FFT_SIZE;
+    for (int i = 0; i < n; i++) {
+        int j = ex->reverse[i];
+        if (j > i) {
+            double t = ex->re[i];
+            ex->re[i] = ex->re[j];
+            ex->re[j] = t;
+            t = ex->im[i];
+            ex->im[i] = ex->im[j];
+            ex->im[j] = t;
+        }
+    }
+    for (int size = 2; size <= n; size *= 2) {
+        int half = size / 2, step = n / size;
+        for (int start = 0; start < n; start += size) {
+            for (int k = 0; k < half; k++) {
+                double wr = ex->cosines[k * step], wi = -ex->sines[k * step];
+                int a = start + k, b = a + half;
+                double tr = ex->re[b] * wr - ex->im[b] * wi;
+                double ti = ex->re[b] * wi + ex->im[b] * wr;
+                ex->re[b] = ex->re[a] - tr;
+                ex->im[b] = ex->im[a] - ti;
+                ex->re[a] += tr;
+                ex->im[a] += ti;
+            }
+        }
+    }
+}
+
+static void add_peak(extractor_t *ex, uint32_t frame, int bin, float level)
+{
+    if (ex->peak_count == ex->peak_capacity) {
+        size_t capacity = ex->peak_capacity ? ex->peak_capacity * 2 : 4096;
+        spectral_peak_t *peaks = realloc(ex->peaks, capacity * sizeof(*peaks));
+        if (!peaks) {
+            ex->failed = true;
+            return;
+        }
+        ex->peaks = peaks;
+        ex->peak_capacity = capacity;
+    }
+    ex->peaks[ex->peak_count].frame = frame;
+    ex->peaks[ex->peak_count].bin = (uint16_t)bin;
+    ex->peaks[ex->peak_count].level = level;
+    ex->peak_count++;
+}
+
+/*
+ * Keep the strongest onsets of frame c. Requiring a rise over the frames
+ * before (rather than a maximum over frames after) gives a steady tone one
+ * peak where it starts, wherever noise puts its loudest frame. Ties between
+ * bins go to the lowest.
+ */
+static void find_peaks(extractor_t *ex, uint32_t c)
+{
+    const float *level = ex->level[c % PEAK_RING];
+    const float *nearby = ex->nearby[c % PEAK_RING];
+    uint32_t first = c >= PEAK_FRAMES ? c - PEAK_FRAMES : 0;
+
+    float loudest = level[1];
+    for (int k = 2; k < MBX_FINGERPRINT_BINS; k++) {
+        if (level[k] > loudest) loudest = level[k];
+    }
+    float floor_level = loudest - PEAK_RANGE_DB;
+    if (floor_level < MBX_FINGERPRINT_MIN_LEVEL) floor_level = MBX_FINGERPRINT_MIN_LEVEL;
+
+    int best_bin[MBX_FINGERPRINT_PEAKS_PER_FRAME];
+    float best_level[MBX_FINGERPRINT_PEAKS_PER_FRAME];
+    int found = 0;
+
+    for (int k = 1; k < MBX_FINGERPRINT_BINS; k++) {
+        float value = level[k];
+        if (value < floor_level || value < nearby[k]) continue;
+
+        bool peak = true;
+        for (int j = 1; j <= PEAK_BINS && peak && k - j >= 0; j++) peak = value > level[k - j];
+        for (uint32_t t = first; t < c && peak; t++) peak = value >= ex->nearby[t % PEAK_RING][k] + ONSET_DB;
+        if (!peak) continue;
+
+        // Insertion into the short list of the frame's strongest peaks
+        if (found == MBX_FINGERPRINT_PEAKS_PER_FRAME && value <= best_level[found - 1]) continue;
+        int position = found < MBX_FINGERPRINT_PEAKS_PER_FRAME ? found++ : found - 1;
+        while (position > 0 && best_level[position - 1] < value) {
+            best_level[position] = best_level[position - 1];
+            best_bin[position] = best_bin[position - 1];
+            position--;
+        }
+        best_level[position] = value;
+        best_bin[position] = k;
+    }
+
+    for (int i = 0; i < found; i++) add_peak(ex, c, best_bin[i], best_level[i]);
+}
+
+// Spectrum of the buffered samples as the next frame, and its peaks
+static void analyse_frame(extractor_t *ex)
+{
+    for (int i = 0; i < MBX_FINGERPRINT_FFT_SIZE; i++) {
+        ex->re[i] = ex->samples[i] * ex->window[i];
+        ex->im[i] = 0.0;
+    }
+    transform(ex);
+
+    uint32_t frame = ex->frames++;
+    float *level = ex->level[frame % PEAK_RING];
+    float *nearby = ex->nearby[frame % PEAK_RING];
+    for (int k = 0; k < MBX_FINGERPRINT_BINS; k++) {
+        double power = ex->re[k] * ex->re[k] + ex->im[k] * ex->im[k];
+        level[k] = (float)(10.0 * log10(power + 1e-9) - ex->reference);
+    }
+    for (int k = 0; k < MBX_FINGERPRINT_BINS; k++) {
+        float loudest = level[k];
+        int low = k > PEAK_BINS ? k - PEAK_BINS : 0;
+        int high = k + PEAK_BINS < MBX_FINGERPRINT_BINS - 1 ? k + PEAK_BINS : MBX_FINGERPRINT_BINS - 1;
+        for (int j = low; j <= high; j++) {
+            if (level[j] > loudest) loudest = level[j];
+        }
+        nearby[k] = loudest;
+    }
+
+    find_peaks(ex, frame);
+}
+
+static void extractor_feed(extractor_t *ex, const short *samples, size_t count)
+{
+    while (count > 0) {
+        size_t take = MBX_FINGERPRINT_FFT_SIZE - ex->filled;
+        if (take > count) take = count;
+        memcpy(ex->samples + ex->filled, samples, take * sizeof(short));
+        ex->filled += take;
+        samples += take;
+        count -= take;
+
+        if (ex->filled == MBX_FINGERPRINT_FFT_SIZE) {
+            analyse_frame(ex);
+            memmove(ex->samples, ex->samples + MBX_FINGERPRINT_HOP,
+                    (MBX_FINGERPRINT_FFT_SIZE - MBX_FINGERPRINT_HOP) * sizeof(short));
+            ex->filled = MBX_FINGERPRINT_FFT_SIZE - MBX_FINGERPRINT_HOP;
+        }
+    }
+}
+
+// Pairs are packed with the distance in bits 0-5 and the bins in bits 6-14 and
+// 16-24, then mixed so the top bits spread them over the directory
+#define DISTANCE_MASK 0x3Fu
+
+static uint32_t mix_hash(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// Inverse of mix_hash
+static uint32_t unmix_hash(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x7ED1B41Du;
+    hash ^= hash >> 13 ^ hash >> 26;
+    hash *= 0xA5CB9243u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static uint32_t pair_hash(unsigned int anchor_bin, unsigned int bin, unsigned int distance)
+{
+    return mix_hash((uint32_t)anchor_bin << 16 | (uint32_t)bin << 6 | distance);
+}
+
+// Pair every peak with the next ones in its zone
+static bool extractor_finish(extractor_t *ex, int sample_rate, mbx_fingerprint_t *fingerprint)
+{
+    if (ex->failed) return false;
+
+    memset(fingerprint, 0, sizeof(*fingerprint));
+    fingerprint->frames = ex->frames;
+    fingerprint->peaks = ex->peak_count;
+    fingerprint->sample_rate = sample_rate;
+    if (ex->peak_count == 0) return true;
+
+    fingerprint->capacity = ex->peak_count * MBX_FINGERPRINT_FAN_OUT;
+    fingerprint->hashes = malloc(fingerprint->capacity * sizeof(mbx_fingerprint_hash_t));
+    if (!fingerprint->hashes) return false;
+
+    for (size_t i = 0; i < ex->peak_count; i++) {
+        const spectral_peak_t *anchor = &ex->peaks[i];
+        int paired = 0;
+        for (size_t j = i + 1; j < ex->peak_count && paired < MBX_FINGERPRINT_FAN_OUT; j++) {
+            uint32_t distance = ex->peaks[j].frame - anchor->frame;
+            if (distance > MBX_FINGERPRINT_ZONE) break;
+            if (distance == 0) continue;
+            mbx_fingerprint_hash_t *hash = &fingerprint->hashes[fingerprint->count++];
+            hash->hash = pair_hash(anchor->bin, ex->peaks[j].bin, distance);
+            hash->frame = anchor->frame;
+            paired++;
+        }
+    }
+    return true;
+}
+
+bool mbx_fingerprint_samples(const short *samples, size_t count, int sample_rate, mbx_fingerprint_t *fingerprint)
+{
+    memset(fingerprint, 0, sizeof(*fingerprint));
+    extractor_t *ex = extractor_create();
+    if (!ex) return false;
+    extractor_feed(ex, samples, count);
+    bool ok = extractor_finish(ex, sample_rate, fingerprint);
+    extractor_free(ex);
+    return ok;
+}
+
+bool mbx_fingerprint_wav(const char *filename, mbx_fingerprint_t *fingerprint)
+{
+    memset(fingerprint, 0, sizeof(*fingerprint));
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        printf("Error: Could not open %s\n", filename);
+        return false;
+    }
+
+    int sample_rate, channels, bits_per_sample;
+    if (!read_wav_header(file, &sample_rate, &channels, &bits_per_sample) || bits_per_sample != 16 ||
+        channels < 1 || sample_rate <= 0) {
+        printf("Error: %s is not a 16-bit PCM WAV file\n", filename);
+        fclose(file);
+        return false;
+    }
+
+    extractor_t *ex = extractor_create();
+    short *block = malloc((size_t)WAV_BLOCK * channels * sizeof(short));
+    short mono[WAV_BLOCK];
+    bool ok = ex && block;
+    size_t got;
+    while (ok && (got = fread(block, sizeof(short) * channels, WAV_BLOCK, file)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            int sum = 0;
+            for (int c = 0; c < channels; c++) sum += block[i * channels + c];
+            mono[i] = (short)(sum / channels);
+        }
+        extractor_feed(ex, mono, got);
+    }
+    fclose(file);
+    free(block);
+
+    ok = ok && extractor_finish(ex, sample_rate, fingerprint);
+    extractor_free(ex);
+    return ok;
+}
+
+void mbx_fingerprint_free(mbx_fingerprint_t *fingerprint)
+{
+    free(fingerprint->hashes);
+    memset(fingerprint, 0, sizeof(*fingerprint));
+}
+
+static const char *file_name(const mbx_fingerprint_index_t *index, uint32_t file)
+{
+    uint32_t offset = mbx_get_le32(index->files + (size_t)file * INDEX_FILE_BYTES);
+    return offset < index->names_size ? index->names + offset : "";
+}
+
+// Check the header and that the sections exactly fill the file
+static bool index_layout(mbx_fingerprint_index_t *index)
+{
+    const uint8_t *data = index->data;
+    if (index->size < INDEX_HEADER_BYTES + INDEX_DIRECTORY_ENTRIES * 4 || memcmp(data, "MBXAFPIX", 8) != 0 ||
+        mbx_get_le32(data + 8) != MBX_FINGERPRINT_INDEX_VERSION ||
+        mbx_get_le32(data + 24) != MBX_FINGERPRINT_FFT_SIZE || mbx_get_le32(data + 28) != MBX_FINGERPRINT_HOP) {
+        return false;
+    }
+    index->file_count = mbx_get_le32(data + 12);
+    index->posting_count = mbx_get_le32(data + 16);
+    index->names_size = mbx_get_le32(data + 20);
+
+    uint64_t expected = INDEX_HEADER_BYTES + (uint64_t)INDEX_DIRECTORY_ENTRIES * 4 +
+                        (uint64_t)index->posting_count * INDEX_POSTING_BYTES +
+                        (uint64_t)index->file_count * INDEX_FILE_BYTES + index->names_size;
+    if (expected != index->size) return false;
+
+    index->directory = data + INDEX_HEADER_BYTES;
+    index->postings = index->directory + INDEX_DIRECTORY_ENTRIES * 4;
+    index->files = index->postings + (size_t)index->posting_count * INDEX_POSTING_BYTES;
+    index->names = (const char *)(index->files + (size_t)index->file_count * INDEX_FILE_BYTES);
+    if (index->names_size == 0 ? index->file_count > 0 : index->names[index->names_size - 1] != '\0') return false;
+    return mbx_get_le32(index->directory + (INDEX_DIRECTORY_ENTRIES - 1) * 4) == index->posting_count;
+}
+
+bool mbx_fingerprint_index_open(mbx_fingerprint_index_t *index, const char *filename)
+{
+    memset(index, 0, sizeof(*index));
+    snprintf(index->filename, sizeof(index->filename), "%s", filename);
+
+#ifdef _WIN32
+    FILE *file = fopen(filename, "rb");
+    if (!file) return true;
+    bool ok = fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? ftell(file) : -1;
+    ok = size > 0 && fseek(file, 0, SEEK_SET) == 0;
+    uint8_t *data = ok ? malloc((size_t)size) : NULL;
+    ok = data && fread(data, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    index->data = data;
+    index->size = ok ? (size_t)size : 0;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return true;
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0 && info.st_size > 0;
+    void *data = ok ? mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    ok = data != MAP_FAILED;
+    if (ok) {
+        index->data = data;
+        index->size = (size_t)info.st_size;
+        index->mapped = true;
+    }
+#endif
+
+    if (!ok || !index_layout(index)) {
+        printf("Error: %s is not a valid fingerprint index\n", filename);
+        mbx_fingerprint_index_close(index);
+        return false;
+    }
+    return true;
+}
+
+void mbx_fingerprint_index_close(mbx_fingerprint_index_t *index)
+{
+#ifdef _WIN32
+    free((void *)index->data);
+#else
+    if (index->mapped) munmap((void *)index->data, index->size);
+#endif
+    index->data = NULL;
+    index->size = 0;
+    index->mapped = false;
+    index->file_count = 0;
+    index->posting_count = 0;
+}
+
+static int compare_hashes(const void *a, const void *b)
+{
+    const mbx_fingerprint_hash_t *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return (x->frame > y->frame) - (x->frame < y->frame);
+}
+
+static bool write_posting(FILE *file, uint32_t hash, uint32_t id, uint32_t frame)
+{
+    uint8_t record[INDEX_POSTING_BYTES];
+    mbx_put_le32(record, hash);
+    mbx_put_le32(record + 4, id);
+    mbx_put_le32(record + 8, frame);
+    return fwrite(record, 1, sizeof(record), file) == sizeof(record);
+}
+
+bool mbx_fingerprint_index_add(const mbx_fingerprint_index_t *index, const char *path,
+                               const mbx_fingerprint_t *fingerprint)
+{
+    // An earlier fingerprint under the same path is dropped; later files move down one number
+    uint32_t replaced = UINT32_MAX;
+    for (uint32_t f = 0; f < index->file_count && replaced == UINT32_MAX; f++) {
+        if (strcmp(file_name(index, f), path) == 0) replaced = f;
+    }
+    uint32_t new_id = index->file_count - (replaced != UINT32_MAX);
+
+    mbx_fingerprint_hash_t *added = malloc((fingerprint->count + 1) * sizeof(*added));
+    uint32_t *directory = calloc(INDEX_DIRECTORY_ENTRIES, sizeof(uint32_t));
+    if (!added || !directory) {
+        free(added);
+        free(directory);
+        return false;
+    }
+    memcpy(added, fingerprint->hashes, fingerprint->count * sizeof(*added));
+    qsort(added, fingerprint->count, sizeof(*added), compare_hashes);
+
+    // Postings per top-16-bit value, then running totals
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < index->posting_count; i++) {
+        const uint8_t *posting = index->postings + (size_t)i * INDEX_POSTING_BYTES;
+        if (mbx_get_le32(posting + 4) == replaced) continue;
+        directory[(mbx_get_le32(posting) >> 16) + 1]++;
+        total++;
+    }
+    for (size_t i = 0; i < fingerprint->count; i++) directory[(added[i].hash >> 16) + 1]++;
+    total += fingerprint->count;
+    for (uint32_t i = 1; i < INDEX_DIRECTORY_ENTRIES; i++) directory[i] += directory[i - 1];
+
+    size_t names_size = 0;
+    for (uint32_t f = 0; f < index->file_count; f++) {
+        if (f != replaced) names_size += strlen(file_name(index, f)) + 1;
+    }
+    names_size += strlen(path) + 1;
+    if (total > UINT32_MAX || names_size > UINT32_MAX) {
+        printf("Error: Fingerprint index %s is full\n", index->filename);
+        free(added);
+        free(directory);
+        return false;
+    }
+
+    char temp_filename[272];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", index->filename);
+    FILE *file = fopen(temp_filename, "wb");
+    bool ok = file != NULL;
+
+    uint8_t header[INDEX_HEADER_BYTES] = {'M', 'B', 'X', 'A', 'F', 'P', 'I', 'X'};
+    mbx_put_le32(header + 8, MBX_FINGERPRINT_INDEX_VERSION);
+    mbx_put_le32(header + 12, new_id + 1);
+    mbx_put_le32(header + 16, (uint32_t)total);
+    mbx_put_le32(header + 20, (uint32_t)names_size);
+    mbx_put_le32(header + 24, MBX_FINGERPRINT_FFT_SIZE);
+    mbx_put_le32(header + 28, MBX_FINGERPRINT_HOP);
+    ok = ok && fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    for (uint32_t i = 0; ok && i < INDEX_DIRECTORY_ENTRIES; i++) {
+        uint8_t entry[4];
+        mbx_put_le32(entry, directory[i]);
+        ok = fwrite(entry, 1, sizeof(entry), file) == sizeof(entry);
+    }
+
+    // Merge the old postings with the new recording's; for equal hashes the new file's higher number comes last
+    uint32_t old = 0;
+    size_t next = 0;
+    while (ok && (old < index->posting_count || next < fingerprint->count)) {
+        const uint8_t *posting = old < index->posting_count ? index->postings + (size_t)old * INDEX_POSTING_BYTES : NULL;
+        if (posting && mbx_get_le32(posting + 4) == replaced) {
+            old++;
+            continue;
+        }
+        if (posting && (next == fingerprint->count || mbx_get_le32(posting) <= added[next].hash)) {
+            uint32_t id = mbx_get_le32(posting + 4);
+            ok = write_posting(file, mbx_get_le32(posting), id - (replaced != UINT32_MAX && id > replaced),
+                               mbx_get_le32(posting + 8));
+            old++;
+        } else {
+            ok = write_posting(file, added[next].hash, new_id, added[next].frame);
+            next++;
+        }
+    }
+
+    // File records and the name pool, in file number order
+    uint32_t name_offset = 0;
+    for (uint32_t f = 0; ok && f <= index->file_count; f++) {
+        if (f == replaced) continue;
+        uint8_t record[INDEX_FILE_BYTES];
+        const uint8_t *source = f < index->file_count ? index->files + (size_t)f * INDEX_FILE_BYTES : NULL;
+        mbx_put_le32(record, name_offset);
+        mbx_put_le32(record + 4, source ? mbx_get_le32(source + 4) : fingerprint->frames);
+        mbx_put_le32(record + 8, source ? mbx_get_le32(source + 8) : (uint32_t)fingerprint->sample_rate);
+        mbx_put_le32(record + 12, source ? mbx_get_le32(source + 12) : (uint32_t)fingerprint->count);
+        ok = fwrite(record, 1, sizeof(record), file) == sizeof(record);
+        name_offset += (uint32_t)strlen(source ? file_name(index, f) : path) + 1;
+    }
+    for (uint32_t f = 0; ok && f <= index->file_count; f++) {
+        if (f == replaced) continue;
+        const char *name = f < index->file_count ? file_name(index, f) : path;
+        ok = fwrite(name, 1, strlen(name) + 1, file) == strlen(name) + 1;
+    }
+
+    free(added);
+    free(directory);
+    if (file && fclose(file) != 0) ok = false;
+    ok = ok && mbx_checkpoint_sync_file(temp_filename) && mbx_checkpoint_replace_file(temp_filename, index->filename);
+    if (!ok) {
+        remove(temp_filename);
+        printf("Error: Could not write fingerprint index %s\n", index->filename);
+    }
+    return ok;
+}
+
+// Votes per (file, offset) in an open-addressed table that doubles when half full
+typedef struct {
+    uint64_t key;
+    uint32_t votes;
+} vote_t;
+
+typedef struct {
+    vote_t *slots;
+    size_t mask;
+    size_t used;
+} vote_table_t;
+
+static uint64_t vote_key(uint32_t file, int64_t offset)
+{
+    return (uint64_t)file << 32 | (uint32_t)(int32_t)offset;
+}
+
+static size_t vote_slot(const vote_table_t *table, uint64_t key)
+{
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    size_t slot = (size_t)(hash >> 32) & table->mask;
+    while (table->slots[slot].votes != 0 && table->slots[slot].key != key) slot = (slot + 1) & table->mask;
+    return slot;
+}
+
+static bool vote_add(vote_table_t *table, uint64_t key)
+{
+    if (2 * (table->used + 1) > table->mask + 1) {
+        vote_table_t grown = {calloc(2 * (table->mask + 1), sizeof(vote_t)), 2 * table->mask + 1, table->used};
+        if (!grown.slots) return false;
+        for (size_t i = 0; i <= table->mask; i++) {
+            if (table->slots[i].votes != 0) grown.slots[vote_slot(&grown, table->slots[i].key)] = table->slots[i];
+        }
+        free(table->slots);
+        *table = grown;
+    }
+    size_t slot = vote_slot(table, key);
+    if (table->slots[slot].votes == 0) {
+        table->slots[slot].key = key;
+        table->used++;
+    }
+    table->slots[slot].votes++;
+    return true;
+}
+
+static uint32_t vote_count(const vote_table_t *table, uint64_t key)
+{
+    return table->slots[vote_slot(table, key)].votes;
+}
+
+// First posting in [low, high) whose hash is not below the given one
+static uint32_t lower_bound(const mbx_fingerprint_index_t *index, uint32_t low, uint32_t high, uint32_t hash)
+{
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (mbx_get_le32(index->postings + (size_t)middle * INDEX_POSTING_BYTES) < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Vote for the offset of every posting of a hash, unless the hash is too common to tell anything
+static bool vote_hash(const mbx_fingerprint_index_t *index, vote_table_t *votes, uint32_t hash, uint32_t frame,
+                      size_t *skipped)
+{
+    uint32_t top = hash >> 16;
+    uint32_t low = mbx_get_le32(index->directory + (size_t)top * 4);
+    uint32_t high = mbx_get_le32(index->directory + (size_t)(top + 1) * 4);
+    if (high > index->posting_count || low > high) return true;
+
+    uint32_t first = lower_bound(index, low, high, hash);
+    uint32_t last = hash == UINT32_MAX ? high : lower_bound(index, first, high, hash + 1);
+    if (last - first > MBX_FINGERPRINT_MAX_POSTINGS) {
+        if (skipped) (*skipped)++;
+        return true;
+    }
+    for (uint32_t p = first; p < last; p++) {
+        const uint8_t *posting = index->postings + (size_t)p * INDEX_POSTING_BYTES;
+        uint32_t file = mbx_get_le32(posting + 4);
+        if (file >= index->file_count) continue;
+        if (!vote_add(votes, vote_key(file, (int64_t)mbx_get_le32(posting + 8) - frame))) return false;
+    }
+    return true;
+}
+
+size_t mbx_fingerprint_index_query(const mbx_fingerprint_index_t *index, const mbx_fingerprint_t *fingerprint,
+                                   mbx_fingerprint_match_t *matches, size_t k, size_t *skipped)
+{
+    if (skipped) *skipped = 0;
+    if (index->file_count == 0 || fingerprint->count == 0 || k == 0) return 0;
+
+    vote_table_t votes = {calloc(1024, sizeof(vote_t)), 1023, 0};
+    mbx_fingerprint_match_t *best = calloc(index->file_count, sizeof(*best));
+    if (!votes.slots || !best) {
+        free(votes.slots);
+        free(best);
+        return 0;
+    }
+
+    // Onsets in the clip can land a frame earlier or later than in the recording, so the
+    // pair distances either side are looked up as well
+    bool ok = true;
+    for (size_t i = 0; ok && i < fingerprint->count; i++) {
+        const mbx_fingerprint_hash_t *query = &fingerprint->hashes[i];
+        uint32_t pair = unmix_hash(query->hash);
+        uint32_t distance = pair & DISTANCE_MASK;
+        for (uint32_t d = distance - 1; ok && d <= distance + 1; d++) {
+            if (d == 0 || d > MBX_FINGERPRINT_ZONE) continue;
+            ok = vote_hash(index, &votes, mix_hash((pair & ~DISTANCE_MASK) | d), query->frame,
+                           d == distance ? skipped : NULL);
+        }
+    }
+
+    // Frames of clip and recording can fall up to one frame apart, so neighbouring offsets vote together
+    for (size_t s = 0; ok && s <= votes.mask; s++) {
+        const vote_t *vote = &votes.slots[s];
+        if (vote->votes == 0) continue;
+        uint32_t file = (uint32_t)(vote->key >> 32);
+        int64_t offset = (int32_t)(uint32_t)vote->key;
+        uint32_t before = vote_count(&votes, vote_key(file, offset - 1));
+        uint32_t after = vote_count(&votes, vote_key(file, offset + 1));
+        uint32_t score = vote->votes + (before > after ? before : after);
+        mbx_fingerprint_match_t *match = &best[file];
+        if (score > match->score || (score == match->score && offset < match->offset_frames)) {
+            match->score = score;
+            match->offset_frames = before > vote->votes ? offset - 1 : offset;
+        }
+    }
+
+    size_t found = 0;
+    for (uint32_t f = 0; ok && f < index->file_count; f++) {
+        if (best[f].score < MBX_FINGERPRINT_MIN_SCORE) continue;
+        if (found == k && best[f].score <= matches[k - 1].score) continue;
+        best[f].file = f;
+        best[f].path = file_name(index, f);
+        best[f].sample_rate = (int)mbx_get_le32(index->files + (size_t)f * INDEX_FILE_BYTES + 8);
+
+        size_t position = found < k ? found++ : k - 1;
+        while (position > 0 && matches[position - 1].score < best[f].score) {
+            matches[position] = matches[position - 1];
+            position--;
+        }
+        matches[position] = best[f];
+    }
+
+    free(votes.slots);
+    free(best);
+    return ok ? found : 0;
+}
+
+bool mbx_fingerprint_add_wav(const char *wav_filename, const char *index_filename)
+{
+    mbx_fingerprint_t fingerprint;
+    if (!mbx_fingerprint_wav(wav_filename, &fingerprint)) return false;
+    printf("[FINGERPRINT] %s: %.1f s, %zu peaks, %zu hashes\n", wav_filename,
+           (double)fingerprint.frames * MBX_FINGERPRINT_HOP / fingerprint.sample_rate, fingerprint.peaks,
+           fingerprint.count);
+
+    mbx_fingerprint_index_t index;
+    bool ok = mbx_fingerprint_index_open(&index, index_filename);
+    ok = ok && mbx_fingerprint_index_add(&index, wav_filename, &fingerprint);
+    mbx_fingerprint_index_close(&index);
+    mbx_fingerprint_free(&fingerprint);
+
+    if (ok && mbx_fingerprint_index_open(&index, index_filename)) {
+        printf("[INDEX] %s now holds %u recordings, %u hashes (%.1f MiB)\n", index_filename, index.file_count,
+               index.posting_count, index.size / (1024.0 * 1024.0));
+        mbx_fingerprint_index_close(&index);
+    }
+    return ok;
+}
+
+bool mbx_fingerprint_locate_wav(const char *wav_filename, const char *index_filename)
+{
+    mbx_fingerprint_t fingerprint;
+    if (!mbx_fingerprint_wav(wav_filename, &fingerprint)) return false;
+
+    mbx_fingerprint_index_t index;
+    if (!mbx_fingerprint_index_open(&index, index_filename)) {
+        mbx_fingerprint_free(&fingerprint);
+        return false;
+    }
+
+    clock_t start = clock();
+    mbx_fingerprint_match_t matches[MBX_FINGERPRINT_RESULTS];
+    size_t skipped;
+    size_t found = mbx_fingerprint_index_query(&index, &fingerprint, matches, MBX_FINGERPRINT_RESULTS, &skipped);
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("[LOCATE] %s: %.1f s, %zu hashes (%zu too common to use)\n", wav_filename,
+           (double)fingerprint.frames * MBX_FINGERPRINT_HOP / fingerprint.sample_rate, fingerprint.count, skipped);
+    printf("\n=== Matches in %s (%u recordings) ===\n", index_filename, index.file_count);
+    if (found == 0) {
+        printf("No recording shares %d aligned hashes with the clip\n", MBX_FINGERPRINT_MIN_SCORE);
+    } else {
+        printf("  Score  Offset                          Recording\n");
+    }
+    for (size_t i = 0; i < found; i++) {
+        int64_t sample = matches[i].offset_frames * MBX_FINGERPRINT_HOP;
+        printf("  %5u  %9.3f s (sample %10lld)  %s\n", matches[i].score, (double)sample / matches[i].sample_rate,
+               (long long)sample, matches[i].path);
+    }
+    printf("Lookup: %.1f ms\n", elapsed * 1000.0);
+
+    mbx_fingerprint_index_close(&index);
+    mbx_fingerprint_free(&fingerprint);
+    return true;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file mbx_fingerprint.h
+ * @brief Audio fingerprints for locating a SONAR snippet in its source recording
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Fingerprints audio with constellation hashes: the spectrogram (1024-point
+ * FFT, hop of 512 samples) is reduced to its onsets, points that are the
+ * loudest of their neighbouring bins and clearly louder than those bins were
+ * a frame or two before. Each peak is paired with the next few peaks within
+ * a short time zone. A pair hashes
+ * its two frequency bins and their frame distance, and is stored with the
+ * anchor's frame. A clip cut from a recording shares many hashes with it,
+ * all at the same frame offset, so a vote over (file, offset) finds the
+ * source and the position without decoding anything. A clip's frames do not
+ * line up with the recording's, so peaks can move by a frame; the query also
+ * looks up the pair distances either side and merges neighbouring offsets.
+ *
+ * SONAR repeats the same tones wherever the data repeats a byte pattern, so
+ * hashes that occur in very many places carry little information; the
+ * query skips any hash with more than MBX_FINGERPRINT_MAX_POSTINGS postings.
+ *
+ * The index is a single file that is memory-mapped for queries. Postings
+ * are sorted by hash behind a directory of the top 16 hash bits, so a
+ * lookup is a directory read and a short binary search. Adding a recording
+ * merges its postings into a new index file that replaces the old one.
+ *
+ * Index layout (integers little-endian):
+ * - 32-byte header: "MBXAFPIX", version (u32), file count (u32), posting
+ *   count (u32), name pool size (u32), FFT size (u32), hop (u32)
+ * - directory: 65,537 u32 posting positions, one per top-16-bit hash value
+ *   and one for the end
+ * - postings: 12 bytes each, hash (u32), file (u32), anchor frame (u32),
+ *   sorted by hash, file and frame
+ * - files: 16 bytes each, name pool offset (u32), frames (u32), sample
+ *   rate (u32), hashes (u32)
+ * - name pool: NUL-terminated paths
+ */
+
+#ifndef MBX_FINGERPRINT_H
+#define MBX_FINGERPRINT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBX_FINGERPRINT_FFT_SIZE 1024    /**< Samples per spectrogram frame */
+#define MBX_FINGERPRINT_HOP 512          /**< Samples between frames */
+#define MBX_FINGERPRINT_BINS 512         /**< Frequency bins per frame */
+#define MBX_FINGERPRINT_PEAKS_PER_FRAME 3 /**< Strongest peaks kept per frame */
+#define MBX_FINGERPRINT_FAN_OUT 6        /**< Peaks each anchor is paired with */
+#define MBX_FINGERPRINT_ZONE 48          /**< Frames after an anchor its pair peaks may lie in */
+#define MBX_FINGERPRINT_MIN_LEVEL -60.0  /**< Quietest peak in dB below a full-scale sine */
+#define MBX_FINGERPRINT_MAX_POSTINGS 50000 /**< Hashes more common than this are ignored by queries */
+#define MBX_FINGERPRINT_MIN_SCORE 16     /**< Aligned hashes needed to report a match */
+#define MBX_FINGERPRINT_RESULTS 5        /**< Matches listed by a query */
+#define MBX_FINGERPRINT_INDEX_VERSION 1
+
+/**
+ * @brief One hash of a peak pair
+ */
+typedef struct {
+    uint32_t hash;             /**< Hash of both bins and their frame distance */
+    uint32_t frame;            /**< Frame of the anchor peak */
+} mbx_fingerprint_hash_t;
+
+/**
+ * @brief Fingerprint of a recording
+ */
+typedef struct {
+    mbx_fingerprint_hash_t *hashes; /**< Hashes in anchor order */
+    size_t count;              /**< Number of hashes */
+    size_t capacity;           /**< Allocated hashes */
+    size_t peaks;              /**< Spectrogram peaks found */
+    uint32_t frames;           /**< Spectrogram frames */
+    int sample_rate;           /**< Sample rate of the audio in Hz */
+} mbx_fingerprint_t;
+
+/**
+ * @brief Memory-mapped index
+ */
+typedef struct {
+    char filename[256];        /**< Index file */
+    const uint8_t *data;       /**< Index contents (NULL for an empty index) */
+    size_t size;               /**< Bytes of data */
+    uint32_t file_count;       /**< Recordings in the index */
+    uint32_t posting_count;    /**< Postings in the index */
+    const uint8_t *directory;  /**< Directory of posting positions */
+    const uint8_t *postings;   /**< Sorted postings */
+    const uint8_t *files;      /**< File records */
+    const char *names;         /**< Name pool */
+    uint32_t names_size;       /**< Bytes in the name pool */
+    bool mapped;               /**< data is a mapping rather than a heap copy */
+} mbx_fingerprint_index_t;
+
+/**
+ * @brief A recording that shares aligned hashes with a query
+ */
+typedef struct {
+    uint32_t file;             /**< File number in the index */
+    const char *path;          /**< Path the recording was indexed under */
+    int64_t offset_frames;     /**< Frame of the recording where the query starts */
+    uint32_t score;            /**< Hashes that agree on the offset */
+    int sample_rate;           /**< Sample rate of the recording in Hz */
+} mbx_fingerprint_match_t;
+
+/**
+ * @brief Fingerprint 16-bit PCM audio
+ *
+ * @param samples Mono samples
+ * @param count Number of samples
+ * @param sample_rate Sample rate in Hz
+ * @param fingerprint Output (release with mbx_fingerprint_free)
+ * @return true on success, false on allocation failure
+ */
+bool mbx_fingerprint_samples(const short *samples, size_t count, int sample_rate, mbx_fingerprint_t *fingerprint);
+
+/**
+ * @brief Fingerprint a 16-bit PCM WAV file, reading it in blocks
+ *
+ * Channels are mixed down to mono.
+ *
+ * @param filename WAV file
+ * @param fingerprint Output (release with mbx_fingerprint_free)
+ * @return true on success; false (with an error printed) if the file is not 16-bit PCM WAV
+ */
+bool mbx_fingerprint_wav(const char *filename, mbx_fingerprint_t *fingerprint);
+
+/**
+ * @brief Release a fingerprint
+ *
+ * @param fingerprint Pointer to fingerprint
+ */
+void mbx_fingerprint_free(mbx_fingerprint_t *fingerprint);
+
+/**
+ * @brief Map an index file
+ *
+ * A missing file gives an empty index.
+ *
+ * @param index Index to initialise
+ * @param filename Index file
+ * @return true on success; false (with an error printed) for an unreadable or corrupt index
+ */
+bool mbx_fingerprint_index_open(mbx_fingerprint_index_t *index, const char *filename);
+
+/**
+ * @brief Unmap an index
+ *
+ * @param index Pointer to index
+ */
+void mbx_fingerprint_index_close(mbx_fingerprint_index_t *index);
+
+/**
+ * @brief Write a new index with a recording added (replacing any earlier fingerprint under the same path)
+ *
+ * The new index is written next to the old one and renamed over it, so
+ * readers see either the old or the new index.
+ *
+ * @param index Open index (left open; reopen it to see the new recording)
+ * @param path Name to index the recording under
+ * @param fingerprint Fingerprint of the recording
+ * @return true if the new index is in place
+ */
+bool mbx_fingerprint_index_add(const mbx_fingerprint_index_t *index, const char *path,
+                               const mbx_fingerprint_t *fingerprint);
+
+/**
+ * @brief Find the recordings a clip was cut from
+ *
+ * @param index Open index
+ * @param fingerprint Fingerprint of the clip
+ * @param matches Output, best first (at most one per recording)
+ * @param k Capacity of matches
+ * @param skipped Optional output: query hashes ignored as too common
+ * @return Number of matches with at least MBX_FINGERPRINT_MIN_SCORE aligned hashes
+ */
+size_t mbx_fingerprint_index_query(const mbx_fingerprint_index_t *index, const mbx_fingerprint_t *fingerprint,
+                                   mbx_fingerprint_match_t *matches, size_t k, size_t *skipped);
+
+/**
+ * @brief Fingerprint a WAV file and add it to an index, printing a summary
+ *
+ * @param wav_filename WAV file
+ * @param index_filename Index file (created if missing)
+ * @return true if the index was updated
+ */
+bool mbx_fingerprint_add_wav(const char *wav_filename, const char *index_filename);
+
+/**
+ * @brief Fingerprint a WAV clip and print the recordings and offsets it matches
+ *
+ * @param wav_filename WAV clip
+ * @param index_filename Index file
+ * @return true if the query ran (whether or not anything matched)
+ */
+bool mbx_fingerprint_locate_wav(const char *wav_filename, const char *index_filename);
+
+#endif
@@ -0,0 +1,123 @@
+#include "mbx_freqplan.h"
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Blocks shorter than this cannot be classified reliably
+#define FREQPLAN_MIN_DETECT_SAMPLES 16
+
+// Bin range [*low, *high] inside the band for symbol length n
+static int band_bins(int sample_rate, int n, double min_frequency, double max_frequency, int *low, int *high)
+{
+    *low = (int)ceil(min_frequency * n / sample_rate);
+    *high = (int)floor(max_frequency * n / sample_rate);
+    if (*low < 1) *low = 1;                         // never use DC
+    if (*high > (n - 1) / 2) *high = (n - 1) / 2;   // stay strictly below Nyquist
+    return *high >= *low ? *high - *low + 1 : 0;
+}
+
+bool mbx_freqplan_init(mbx_freqplan_t *plan, int sample_rate, int symbol_samples,
+                       double min_frequency, double max_frequency)
+{
+    if (!plan || sample_rate <= 0 || symbol_samples <= 0) return false;
+
+    int low, high;
+    int available = band_bins(sample_rate, symbol_samples, min_frequency, max_frequency, &low, &high);
+    if (available < MBX_FREQPLAN_TONES) return false;
+
+    memset(plan, 0, sizeof(*plan));
+    plan->sample_rate = sample_rate;
+    plan->symbol_samples = symbol_samples;
+    plan->first_bin = low;
+    plan->bin_stride = (available - 1) / (MBX_FREQPLAN_TONES - 1);
+    plan->bin_count = symbol_samples / 2 + 1;
+    plan->inverse = malloc(plan->bin_count);
+    if (!plan->inverse) return false;
+
+    for (int byte = 0; byte < MBX_FREQPLAN_TONES; byte++) {
+        int bin = plan->first_bin + byte * plan->bin_stride;
+        plan->frequency[byte] = (double)bin * sample_rate / symbol_samples;
+        plan->coefficient[byte] = 2.0 * cos(2.0 * M_PI * bin / symbol_samples);
+    }
+
+    // Every bin resolves to the byte whose tone is nearest
+    for (int bin = 0; bin < plan->bin_count; bin++) {
+        int offset = bin - plan->first_bin;
+        int byte = offset <= 0 ? 0 : (offset + plan->bin_stride / 2) / plan->bin_stride;
+        plan->inverse[bin] = (unsigned char)(byte < MBX_FREQPLAN_TONES ? byte : MBX_FREQPLAN_TONES - 1);
+    }
+    return true;
+}
+
+int mbx_freqplan_min_symbol(int sample_rate, double min_frequency, double max_frequency)
+{
+    if (sample_rate <= 0 || max_frequency <= min_frequency) return 0;
+
+    // Bin spacing is sample_rate / n, so the band holds about (max - min) * n / sample_rate bins
+    int n = (int)floor((MBX_FREQPLAN_TONES - 1) * (double)sample_rate / (max_frequency - min_frequency));
+    if (n < 2 * MBX_FREQPLAN_TONES) n = 2 * MBX_FREQPLAN_TONES;
+
+    // Rounding at the band edges can cost a bin or two; the count grows with n
+    for (int limit = n + sample_rate; n < limit; n++) {
+        int low, high;
+        if (band_bins(sample_rate, n, min_frequency, max_frequency, &low, &high) >= MBX_FREQPLAN_TONES)
+            return n;
+    }
+    return 0;
+}
+
+double mbx_freqplan_symbol_duration(const mbx_freqplan_t *plan)
+{
+    return (plan->symbol_samples + 0.5) / plan->sample_rate;
+}
+
+unsigned char mbx_freqplan_byte(const mbx_freqplan_t *plan, double frequency)
+{
+    int bin = (int)floor(frequency * plan->symbol_samples / plan->sample_rate + 0.5);
+    if (bin < 0) bin = 0;
+    if (bin >= plan->bin_count) bin = plan->bin_count - 1;
+    return plan->inverse[bin];
+}
+
+double mbx_freqplan_detect(const mbx_freqplan_t *plan, const short *samples, int count)
+{
+    if (!plan || !samples || count < FREQPLAN_MIN_DETECT_SAMPLES) return 0.0;
+    if (count > plan->symbol_samples) count = plan->symbol_samples;
+
+    // All 256 Goertzel filters advance together so the inner loop vectorizes
+    double s1[MBX_FREQPLAN_TONES] = {0};
+    double s2[MBX_FREQPLAN_TONES] = {0};
+    for (int i = 0; i < count; i++) {
+        double x = samples[i];
+        for (int b = 0; b < MBX_FREQPLAN_TONES; b++) {
+            double s0 = x + plan->coefficient[b] * s1[b] - s2[b];
+            s2[b] = s1[b];
+            s1[b] = s0;
+        }
+    }
+
+    int best = 0;
+    double best_power = -1.0;
+    for (int b = 0; b < MBX_FREQPLAN_TONES; b++) {
+        double power = s1[b] * s1[b] + s2[b] * s2[b] - plan->coefficient[b] * s1[b] * s2[b];
+        if (power > best_power) {
+            best_power = power;
+            best = b;
+        }
+    }
+    return plan->frequency[best];
+}
+
+void mbx_freqplan_free(mbx_freqplan_t *plan)
+{
+    if (!plan) return;
+
+    free(plan->inverse);
+    plan->inverse = NULL;
+    plan->bin_count = 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file mbx_freqplan.h
+ * @brief Orthogonal frequency plans shared by SONAR and dSONAR
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * The linear byte-to-frequency map spaces tones about 7.8 Hz apart, so the
+ * decoder needs long symbols to tell neighbours apart, and tones do not
+ * complete whole cycles per symbol. A frequency plan instead puts every
+ * byte on an exact DFT bin of the symbol (f = k * sample_rate / N). Such
+ * tones complete an integer number of cycles per symbol and are mutually
+ * orthogonal over it, so a Goertzel filter bank separates them with no
+ * leakage, even at the shortest symbol length for which 256 bins fit in
+ * the allowed band.
+ *
+ * The plan holds the forward table (byte -> frequency) used by SONAR and a
+ * precomputed inverse table (bin -> byte) used by dSONAR.
+ */
+
+#ifndef MBX_FREQPLAN_H
+#define MBX_FREQPLAN_H
+#include <stdbool.h>
+
+#define MBX_FREQPLAN_TONES 256          /**< One tone per byte value */
+#define MBX_FREQPLAN_MAX_FRACTION 0.45  /**< Default upper band edge as a fraction of the sample rate */
+
+/**
+ * @brief Frequency plan for one sample rate and symbol length
+ */
+typedef struct {
+    int sample_rate;           /**< Sample rate in Hz */
+    int symbol_samples;        /**< Symbol length N in samples; tones are bin-centered for N */
+    int first_bin;             /**< DFT bin of byte 0 */
+    int bin_stride;            /**< Bins between adjacent byte values (at least 1) */
+    double frequency[MBX_FREQPLAN_TONES]; /**< Tone frequency in Hz per byte value */
+    double coefficient[MBX_FREQPLAN_TONES]; /**< Goertzel coefficient 2cos(2*pi*k/N) per byte value */
+    int bin_count;             /**< Number of entries in inverse (N / 2 + 1) */
+    unsigned char *inverse;    /**< Nearest byte value for every bin 0..N/2 */
+} mbx_freqplan_t;
+
+/**
+ * @brief Build a plan of 256 orthogonal tones within a band
+ *
+ * Tones are spread as far apart as the band allows (the bin stride is the
+ * largest that still fits 256 tones), starting at the first bin at or
+ * above min_frequency.
+ *
+ * @param plan Pointer to plan to initialize
+ * @param sample_rate Sample rate in Hz
+ * @param symbol_samples Symbol length N in samples
+ * @param min_frequency Lowest allowed tone frequency in Hz
+ * @param max_frequency Highest allowed tone frequency in Hz (below sample_rate / 2)
+ * @return true on success, false if 256 bins do not fit or allocation failed
+ */
+bool mbx_freqplan_init(mbx_freqplan_t *plan, int sample_rate, int symbol_samples,
+                       double min_frequency, double max_frequency);
+
+/**
+ * @brief Shortest symbol length for which a plan fits within a band
+ *
+ * @param sample_rate Sample rate in Hz
+ * @param min_frequency Lowest allowed tone frequency in Hz
+ * @param max_frequency Highest allowed tone frequency in Hz
+ * @return Minimal symbol length N in samples, 0 if the band can never hold 256 tones
+ */
+int mbx_freqplan_min_symbol(int sample_rate, double min_frequency, double max_frequency);
+
+/**
+ * @brief Symbol duration in seconds that SONAR and dSONAR turn back into exactly N samples
+ *
+ * Includes half a sample of guard so that (int)(duration * sample_rate)
+ * is N despite floating-point rounding.
+ *
+ * @param plan Pointer to initialized plan
+ * @return Symbol duration in seconds
+ */
+double mbx_freqplan_symbol_duration(const mbx_freqplan_t *plan);
+
+/**
+ * @brief Map a frequency to the byte of the nearest plan tone
+ *
+ * @param plan Pointer to initialized plan
+ * @param frequency Frequency in Hz
+ * @return Byte value (0-255)
+ */
+unsigned char mbx_freqplan_byte(const mbx_freqplan_t *plan, double frequency);
+
+/**
+ * @brief Find the plan tone present in a block of audio
+ *
+ * Runs a Goertzel filter at each of the 256 tone bins over the first
+ * symbol_samples samples (or fewer if the block is shorter) and returns
+ * the strongest.
+ *
+ * @param plan Pointer to initialized plan
+ * @param samples 16-bit PCM samples starting at a symbol boundary
+ * @param count Number of samples available
+ * @return Frequency of the strongest tone in Hz, 0.0 if count is too short
+ */
+double mbx_freqplan_detect(const mbx_freqplan_t *plan, const short *samples, int count);
+
+/**
+ * @brief Release plan storage
+ *
+ * @param plan Pointer to plan
+ */
+void mbx_freqplan_free(mbx_freqplan_t *plan);
+
+#endif
@@ -0,0 +1,204 @@
+#include "mbx_lz.h"
+#include "mbx_digest.h"
+#include "mbx_endian.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 5   // sequences never end with a match closer than this to the end
+#define LZ_MATCH_LIMIT 12    // no match may start within this many bytes of the end
+
+static uint32_t read32(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static unsigned int lz_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Lengths of 15 and above continue in 255-valued extension bytes
+static unsigned char *put_length(unsigned char *op, unsigned char *end, size_t length)
+{
+    while (length >= 255) {
+        if (op >= end) return NULL;
+        *op++ = 255;
+        length -= 255;
+    }
+    if (op >= end) return NULL;
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+// Emit literals [anchor, anchor + literals) followed by an optional match
+static unsigned char *put_sequence(unsigned char *op, unsigned char *end, const unsigned char *anchor,
+                                   size_t literals, size_t offset, size_t match_length)
+{
+    if (op >= end) return NULL;
+    unsigned char *token = op++;
+    *token = (unsigned char)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15 && !(op = put_length(op, end, literals - 15))) return NULL;
+
+    if ((size_t)(end - op) < literals) return NULL;
+    memcpy(op, anchor, literals);
+    op += literals;
+
+    if (match_length == 0) return op;
+
+    if (end - op < 2) return NULL;
+    *op++ = (unsigned char)offset;
+    *op++ = (unsigned char)(offset >> 8);
+
+    size_t extra = match_length - LZ_MIN_MATCH;
+    *token |= (unsigned char)(extra < 15 ? extra : 15);
+    if (extra >= 15 && !(op = put_length(op, end, extra - 15))) return NULL;
+    return op;
+}
+
+size_t mbx_lz_bound(size_t length)
+{
+    return MBX_LZ_HEADER_SIZE + length + length / 255 + 16;
+}
+
+size_t mbx_lz_compress(const unsigned char *src, size_t length, unsigned char *dst, size_t capacity)
+{
+    if (!src || !dst || capacity < MBX_LZ_HEADER_SIZE || length > 0xFFFFFFFFu) return 0;
+
+    memcpy(dst, MBX_LZ_MAGIC, 4);
+    mbx_put_le32(dst + 4, (uint32_t)length);
+    mbx_put_le32(dst + 8, mbx_crc32c(0, src, length));
+
+    unsigned char *op = dst + MBX_LZ_HEADER_SIZE;
+    unsigned char *end = dst + capacity;
+    size_t anchor = 0;
+
+    if (length > LZ_MATCH_LIMIT) {
+        uint32_t *table = calloc((size_t)1 << LZ_HASH_BITS, sizeof(uint32_t));
+        if (!table) return 0;
+
+        size_t limit = length - LZ_MATCH_LIMIT;
+        size_t match_end = length - LZ_LAST_LITERALS;
+        size_t ip = 0;
+
+        while (ip <= limit) {
+            uint32_t sequence = read32(src + ip);
+            unsigned int h = lz_hash(sequence);
+            size_t ref = table[h];
+            table[h] = (uint32_t)ip;
+
+            if (ref >= ip || ip - ref > LZ_MAX_OFFSET || read32(src + ref) != sequence) {
+                // Skip faster through incompressible stretches
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            // Extend backwards over pending literals, then forwards
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            size_t match_length = LZ_MIN_MATCH;
+            while (ip + match_length < match_end && src[ip + match_length] == src[ref + match_length]) {
+                match_length++;
+            }
+
+            op = put_sequence(op, end, src + anchor, ip - anchor, ip - ref, match_length);
+            if (!op) {
+                free(table);
+                return 0;
+            }
+
+            ip += match_length;
+            anchor = ip;
+            if (ip - 2 <= limit) table[lz_hash(read32(src + ip - 2))] = (uint32_t)(ip - 2);
+        }
+
+        free(table);
+    }
+
+    op = put_sequence(op, end, src + anchor, length - anchor, 0, 0);
+    return op ? (size_t)(op - dst) : 0;
+}
+
+bool mbx_lz_is_compressed(const unsigned char *data, size_t length)
+{
+    return data && length >= MBX_LZ_HEADER_SIZE && memcmp(data, MBX_LZ_MAGIC, 4) == 0 &&
+           mbx_get_le32(data + 4) <= MOJIBAKE_MAX_FILE_SIZE;
+}
+
+size_t mbx_lz_original_length(const unsigned char *data, size_t length)
+{
+    return mbx_lz_is_compressed(data, length) ? mbx_get_le32(data + 4) : 0;
+}
+
+unsigned char *mbx_lz_decompress(const unsigned char *src, size_t length, size_t *out_length)
+{
+    if (!out_length || !mbx_lz_is_compressed(src, length)) return NULL;
+
+    size_t original = mbx_get_le32(src + 4);
+    uint32_t crc = mbx_get_le32(src + 8);
+    unsigned char *out = malloc(original > 0 ? original : 1);
+    if (!out) return NULL;
+
+    const unsigned char *ip = src + MBX_LZ_HEADER_SIZE;
+    const unsigned char *in_end = src + length;
+    size_t op = 0;
+
+    while (ip < in_end) {
+        unsigned int token = *ip++;
+
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            unsigned int byte;
+            do {
+                if (ip >= in_end) goto fail;
+                byte = *ip++;
+                literals += byte;
+            } while (byte == 255);
+        }
+        if ((size_t)(in_end - ip) < literals || original - op < literals) goto fail;
+        memcpy(out + op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // The last sequence carries literals only
+        if (ip == in_end) break;
+
+        if (in_end - ip < 2) goto fail;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+
+        size_t match_length = (token & 0x0F) + LZ_MIN_MATCH;
+        if ((token & 0x0F) == 15) {
+            unsigned int byte;
+            do {
+                if (ip >= in_end) goto fail;
+                byte = *ip++;
+                match_length += byte;
+            } while (byte == 255);
+        }
+        if (offset == 0 || offset > op || original - op < match_length) goto fail;
+
+        // Byte-wise copy handles overlapping references (runs)
+        const unsigned char *ref = out + op - offset;
+        for (size_t i = 0; i < match_length; i++) {
+            out[op + i] = ref[i];
+        }
+        op += match_length;
+    }
+
+    if (op != original || mbx_crc32c(0, out, original) != crc) goto fail;
+
+    *out_length = original;
+    return out;
+
+fail:
+    free(out);
+    return NULL;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file mbx_lz.h
+ * @brief LZ compression stage for SONAR payloads
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Small LZ77-family block compressor (LZ4-style sequences of literals and
+ * back-references) used by SONAR to shrink partitions before they are
+ * turned into tones. Compressed payloads carry an in-band header so that
+ * dSONAR can recognize and expand them without extra metadata.
+ *
+ * Payload layout (all integers little-endian):
+ * - 4 bytes magic "MZL1"
+ * - 4 bytes original length
+ * - 4 bytes CRC32C of the original data
+ * - compressed sequences
+ */
+
+#ifndef MBX_LZ_H
+#define MBX_LZ_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "mojibake/mojibake.h"
+
+#define MBX_LZ_MAGIC "MZL1"          /**< Magic bytes at the start of a compressed payload */
+#define MBX_LZ_HEADER_SIZE 12        /**< Size of the payload header in bytes */
+
+/**
+ * @brief Worst-case size of a compressed payload
+ *
+ * @param length Number of input bytes
+ * @return Buffer size that is always large enough for mbx_lz_compress
+ */
+size_t mbx_lz_bound(size_t length);
+
+/**
+ * @brief Compress a memory block into a self-describing payload
+ *
+ * @param src Input data
+ * @param length Number of input bytes
+ * @param dst Output buffer
+ * @param capacity Size of the output buffer in bytes
+ * @return Size of the payload, or 0 if it would not fit in capacity
+ */
+size_t mbx_lz_compress(const unsigned char *src, size_t length, unsigned char *dst, size_t capacity);
+
+/**
+ * @brief Check whether data starts with a compressed payload header
+ *
+ * @param data Data to inspect
+ * @param length Number of bytes available
+ * @return true if the magic and a plausible original length are present
+ */
+bool mbx_lz_is_compressed(const unsigned char *data, size_t length);
+
+/**
+ * @brief Size of the data a compressed payload expands to
+ *
+ * Only the header is inspected, so this works on the first
+ * MBX_LZ_HEADER_SIZE bytes of a payload.
+ *
+ * @param data Start of the payload
+ * @param length Number of bytes available
+ * @return Original length from the header, 0 if data is not a compressed payload
+ */
+size_t mbx_lz_original_length(const unsigned char *data, size_t length);
+
+/**
+ * @brief Expand a compressed payload
+ *
+ * Every back-reference is bounds-checked and the result must match the
+ * CRC32C recorded in the header, so damaged payloads are rejected rather
+ * than producing garbage.
+ *
+ * @param src Compressed payload including its header
+ * @param length Size of the payload in bytes
+ * @param out_length Pointer to store the size of the expanded data
+ * @return Newly allocated expanded data (caller frees), NULL on failure
+ */
+unsigned char *mbx_lz_decompress(const unsigned char *src, size_t length, size_t *out_length);
+
+#endif
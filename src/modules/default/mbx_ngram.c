@@ -0,0 +1,517 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_ngram.h"
+#include "mbx_parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Bytes read per refill beyond the n-gram overlap
+#define NGRAM_READ_CHUNK (64 * 1024)
+
+// Tables start on a cache line so worker threads never share one
+#define NGRAM_CACHE_LINE 64
+
+// Bits of the hash that pick a counter in one sketch row (log2 of the width)
+#define NGRAM_ROW_BITS 14
+
+mbx_ngram_table_t *mbx_ngram_table_create(unsigned int n)
+{
+    if (n < MBX_NGRAM_MIN_N || n > MBX_NGRAM_MAX_N) return NULL;
+
+    void *memory = NULL;
+#ifdef _WIN32
+    memory = _aligned_malloc(sizeof(mbx_ngram_table_t), NGRAM_CACHE_LINE);
+#else
+    if (posix_memalign(&memory, NGRAM_CACHE_LINE, sizeof(mbx_ngram_table_t)) != 0) memory = NULL;
+#endif
+    if (!memory) return NULL;
+
+    mbx_ngram_table_t *table = memory;
+    table->n = n;
+    mbx_ngram_reset(table);
+    return table;
+}
+
+void mbx_ngram_table_free(mbx_ngram_table_t *table)
+{
+#ifdef _WIN32
+    _aligned_free(table);
+#else
+    free(table);
+#endif
+}
+
+void mbx_ngram_reset(mbx_ngram_table_t *table)
+{
+    unsigned int n = table->n;
+    memset(table, 0, sizeof(*table));
+    table->n = n;
+}
+
+// 64-bit finalizer of MurmurHash3: every bit of an n-gram affects every sketch row
+static uint64_t mix(uint64_t gram)
+{
+    gram ^= gram >> 33;
+    gram *= 0xFF51AFD7ED558CCDull;
+    gram ^= gram >> 33;
+    gram *= 0xC4CEB9FE1A85EC53ull;
+    gram ^= gram >> 33;
+    return gram;
+}
+
+// Row r uses hash bits 63-50, 49-36, 35-22 and 21-8
+static size_t sketch_slot(uint64_t hash, int row)
+{
+    return (size_t)(hash >> (64 - NGRAM_ROW_BITS * (row + 1))) & (MBX_NGRAM_SKETCH_WIDTH - 1);
+}
+
+static uint64_t sketch_estimate(const mbx_ngram_table_t *table, uint64_t hash)
+{
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < MBX_NGRAM_SKETCH_DEPTH; row++) {
+        uint32_t value = table->sketch[row][sketch_slot(hash, row)];
+        if (value < estimate) estimate = value;
+    }
+    return estimate;
+}
+
+static int compare_counts(const void *a, const void *b)
+{
+    const mbx_ngram_count_t *x = a, *y = b;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    return x->gram < y->gram ? -1 : (x->gram > y->gram);
+}
+
+// Candidates as a list, most frequent first
+static size_t gather_candidates(const mbx_ngram_table_t *table, mbx_ngram_count_t *list)
+{
+    size_t count = 0;
+    for (size_t slot = 0; slot < MBX_NGRAM_CANDIDATES * 2; slot++) {
+        if (table->candidates[slot].count != 0) list[count++] = table->candidates[slot];
+    }
+    qsort(list, count, sizeof(*list), compare_counts);
+    return count;
+}
+
+static void insert_candidate(mbx_ngram_table_t *table, uint64_t gram, uint64_t hash, uint64_t count)
+{
+    size_t slot = (size_t)hash & (MBX_NGRAM_CANDIDATES * 2 - 1);
+    while (table->candidates[slot].count != 0) slot = (slot + 1) & (MBX_NGRAM_CANDIDATES * 2 - 1);
+    table->candidates[slot].gram = gram;
+    table->candidates[slot].count = count;
+    table->candidate_count++;
+}
+
+// Keep the more frequent half of the candidates; newcomers must then beat the weakest one kept
+static void prune_candidates(mbx_ngram_table_t *table)
+{
+    mbx_ngram_count_t list[MBX_NGRAM_CANDIDATES];
+    size_t count = gather_candidates(table, list);
+    size_t keep = count / 2;
+
+    memset(table->candidates, 0, sizeof(table->candidates));
+    table->candidate_count = 0;
+    for (size_t i = 0; i < keep; i++) {
+        insert_candidate(table, list[i].gram, mix(list[i].gram), list[i].count);
+    }
+    if (keep > 0 && list[keep - 1].count > table->threshold) table->threshold = list[keep - 1].count;
+}
+
+// Record the latest estimate of an n-gram that may be frequent
+static void offer_candidate(mbx_ngram_table_t *table, uint64_t gram, uint64_t hash, uint64_t count)
+{
+    size_t slot = (size_t)hash & (MBX_NGRAM_CANDIDATES * 2 - 1);
+    while (table->candidates[slot].count != 0) {
+        if (table->candidates[slot].gram == gram) {
+            table->candidates[slot].count = count;
+            return;
+        }
+        slot = (slot + 1) & (MBX_NGRAM_CANDIDATES * 2 - 1);
+    }
+
+    if (table->candidate_count == MBX_NGRAM_CANDIDATES) {
+        prune_candidates(table);
+        if (count <= table->threshold) return;
+    }
+    insert_candidate(table, gram, hash, count);
+}
+
+void mbx_ngram_add(mbx_ngram_table_t *table, const unsigned char *bytes, size_t length, size_t starts)
+{
+    if (table == NULL || bytes == NULL || length == 0) return;
+    if (starts > length) starts = length;
+
+    // Byte histogram in four interleaved copies, so runs of one byte do not stall on a single counter
+    uint32_t counts[4][256];
+    memset(counts, 0, sizeof(counts));
+    size_t i = 0;
+    for (; i + 4 <= starts; i += 4) {
+        counts[0][bytes[i]]++;
+        counts[1][bytes[i + 1]]++;
+        counts[2][bytes[i + 2]]++;
+        counts[3][bytes[i + 3]]++;
+    }
+    for (; i < starts; i++) counts[0][bytes[i]]++;
+    for (int b = 0; b < 256; b++) {
+        table->bytes[b] += (uint64_t)counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b];
+    }
+    table->total += starts;
+
+    // Pairs that start in the range
+    size_t pairs = starts < length - 1 ? starts : length - 1;
+    uint32_t *bigrams = table->bigrams;
+    unsigned int pair = bytes[0];
+    for (i = 1; i <= pairs; i++) {
+        pair = (pair << 8 | bytes[i]) & 0xFFFF;
+        bigrams[pair]++;
+    }
+    table->pairs += pairs;
+
+    // n-grams that start in the range
+    size_t n = table->n;
+    if (length < n) return;
+    size_t grams = starts < length - n + 1 ? starts : length - n + 1;
+    uint64_t mask = n == 8 ? UINT64_MAX : ((uint64_t)1 << (8 * n)) - 1;
+    uint64_t gram = 0;
+    for (i = 0; i + 1 < n; i++) gram = gram << 8 | bytes[i];
+
+    for (i = 0; i < grams; i++) {
+        gram = (gram << 8 | bytes[i + n - 1]) & mask;
+        uint64_t hash = mix(gram);
+        uint32_t estimate = UINT32_MAX;
+        for (int row = 0; row < MBX_NGRAM_SKETCH_DEPTH; row++) {
+            uint32_t value = ++table->sketch[row][sketch_slot(hash, row)];
+            if (value < estimate) estimate = value;
+        }
+        if (estimate > table->threshold) offer_candidate(table, gram, hash, estimate);
+    }
+    table->ngrams += grams;
+}
+
+void mbx_ngram_merge(mbx_ngram_table_t *table, const mbx_ngram_table_t *other)
+{
+    if (table == NULL || other == NULL || table->n != other->n) return;
+
+    for (size_t i = 0; i < MBX_NGRAM_BIGRAMS; i++) table->bigrams[i] += other->bigrams[i];
+    for (int row = 0; row < MBX_NGRAM_SKETCH_DEPTH; row++) {
+        for (size_t i = 0; i < MBX_NGRAM_SKETCH_WIDTH; i++) table->sketch[row][i] += other->sketch[row][i];
+    }
+    for (int b = 0; b < 256; b++) table->bytes[b] += other->bytes[b];
+    table->total += other->total;
+    table->pairs += other->pairs;
+    table->ngrams += other->ngrams;
+
+    // Re-estimate the candidates of both tables from the merged sketch
+    if (other->threshold > table->threshold) table->threshold = other->threshold;
+    for (size_t slot = 0; slot < MBX_NGRAM_CANDIDATES * 2; slot++) {
+        mbx_ngram_count_t *candidate = &table->candidates[slot];
+        if (candidate->count != 0) candidate->count = sketch_estimate(table, mix(candidate->gram));
+    }
+    for (size_t slot = 0; slot < MBX_NGRAM_CANDIDATES * 2; slot++) {
+        const mbx_ngram_count_t *candidate = &other->candidates[slot];
+        if (candidate->count == 0) continue;
+        uint64_t hash = mix(candidate->gram);
+        uint64_t estimate = sketch_estimate(table, hash);
+        if (estimate > table->threshold) offer_candidate(table, candidate->gram, hash, estimate);
+    }
+}
+
+double mbx_ngram_entropy(const mbx_ngram_table_t *table)
+{
+    if (table->total == 0) return 0.0;
+    double entropy = 0.0;
+    for (int b = 0; b < 256; b++) {
+        if (table->bytes[b] == 0) continue;
+        double p = (double)table->bytes[b] / table->total;
+        entropy -= p * log2(p);
+    }
+    return entropy;
+}
+
+double mbx_ngram_transition_entropy(const mbx_ngram_table_t *table)
+{
+    if (table->pairs == 0) return 0.0;
+
+    // Sum over pairs ab of count(ab) * log2(count(a.) / count(ab)), over all pairs
+    double sum = 0.0;
+    for (int a = 0; a < 256; a++) {
+        const uint32_t *row = &table->bigrams[a * 256];
+        uint64_t row_total = 0;
+        for (int b = 0; b < 256; b++) row_total += row[b];
+        if (row_total == 0) continue;
+
+        double log_total = log2((double)row_total);
+        for (int b = 0; b < 256; b++) {
+            if (row[b] != 0) sum += row[b] * (log_total - log2((double)row[b]));
+        }
+    }
+    return sum / table->pairs;
+}
+
+static unsigned int distinct_bigrams(const mbx_ngram_table_t *table)
+{
+    unsigned int distinct = 0;
+    for (size_t i = 0; i < MBX_NGRAM_BIGRAMS; i++) distinct += table->bigrams[i] != 0;
+    return distinct;
+}
+
+size_t mbx_ngram_top_bigrams(const mbx_ngram_table_t *table, mbx_ngram_count_t *top, size_t k)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < MBX_NGRAM_BIGRAMS && k > 0; i++) {
+        uint32_t value = table->bigrams[i];
+        if (value == 0 || (count == k && value <= top[k - 1].count)) continue;
+
+        // Insertion into the short sorted list (earlier pairs win ties)
+        size_t position = count < k ? count++ : k - 1;
+        while (position > 0 && top[position - 1].count < value) {
+            top[position] = top[position - 1];
+            position--;
+        }
+        top[position].gram = i;
+        top[position].count = value;
+    }
+    return count;
+}
+
+size_t mbx_ngram_top(const mbx_ngram_table_t *table, mbx_ngram_count_t *top, size_t k)
+{
+    mbx_ngram_count_t list[MBX_NGRAM_CANDIDATES];
+    size_t count = 0;
+    for (size_t slot = 0; slot < MBX_NGRAM_CANDIDATES * 2; slot++) {
+        const mbx_ngram_count_t *candidate = &table->candidates[slot];
+        if (candidate->count == 0) continue;
+        list[count].gram = candidate->gram;
+        list[count].count = sketch_estimate(table, mix(candidate->gram));
+        count++;
+    }
+    qsort(list, count, sizeof(*list), compare_counts);
+    if (count > k) count = k;
+    memcpy(top, list, count * sizeof(*top));
+    return count;
+}
+
+bool mbx_ngram_partition(mojibake_target_t *target, unsigned int index, mbx_ngram_table_t *table,
+                         mbx_ngram_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    if (target == NULL || table == NULL || index >= target->partition_count) return false;
+
+    size_t offset = (size_t)index * target->partition_size;
+    size_t length = target->partition_size;
+    if (index == target->partition_count - 1) length = target->size - offset;
+    summary->offset = offset;
+    summary->length = length;
+    mbx_ngram_reset(table);
+
+    // Pairs and n-grams that start near the end read into the next partition
+    size_t end = offset + length;
+    size_t overlap = table->n - 1;
+    size_t limit = end + overlap < target->size ? end + overlap : target->size;
+    unsigned char *buffer = malloc(NGRAM_READ_CHUNK + overlap);
+    bool ok = buffer != NULL;
+
+    size_t position = offset;
+    while (ok && position < end) {
+        size_t starts = end - position < NGRAM_READ_CHUNK ? end - position : NGRAM_READ_CHUNK;
+        size_t want = limit - position < starts + overlap ? limit - position : starts + overlap;
+        size_t got = mojibake_read(target, position, buffer, want);
+        if (got < starts) {
+            ok = false;
+            break;
+        }
+        mbx_ngram_add(table, buffer, got, starts);
+        position += starts;
+    }
+    free(buffer);
+
+    summary->entropy = mbx_ngram_entropy(table);
+    summary->transition_entropy = mbx_ngram_transition_entropy(table);
+    summary->distinct_bigrams = distinct_bigrams(table);
+    summary->top_count = mbx_ngram_top_bigrams(table, summary->top, MBX_NGRAM_PARTITION_TOP);
+    summary->ok = ok;
+    return ok;
+}
+
+// Bytes in hexadecimal, then as ASCII with dots for the rest
+static void print_gram(uint64_t gram, unsigned int n)
+{
+    char text[MBX_NGRAM_MAX_N + 1];
+    for (unsigned int k = 0; k < n; k++) {
+        unsigned char byte = (unsigned char)(gram >> (8 * (n - 1 - k)));
+        printf("%02X ", byte);
+        text[k] = byte >= 0x20 && byte < 0x7F ? (char)byte : '.';
+    }
+    text[n] = '\0';
+    printf(" \"%s\"", text);
+}
+
+static void print_summary(unsigned int index, const mbx_ngram_summary_t *summary, uint64_t pairs)
+{
+    printf("=== Partition %u N-gram Analysis ===\n", index);
+    printf("Range: %zu - %zu (%zu bytes)\n", summary->offset, summary->offset + summary->length, summary->length);
+    if (!summary->ok) {
+        printf("Error: Partition could not be read completely\n");
+    }
+    printf("Entropy: %.3f bits/byte, transition entropy %.3f bits\n", summary->entropy,
+           summary->transition_entropy);
+    printf("Distinct bigrams: %u of %d (%.1f%%)\n", summary->distinct_bigrams, MBX_NGRAM_BIGRAMS,
+           summary->distinct_bigrams * 100.0 / MBX_NGRAM_BIGRAMS);
+    if (summary->top_count > 0) {
+        printf("Top bigrams:");
+        for (size_t i = 0; i < summary->top_count; i++) {
+            printf("%s %02X %02X (%.1f%%)", i > 0 ? "," : "", (unsigned int)(summary->top[i].gram >> 8),
+                   (unsigned int)(summary->top[i].gram & 0xFF), summary->top[i].count * 100.0 / pairs);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+static void print_ngrams(const mbx_ngram_table_t *table)
+{
+    mbx_ngram_count_t top[MBX_NGRAM_TOP];
+    size_t count = mbx_ngram_top(table, top, MBX_NGRAM_TOP);
+    if (count == 0) return;
+
+    // Count-Min bound: overestimates exceed e/width of the total with probability e^-depth
+    double error = ceil(exp(1.0) / MBX_NGRAM_SKETCH_WIDTH * table->ngrams);
+    if (table->n == 3) printf("Top trigrams");
+    else printf("Top %u-grams", table->n);
+    printf(" (estimates, at most %.0f too high with 98%% probability):\n", error);
+    for (size_t i = 0; i < count; i++) {
+        printf("  %6.2f%% %12llu  ", top[i].count * 100.0 / table->ngrams, (unsigned long long)top[i].count);
+        print_gram(top[i].gram, table->n);
+        printf("\n");
+    }
+}
+
+static void print_file_summary(const mbx_ngram_table_t *table)
+{
+    printf("=== File N-gram Summary ===\n");
+    printf("Bytes: %llu, pairs: %llu, %u-grams: %llu\n", (unsigned long long)table->total,
+           (unsigned long long)table->pairs, table->n, (unsigned long long)table->ngrams);
+    printf("Entropy: %.3f bits/byte, transition entropy %.3f bits\n", mbx_ngram_entropy(table),
+           mbx_ngram_transition_entropy(table));
+    unsigned int distinct = distinct_bigrams(table);
+    printf("Distinct bigrams: %u of %d (%.1f%%)\n", distinct, MBX_NGRAM_BIGRAMS,
+           distinct * 100.0 / MBX_NGRAM_BIGRAMS);
+
+    mbx_ngram_count_t top[MBX_NGRAM_TOP];
+    size_t count = mbx_ngram_top_bigrams(table, top, MBX_NGRAM_TOP);
+    if (count > 0) printf("Top bigrams:\n");
+    for (size_t i = 0; i < count; i++) {
+        printf("  %6.2f%% %12llu  ", top[i].count * 100.0 / table->pairs, (unsigned long long)top[i].count);
+        print_gram(top[i].gram, 2);
+        printf("\n");
+    }
+    print_ngrams(table);
+    printf("\n");
+}
+
+// Each worker owns its tables: one for the partition in hand, one for everything it counted
+typedef struct {
+    mbx_ngram_table_t *partition;
+    mbx_ngram_table_t *total;
+} ngram_worker_t;
+
+typedef struct {
+    mojibake_target_t *target;
+    const mbx_ngram_config_t *config;
+    mbx_ngram_summary_t *summaries;
+    ngram_worker_t *workers;
+} ngram_batch_t;
+
+// The tables take every update, so they are made on the worker's thread, on its own node
+static bool ngram_start(void *arg, int worker)
+{
+    ngram_batch_t *batch = arg;
+    ngram_worker_t *self = &batch->workers[worker];
+    self->partition = mbx_ngram_table_create(batch->config->n);
+    self->total = mbx_ngram_table_create(batch->config->n);
+    if (self->partition && self->total) return true;
+
+    // A worker without tables is left out
+    mbx_ngram_table_free(self->partition);
+    mbx_ngram_table_free(self->total);
+    self->partition = self->total = NULL;
+    return false;
+}
+
+static void ngram_job(void *arg, unsigned int index, int worker)
+{
+    ngram_batch_t *batch = arg;
+    ngram_worker_t *self = &batch->workers[worker];
+    mbx_ngram_partition(batch->target, index, self->partition, &batch->summaries[index]);
+    mbx_ngram_merge(self->total, self->partition);
+}
+
+bool mbx_ngram_batch(mojibake_target_t *target, const mbx_ngram_config_t *config)
+{
+    if (target == NULL || config == NULL) return false;
+
+    int threads = mbx_parallel_threads(config->threads, target);
+    ngram_batch_t batch = {.target = target, .config = config};
+    batch.summaries = calloc(target->partition_count, sizeof(mbx_ngram_summary_t));
+    batch.workers = calloc(threads, sizeof(ngram_worker_t));
+    if (!batch.summaries || !batch.workers) {
+        free(batch.summaries);
+        free(batch.workers);
+        return false;
+    }
+
+    mbx_parallel_job_t job = {.threads = threads, .numa = config->numa,
+                              .start = ngram_start, .partition = ngram_job, .arg = &batch};
+    threads = mbx_parallel_run(target, &job);
+
+    mbx_ngram_table_t *file = NULL;
+    for (int i = 0; i < threads; i++) {
+        if (!batch.workers[i].total) continue;
+        if (file) mbx_ngram_merge(file, batch.workers[i].total);
+        else file = batch.workers[i].total;
+    }
+
+    bool ok = file != NULL;
+    if (file) {
+        printf("[NGRAM] %u partitions on %d threads\n\n", target->partition_count, threads);
+        for (unsigned int i = 0; i < target->partition_count; i++) {
+            const mbx_ngram_summary_t *summary = &batch.summaries[i];
+            uint64_t pairs = summary->length > 0 ? summary->length : 1;
+            print_summary(i, summary, pairs);
+            ok = ok && summary->ok;
+        }
+        print_file_summary(file);
+    } else {
+        printf("Error: Could not allocate n-gram tables\n");
+    }
+
+    for (int i = 0; i < threads; i++) {
+        mbx_ngram_table_free(batch.workers[i].partition);
+        mbx_ngram_table_free(batch.workers[i].total);
+    }
+    free(batch.summaries);
+    free(batch.workers);
+    return ok;
+}
+
+bool mbx_ngram(mojibake_target_t *target, unsigned int index, void *arg)
+{
+    const mbx_ngram_config_t *config = arg;
+    mbx_ngram_table_t *table = mbx_ngram_table_create(config ? config->n : MBX_NGRAM_DEFAULT_N);
+    if (!table) return false;
+
+    mbx_ngram_summary_t summary;
+    bool ok = mbx_ngram_partition(target, index, table, &summary);
+    print_summary(index, &summary, table->pairs > 0 ? table->pairs : 1);
+    if (ok) {
+        print_ngrams(table);
+        printf("\n");
+    }
+    mbx_ngram_table_free(table);
+    return ok;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file mbx_ngram.h
+ * @brief Byte n-gram statistics
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Fingerprints the structure of data by its byte pairs and longer n-grams:
+ *
+ * - Exact bigram counts in a 65,536-bin table, with the most frequent
+ *   pairs, the number of distinct pairs and the transition entropy
+ *   H(next byte | current byte) in bits
+ * - Frequent n-grams (n = 3 to 8, trigrams by default) from a Count-Min
+ *   sketch of 4 x 16,384 counters and a bounded candidate set, so memory
+ *   stays the same however many distinct n-grams the data holds. Counts
+ *   are sketch estimates: never too low, and too high by at most
+ *   e / 16,384 of all n-grams with 98% probability.
+ *
+ * Pairs and n-grams are counted at the partition where they start, so
+ * those spanning a partition boundary are counted once. Partitions are
+ * analysed in parallel; every worker thread counts into its own tables
+ * (aligned to cache lines, so threads never share a line), and the
+ * tables are merged when all partitions are done.
+ */
+
+#ifndef MBX_NGRAM_H
+#define MBX_NGRAM_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mojibake/mojibake.h"
+
+#define MBX_NGRAM_BIGRAMS 65536          /**< Bins of the bigram table */
+#define MBX_NGRAM_DEFAULT_N 3            /**< Default sketched n-gram length */
+#define MBX_NGRAM_MIN_N 3                /**< Shortest sketched n-gram (bigrams are counted exactly) */
+#define MBX_NGRAM_MAX_N 8                /**< Longest sketched n-gram */
+#define MBX_NGRAM_SKETCH_DEPTH 4         /**< Rows of the Count-Min sketch */
+#define MBX_NGRAM_SKETCH_WIDTH 16384     /**< Counters per sketch row (a power of two) */
+#define MBX_NGRAM_CANDIDATES 1024        /**< Frequent n-gram candidates kept per table */
+#define MBX_NGRAM_TOP 10                 /**< Most frequent bigrams and n-grams in the file summary */
+#define MBX_NGRAM_PARTITION_TOP 3        /**< Most frequent bigrams in a partition summary */
+
+/**
+ * @brief An n-gram and its count
+ */
+typedef struct {
+    uint64_t gram;             /**< Bytes of the n-gram, first byte most significant */
+    uint64_t count;            /**< Occurrences (an estimate for sketched n-grams) */
+} mbx_ngram_count_t;
+
+/**
+ * @brief Counter tables (allocate with mbx_ngram_table_create)
+ */
+typedef struct {
+    uint32_t bigrams[MBX_NGRAM_BIGRAMS]; /**< Pair counts, indexed by first byte * 256 + second byte */
+    uint32_t sketch[MBX_NGRAM_SKETCH_DEPTH][MBX_NGRAM_SKETCH_WIDTH]; /**< Count-Min sketch of n-grams */
+    uint64_t bytes[256];       /**< Byte histogram */
+    mbx_ngram_count_t candidates[MBX_NGRAM_CANDIDATES * 2]; /**< Open-addressed candidates (count 0 = empty slot) */
+    size_t candidate_count;    /**< Candidates stored */
+    uint64_t threshold;        /**< Estimate a new candidate must exceed once the set has been pruned */
+    uint64_t total;            /**< Bytes counted */
+    uint64_t pairs;            /**< Pairs counted */
+    uint64_t ngrams;           /**< n-grams counted */
+    unsigned int n;            /**< Sketched n-gram length */
+} mbx_ngram_table_t;
+
+/**
+ * @brief Analysis settings
+ */
+typedef struct {
+    unsigned int n;            /**< Sketched n-gram length (MBX_NGRAM_MIN_N to MBX_NGRAM_MAX_N) */
+    int threads;               /**< Worker threads (0 = one per online CPU) */
+    bool numa;                 /**< Pin workers to NUMA nodes and prefer node-local partitions */
+} mbx_ngram_config_t;
+
+/**
+ * @brief Per-partition summary
+ */
+typedef struct {
+    size_t offset;             /**< File offset of the partition */
+    size_t length;             /**< Partition length in bytes */
+    double entropy;            /**< Byte entropy in bits per byte */
+    double transition_entropy; /**< Entropy of a byte given the byte before it, in bits */
+    unsigned int distinct_bigrams; /**< Pairs that occur at least once */
+    mbx_ngram_count_t top[MBX_NGRAM_PARTITION_TOP]; /**< Most frequent pairs */
+    size_t top_count;          /**< Pairs stored in top */
+    bool ok;                   /**< Partition was read and counted completely */
+} mbx_ngram_summary_t;
+
+/**
+ * @brief Allocate empty tables, aligned to a cache line
+ *
+ * @param n Sketched n-gram length (MBX_NGRAM_MIN_N to MBX_NGRAM_MAX_N)
+ * @return Tables, or NULL on invalid length or allocation failure
+ */
+mbx_ngram_table_t *mbx_ngram_table_create(unsigned int n);
+
+/**
+ * @brief Release tables
+ *
+ * @param table Tables from mbx_ngram_table_create (NULL is ignored)
+ */
+void mbx_ngram_table_free(mbx_ngram_table_t *table);
+
+/**
+ * @brief Empty all counters
+ *
+ * @param table Pointer to tables
+ */
+void mbx_ngram_reset(mbx_ngram_table_t *table);
+
+/**
+ * @brief Count the bytes, pairs and n-grams that start in a range
+ *
+ * Bytes past the range complete the pairs and n-grams that start near its
+ * end, so a stream can be counted in chunks that overlap by n - 1 bytes.
+ *
+ * @param table Pointer to tables
+ * @param bytes The range followed by any bytes after it
+ * @param length Number of bytes available
+ * @param starts Length of the range (at most length)
+ */
+void mbx_ngram_add(mbx_ngram_table_t *table, const unsigned char *bytes, size_t length, size_t starts);
+
+/**
+ * @brief Add one set of tables into another
+ *
+ * @param table Tables to add to
+ * @param other Tables to add (same n-gram length)
+ */
+void mbx_ngram_merge(mbx_ngram_table_t *table, const mbx_ngram_table_t *other);
+
+/**
+ * @brief Byte entropy
+ *
+ * @param table Pointer to tables
+ * @return Entropy in bits per byte (0-8)
+ */
+double mbx_ngram_entropy(const mbx_ngram_table_t *table);
+
+/**
+ * @brief Transition entropy H(next byte | current byte)
+ *
+ * @param table Pointer to tables
+ * @return Entropy in bits (0-8); low values mean each byte predicts the next
+ */
+double mbx_ngram_transition_entropy(const mbx_ngram_table_t *table);
+
+/**
+ * @brief Most frequent bigrams
+ *
+ * @param table Pointer to tables
+ * @param top Output, most frequent first
+ * @param k Capacity of top
+ * @return Number of bigrams stored (only pairs that occur)
+ */
+size_t mbx_ngram_top_bigrams(const mbx_ngram_table_t *table, mbx_ngram_count_t *top, size_t k);
+
+/**
+ * @brief Most frequent sketched n-grams
+ *
+ * @param table Pointer to tables
+ * @param top Output, most frequent first (estimated counts)
+ * @param k Capacity of top
+ * @return Number of n-grams stored
+ */
+size_t mbx_ngram_top(const mbx_ngram_table_t *table, mbx_ngram_count_t *top, size_t k);
+
+/**
+ * @brief Count one partition into the tables and summarise it
+ *
+ * The tables are reset first. The last partition also covers the bytes
+ * left over by the partition size. Safe to call from several threads on
+ * the same target with different tables.
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index
+ * @param table Tables to count into
+ * @param summary Output summary
+ * @return true if the partition was counted, false on read failure
+ */
+bool mbx_ngram_partition(mojibake_target_t *target, unsigned int index, mbx_ngram_table_t *table,
+                         mbx_ngram_summary_t *summary);
+
+/**
+ * @brief Analyse all partitions in parallel and print their summaries and the file's
+ *
+ * @param target Pointer to mojibake target
+ * @param config Analysis settings
+ * @return true if every partition was counted
+ */
+bool mbx_ngram_batch(mojibake_target_t *target, const mbx_ngram_config_t *config);
+
+/**
+ * @brief n-gram module function (one partition, for mojibake_execute)
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index to process
+ * @param arg Pointer to mbx_ngram_config_t (NULL for defaults)
+ * @return true if the partition was analysed
+ */
+bool mbx_ngram(mojibake_target_t *target, unsigned int index, void *arg);
+
+#endif
@@ -0,0 +1,200 @@
+#if defined(__linux__)
+#define _GNU_SOURCE // sched_setaffinity and cpu_set_t
+#endif
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_numa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#define NUMA_NODE_DIR "/sys/devices/system/node"
+#endif
+
+// Placed blocks start on a page so no page straddles two nodes
+#define NUMA_PAGE_SIZE 4096
+
+static mbx_numa_topology_t topology;
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+
+#if defined(__linux__)
+// CPUs the process could run on when the topology was read, restored by mbx_numa_unpin
+static cpu_set_t process_cpus;
+static bool process_cpus_known;
+
+// Read a sysfs list such as "0-3,8-11" into its values, in order
+static int read_list(const char *path, short *values, int capacity)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+    char line[4096];
+    int count = 0;
+    if (fgets(line, sizeof(line), file)) {
+        char *cursor = line;
+        while (*cursor && *cursor != '\n') {
+            char *end;
+            long first = strtol(cursor, &end, 10);
+            if (end == cursor || first < 0) break;
+            long last = first;
+            if (*end == '-') {
+                cursor = end + 1;
+                last = strtol(cursor, &end, 10);
+                if (end == cursor || last < first) break;
+            }
+            for (long value = first; value <= last && count < capacity; value++) {
+                values[count++] = (short)value;
+            }
+            cursor = *end == ',' ? end + 1 : end;
+        }
+    }
+    fclose(file);
+    return count;
+}
+#endif
+
+static void read_topology(void)
+{
+    topology.node_count = 1;
+    topology.node_ids[0] = 0;
+    topology.cpu_count[0] = 0;
+
+#if defined(__linux__)
+    process_cpus_known = sched_getaffinity(0, sizeof(process_cpus), &process_cpus) == 0;
+    if (!process_cpus_known) return;
+
+    static short node_ids[MBX_NUMA_MAX_CPUS];
+    static short cpus[MBX_NUMA_MAX_CPUS];
+    int node_total = read_list(NUMA_NODE_DIR "/online", node_ids, MBX_NUMA_MAX_CPUS);
+
+    // Memory-only nodes and nodes whose CPUs are all off limits get no workers
+    int count = 0;
+    for (int i = 0; i < node_total; i++) {
+        char path[96];
+        snprintf(path, sizeof(path), NUMA_NODE_DIR "/node%d/cpulist", node_ids[i]);
+        int cpu_total = read_list(path, cpus, MBX_NUMA_MAX_CPUS);
+        int slot = count < MBX_NUMA_MAX_NODES ? count : MBX_NUMA_MAX_NODES - 1;
+        if (slot == count) topology.cpu_count[slot] = 0;
+        for (int c = 0; c < cpu_total; c++) {
+            if (cpus[c] < CPU_SETSIZE && CPU_ISSET(cpus[c], &process_cpus)) {
+                topology.cpus[slot][topology.cpu_count[slot]++] = cpus[c];
+            }
+        }
+        if (slot == count && topology.cpu_count[slot] > 0) {
+            topology.node_ids[slot] = node_ids[i];
+            count++;
+        }
+    }
+    topology.node_count = count > 0 ? count : 1;
+#endif
+}
+
+const mbx_numa_topology_t *mbx_numa_topology(void)
+{
+    pthread_once(&topology_once, read_topology);
+    return &topology;
+}
+
+bool mbx_numa_pin(int node)
+{
+    const mbx_numa_topology_t *host = mbx_numa_topology();
+    if (node < 0 || node >= host->node_count || host->cpu_count[node] == 0) return false;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < host->cpu_count[node]; i++) {
+        CPU_SET(host->cpus[node][i], &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+void mbx_numa_unpin(void)
+{
+#if defined(__linux__)
+    if (process_cpus_known) {
+        sched_setaffinity(0, sizeof(process_cpus), &process_cpus);
+    }
+#endif
+}
+
+// Node n's partitions run from the first index whose home is n: ceil(n * count / nodes)
+unsigned int mbx_numa_first_partition(unsigned int partition_count, int node_count, int node)
+{
+    return (unsigned int)(((uint64_t)node * partition_count + node_count - 1) / node_count);
+}
+
+typedef struct {
+    const unsigned char *source;
+    unsigned char *block;
+    size_t offset;
+    size_t length;
+    int node;
+} place_job_t;
+
+// Runs pinned to the node, so the pages it writes first are allocated there
+static void *place_worker(void *arg)
+{
+    place_job_t *job = arg;
+    mbx_numa_pin(job->node);
+    memcpy(job->block + job->offset, job->source + job->offset, job->length);
+    return NULL;
+}
+
+int mbx_numa_place(mojibake_target_t *target)
+{
+    if (target == NULL || target->block == NULL) return 1;
+    const mbx_numa_topology_t *host = mbx_numa_topology();
+    int nodes = host->node_count;
+    if (nodes > (int)target->partition_count) nodes = (int)target->partition_count;
+    if (nodes < 2) return 1;
+
+    // A fresh allocation of this size comes straight from the kernel, so no page is touched yet
+    void *block = NULL;
+#ifdef _WIN32
+    block = _aligned_malloc(target->size, NUMA_PAGE_SIZE);
+#else
+    if (posix_memalign(&block, NUMA_PAGE_SIZE, target->size) != 0) block = NULL;
+#endif
+    if (!block) return 1;
+
+    place_job_t jobs[MBX_NUMA_MAX_NODES];
+    pthread_t threads[MBX_NUMA_MAX_NODES];
+    bool started[MBX_NUMA_MAX_NODES];
+    for (int n = 0; n < nodes; n++) {
+        size_t start = (size_t)mbx_numa_first_partition(target->partition_count, nodes, n) * target->partition_size;
+        size_t end = n == nodes - 1 ? target->size
+                                    : (size_t)mbx_numa_first_partition(target->partition_count, nodes, n + 1) *
+                                          target->partition_size;
+        jobs[n] = (place_job_t){target->block, block, start, end - start, n};
+        started[n] = pthread_create(&threads[n], NULL, place_worker, &jobs[n]) == 0;
+    }
+    // A node whose thread did not start is copied here; the data is right, only its placement is not
+    int placed = 0;
+    for (int n = 0; n < nodes; n++) {
+        if (started[n]) {
+            pthread_join(threads[n], NULL);
+            placed++;
+        } else {
+            memcpy((unsigned char *)block + jobs[n].offset, (const unsigned char *)target->block + jobs[n].offset,
+                   jobs[n].length);
+        }
+    }
+
+#ifdef _WIN32
+    if (target->block_aligned) _aligned_free(target->block);
+    else
+#endif
+        free(target->block);
+    target->block = block;
+    target->block_aligned = true;
+    return placed > 0 ? placed : 1;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file mbx_numa.h
+ * @brief NUMA-aware partition scheduling and memory placement
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * On a host with several NUMA nodes, memory is local to one node and
+ * slower to reach from the others. A file loaded by one thread has all of
+ * its pages on that thread's node, so workers on the other nodes would
+ * read every partition remotely.
+ *
+ * Partitions are given a home node: the partitions are split into as many
+ * contiguous runs as there are nodes (mbx_numa_first_partition). The
+ * worker pool (mbx_parallel.h) starts its workers round-robin over the
+ * nodes, pins each to its node's CPUs, and lets a worker claim the
+ * partitions of its own node first; once those are gone it takes
+ * partitions from the other nodes, so no worker idles while work is left.
+ * mbx_numa_place moves an in-memory block onto the home nodes of its
+ * partitions by first touch: one pinned thread per node copies that
+ * node's partitions into a fresh buffer. Streamed targets need no
+ * placement; each worker allocates its read buffers after it is pinned,
+ * so the kernel puts them on the worker's node.
+ *
+ * The topology is read from /sys/devices/system/node, limited to the CPUs
+ * the process may run on. Elsewhere, and on single-node hosts, everything
+ * here degrades to the plain shared partition counter.
+ */
+
+#ifndef MBX_NUMA_H
+#define MBX_NUMA_H
+#include <stdbool.h>
+#include "mojibake/mojibake.h"
+
+#define MBX_NUMA_MAX_NODES 64          /**< Nodes handled; CPUs of further nodes count as the last one */
+#define MBX_NUMA_MAX_CPUS 1024         /**< Highest CPU number handled, plus one */
+
+/**
+ * @brief CPUs of the NUMA nodes the process may run on
+ */
+typedef struct {
+    int node_count;                    /**< Nodes with at least one usable CPU (1 if unknown) */
+    int node_ids[MBX_NUMA_MAX_NODES];  /**< Kernel node number of each node */
+    int cpu_count[MBX_NUMA_MAX_NODES]; /**< Usable CPUs of each node */
+    short cpus[MBX_NUMA_MAX_NODES][MBX_NUMA_MAX_CPUS]; /**< Usable CPU numbers of each node */
+} mbx_numa_topology_t;
+
+/**
+ * @brief Get the host topology
+ *
+ * Read once; later calls return the same topology.
+ *
+ * @return Topology (never NULL)
+ */
+const mbx_numa_topology_t *mbx_numa_topology(void);
+
+/**
+ * @brief Pin the calling thread to the CPUs of a node
+ *
+ * @param node Node, counted among the nodes of the topology
+ * @return true if the thread was pinned
+ */
+bool mbx_numa_pin(int node);
+
+/**
+ * @brief Let the calling thread run on every CPU of the process again
+ *
+ * Undoes mbx_numa_pin.
+ */
+void mbx_numa_unpin(void);
+
+/**
+ * @brief Get the first partition whose home is a node
+ *
+ * Node n is home to partitions mbx_numa_first_partition(count, nodes, n)
+ * to mbx_numa_first_partition(count, nodes, n + 1) - 1.
+ *
+ * @param partition_count Partitions of the target
+ * @param node_count Nodes the partitions are spread over
+ * @param node Node, or node_count for the end of the last node's run
+ * @return Partition index
+ */
+unsigned int mbx_numa_first_partition(unsigned int partition_count, int node_count, int node);
+
+/**
+ * @brief Move an in-memory target onto the home nodes of its partitions
+ *
+ * Does nothing for streamed targets or on a single-node host. If the new
+ * buffer cannot be allocated the block stays where it is; a node whose
+ * thread cannot be started is copied unplaced by the calling thread.
+ * The new block is page-aligned and marked block_aligned, so
+ * mojibake_close releases it with the matching function.
+ *
+ * @param target Target to place
+ * @return Nodes the block is spread over (1 if it was left in place)
+ */
+int mbx_numa_place(mojibake_target_t *target);
+
+#endif
@@ -0,0 +1,138 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_parallel.h"
+#include "mbx_numa.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+int mbx_parallel_cpus(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+int mbx_parallel_threads(int threads, const mojibake_target_t *target)
+{
+    if (threads <= 0) threads = mbx_parallel_cpus();
+    if (threads > (int)target->partition_count) threads = (int)target->partition_count;
+    return threads > 0 ? threads : 1;
+}
+
+// Partition queues of one run: node n owns partitions first[n] to first[n + 1] - 1 and hands them out through next[n]
+typedef struct {
+    int node_count;                    // nodes in use (1 when not pinning)
+    bool pin;                          // pin workers to their node
+    unsigned int first[MBX_NUMA_MAX_NODES + 1];
+    unsigned int next[MBX_NUMA_MAX_NODES];
+    unsigned int joined;               // workers that have joined so far
+} parallel_schedule_t;
+
+typedef struct {
+    const mbx_parallel_job_t *job;
+    parallel_schedule_t schedule;
+} parallel_run_t;
+
+// Without pinning, or on a single-node host, all partitions share one queue and are claimed in order
+static void schedule_init(parallel_schedule_t *schedule, const mojibake_target_t *target, bool pin)
+{
+    const mbx_numa_topology_t *topology = mbx_numa_topology();
+    schedule->pin = pin && topology->node_count > 1;
+    schedule->node_count = schedule->pin ? topology->node_count : 1;
+    if (schedule->node_count > (int)target->partition_count) {
+        schedule->node_count = target->partition_count > 0 ? (int)target->partition_count : 1;
+    }
+    for (int n = 0; n <= schedule->node_count; n++) {
+        schedule->first[n] = mbx_numa_first_partition(target->partition_count, schedule->node_count, n);
+    }
+    for (int n = 0; n < schedule->node_count; n++) {
+        schedule->next[n] = schedule->first[n];
+    }
+    schedule->joined = 0;
+}
+
+// Give the calling thread the next node in round-robin order and, when pinning, pin it there
+static int schedule_join(parallel_schedule_t *schedule)
+{
+    unsigned int worker = __atomic_fetch_add(&schedule->joined, 1, __ATOMIC_RELAXED);
+    int node = (int)(worker % (unsigned int)schedule->node_count);
+    if (schedule->pin) {
+        mbx_numa_pin(node);
+    }
+    return node;
+}
+
+// Partitions of the worker's own node come first, then those of the other nodes in turn
+static bool schedule_claim(parallel_schedule_t *schedule, int node, unsigned int *index)
+{
+    for (int k = 0; k < schedule->node_count; k++) {
+        int queue = (node + k) % schedule->node_count;
+        unsigned int end = schedule->first[queue + 1];
+        if (__atomic_load_n(&schedule->next[queue], __ATOMIC_RELAXED) >= end) continue;
+        unsigned int claimed = __atomic_fetch_add(&schedule->next[queue], 1, __ATOMIC_RELAXED);
+        if (claimed < end) {
+            *index = claimed;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    parallel_run_t *run;
+    int worker;
+} parallel_worker_t;
+
+static void *parallel_worker(void *arg)
+{
+    parallel_worker_t *self = arg;
+    parallel_run_t *run = self->run;
+    int node = schedule_join(&run->schedule);
+    if (run->job->start && !run->job->start(run->job->arg, self->worker)) return NULL;
+
+    unsigned int index;
+    while (schedule_claim(&run->schedule, node, &index)) {
+        run->job->partition(run->job->arg, index, self->worker);
+    }
+    return NULL;
+}
+
+int mbx_parallel_run(mojibake_target_t *target, const mbx_parallel_job_t *job)
+{
+    parallel_run_t run = {.job = job};
+    schedule_init(&run.schedule, target, job->numa);
+
+    int threads = mbx_parallel_threads(job->threads, target);
+    pthread_t *handles = malloc(threads * sizeof(pthread_t));
+    parallel_worker_t *workers = malloc(threads * sizeof(parallel_worker_t));
+    if (!handles || !workers) threads = 1;
+
+    // The calling thread is worker 0; threads that fail to start leave their share to the rest
+    parallel_worker_t self = {&run, 0};
+    int started = 0;
+    while (started < threads - 1) {
+        workers[started] = (parallel_worker_t){&run, started + 1};
+        if (pthread_create(&handles[started], NULL, parallel_worker, &workers[started]) != 0) break;
+        started++;
+    }
+    parallel_worker(&self);
+    // The calling thread was pinned as a worker; give it its CPUs back
+    if (run.schedule.pin) mbx_numa_unpin();
+    for (int i = 0; i < started; i++) {
+        pthread_join(handles[i], NULL);
+    }
+
+    free(workers);
+    free(handles);
+    return started + 1;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file mbx_parallel.h
+ * @brief Shared worker pool of the parallel batch modules
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Entropy, search, n-gram, similarity and diff all process the partitions
+ * of a target independently and report them in order afterwards. They
+ * hand mbx_parallel_run a job: a callback for one partition and,
+ * optionally, one that sets up a worker's private state. The run starts
+ * the threads (the calling thread is one of the workers), lets each claim
+ * partitions one at a time, its own NUMA node's first when the job asks
+ * for placement (see mbx_numa.h), so uneven partitions balance out, and
+ * returns once every partition is done.
+ *
+ * mojibake_read is safe on a shared target, so the callbacks read their
+ * partitions without any locking of their own.
+ */
+
+#ifndef MBX_PARALLEL_H
+#define MBX_PARALLEL_H
+#include <stdbool.h>
+#include "mojibake/mojibake.h"
+
+/**
+ * @brief Work of one parallel run
+ */
+typedef struct {
+    int threads;                       /**< Worker threads, 0 = one per online CPU */
+    bool numa;                         /**< Pin workers to NUMA nodes and prefer node-local partitions */
+    /**
+     * Optional: set up the private state of a worker, on the worker's
+     * thread after it is pinned, so its memory is node-local. A worker
+     * whose start fails takes no partitions.
+     */
+    bool (*start)(void *arg, int worker);
+    void (*partition)(void *arg, unsigned int index, int worker); /**< Process one partition */
+    void *arg;                         /**< Passed to the callbacks */
+} mbx_parallel_job_t;
+
+/**
+ * @brief Get the number of online CPUs
+ *
+ * @return CPUs (at least 1)
+ */
+int mbx_parallel_cpus(void);
+
+/**
+ * @brief Get the number of workers a run will use at most
+ *
+ * Workers are numbered 0 to this count - 1, so per-worker state can be
+ * sized with it before the run.
+ *
+ * @param threads Requested threads, 0 = one per online CPU
+ * @param target Target whose partitions are processed
+ * @return Workers (at least 1, at most one per partition)
+ */
+int mbx_parallel_threads(int threads, const mojibake_target_t *target);
+
+/**
+ * @brief Process every partition of a target on worker threads
+ *
+ * Workers that fail to start leave their share to the rest; the calling
+ * thread always works, so every partition is processed unless the
+ * calling thread's start callback fails too.
+ *
+ * @param target Target whose partitions are processed
+ * @param job Callbacks and settings
+ * @return Workers that ran, the calling thread included
+ */
+int mbx_parallel_run(mojibake_target_t *target, const mbx_parallel_job_t *job);
+
+#endif
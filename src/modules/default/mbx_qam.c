@@ -0,0 +1,176 @@
+#include "mbx_qam.h"
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Keeps the worst-case sum of all carriers just below full scale
+#define QAM_PEAK 0.9
+
+// Constellation levels per axis (2 for QPSK, 4 for 16-QAM)
+static int axis_levels(const mbx_qam_t *qam)
+{
+    return 1 << (qam->bits_per_carrier / 2);
+}
+
+bool mbx_qam_init(mbx_qam_t *qam, int sample_rate, int order, double min_frequency, double max_frequency)
+{
+    if (!qam || sample_rate < MBX_QAM_SYMBOL_RATE || (order != 4 && order != 16)) return false;
+
+    memset(qam, 0, sizeof(*qam));
+    qam->sample_rate = sample_rate;
+    qam->symbol_samples = (int)floor((double)sample_rate / MBX_QAM_SYMBOL_RATE + 0.5);
+    qam->order = order;
+    qam->bits_per_carrier = order == 16 ? 4 : 2;
+    qam->symbol_bytes = MBX_QAM_CARRIERS * qam->bits_per_carrier / 8;
+
+    // Data carriers on consecutive bins with the pilot in the middle, all inside the band
+    int n = qam->symbol_samples;
+    int low = (int)ceil(min_frequency * n / sample_rate);
+    int high = (int)floor(max_frequency * n / sample_rate);
+    if (low < 1) low = 1;
+    if (high > (n - 1) / 2) high = (n - 1) / 2;
+    if (high - low + 1 < MBX_QAM_CARRIERS + 1) return false;
+
+    qam->pilot_bin = low + MBX_QAM_CARRIERS / 2;
+    for (int c = 0; c < MBX_QAM_CARRIERS; c++) {
+        qam->bins[c] = low + c + (c >= MBX_QAM_CARRIERS / 2 ? 1 : 0);
+    }
+
+    int max_level = axis_levels(qam) - 1;
+    qam->scale = QAM_PEAK / ((MBX_QAM_CARRIERS + 1) * max_level * sqrt(2.0));
+
+    qam->cosine = malloc(n * sizeof(double));
+    qam->sine = malloc(n * sizeof(double));
+    if (!qam->cosine || !qam->sine) {
+        mbx_qam_free(qam);
+        return false;
+    }
+    for (int m = 0; m < n; m++) {
+        qam->cosine[m] = cos(2.0 * M_PI * m / n);
+        qam->sine[m] = sin(2.0 * M_PI * m / n);
+    }
+    return true;
+}
+
+size_t mbx_qam_symbol_count(const mbx_qam_t *qam, size_t payload_size)
+{
+    size_t total = payload_size + MBX_QAM_LENGTH_PREFIX;
+    return (total + qam->symbol_bytes - 1) / qam->symbol_bytes;
+}
+
+// Bits of one carrier, taken most significant first from the symbol's bytes
+static unsigned int carrier_bits(const mbx_qam_t *qam, const unsigned char *bytes, int carrier)
+{
+    int position = carrier * qam->bits_per_carrier;
+    int shift = 8 - qam->bits_per_carrier - position % 8;
+    return (bytes[position / 8] >> shift) & ((1u << qam->bits_per_carrier) - 1);
+}
+
+// Gray-coded bits of one axis -> level in {-(M-1), ..., -1, 1, ..., M-1}
+static int gray_to_level(unsigned int gray, int levels)
+{
+    unsigned int index = gray ^ (gray >> 1);
+    return 2 * (int)index - (levels - 1);
+}
+
+// Nearest level index on one axis, returned as Gray-coded bits
+static unsigned int slice_axis(double value, int levels, double *error)
+{
+    int index = (int)floor((value + levels - 1) / 2.0 + 0.5);
+    if (index < 0) index = 0;
+    if (index > levels - 1) index = levels - 1;
+    *error = value - (2 * index - (levels - 1));
+    return (unsigned int)(index ^ (index >> 1));
+}
+
+void mbx_qam_modulate(const mbx_qam_t *qam, const unsigned char *bytes, double *samples)
+{
+    int n = qam->symbol_samples;
+    int levels = axis_levels(qam);
+    int half = qam->bits_per_carrier / 2;
+    double in_phase[MBX_QAM_CARRIERS], quadrature[MBX_QAM_CARRIERS];
+
+    for (int c = 0; c < MBX_QAM_CARRIERS; c++) {
+        unsigned int bits = carrier_bits(qam, bytes, c);
+        in_phase[c] = gray_to_level(bits >> half, levels);
+        quadrature[c] = gray_to_level(bits & ((1u << half) - 1), levels);
+    }
+
+    // Pilot: known real point at the largest level
+    double pilot = levels - 1;
+    for (int i = 0; i < n; i++) {
+        double value = pilot * qam->cosine[(long)qam->pilot_bin * i % n];
+        for (int c = 0; c < MBX_QAM_CARRIERS; c++) {
+            int m = (int)((long)qam->bins[c] * i % n);
+            value += in_phase[c] * qam->cosine[m] - quadrature[c] * qam->sine[m];
+        }
+        samples[i] = qam->scale * value;
+    }
+}
+
+// Correlate a symbol against one carrier: returns N/2 times its complex amplitude I + jQ
+static void correlate(const mbx_qam_t *qam, const short *samples, int bin, double *re, double *im)
+{
+    int n = qam->symbol_samples;
+    double sum_re = 0.0, sum_im = 0.0;
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        sum_re += samples[i] * qam->cosine[m];
+        sum_im += samples[i] * qam->sine[m];
+        m += bin;
+        if (m >= n) m -= n;
+    }
+    *re = sum_re;
+    *im = -sum_im; // The carrier is I cos - Q sin
+}
+
+double mbx_qam_demodulate(const mbx_qam_t *qam, const short *samples, unsigned char *bytes)
+{
+    int levels = axis_levels(qam);
+    int half = qam->bits_per_carrier / 2;
+    memset(bytes, 0, qam->symbol_bytes);
+
+    // The pilot's received amplitude and phase give the channel gain and rotation
+    double pilot_re, pilot_im;
+    correlate(qam, samples, qam->pilot_bin, &pilot_re, &pilot_im);
+    double gain_re = pilot_re / (levels - 1);
+    double gain_im = pilot_im / (levels - 1);
+    double gain_power = gain_re * gain_re + gain_im * gain_im;
+    if (gain_power < 1e-9) return 0.0;
+
+    double total_error = 0.0;
+    for (int c = 0; c < MBX_QAM_CARRIERS; c++) {
+        double y_re, y_im;
+        correlate(qam, samples, qam->bins[c], &y_re, &y_im);
+
+        // Undo the channel: z = y / gain
+        double z_re = (y_re * gain_re + y_im * gain_im) / gain_power;
+        double z_im = (y_im * gain_re - y_re * gain_im) / gain_power;
+
+        double error_re, error_im;
+        unsigned int bits = slice_axis(z_re, levels, &error_re) << half;
+        bits |= slice_axis(z_im, levels, &error_im);
+
+        int position = c * qam->bits_per_carrier;
+        bytes[position / 8] |= (unsigned char)(bits << (8 - qam->bits_per_carrier - position % 8));
+
+        double error = sqrt(error_re * error_re + error_im * error_im);
+        total_error += error < 1.0 ? error : 1.0;
+    }
+    return 1.0 - total_error / MBX_QAM_CARRIERS;
+}
+
+void mbx_qam_free(mbx_qam_t *qam)
+{
+    if (!qam) return;
+
+    free(qam->cosine);
+    free(qam->sine);
+    qam->cosine = NULL;
+    qam->sine = NULL;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file mbx_qam.h
+ * @brief Coherent multi-carrier PSK/QAM modulation shared by SONAR and dSONAR
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * One tone per byte carries 8 bits per 50 ms symbol and spends its
+ * amplitude on a value already implied by the frequency. The coherent mode
+ * instead sends a symbol of 16 simultaneous data carriers plus one pilot,
+ * all on exact DFT bins of a 10 ms symbol (100 Hz apart, inside the
+ * 220-2220 Hz band). Each data carrier holds a QPSK (2 bit) or 16-QAM
+ * (4 bit, Gray coded) constellation point in its amplitude and phase, so
+ * a symbol carries 4 or 8 bytes.
+ *
+ * The pilot is sent with a known amplitude and phase. The demodulator
+ * correlates each symbol against every carrier, derives the channel's gain
+ * and phase rotation from the pilot, removes it from the data carriers and
+ * slices them to the nearest constellation point.
+ *
+ * Stream layout: the payload is prefixed with its length as a 32-bit
+ * little-endian integer and zero-padded to a whole symbol.
+ */
+
+#ifndef MBX_QAM_H
+#define MBX_QAM_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MBX_QAM_CARRIERS 16            /**< Data carriers per symbol */
+#define MBX_QAM_SYMBOL_RATE 100        /**< Symbols per second (carrier spacing in Hz) */
+#define MBX_QAM_LENGTH_PREFIX 4        /**< Bytes of the little-endian payload length prefix */
+#define MBX_QAM_MAX_SYMBOL_BYTES (MBX_QAM_CARRIERS / 2) /**< Bytes per symbol at 16-QAM */
+
+/**
+ * @brief Modulation parameters and precomputed carrier tables
+ */
+typedef struct {
+    int sample_rate;           /**< Sample rate in Hz */
+    int symbol_samples;        /**< Symbol length N in samples */
+    int order;                 /**< Constellation size: 4 (QPSK) or 16 (16-QAM) */
+    int bits_per_carrier;      /**< log2(order) */
+    int symbol_bytes;          /**< Payload bytes per symbol */
+    int pilot_bin;             /**< DFT bin of the pilot carrier */
+    int bins[MBX_QAM_CARRIERS]; /**< DFT bins of the data carriers */
+    double scale;              /**< Sample amplitude per constellation unit (keeps the peak below full scale) */
+    double *cosine;            /**< cos(2*pi*m/N) for m = 0..N-1 */
+    double *sine;              /**< sin(2*pi*m/N) for m = 0..N-1 */
+} mbx_qam_t;
+
+/**
+ * @brief Build a modulation plan within a band
+ *
+ * @param qam Pointer to plan to initialize
+ * @param sample_rate Sample rate in Hz
+ * @param order Constellation size: 4 (QPSK) or 16 (16-QAM)
+ * @param min_frequency Lowest allowed carrier frequency in Hz
+ * @param max_frequency Highest allowed carrier frequency in Hz
+ * @return true on success, false if the carriers do not fit, the order is unsupported or allocation failed
+ */
+bool mbx_qam_init(mbx_qam_t *qam, int sample_rate, int order, double min_frequency, double max_frequency);
+
+/**
+ * @brief Number of symbols needed for a payload, including the length prefix
+ *
+ * @param qam Pointer to initialized plan
+ * @param payload_size Payload size in bytes
+ * @return Symbol count
+ */
+size_t mbx_qam_symbol_count(const mbx_qam_t *qam, size_t payload_size);
+
+/**
+ * @brief Modulate one symbol
+ *
+ * @param qam Pointer to initialized plan
+ * @param bytes symbol_bytes bytes to send
+ * @param samples Output buffer of symbol_samples samples in [-1.0, 1.0]
+ */
+void mbx_qam_modulate(const mbx_qam_t *qam, const unsigned char *bytes, double *samples);
+
+/**
+ * @brief Demodulate one symbol
+ *
+ * @param qam Pointer to initialized plan
+ * @param samples symbol_samples 16-bit PCM samples
+ * @param bytes Output buffer of symbol_bytes bytes
+ * @return Quality in [0.0, 1.0]: 1 minus the mean error vector magnitude relative to
+ *         half the constellation spacing; 0.0 if the pilot is missing
+ */
+double mbx_qam_demodulate(const mbx_qam_t *qam, const short *samples, unsigned char *bytes);
+
+/**
+ * @brief Release plan storage
+ *
+ * @param qam Pointer to plan
+ */
+void mbx_qam_free(mbx_qam_t *qam);
+
+#endif
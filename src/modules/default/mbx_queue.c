@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_queue.h"
+#include <stdlib.h>
+#include <sched.h>
+
+// Busy-poll briefly before yielding the CPU to the other stage
+#define QUEUE_SPIN_LIMIT 64
+
+bool mbx_queue_init(mbx_queue_t *queue, unsigned int capacity)
+{
+    unsigned int size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    queue->slots = calloc(size, sizeof(void*));
+    if (!queue->slots) return false;
+
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    return true;
+}
+
+void mbx_queue_free(mbx_queue_t *queue)
+{
+    free(queue->slots);
+    queue->slots = NULL;
+}
+
+bool mbx_queue_try_push(mbx_queue_t *queue, void *item)
+{
+    unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (head - tail > queue->mask) return false;
+
+    queue->slots[head & queue->mask] = item;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void *mbx_queue_try_pop(mbx_queue_t *queue)
+{
+    unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (head == tail) return NULL;
+
+    void *item = queue->slots[tail & queue->mask];
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return item;
+}
+
+void mbx_queue_push(mbx_queue_t *queue, void *item)
+{
+    int spins = 0;
+    while (!mbx_queue_try_push(queue, item)) {
+        if (++spins >= QUEUE_SPIN_LIMIT) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+void *mbx_queue_pop(mbx_queue_t *queue)
+{
+    int spins = 0;
+    void *item;
+    while (!(item = mbx_queue_try_pop(queue))) {
+        if (++spins >= QUEUE_SPIN_LIMIT) {
+            sched_yield();
+            spins = 0;
+        }
+    }
+    return item;
+}
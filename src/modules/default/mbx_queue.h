@@ -0,0 +1,85 @@
+/**
+ * @file mbx_queue.h
+ * @brief Bounded lock-free single-producer/single-consumer queue
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Ring buffer of pointers connecting two pipeline stages, each running on
+ * its own thread. Exactly one thread may push and exactly one other thread
+ * may pop. Pipelines pair a "full" queue with a "free" queue that returns
+ * consumed blocks to the producer, so memory stays bounded by the number
+ * of blocks allocated up front.
+ */
+
+#ifndef MBX_QUEUE_H
+#define MBX_QUEUE_H
+#include <stdbool.h>
+
+#define MBX_QUEUE_CACHE_LINE 64 /**< Padding between producer and consumer indices */
+
+/**
+ * @brief SPSC queue state
+ *
+ * The producer only writes head and the consumer only writes tail; both are
+ * accessed with acquire/release atomics and live on separate cache lines.
+ */
+typedef struct {
+    void **slots;              /**< Ring of item pointers */
+    unsigned int mask;         /**< Capacity - 1 (capacity is a power of two) */
+    char pad0[MBX_QUEUE_CACHE_LINE];
+    unsigned int head;         /**< Next slot to push (producer owned) */
+    char pad1[MBX_QUEUE_CACHE_LINE];
+    unsigned int tail;         /**< Next slot to pop (consumer owned) */
+    char pad2[MBX_QUEUE_CACHE_LINE];
+} mbx_queue_t;
+
+/**
+ * @brief Initialize a queue
+ *
+ * @param queue Pointer to queue to initialize
+ * @param capacity Minimum number of items the queue must hold (rounded up to a power of two)
+ * @return true on success, false if memory allocation failed
+ */
+bool mbx_queue_init(mbx_queue_t *queue, unsigned int capacity);
+
+/**
+ * @brief Release queue storage (items are not freed)
+ *
+ * @param queue Pointer to queue
+ */
+void mbx_queue_free(mbx_queue_t *queue);
+
+/**
+ * @brief Try to push an item (producer thread only)
+ *
+ * @param queue Pointer to queue
+ * @param item Item to push (must not be NULL)
+ * @return true if pushed, false if the queue is full
+ */
+bool mbx_queue_try_push(mbx_queue_t *queue, void *item);
+
+/**
+ * @brief Try to pop an item (consumer thread only)
+ *
+ * @param queue Pointer to queue
+ * @return Oldest item, NULL if the queue is empty
+ */
+void *mbx_queue_try_pop(mbx_queue_t *queue);
+
+/**
+ * @brief Push an item, waiting while the queue is full
+ *
+ * @param queue Pointer to queue
+ * @param item Item to push (must not be NULL)
+ */
+void mbx_queue_push(mbx_queue_t *queue, void *item);
+
+/**
+ * @brief Pop an item, waiting while the queue is empty
+ *
+ * @param queue Pointer to queue
+ * @return Oldest item
+ */
+void *mbx_queue_pop(mbx_queue_t *queue);
+
+#endif
@@ -0,0 +1,542 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_search.h"
+#include "mbx_parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define MBX_SEARCH_SSSE3
+#endif
+
+// Bytes read per refill
+#define SEARCH_READ_CHUNK (64 * 1024)
+
+// Longest pattern file line: a pattern in spaced hexadecimal plus the prefix
+#define SEARCH_MAX_LINE (MBX_SEARCH_MAX_PATTERN * 3 + 16)
+
+// Transition entries carry this flag when the target state reports matches
+#define SEARCH_REPORTS 0x80000000u
+
+void mbx_search_init(mbx_search_matcher_t *matcher)
+{
+    memset(matcher, 0, sizeof(*matcher));
+}
+
+bool mbx_search_add(mbx_search_matcher_t *matcher, const unsigned char *bytes, size_t length, const char *text)
+{
+    if (matcher == NULL || bytes == NULL || length == 0 || length > MBX_SEARCH_MAX_PATTERN) return false;
+
+    mbx_search_pattern_t *patterns = realloc(matcher->patterns, (matcher->pattern_count + 1) * sizeof(*patterns));
+    if (!patterns) return false;
+    matcher->patterns = patterns;
+
+    mbx_search_pattern_t *pattern = &patterns[matcher->pattern_count];
+    pattern->bytes = malloc(length);
+    pattern->text = malloc(strlen(text) + 1);
+    if (!pattern->bytes || !pattern->text) {
+        free(pattern->bytes);
+        free(pattern->text);
+        return false;
+    }
+    memcpy(pattern->bytes, bytes, length);
+    strcpy(pattern->text, text);
+    pattern->length = length;
+
+    matcher->pattern_count++;
+    if (length > matcher->max_length) matcher->max_length = length;
+    return true;
+}
+
+static bool search_ssse3_available(void)
+{
+#if defined(MBX_SEARCH_SSSE3)
+    return __builtin_cpu_supports("ssse3");
+#else
+    return false;
+#endif
+}
+
+bool mbx_search_compile(mbx_search_matcher_t *matcher)
+{
+    if (matcher == NULL || matcher->pattern_count == 0) return false;
+
+    // Every byte that occurs in a pattern gets its own class; class 0 is all the others
+    memset(matcher->classes, 0, sizeof(matcher->classes));
+    memset(matcher->starts, 0, sizeof(matcher->starts));
+    size_t total = 0;
+    for (size_t p = 0; p < matcher->pattern_count; p++) {
+        const mbx_search_pattern_t *pattern = &matcher->patterns[p];
+        for (size_t k = 0; k < pattern->length; k++) matcher->classes[pattern->bytes[k]] = 1;
+        matcher->starts[pattern->bytes[0]] = 1;
+        total += pattern->length;
+    }
+    unsigned int classes = 1;
+    for (int b = 0; b < 256; b++) {
+        if (matcher->classes[b]) matcher->classes[b] = (unsigned char)classes++;
+    }
+    matcher->class_count = classes;
+
+    // Rows are addressed by offset with the top bit free for the report flag
+    size_t max_states = total + 1;
+    if (max_states > (SEARCH_REPORTS - 1) / classes) {
+        printf("Error: Pattern set too large (%zu bytes in %u byte classes)\n", total, classes);
+        return false;
+    }
+
+    free(matcher->transitions);
+    free(matcher->state_matches);
+    free(matcher->dictionary_links);
+    free(matcher->next_match);
+    matcher->transitions = calloc(max_states * classes, sizeof(uint32_t));
+    matcher->state_matches = malloc(max_states * sizeof(int32_t));
+    matcher->dictionary_links = calloc(max_states, sizeof(uint32_t));
+    matcher->next_match = malloc(matcher->pattern_count * sizeof(int32_t));
+    uint32_t *failure = calloc(max_states, sizeof(uint32_t));
+    uint32_t *queue = malloc(max_states * sizeof(uint32_t));
+    if (!matcher->transitions || !matcher->state_matches || !matcher->dictionary_links ||
+        !matcher->next_match || !failure || !queue) {
+        free(failure);
+        free(queue);
+        return false;
+    }
+    for (size_t s = 0; s < max_states; s++) matcher->state_matches[s] = -1;
+
+    // Trie of the patterns; while building, 0 marks a missing edge (no edge leads back to the root)
+    uint32_t *next = matcher->transitions;
+    size_t states = 1;
+    for (size_t p = 0; p < matcher->pattern_count; p++) {
+        const mbx_search_pattern_t *pattern = &matcher->patterns[p];
+        size_t state = 0;
+        for (size_t k = 0; k < pattern->length; k++) {
+            uint32_t *edge = &next[state * classes + matcher->classes[pattern->bytes[k]]];
+            if (*edge == 0) *edge = (uint32_t)states++;
+            state = *edge;
+        }
+        // Duplicate patterns share a state and are reported together, earliest first
+        matcher->next_match[p] = -1;
+        if (matcher->state_matches[state] < 0) {
+            matcher->state_matches[state] = (int32_t)p;
+        } else {
+            int32_t last = matcher->state_matches[state];
+            while (matcher->next_match[last] >= 0) last = matcher->next_match[last];
+            matcher->next_match[last] = (int32_t)p;
+        }
+    }
+    matcher->state_count = states;
+
+    // Breadth-first: failure links, dictionary links, then missing edges
+    // borrowed from the failure state turn the trie into a full automaton
+    size_t head = 0, tail = 0;
+    for (unsigned int c = 0; c < classes; c++) {
+        if (next[c] != 0) queue[tail++] = next[c];
+    }
+    while (head < tail) {
+        uint32_t state = queue[head++];
+        uint32_t fail = failure[state];
+        matcher->dictionary_links[state] = matcher->state_matches[fail] >= 0 ? fail : matcher->dictionary_links[fail];
+        for (unsigned int c = 0; c < classes; c++) {
+            uint32_t *edge = &next[state * classes + c];
+            if (*edge != 0) {
+                failure[*edge] = next[fail * classes + c];
+                queue[tail++] = *edge;
+            } else {
+                *edge = next[fail * classes + c];
+            }
+        }
+    }
+
+    // Store row offsets so scanning needs no multiplication, flagged where matches end
+    for (size_t e = 0; e < states * classes; e++) {
+        uint32_t target = next[e];
+        bool reports = matcher->state_matches[target] >= 0 || matcher->dictionary_links[target] != 0;
+        next[e] = target * classes | (reports ? SEARCH_REPORTS : 0);
+    }
+
+    // Start-byte set as two 16-entry bitmaps for the SSSE3 prefilter
+    memset(matcher->start_low, 0, sizeof(matcher->start_low));
+    memset(matcher->start_high, 0, sizeof(matcher->start_high));
+    for (int b = 0; b < 256; b++) {
+        if (!matcher->starts[b]) continue;
+        if (b < 0x80) matcher->start_low[b & 0x0F] |= (unsigned char)(1 << (b >> 4));
+        else matcher->start_high[b & 0x0F] |= (unsigned char)(1 << ((b >> 4) - 8));
+    }
+    matcher->prefilter = search_ssse3_available();
+
+    free(failure);
+    free(queue);
+    return true;
+}
+
+void mbx_search_free(mbx_search_matcher_t *matcher)
+{
+    if (matcher == NULL) return;
+    for (size_t p = 0; p < matcher->pattern_count; p++) {
+        free(matcher->patterns[p].bytes);
+        free(matcher->patterns[p].text);
+    }
+    free(matcher->patterns);
+    free(matcher->transitions);
+    free(matcher->state_matches);
+    free(matcher->dictionary_links);
+    free(matcher->next_match);
+    mbx_search_init(matcher);
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decode one pattern line; returns its length, 0 on a syntax error (*error says which)
+static size_t parse_pattern(const char *line, unsigned char *out, const char **error)
+{
+    size_t length = 0;
+
+    if (strncmp(line, "hex:", 4) == 0) {
+        int high = -1;
+        for (const char *p = line + 4; *p; p++) {
+            if (*p == ' ' || *p == '\t') continue;
+            int digit = hex_digit(*p);
+            if (digit < 0) {
+                *error = "invalid hexadecimal digit";
+                return 0;
+            }
+            if (high < 0) {
+                high = digit;
+                continue;
+            }
+            if (length == MBX_SEARCH_MAX_PATTERN) {
+                *error = "pattern too long";
+                return 0;
+            }
+            out[length++] = (unsigned char)(high << 4 | digit);
+            high = -1;
+        }
+        if (high >= 0) {
+            *error = "odd number of hexadecimal digits";
+            return 0;
+        }
+    } else {
+        for (const char *p = line; *p; p++) {
+            unsigned char byte = (unsigned char)*p;
+            if (*p == '\\') {
+                p++;
+                switch (*p) {
+                case '\\': byte = '\\'; break;
+                case 'n': byte = '\n'; break;
+                case 'r': byte = '\r'; break;
+                case 't': byte = '\t'; break;
+                case '0': byte = 0; break;
+                case 'x': {
+                    int high = hex_digit(p[1]), low = high >= 0 ? hex_digit(p[2]) : -1;
+                    if (low < 0) {
+                        *error = "\\x needs two hexadecimal digits";
+                        return 0;
+                    }
+                    byte = (unsigned char)(high << 4 | low);
+                    p += 2;
+                    break;
+                }
+                default:
+                    *error = "unknown escape";
+                    return 0;
+                }
+            }
+            if (length == MBX_SEARCH_MAX_PATTERN) {
+                *error = "pattern too long";
+                return 0;
+            }
+            out[length++] = byte;
+        }
+    }
+
+    if (length == 0) *error = "empty pattern";
+    return length;
+}
+
+bool mbx_search_load(const char *path, mbx_search_matcher_t *matcher)
+{
+    mbx_search_init(matcher);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        printf("Error: Could not open pattern file '%s'\n", path);
+        return false;
+    }
+
+    char line[SEARCH_MAX_LINE];
+    unsigned char bytes[MBX_SEARCH_MAX_PATTERN];
+    unsigned int number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        number++;
+        size_t length = strlen(line);
+        if (length == sizeof(line) - 1 && line[length - 1] != '\n' && !feof(file)) {
+            printf("Error: %s:%u: line too long\n", path, number);
+            ok = false;
+            break;
+        }
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+        if (length == 0 || line[0] == '#') continue;
+
+        const char *error = NULL;
+        size_t pattern_length = parse_pattern(line, bytes, &error);
+        if (pattern_length == 0) {
+            printf("Error: %s:%u: %s\n", path, number, error);
+            ok = false;
+        } else if (!mbx_search_add(matcher, bytes, pattern_length, line)) {
+            printf("Error: Out of memory reading %s\n", path);
+            ok = false;
+        }
+    }
+    fclose(file);
+
+    if (ok && matcher->pattern_count == 0) {
+        printf("Error: No patterns in %s\n", path);
+        ok = false;
+    }
+    if (ok && !mbx_search_compile(matcher)) ok = false;
+    if (!ok) mbx_search_free(matcher);
+    return ok;
+}
+
+#if defined(MBX_SEARCH_SSSE3)
+// Index of the first byte that can start a pattern, or length if there is none
+__attribute__((target("ssse3")))
+static size_t skip_to_start(const mbx_search_matcher_t *matcher, const unsigned char *bytes, size_t length)
+{
+    const __m128i low_table = _mm_loadu_si128((const __m128i *)matcher->start_low);
+    const __m128i high_table = _mm_loadu_si128((const __m128i *)matcher->start_high);
+    const __m128i bit_table = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+        __m128i low = _mm_and_si128(v, nibble);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        // Bitmap row for the low nibble, from the table that covers the high nibble
+        __m128i upper = _mm_cmpgt_epi8(high, _mm_set1_epi8(7));
+        __m128i row = _mm_or_si128(_mm_and_si128(upper, _mm_shuffle_epi8(high_table, low)),
+                                   _mm_andnot_si128(upper, _mm_shuffle_epi8(low_table, low)));
+        __m128i bit = _mm_shuffle_epi8(bit_table, high);
+        int hits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit));
+        if (hits != 0) return i + (size_t)__builtin_ctz((unsigned int)hits);
+    }
+    while (i < length && !matcher->starts[bytes[i]]) i++;
+    return i;
+}
+#endif
+
+void mbx_search_scan(const mbx_search_matcher_t *matcher, uint32_t *state, const unsigned char *bytes,
+                     size_t length, size_t offset, mbx_search_callback_t callback, void *context)
+{
+    const uint32_t *transitions = matcher->transitions;
+    const unsigned char *classes = matcher->classes;
+    uint32_t row = *state;
+
+    for (size_t i = 0; i < length; i++) {
+        // At the root only a start byte can lead anywhere
+        if (row == 0 && !matcher->starts[bytes[i]]) {
+#if defined(MBX_SEARCH_SSSE3)
+            if (matcher->prefilter) {
+                i += skip_to_start(matcher, bytes + i, length - i);
+            } else
+#endif
+            {
+                while (i < length && !matcher->starts[bytes[i]]) i++;
+            }
+            if (i == length) break;
+        }
+
+        row = transitions[row + classes[bytes[i]]];
+        if (row & SEARCH_REPORTS) {
+            row &= ~SEARCH_REPORTS;
+            uint32_t reporting = row / matcher->class_count;
+            if (matcher->state_matches[reporting] < 0) reporting = matcher->dictionary_links[reporting];
+            while (reporting != 0) {
+                for (int32_t p = matcher->state_matches[reporting]; p >= 0; p = matcher->next_match[p]) {
+                    callback((size_t)p, offset + i + 1 - matcher->patterns[p].length, context);
+                }
+                reporting = matcher->dictionary_links[reporting];
+            }
+        }
+    }
+    *state = row;
+}
+
+typedef struct {
+    const mbx_search_config_t *config;
+    mbx_search_summary_t *summary;
+    size_t end;
+    FILE *matches;
+    bool write_failed;
+} search_partition_t;
+
+// Keep matches that start in the partition; those further on belong to the next one
+static void record_match(size_t pattern, size_t offset, void *context)
+{
+    search_partition_t *partition = context;
+    mbx_search_summary_t *summary = partition->summary;
+    if (offset >= partition->end) return;
+
+    if (summary->listed_count < MBX_SEARCH_LISTED_MATCHES) {
+        summary->listed[summary->listed_count].offset = offset;
+        summary->listed[summary->listed_count].pattern = pattern;
+        summary->listed_count++;
+    }
+    summary->matches++;
+    if (summary->pattern_matches) summary->pattern_matches[pattern]++;
+    if (partition->matches && fprintf(partition->matches, "%zu,%zu\n", offset, pattern) < 0)
+        partition->write_failed = true;
+}
+
+bool mbx_search_partition(mojibake_target_t *target, unsigned int index,
+                          const mbx_search_config_t *config, mbx_search_summary_t *summary)
+{
+    size_t *pattern_matches = summary->pattern_matches;
+    memset(summary, 0, sizeof(*summary));
+    summary->pattern_matches = pattern_matches;
+    if (target == NULL || config == NULL || config->matcher == NULL || index >= target->partition_count)
+        return false;
+
+    size_t offset = (size_t)index * target->partition_size;
+    size_t length = target->partition_size;
+    if (index == target->partition_count - 1) length = target->size - offset;
+    summary->offset = offset;
+    summary->length = length;
+
+    // Read on into the next partition far enough to finish any match started here
+    size_t end = offset + length;
+    size_t scan_end = end + config->matcher->max_length - 1;
+    if (scan_end > target->size) scan_end = target->size;
+
+    search_partition_t partition = {config, summary, end, NULL, false};
+    if (config->write_matches) {
+        char filename[256];
+        snprintf(filename, sizeof(filename), "search_partition_%u.csv", index);
+        partition.matches = fopen(filename, "w");
+        if (!partition.matches) {
+            printf("Error: Could not create %s\n", filename);
+            return false;
+        }
+        fprintf(partition.matches, "Offset,Pattern\n");
+    }
+
+    unsigned char *buffer = malloc(SEARCH_READ_CHUNK);
+    bool ok = buffer != NULL;
+    uint32_t state = 0;
+    size_t position = offset;
+    while (ok && position < scan_end) {
+        size_t want = scan_end - position < SEARCH_READ_CHUNK ? scan_end - position : SEARCH_READ_CHUNK;
+        size_t got = mojibake_read(target, position, buffer, want);
+        if (got == 0) {
+            ok = false;
+            break;
+        }
+        mbx_search_scan(config->matcher, &state, buffer, got, position, record_match, &partition);
+        position += got;
+        // Past the end with no match in progress nothing more can start inside the partition
+        if (position >= end && state == 0) break;
+    }
+
+    if (partition.matches && (fclose(partition.matches) != 0 || partition.write_failed)) ok = false;
+    free(buffer);
+    summary->ok = ok;
+    return ok;
+}
+
+static void print_summary(unsigned int index, const mbx_search_summary_t *summary, const mbx_search_config_t *config)
+{
+    printf("=== Partition %u Search ===\n", index);
+    printf("Range: %zu - %zu (%zu bytes)\n", summary->offset, summary->offset + summary->length, summary->length);
+    if (!summary->ok) {
+        printf("Error: Partition could not be searched completely\n");
+    }
+    printf("Matches: %zu\n", summary->matches);
+    for (int i = 0; i < summary->listed_count; i++) {
+        const mbx_search_match_t *match = &summary->listed[i];
+        printf("  0x%08zx  %s\n", match->offset, config->matcher->patterns[match->pattern].text);
+    }
+    if (summary->matches > (size_t)summary->listed_count) {
+        printf("  ... %zu more matches\n", summary->matches - summary->listed_count);
+    }
+    if (config->write_matches) {
+        printf("Matches file: search_partition_%u.csv\n", index);
+    }
+    printf("\n");
+}
+
+typedef struct {
+    mojibake_target_t *target;
+    const mbx_search_config_t *config;
+    mbx_search_summary_t *summaries;
+} search_batch_t;
+
+static void search_job(void *arg, unsigned int index, int worker)
+{
+    search_batch_t *batch = arg;
+    (void)worker;
+    mbx_search_partition(batch->target, index, batch->config, &batch->summaries[index]);
+}
+
+bool mbx_search_batch(mojibake_target_t *target, const mbx_search_config_t *config)
+{
+    if (target == NULL || config == NULL || config->matcher == NULL) return false;
+
+    const mbx_search_matcher_t *matcher = config->matcher;
+    unsigned int partitions = target->partition_count;
+    search_batch_t batch = {.target = target, .config = config};
+    batch.summaries = calloc(partitions, sizeof(mbx_search_summary_t));
+    size_t *counts = calloc((size_t)partitions * matcher->pattern_count, sizeof(size_t));
+    if (!batch.summaries || !counts) {
+        free(batch.summaries);
+        free(counts);
+        return false;
+    }
+    for (unsigned int i = 0; i < partitions; i++) {
+        batch.summaries[i].pattern_matches = counts + (size_t)i * matcher->pattern_count;
+    }
+
+    mbx_parallel_job_t job = {.threads = config->threads, .numa = config->numa,
+                              .partition = search_job, .arg = &batch};
+    int threads = mbx_parallel_run(target, &job);
+    printf("[SEARCH] %zu patterns, %u partitions on %d threads\n\n", matcher->pattern_count, partitions, threads);
+
+    bool ok = true;
+    size_t total = 0;
+    for (unsigned int i = 0; i < partitions; i++) {
+        print_summary(i, &batch.summaries[i], config);
+        ok = ok && batch.summaries[i].ok;
+        total += batch.summaries[i].matches;
+    }
+
+    printf("=== File Search Summary ===\n");
+    printf("Matches: %zu\n", total);
+    for (size_t p = 0; p < matcher->pattern_count; p++) {
+        size_t count = 0;
+        for (unsigned int i = 0; i < partitions; i++) count += batch.summaries[i].pattern_matches[p];
+        printf("  %8zu  [%zu] %s\n", count, p, matcher->patterns[p].text);
+    }
+    printf("\n");
+
+    free(counts);
+    free(batch.summaries);
+    return ok;
+}
+
+bool mbx_search(mojibake_target_t *target, unsigned int index, void *arg)
+{
+    const mbx_search_config_t *config = arg;
+    if (config == NULL || config->matcher == NULL) return false;
+
+    mbx_search_summary_t summary;
+    summary.pattern_matches = NULL;
+    bool ok = mbx_search_partition(target, index, config, &summary);
+    print_summary(index, &summary, config);
+    return ok;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file mbx_search.h
+ * @brief Multi-pattern signature search
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Finds every occurrence of a set of byte patterns in one pass with an
+ * Aho-Corasick automaton. The automaton is compiled into a transition
+ * table over byte classes (each byte that occurs in a pattern is its own
+ * class, all other bytes share one), so every input byte costs one table
+ * lookup however many patterns there are. While no match is in progress,
+ * bytes that cannot start a pattern are skipped 16 at a time with an SSSE3
+ * set-membership test when the CPU supports it.
+ *
+ * Partitions are searched in parallel. Each one scans past its end by the
+ * length of the longest pattern less one byte and reports the matches that
+ * start inside it, so matches spanning a partition boundary are found
+ * exactly once. Offsets are absolute file offsets.
+ *
+ * Pattern files hold one pattern per line. Empty lines and lines starting
+ * with '#' are ignored. A line starting with "hex:" gives the bytes in
+ * hexadecimal (whitespace between digits is ignored); any other line is
+ * literal text with the escapes \\, \n, \r, \t, \0 and \xHH.
+ */
+
+#ifndef MBX_SEARCH_H
+#define MBX_SEARCH_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mojibake/mojibake.h"
+
+#define MBX_SEARCH_MAX_PATTERN 1024      /**< Longest pattern in bytes */
+#define MBX_SEARCH_LISTED_MATCHES 16     /**< Matches listed per partition summary (the CSV has all) */
+
+/**
+ * @brief One search pattern
+ */
+typedef struct {
+    unsigned char *bytes;      /**< Pattern bytes */
+    size_t length;             /**< Length in bytes (at least 1) */
+    char *text;                /**< Pattern as written in the pattern file */
+} mbx_search_pattern_t;
+
+/**
+ * @brief Pattern set and its compiled automaton
+ */
+typedef struct {
+    mbx_search_pattern_t *patterns; /**< Patterns in the order they were added */
+    size_t pattern_count;      /**< Number of patterns */
+    size_t max_length;         /**< Length of the longest pattern */
+    unsigned char classes[256]; /**< Byte class of each byte value */
+    unsigned int class_count;  /**< Number of byte classes */
+    uint32_t *transitions;     /**< state_count x class_count entries: target row offset, top bit set if it reports matches */
+    int32_t *state_matches;    /**< First pattern ending at each state, -1 if none */
+    uint32_t *dictionary_links; /**< Nearest proper suffix state with matches (0 if none) */
+    int32_t *next_match;       /**< Next pattern ending at the same state, -1 if none */
+    size_t state_count;        /**< Number of automaton states */
+    unsigned char starts[256]; /**< Nonzero for bytes that start a pattern */
+    unsigned char start_low[16];  /**< Start bytes with high nibble 0-7: bit (high nibble) per low nibble */
+    unsigned char start_high[16]; /**< Start bytes with high nibble 8-F: bit (high nibble - 8) per low nibble */
+    bool prefilter;            /**< The CPU runs the SSSE3 start-byte skip (checked when compiling) */
+} mbx_search_matcher_t;
+
+/**
+ * @brief Called for each match
+ *
+ * @param pattern Index of the pattern that matched
+ * @param offset Offset of the first matching byte
+ * @param context Caller's context
+ */
+typedef void (*mbx_search_callback_t)(size_t pattern, size_t offset, void *context);
+
+/**
+ * @brief One match
+ */
+typedef struct {
+    size_t offset;             /**< File offset of the first matching byte */
+    size_t pattern;            /**< Index of the pattern */
+} mbx_search_match_t;
+
+/**
+ * @brief Search settings
+ */
+typedef struct {
+    const mbx_search_matcher_t *matcher; /**< Compiled patterns */
+    int threads;               /**< Worker threads (0 = one per online CPU) */
+    bool numa;                 /**< Pin workers to NUMA nodes and prefer node-local partitions */
+    bool write_matches;        /**< Write search_partition_<n>.csv */
+} mbx_search_config_t;
+
+/**
+ * @brief Per-partition summary
+ */
+typedef struct {
+    size_t offset;             /**< File offset of the partition */
+    size_t length;             /**< Partition length in bytes */
+    size_t matches;            /**< Matches starting in the partition */
+    size_t *pattern_matches;   /**< Optional per-pattern counts (pattern_count entries, zeroed by the caller) */
+    mbx_search_match_t listed[MBX_SEARCH_LISTED_MATCHES]; /**< First matches found */
+    int listed_count;          /**< Matches stored in listed */
+    bool ok;                   /**< Partition was read and searched completely */
+} mbx_search_summary_t;
+
+/**
+ * @brief Prepare an empty pattern set
+ *
+ * @param matcher Pointer to matcher
+ */
+void mbx_search_init(mbx_search_matcher_t *matcher);
+
+/**
+ * @brief Add a pattern (before compiling)
+ *
+ * @param matcher Pointer to matcher
+ * @param bytes Pattern bytes
+ * @param length Length in bytes (1 to MBX_SEARCH_MAX_PATTERN)
+ * @param text Pattern as it should be reported
+ * @return true on success, false on invalid length or allocation failure
+ */
+bool mbx_search_add(mbx_search_matcher_t *matcher, const unsigned char *bytes, size_t length, const char *text);
+
+/**
+ * @brief Build the automaton from the patterns added
+ *
+ * @param matcher Pointer to matcher
+ * @return true on success, false if there are no patterns or the table does not fit
+ */
+bool mbx_search_compile(mbx_search_matcher_t *matcher);
+
+/**
+ * @brief Read a pattern file and compile it
+ *
+ * @param path Path of the pattern file
+ * @param matcher Matcher to initialise
+ * @return true on success; on failure an error naming the line is printed
+ */
+bool mbx_search_load(const char *path, mbx_search_matcher_t *matcher);
+
+/**
+ * @brief Release a matcher
+ *
+ * @param matcher Pointer to matcher
+ */
+void mbx_search_free(mbx_search_matcher_t *matcher);
+
+/**
+ * @brief Feed bytes through the automaton
+ *
+ * The state carries partial matches from one call to the next, so a
+ * stream can be searched in chunks of any size.
+ *
+ * @param matcher Compiled matcher
+ * @param state Automaton state (0 before the first byte), updated
+ * @param bytes Bytes to search
+ * @param length Number of bytes
+ * @param offset Offset of bytes[0] in the stream
+ * @param callback Called for every match, in the order the matches end
+ * @param context Passed to the callback
+ */
+void mbx_search_scan(const mbx_search_matcher_t *matcher, uint32_t *state, const unsigned char *bytes,
+                     size_t length, size_t offset, mbx_search_callback_t callback, void *context);
+
+/**
+ * @brief Search one partition
+ *
+ * The last partition also covers the bytes left over by the partition
+ * size. Safe to call from several threads on the same target.
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index
+ * @param config Search settings
+ * @param summary Output summary (set pattern_matches before the call, or NULL)
+ * @return true if the partition was searched, false on read or write failure
+ */
+bool mbx_search_partition(mojibake_target_t *target, unsigned int index,
+                          const mbx_search_config_t *config, mbx_search_summary_t *summary);
+
+/**
+ * @brief Search all partitions in parallel and print their summaries
+ *
+ * @param target Pointer to mojibake target
+ * @param config Search settings
+ * @return true if every partition was searched
+ */
+bool mbx_search_batch(mojibake_target_t *target, const mbx_search_config_t *config);
+
+/**
+ * @brief Search module function (one partition, for mojibake_execute)
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index to process
+ * @param arg Pointer to mbx_search_config_t
+ * @return true if the partition was searched
+ */
+bool mbx_search(mojibake_target_t *target, unsigned int index, void *arg);
+
+#endif
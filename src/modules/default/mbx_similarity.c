@@ -0,0 +1,643 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_similarity.h"
+#include "mbx_parallel.h"
+#include "mbx_checkpoint.h"
+#include "mbx_endian.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Bytes read per refill beyond the window overlap
+#define SIMILARITY_READ_CHUNK (64 * 1024)
+
+#define INDEX_HEADER_BYTES 16
+#define INDEX_RECORD_BYTES 64
+
+// Low bit of every two-bit bucket code
+#define CODE_LOW_BITS 0x5555555555555555ull
+
+// Pearson permutation of the byte values
+static const unsigned char pearson_table[256] = {
+     26, 118, 108, 174,  20, 212, 141, 117, 179, 218,  52, 185, 197, 167,  91, 161,
+    194, 203, 216, 170, 242, 157, 134, 139, 186, 151,  41, 132, 178,  23, 225,  53,
+      8, 138,  71, 169, 109,   6,  18, 205, 115, 119, 190, 183, 123, 191, 128, 227,
+     22, 177, 176,  64, 198,  80,   2, 103, 188, 148,  97,  67, 208,  81,  74,  73,
+    113,  30, 137,  34, 187,   9, 129,  85, 240, 181, 231, 124, 150, 126, 130, 175,
+    204,  29, 217, 112,  68, 255, 106, 160,  79,  54,  82,  44, 152,  21,  16, 229,
+    121, 116, 171,  59,  89,  27, 105,  35, 200,  96, 233,  40, 156, 146, 234,  98,
+    199, 246, 219, 239,   3,  42, 243, 252,  12, 223,  39, 111,  92, 142, 158,  95,
+     75, 120,  47,  57, 235,  51,  94, 144, 206, 143, 182, 110, 228, 159, 237,  24,
+    213, 245, 202, 241, 211, 201,  14, 135,   0, 163, 133, 101, 162, 193, 244, 100,
+     50, 248, 254, 173, 209,  33,  46,  49, 114, 147,  99, 232,  58,  83,  84,  65,
+     87,  69, 214, 140, 195,  70,  78,  60, 172, 196,  10, 238,  88,  25,  56, 220,
+    210, 153,   4, 127, 102,  76, 207, 166,  62, 136, 164, 230,  13,  45,  32,   1,
+    236, 155,  15,  43, 221,  11,  31,   5,  63, 224, 251,  37, 154,  72, 215, 168,
+     48, 226,  90, 222,  77, 131, 149,  86, 253, 125, 104, 165, 247, 122,  55,  36,
+    250,  19,  17,  66, 189,  61, 192, 107,  93, 180,  28, 184,   7, 249, 145,  38
+};
+
+// Bucket of a salted byte triplet (the salt lookup folds into a constant)
+static unsigned int triplet_bucket(unsigned int salt, unsigned int a, unsigned int b, unsigned int c)
+{
+    unsigned int hash = pearson_table[pearson_table[salt] ^ a];
+    hash = pearson_table[hash ^ b];
+    return pearson_table[hash ^ c] & (MBX_SIMILARITY_BUCKETS - 1);
+}
+
+void mbx_similarity_init(mbx_similarity_counts_t *counts)
+{
+    memset(counts, 0, sizeof(*counts));
+}
+
+void mbx_similarity_add(mbx_similarity_counts_t *counts, const unsigned char *bytes, size_t length,
+                        size_t history)
+{
+    size_t first = history > MBX_SIMILARITY_WINDOW - 1 ? history : MBX_SIMILARITY_WINDOW - 1;
+    if (counts == NULL || bytes == NULL || length <= first) return;
+
+    uint32_t *buckets = counts->buckets;
+    unsigned int checksum = counts->checksum;
+    for (size_t i = first; i < length; i++) {
+        unsigned int w0 = bytes[i], w1 = bytes[i - 1], w2 = bytes[i - 2], w3 = bytes[i - 3], w4 = bytes[i - 4];
+        checksum += pearson_table[pearson_table[w0] ^ w1];
+        buckets[triplet_bucket(2, w0, w1, w2)]++;
+        buckets[triplet_bucket(3, w0, w1, w3)]++;
+        buckets[triplet_bucket(5, w0, w2, w3)]++;
+        buckets[triplet_bucket(7, w0, w2, w4)]++;
+        buckets[triplet_bucket(11, w0, w1, w4)]++;
+        buckets[triplet_bucket(13, w0, w3, w4)]++;
+    }
+    counts->checksum = (uint8_t)checksum;
+    counts->windows += length - first;
+}
+
+void mbx_similarity_merge(mbx_similarity_counts_t *counts, const mbx_similarity_counts_t *other)
+{
+    for (int b = 0; b < MBX_SIMILARITY_BUCKETS; b++) counts->buckets[b] += other->buckets[b];
+    counts->windows += other->windows;
+    counts->checksum = (uint8_t)(counts->checksum + other->checksum);
+}
+
+static int compare_counts(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Logarithmic length code of TLSH: fine steps for short inputs, coarser ones for long inputs
+static uint8_t length_code(uint64_t length)
+{
+    double value;
+    if (length <= 656) {
+        value = log((double)length) / log(1.5);
+    } else if (length <= 3199) {
+        value = log((double)length) / log(1.3) - 8.72777;
+    } else {
+        value = log((double)length) / log(1.1) - 62.5472;
+    }
+    return (uint8_t)((unsigned int)floor(value) & 0xFF);
+}
+
+bool mbx_similarity_digest(const mbx_similarity_counts_t *counts, mbx_similarity_digest_t *digest)
+{
+    memset(digest, 0, sizeof(*digest));
+    uint64_t length = counts->windows + MBX_SIMILARITY_WINDOW - 1;
+    if (counts->windows == 0 || length < MBX_SIMILARITY_MIN_LENGTH) return false;
+
+    uint32_t sorted[MBX_SIMILARITY_BUCKETS];
+    memcpy(sorted, counts->buckets, sizeof(sorted));
+    qsort(sorted, MBX_SIMILARITY_BUCKETS, sizeof(sorted[0]), compare_counts);
+
+    // Too few buckets in use to rank them meaningfully
+    int empty = 0;
+    while (empty < MBX_SIMILARITY_BUCKETS && sorted[empty] == 0) empty++;
+    if (empty >= MBX_SIMILARITY_BUCKETS / 2) return false;
+
+    uint32_t q1 = sorted[MBX_SIMILARITY_BUCKETS / 4 - 1];
+    uint32_t q2 = sorted[MBX_SIMILARITY_BUCKETS / 2 - 1];
+    uint32_t q3 = sorted[MBX_SIMILARITY_BUCKETS * 3 / 4 - 1];
+    for (int b = 0; b < MBX_SIMILARITY_BUCKETS; b++) {
+        uint32_t count = counts->buckets[b];
+        unsigned int code = count <= q1 ? 0 : count <= q2 ? 1 : count <= q3 ? 2 : 3;
+        digest->body[b / 4] |= (uint8_t)(code << (2 * (b % 4)));
+    }
+
+    digest->checksum = counts->checksum;
+    digest->lvalue = length_code(length);
+    unsigned int q1_ratio = (unsigned int)((uint64_t)q1 * 100 / q3) % 16;
+    unsigned int q2_ratio = (unsigned int)((uint64_t)q2 * 100 / q3) % 16;
+    digest->qratios = (uint8_t)(q1_ratio << 4 | q2_ratio);
+    digest->valid = true;
+    return true;
+}
+
+static int modular_difference(int a, int b, int range)
+{
+    int difference = a > b ? a - b : b - a;
+    return difference < range - difference ? difference : range - difference;
+}
+
+/*
+ * Sum over the buckets of the code difference, with codes at opposite ends
+ * (0 and 3) weighing 6. Per two-bit field, x = a ^ b is 01 for codes one
+ * apart, 10 for codes two apart, and 11 either for 01/10 (one apart) or
+ * for 00/11 (three apart); the last two differ in whether a's bits match.
+ */
+static int body_distance(const uint8_t *a, const uint8_t *b)
+{
+    int distance = 0;
+    for (int word = 0; word < MBX_SIMILARITY_BODY_BYTES / 8; word++) {
+        uint64_t x, y;
+        memcpy(&x, a + 8 * word, 8);
+        memcpy(&y, b + 8 * word, 8);
+
+        uint64_t low = (x ^ y) & CODE_LOW_BITS;
+        uint64_t high = ((x ^ y) >> 1) & CODE_LOW_BITS;
+        uint64_t uniform = ~(x ^ (x >> 1)) & CODE_LOW_BITS;
+        uint64_t one = (low & ~high) | (low & high & ~uniform);
+        uint64_t two = high & ~low;
+        uint64_t three = low & high & uniform;
+        distance += __builtin_popcountll(one) + 2 * __builtin_popcountll(two) + 6 * __builtin_popcountll(three);
+    }
+    return distance;
+}
+
+int mbx_similarity_distance(const mbx_similarity_digest_t *a, const mbx_similarity_digest_t *b)
+{
+    if (!a->valid || !b->valid) return -1;
+
+    int distance = 0;
+    int length = modular_difference(a->lvalue, b->lvalue, 256);
+    distance += length <= 1 ? length : length * 12;
+
+    int q1 = modular_difference(a->qratios >> 4, b->qratios >> 4, 16);
+    distance += q1 <= 1 ? q1 : (q1 - 1) * 12;
+    int q2 = modular_difference(a->qratios & 15, b->qratios & 15, 16);
+    distance += q2 <= 1 ? q2 : (q2 - 1) * 12;
+
+    distance += a->checksum != b->checksum;
+    return distance + body_distance(a->body, b->body);
+}
+
+// Checksum, length code, quartile ratios, then the body
+static void pack_digest(const mbx_similarity_digest_t *digest, uint8_t *bytes)
+{
+    bytes[0] = digest->checksum;
+    bytes[1] = digest->lvalue;
+    bytes[2] = digest->qratios;
+    memcpy(bytes + 3, digest->body, MBX_SIMILARITY_BODY_BYTES);
+}
+
+static void unpack_digest(const uint8_t *bytes, mbx_similarity_digest_t *digest)
+{
+    digest->checksum = bytes[0];
+    digest->lvalue = bytes[1];
+    digest->qratios = bytes[2];
+    memcpy(digest->body, bytes + 3, MBX_SIMILARITY_BODY_BYTES);
+    digest->valid = true;
+}
+
+void mbx_similarity_format(const mbx_similarity_digest_t *digest, char *text)
+{
+    if (!digest->valid) {
+        strcpy(text, "-");
+        return;
+    }
+
+    uint8_t bytes[MBX_SIMILARITY_DIGEST_BYTES];
+    pack_digest(digest, bytes);
+    for (int i = 0; i < MBX_SIMILARITY_DIGEST_BYTES; i++) {
+        snprintf(text + 2 * i, 3, "%02X", bytes[i]);
+    }
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool mbx_similarity_parse(const char *text, mbx_similarity_digest_t *digest)
+{
+    memset(digest, 0, sizeof(*digest));
+    if (text == NULL || strlen(text) != MBX_SIMILARITY_TEXT_LENGTH) return false;
+
+    uint8_t bytes[MBX_SIMILARITY_DIGEST_BYTES];
+    for (int i = 0; i < MBX_SIMILARITY_DIGEST_BYTES; i++) {
+        int high = hex_value(text[2 * i]), low = hex_value(text[2 * i + 1]);
+        if (high < 0 || low < 0) return false;
+        bytes[i] = (uint8_t)(high << 4 | low);
+    }
+    unpack_digest(bytes, digest);
+    return true;
+}
+
+static bool reserve_entries(mbx_similarity_index_t *index, size_t count)
+{
+    if (count <= index->capacity) return true;
+    size_t capacity = index->capacity > 0 ? index->capacity : 64;
+    while (capacity < count) capacity *= 2;
+    mbx_similarity_entry_t *entries = realloc(index->entries, capacity * sizeof(*entries));
+    if (!entries) return false;
+    index->entries = entries;
+    index->capacity = capacity;
+    return true;
+}
+
+static bool reserve_paths(mbx_similarity_index_t *index, size_t size)
+{
+    if (size <= index->paths_capacity) return true;
+    size_t capacity = index->paths_capacity > 0 ? index->paths_capacity : 4096;
+    while (capacity < size) capacity *= 2;
+    char *paths = realloc(index->paths, capacity);
+    if (!paths) return false;
+    index->paths = paths;
+    index->paths_capacity = capacity;
+    return true;
+}
+
+bool mbx_similarity_index_load(mbx_similarity_index_t *index, const char *filename)
+{
+    memset(index, 0, sizeof(*index));
+    snprintf(index->filename, sizeof(index->filename), "%s", filename);
+
+    FILE *file = fopen(filename, "rb");
+    if (!file) return true;
+
+    uint8_t header[INDEX_HEADER_BYTES];
+    bool ok = fread(header, 1, sizeof(header), file) == sizeof(header) && memcmp(header, "MBXSIM", 6) == 0 &&
+              header[6] == MBX_SIMILARITY_INDEX_VERSION;
+    size_t count = ok ? mbx_get_le32(header + 8) : 0;
+    size_t paths_size = ok ? mbx_get_le32(header + 12) : 0;
+    ok = ok && reserve_entries(index, count) && reserve_paths(index, paths_size);
+
+    uint8_t record[INDEX_RECORD_BYTES];
+    for (size_t i = 0; ok && i < count; i++) {
+        if (fread(record, 1, sizeof(record), file) != sizeof(record)) {
+            ok = false;
+            break;
+        }
+        mbx_similarity_entry_t *entry = &index->entries[i];
+        unpack_digest(record, &entry->digest);
+        entry->path = mbx_get_le32(record + 36);
+        entry->partition = mbx_get_le32(record + 40);
+        entry->partition_count = mbx_get_le32(record + 44);
+        entry->offset = mbx_get_le64(record + 48);
+        entry->length = mbx_get_le64(record + 56);
+        ok = entry->path < paths_size;
+    }
+
+    // Every path must be terminated inside the pool
+    ok = ok && fread(index->paths, 1, paths_size, file) == paths_size &&
+         (paths_size == 0 || index->paths[paths_size - 1] == '\0');
+    fclose(file);
+
+    if (!ok) {
+        printf("Error: %s is not a valid similarity index\n", filename);
+        mbx_similarity_index_free(index);
+        return false;
+    }
+    index->count = count;
+    index->paths_size = paths_size;
+    return true;
+}
+
+bool mbx_similarity_index_save(const mbx_similarity_index_t *index)
+{
+    char temp_filename[272];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", index->filename);
+
+    FILE *file = fopen(temp_filename, "wb");
+    if (!file) return false;
+
+    uint8_t header[INDEX_HEADER_BYTES] = {'M', 'B', 'X', 'S', 'I', 'M', MBX_SIMILARITY_INDEX_VERSION, 0};
+    mbx_put_le32(header + 8, (uint32_t)index->count);
+    mbx_put_le32(header + 12, (uint32_t)index->paths_size);
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+    uint8_t record[INDEX_RECORD_BYTES];
+    for (size_t i = 0; ok && i < index->count; i++) {
+        const mbx_similarity_entry_t *entry = &index->entries[i];
+        memset(record, 0, sizeof(record));
+        pack_digest(&entry->digest, record);
+        mbx_put_le32(record + 36, entry->path);
+        mbx_put_le32(record + 40, entry->partition);
+        mbx_put_le32(record + 44, entry->partition_count);
+        mbx_put_le64(record + 48, entry->offset);
+        mbx_put_le64(record + 56, entry->length);
+        ok = fwrite(record, 1, sizeof(record), file) == sizeof(record);
+    }
+    ok = ok && fwrite(index->paths, 1, index->paths_size, file) == index->paths_size;
+
+    // The old index stays in place until the new one is fully on disk
+    if (fclose(file) != 0) ok = false;
+    ok = ok && mbx_checkpoint_sync_file(temp_filename) &&
+         mbx_checkpoint_replace_file(temp_filename, index->filename);
+    if (!ok) remove(temp_filename);
+    return ok;
+}
+
+size_t mbx_similarity_index_remove(mbx_similarity_index_t *index, const char *path)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < index->count; i++) {
+        if (strcmp(index->paths + index->entries[i].path, path) != 0) index->entries[kept++] = index->entries[i];
+    }
+    size_t removed = index->count - kept;
+    index->count = kept;
+    if (removed == 0) return 0;
+
+    // Rebuild the pool from the remaining paths; a file's records are adjacent and share one path
+    char *paths = malloc(index->paths_capacity);
+    if (!paths) return removed;
+    size_t size = 0;
+    uint32_t previous_old = 0, previous_new = 0;
+    for (size_t i = 0; i < index->count; i++) {
+        mbx_similarity_entry_t *entry = &index->entries[i];
+        if (i == 0 || entry->path != previous_old) {
+            previous_old = entry->path;
+            previous_new = (uint32_t)size;
+            size_t length = strlen(index->paths + entry->path) + 1;
+            memcpy(paths + size, index->paths + entry->path, length);
+            size += length;
+        }
+        entry->path = previous_new;
+    }
+    free(index->paths);
+    index->paths = paths;
+    index->paths_size = size;
+    return removed;
+}
+
+bool mbx_similarity_index_add(mbx_similarity_index_t *index, const char *path, const mbx_similarity_entry_t *entry)
+{
+    if (!entry->digest.valid || !reserve_entries(index, index->count + 1)) return false;
+
+    // Records of one file are added together, so only the last path can be shared
+    uint32_t offset;
+    if (index->count > 0 && strcmp(index->paths + index->entries[index->count - 1].path, path) == 0) {
+        offset = index->entries[index->count - 1].path;
+    } else {
+        size_t length = strlen(path) + 1;
+        if (index->paths_size + length > UINT32_MAX || !reserve_paths(index, index->paths_size + length))
+            return false;
+        offset = (uint32_t)index->paths_size;
+        memcpy(index->paths + index->paths_size, path, length);
+        index->paths_size += length;
+    }
+
+    index->entries[index->count] = *entry;
+    index->entries[index->count].path = offset;
+    index->count++;
+    return true;
+}
+
+const char *mbx_similarity_index_path(const mbx_similarity_index_t *index, size_t entry)
+{
+    return index->paths + index->entries[entry].path;
+}
+
+size_t mbx_similarity_index_nearest(const mbx_similarity_index_t *index, const mbx_similarity_digest_t *digest,
+                                    bool whole_file, int max_distance, mbx_similarity_neighbour_t *neighbours,
+                                    size_t k)
+{
+    size_t found = 0;
+    if (!digest->valid || k == 0) return 0;
+
+    for (size_t i = 0; i < index->count; i++) {
+        const mbx_similarity_entry_t *entry = &index->entries[i];
+        if ((entry->partition == MBX_SIMILARITY_WHOLE_FILE) != whole_file) continue;
+
+        int distance = mbx_similarity_distance(digest, &entry->digest);
+        if (distance < 0 || distance > max_distance) continue;
+        if (found == k && distance >= neighbours[k - 1].distance) continue;
+
+        // Insertion into the short sorted list (earlier entries win ties)
+        size_t position = found < k ? found++ : k - 1;
+        while (position > 0 && neighbours[position - 1].distance > distance) {
+            neighbours[position] = neighbours[position - 1];
+            position--;
+        }
+        neighbours[position].entry = i;
+        neighbours[position].distance = distance;
+    }
+    return found;
+}
+
+void mbx_similarity_index_free(mbx_similarity_index_t *index)
+{
+    free(index->entries);
+    free(index->paths);
+    index->entries = NULL;
+    index->paths = NULL;
+    index->count = index->capacity = 0;
+    index->paths_size = index->paths_capacity = 0;
+}
+
+bool mbx_similarity_partition(mojibake_target_t *target, unsigned int index, mbx_similarity_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    if (target == NULL || index >= target->partition_count) return false;
+
+    size_t offset = (size_t)index * target->partition_size;
+    size_t length = target->partition_size;
+    if (index == target->partition_count - 1) length = target->size - offset;
+    size_t end = offset + length;
+    summary->offset = offset;
+    summary->length = length;
+
+    const size_t overlap = MBX_SIMILARITY_WINDOW - 1;
+    unsigned char *buffer = malloc(SIMILARITY_READ_CHUNK + overlap);
+    bool ok = buffer != NULL;
+
+    // Windows that end in the first bytes of the partition and start in the partitions before
+    if (ok && offset > 0) {
+        size_t start = offset > overlap ? offset - overlap : 0;
+        size_t stop = offset + overlap < end ? offset + overlap : end;
+        ok = mojibake_read(target, start, buffer, stop - start) == stop - start;
+        if (ok) mbx_similarity_add(&summary->lead, buffer, stop - start, offset - start);
+    }
+
+    size_t position = offset;
+    while (ok && position < end) {
+        size_t history = position > offset ? overlap : 0;
+        size_t count = end - position < SIMILARITY_READ_CHUNK ? end - position : SIMILARITY_READ_CHUNK;
+        ok = mojibake_read(target, position - history, buffer, history + count) == history + count;
+        if (ok) mbx_similarity_add(&summary->counts, buffer, history + count, history);
+        position += count;
+    }
+    free(buffer);
+
+    mbx_similarity_digest(&summary->counts, &summary->digest);
+    summary->ok = ok;
+    return ok;
+}
+
+static void print_digest(const mbx_similarity_digest_t *digest)
+{
+    char text[MBX_SIMILARITY_TEXT_LENGTH + 1];
+    mbx_similarity_format(digest, text);
+    if (digest->valid) {
+        printf("Digest: %s\n", text);
+    } else {
+        printf("Digest: none (needs %d bytes that are not mostly one pattern)\n", MBX_SIMILARITY_MIN_LENGTH);
+    }
+}
+
+static void print_summary(unsigned int index, const mbx_similarity_summary_t *summary)
+{
+    printf("=== Partition %u Similarity Digest ===\n", index);
+    printf("Range: %zu - %zu (%zu bytes)\n", summary->offset, summary->offset + summary->length, summary->length);
+    if (!summary->ok) {
+        printf("Error: Partition could not be read completely\n");
+        return;
+    }
+    print_digest(&summary->digest);
+}
+
+typedef struct {
+    mojibake_target_t *target;
+    mbx_similarity_summary_t *summaries;
+} similarity_batch_t;
+
+static void similarity_job(void *arg, unsigned int index, int worker)
+{
+    similarity_batch_t *batch = arg;
+    (void)worker;
+    mbx_similarity_partition(batch->target, index, &batch->summaries[index]);
+}
+
+// Print the closest indexed partition to each partition, and the closest files to the file
+static void report_neighbours(const mbx_similarity_index_t *index, const mbx_similarity_summary_t *summaries,
+                              unsigned int partition_count, const mbx_similarity_digest_t *file_digest)
+{
+    printf("=== Similar Data in %s ===\n", index->filename);
+
+    mbx_similarity_neighbour_t neighbours[MBX_SIMILARITY_NEIGHBOURS];
+    size_t found = mbx_similarity_index_nearest(index, file_digest, true, MBX_SIMILARITY_MATCH_DISTANCE,
+                                                neighbours, MBX_SIMILARITY_NEIGHBOURS);
+    if (found == 0) {
+        printf("Files: none within distance %d\n", MBX_SIMILARITY_MATCH_DISTANCE);
+    } else {
+        printf("Files:\n");
+    }
+    for (size_t i = 0; i < found; i++) {
+        printf("  %4d  %s\n", neighbours[i].distance, mbx_similarity_index_path(index, neighbours[i].entry));
+    }
+
+    unsigned int matched = 0;
+    for (unsigned int p = 0; p < partition_count; p++) {
+        if (mbx_similarity_index_nearest(index, &summaries[p].digest, false, MBX_SIMILARITY_MATCH_DISTANCE,
+                                         neighbours, 1) == 0) {
+            continue;
+        }
+        const mbx_similarity_entry_t *entry = &index->entries[neighbours[0].entry];
+        if (matched++ == 0) printf("Partitions:\n");
+        printf("  %4d  partition %u ~ %s partition %u of %u (offset %llu)\n", neighbours[0].distance, p,
+               mbx_similarity_index_path(index, neighbours[0].entry), entry->partition, entry->partition_count,
+               (unsigned long long)entry->offset);
+    }
+    if (matched == 0) {
+        printf("Partitions: none within distance %d\n", MBX_SIMILARITY_MATCH_DISTANCE);
+    }
+    printf("\n");
+}
+
+// Replace the file's digests in the index with the new ones
+static bool update_index(mbx_similarity_index_t *index, const char *path, const mbx_similarity_summary_t *summaries,
+                         unsigned int partition_count, const mbx_similarity_digest_t *file_digest, size_t size)
+{
+    mbx_similarity_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.partition_count = partition_count;
+    bool ok = true;
+
+    if (file_digest->valid) {
+        entry.digest = *file_digest;
+        entry.partition = MBX_SIMILARITY_WHOLE_FILE;
+        entry.offset = 0;
+        entry.length = size;
+        ok = mbx_similarity_index_add(index, path, &entry);
+    }
+    for (unsigned int p = 0; ok && p < partition_count; p++) {
+        if (!summaries[p].digest.valid) continue;
+        entry.digest = summaries[p].digest;
+        entry.partition = p;
+        entry.offset = summaries[p].offset;
+        entry.length = summaries[p].length;
+        ok = mbx_similarity_index_add(index, path, &entry);
+    }
+    if (!ok || !mbx_similarity_index_save(index)) {
+        printf("Error: Could not update similarity index %s\n", index->filename);
+        return false;
+    }
+
+    size_t files = 0;
+    for (size_t i = 0; i < index->count; i++) {
+        files += i == 0 || index->entries[i].path != index->entries[i - 1].path;
+    }
+    printf("[INDEX] %s now holds %zu digests of %zu files\n", index->filename, index->count, files);
+    return true;
+}
+
+bool mbx_similarity_batch(mojibake_target_t *target, const mbx_similarity_config_t *config)
+{
+    if (target == NULL || config == NULL) return false;
+
+    similarity_batch_t batch = {.target = target};
+    batch.summaries = calloc(target->partition_count, sizeof(mbx_similarity_summary_t));
+    if (!batch.summaries) return false;
+
+    mbx_parallel_job_t job = {.threads = config->threads, .numa = config->numa,
+                              .partition = similarity_job, .arg = &batch};
+    int threads = mbx_parallel_run(target, &job);
+    printf("[SIMILAR] %u partitions on %d threads\n\n", target->partition_count, threads);
+
+    // Partition counts plus the windows across each boundary give the file's counts
+    bool ok = true;
+    mbx_similarity_counts_t file_counts;
+    mbx_similarity_init(&file_counts);
+    for (unsigned int i = 0; i < target->partition_count; i++) {
+        print_summary(i, &batch.summaries[i]);
+        printf("\n");
+        mbx_similarity_merge(&file_counts, &batch.summaries[i].counts);
+        mbx_similarity_merge(&file_counts, &batch.summaries[i].lead);
+        ok = ok && batch.summaries[i].ok;
+    }
+
+    mbx_similarity_digest_t file_digest;
+    memset(&file_digest, 0, sizeof(file_digest));
+    if (ok) mbx_similarity_digest(&file_counts, &file_digest);
+    printf("=== File Similarity Digest ===\n");
+    print_digest(&file_digest);
+    printf("\n");
+
+    if (ok && config->index_file) {
+        mbx_similarity_index_t index;
+        ok = mbx_similarity_index_load(&index, config->index_file);
+        if (ok) {
+            // A file indexed before is compared with the rest of the corpus, not its old digests
+            mbx_similarity_index_remove(&index, config->path);
+            report_neighbours(&index, batch.summaries, target->partition_count, &file_digest);
+            ok = update_index(&index, config->path, batch.summaries, target->partition_count, &file_digest,
+                              target->size);
+            mbx_similarity_index_free(&index);
+        }
+    }
+
+    free(batch.summaries);
+    return ok;
+}
+
+bool mbx_similarity(mojibake_target_t *target, unsigned int index, void *arg)
+{
+    (void)arg;
+    mbx_similarity_summary_t summary;
+    bool ok = mbx_similarity_partition(target, index, &summary);
+    print_summary(index, &summary);
+    printf("\n");
+    return ok;
+}
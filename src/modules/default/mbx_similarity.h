@@ -0,0 +1,300 @@
+/**
+ * @file mbx_similarity.h
+ * @brief Similarity digests for near-duplicate detection
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Computes locality-sensitive digests in the style of TLSH: a window of
+ * five bytes slides over the data, and six byte triplets from each window
+ * are hashed into 128 buckets. Every bucket is then coded in two bits by
+ * which quartile of the bucket counts it falls in. Similar inputs give
+ * digests a small distance apart, where a cryptographic hash would change
+ * completely. Distances up to about 100 indicate near-duplicates.
+ *
+ * The digest layout and distance follow TLSH (checksum, length code,
+ * quartile ratios, 32-byte body), but the hash table and checksum are this
+ * module's own, so the digests are not comparable with those of the tlsh
+ * tool. The checksum is a sum over the windows rather than a running hash,
+ * so bucket counts from partitions add up to those of the whole file and
+ * file digests come out of the parallel partition pass.
+ *
+ * An index file keeps the digests of a corpus: per file and per partition,
+ * with the path each file was indexed under. Its records have a fixed size,
+ * so the whole index is read in one go and searched with a linear scan
+ * that costs a few popcounts per record (well under a millisecond for
+ * thousands of files).
+ *
+ * Index layout (integers little-endian):
+ * - 16-byte header: "MBXSIM", version byte, zero byte, record count (u32),
+ *   path pool size in bytes (u32)
+ * - 64-byte records: digest (35 bytes), zero byte, path pool offset (u32),
+ *   partition (u32, 0xFFFFFFFF for the whole file), partition count (u32),
+ *   offset (u64), length (u64)
+ * - path pool: NUL-terminated paths
+ */
+
+#ifndef MBX_SIMILARITY_H
+#define MBX_SIMILARITY_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mojibake/mojibake.h"
+
+#define MBX_SIMILARITY_BUCKETS 128       /**< Buckets coded in the digest body */
+#define MBX_SIMILARITY_WINDOW 5          /**< Sliding window length in bytes */
+#define MBX_SIMILARITY_MIN_LENGTH 50     /**< Shortest input that gets a digest */
+#define MBX_SIMILARITY_BODY_BYTES 32     /**< Digest body: two bits per bucket */
+#define MBX_SIMILARITY_DIGEST_BYTES 35   /**< Checksum, length code, quartile ratios and body */
+#define MBX_SIMILARITY_TEXT_LENGTH 70    /**< Hexadecimal digest length, without the terminator */
+#define MBX_SIMILARITY_MATCH_DISTANCE 100 /**< Largest distance reported as a near-duplicate */
+#define MBX_SIMILARITY_NEIGHBOURS 5      /**< Near-duplicate files listed for the file digest */
+#define MBX_SIMILARITY_WHOLE_FILE 0xFFFFFFFFu /**< Partition number of whole-file index records */
+#define MBX_SIMILARITY_INDEX_VERSION 1
+
+/**
+ * @brief Bucket counts of the windows seen so far
+ *
+ * Counts add up, so ranges can be counted separately and merged.
+ */
+typedef struct {
+    uint32_t buckets[MBX_SIMILARITY_BUCKETS]; /**< Triplets hashed into each bucket */
+    uint64_t windows;          /**< Windows counted */
+    uint8_t checksum;          /**< Sum of the window checksums, modulo 256 */
+} mbx_similarity_counts_t;
+
+/**
+ * @brief Similarity digest
+ */
+typedef struct {
+    bool valid;                /**< Input was long and varied enough to digest */
+    uint8_t checksum;          /**< Checksum of the windows */
+    uint8_t lvalue;            /**< Logarithmic length code */
+    uint8_t qratios;           /**< Quartile ratios q1/q3 (high nibble) and q2/q3 (low nibble), in percent modulo 16 */
+    uint8_t body[MBX_SIMILARITY_BODY_BYTES]; /**< Quartile codes, bucket 4k + j in bits 2j-2j+1 of byte k */
+} mbx_similarity_digest_t;
+
+/**
+ * @brief One digest in an index
+ */
+typedef struct {
+    mbx_similarity_digest_t digest; /**< Digest of the file or partition */
+    uint32_t path;             /**< Offset of the file's path in the path pool */
+    uint32_t partition;        /**< Partition number, MBX_SIMILARITY_WHOLE_FILE for the file */
+    uint32_t partition_count;  /**< Partitions the file was split into */
+    uint64_t offset;           /**< File offset of the digested range */
+    uint64_t length;           /**< Length of the digested range in bytes */
+} mbx_similarity_entry_t;
+
+/**
+ * @brief Index of the digests of a corpus
+ */
+typedef struct {
+    char filename[256];        /**< Index file */
+    mbx_similarity_entry_t *entries; /**< Digests, the records of one file kept together */
+    size_t count;              /**< Digests in the index */
+    size_t capacity;           /**< Allocated entries */
+    char *paths;               /**< Path pool */
+    size_t paths_size;         /**< Bytes used in the path pool */
+    size_t paths_capacity;     /**< Allocated path pool bytes */
+} mbx_similarity_index_t;
+
+/**
+ * @brief An index entry close to a query digest
+ */
+typedef struct {
+    size_t entry;              /**< Index of the entry */
+    int distance;              /**< Distance to the query */
+} mbx_similarity_neighbour_t;
+
+/**
+ * @brief Module settings
+ */
+typedef struct {
+    int threads;               /**< Worker threads (0 = one per online CPU) */
+    bool numa;                 /**< Pin workers to NUMA nodes and prefer node-local partitions */
+    const char *index_file;    /**< Index to search and add the file to, NULL for none */
+    const char *path;          /**< Name the file is indexed under */
+} mbx_similarity_config_t;
+
+/**
+ * @brief Per-partition result
+ */
+typedef struct {
+    size_t offset;             /**< File offset of the partition */
+    size_t length;             /**< Partition length in bytes */
+    mbx_similarity_counts_t counts; /**< Windows inside the partition */
+    mbx_similarity_counts_t lead;   /**< Windows that end in the partition but start before it */
+    mbx_similarity_digest_t digest; /**< Digest of the partition on its own */
+    bool ok;                   /**< Partition was read completely */
+} mbx_similarity_summary_t;
+
+/**
+ * @brief Empty the bucket counts
+ *
+ * @param counts Pointer to counts
+ */
+void mbx_similarity_init(mbx_similarity_counts_t *counts);
+
+/**
+ * @brief Count the windows that end in a range
+ *
+ * The range may be preceded by up to four bytes of history, so a stream
+ * can be counted in chunks that overlap by four bytes.
+ *
+ * @param counts Counts to add to
+ * @param bytes History followed by the range
+ * @param length Number of bytes including the history
+ * @param history Bytes before the range
+ */
+void mbx_similarity_add(mbx_similarity_counts_t *counts, const unsigned char *bytes, size_t length,
+                        size_t history);
+
+/**
+ * @brief Add one set of counts into another
+ *
+ * @param counts Counts to add to
+ * @param other Counts to add
+ */
+void mbx_similarity_merge(mbx_similarity_counts_t *counts, const mbx_similarity_counts_t *other);
+
+/**
+ * @brief Turn bucket counts into a digest
+ *
+ * @param counts Counts of contiguous data
+ * @param digest Output digest; invalid for fewer than MBX_SIMILARITY_MIN_LENGTH
+ *        bytes or when more than half the buckets are empty
+ * @return digest->valid
+ */
+bool mbx_similarity_digest(const mbx_similarity_counts_t *counts, mbx_similarity_digest_t *digest);
+
+/**
+ * @brief Distance between two digests
+ *
+ * @param a First digest
+ * @param b Second digest
+ * @return 0 for matching digests, larger for less similar data; -1 if either is invalid
+ */
+int mbx_similarity_distance(const mbx_similarity_digest_t *a, const mbx_similarity_digest_t *b);
+
+/**
+ * @brief Format a digest as hexadecimal
+ *
+ * @param digest Digest
+ * @param text Output of MBX_SIMILARITY_TEXT_LENGTH + 1 bytes ("-" for an invalid digest)
+ */
+void mbx_similarity_format(const mbx_similarity_digest_t *digest, char *text);
+
+/**
+ * @brief Parse a hexadecimal digest
+ *
+ * @param text Text from mbx_similarity_format
+ * @param digest Output digest
+ * @return true if text holds a digest
+ */
+bool mbx_similarity_parse(const char *text, mbx_similarity_digest_t *digest);
+
+/**
+ * @brief Open an index file
+ *
+ * A missing file gives an empty index that is created on save.
+ *
+ * @param index Index to initialise
+ * @param filename Index file
+ * @return true on success; false (with an error printed) for an unreadable or corrupt index
+ */
+bool mbx_similarity_index_load(mbx_similarity_index_t *index, const char *filename);
+
+/**
+ * @brief Atomically replace the index file with the index
+ *
+ * @param index Pointer to index
+ * @return true if the index was written, synced and renamed into place
+ */
+bool mbx_similarity_index_save(const mbx_similarity_index_t *index);
+
+/**
+ * @brief Drop every digest of a file
+ *
+ * @param index Pointer to index
+ * @param path Name the file was indexed under
+ * @return Number of digests removed
+ */
+size_t mbx_similarity_index_remove(mbx_similarity_index_t *index, const char *path);
+
+/**
+ * @brief Add a digest
+ *
+ * @param index Pointer to index
+ * @param path Name of the file the digest belongs to
+ * @param entry Digest and range (the path field is filled in)
+ * @return true on success, false on allocation failure
+ */
+bool mbx_similarity_index_add(mbx_similarity_index_t *index, const char *path, const mbx_similarity_entry_t *entry);
+
+/**
+ * @brief Path of an entry
+ *
+ * @param index Pointer to index
+ * @param entry Index of the entry
+ * @return Path the entry's file was indexed under
+ */
+const char *mbx_similarity_index_path(const mbx_similarity_index_t *index, size_t entry);
+
+/**
+ * @brief Find the digests closest to a query
+ *
+ * @param index Pointer to index
+ * @param digest Query digest
+ * @param whole_file Search file digests (true) or partition digests (false)
+ * @param max_distance Largest distance to report
+ * @param neighbours Output, closest first
+ * @param k Capacity of neighbours
+ * @return Number of neighbours found
+ */
+size_t mbx_similarity_index_nearest(const mbx_similarity_index_t *index, const mbx_similarity_digest_t *digest,
+                                    bool whole_file, int max_distance, mbx_similarity_neighbour_t *neighbours,
+                                    size_t k);
+
+/**
+ * @brief Release an index
+ *
+ * @param index Pointer to index
+ */
+void mbx_similarity_index_free(mbx_similarity_index_t *index);
+
+/**
+ * @brief Digest one partition
+ *
+ * The last partition also covers the bytes left over by the partition
+ * size. Safe to call from several threads on the same target.
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index
+ * @param summary Output result
+ * @return true if the partition was read completely
+ */
+bool mbx_similarity_partition(mojibake_target_t *target, unsigned int index, mbx_similarity_summary_t *summary);
+
+/**
+ * @brief Digest all partitions in parallel, then the file, and consult the index
+ *
+ * With an index file, prints the indexed files and partitions closest to
+ * this file's digests, then replaces the file's digests in the index.
+ *
+ * @param target Pointer to mojibake target
+ * @param config Module settings
+ * @return true if every partition was digested and the index (if any) was updated
+ */
+bool mbx_similarity_batch(mojibake_target_t *target, const mbx_similarity_config_t *config);
+
+/**
+ * @brief Similarity module function (one partition, for mojibake_execute)
+ *
+ * @param target Pointer to mojibake target
+ * @param index Partition index to process
+ * @param arg Unused (may be NULL)
+ * @return true if the partition was digested
+ */
+bool mbx_similarity(mojibake_target_t *target, unsigned int index, void *arg);
+
+#endif
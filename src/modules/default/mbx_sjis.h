@@ -0,0 +1,28 @@
+/**
+ * @file mbx_sjis.h
+ * @brief Shift-JIS to Unicode mapping
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Double-byte characters follow code page 932, the Shift-JIS variant that
+ * Windows and most Japanese text files use (JIS X 0208 plus the NEC and IBM
+ * extensions). The user-defined area (lead bytes 0xF0-0xF9) is treated as
+ * unassigned, so that arbitrary binary data does not decode as valid text.
+ */
+
+#ifndef MBX_SJIS_H
+#define MBX_SJIS_H
+#include <stdint.h>
+
+#define MBX_SJIS_TRAILS 188  /**< Trail bytes per lead byte (0x40-0x7E, 0x80-0xFC) */
+
+/**
+ * @brief Map a double-byte character to Unicode
+ *
+ * @param lead Lead byte
+ * @param trail Trail byte
+ * @return Unicode code point, or 0 if the pair is not an assigned character
+ */
+uint16_t mbx_sjis_to_unicode(unsigned char lead, unsigned char trail);
+
+#endif
@@ -1,9 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
 #include "mbx_sonar.h"
+#include "mbx_digest.h"
+#include "mbx_lz.h"
+#include "mbx_queue.h"
 #include <stdio.h>
 #include <stdlib.h>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -16,6 +21,7 @@
 #define FREE_LIBRARY(handle) FreeLibrary(handle)
 #else
 #include <dlfcn.h>
+#include <unistd.h>
 #define LOAD_LIBRARY(path) dlopen(path, RTLD_LAZY)
 #define GET_PROC_ADDRESS(handle, name) dlsym(handle, name)
 #define FREE_LIBRARY(handle) dlclose(handle)
@@ -27,37 +33,182 @@ static sonar_config_t default_config = {
     .base_frequency = 220.0,    // A3 note
     .frequency_range = 2000.0,  // 220Hz to 2220Hz range
     .sample_duration = 0.05,    // 50ms per byte
-    .use_dynamic_lib = true    
+    .use_dynamic_lib = true,
+    .merge_runs = false,
+    .run_quantum = 0.001,       // 1ms per repeated byte when merging runs
+    .compress = false,
+    .checkpoint = NULL,
+    .resume = false,
+    .plan = NULL,
+    .shape_rolloff = 0.0,
+    .qam = NULL,
+    .engine_path = NULL
 };
 
+// Window used to stream partitions when the target is under a memory budget; together
+// with the fixed WAV pipeline buffers this stays well below MOJIBAKE_MIN_MEMORY
+#define SONAR_STREAM_WINDOW (64 * 1024)
+
+// The configured engine, else $MOJIBAKE_AUDIO_ENGINE, else the one "make engine" puts beside the executable
+static const char *engine_path(const sonar_config_t *config, char *buffer, size_t size)
+{
+    if (config->engine_path) return config->engine_path;
+    const char *variable = getenv("MOJIBAKE_AUDIO_ENGINE");
+    if (variable && *variable) return variable;
+
+    size_t length = 0;
+#ifdef _WIN32
+    DWORD got = GetModuleFileNameA(NULL, buffer, (DWORD)size);
+    if (got > 0 && got < size) length = got;
+#elif defined(__linux__)
+    ssize_t got = readlink("/proc/self/exe", buffer, size - 1);
+    if (got > 0) length = (size_t)got;
+#endif
+    while (length > 0 && buffer[length - 1] != '/' && buffer[length - 1] != '\\') length--;
+    // Without the executable's directory the loader's own search path decides
+    if (length == 0 || length + sizeof(SONAR_ENGINE_NAME) > size) return SONAR_ENGINE_NAME;
+    memcpy(buffer + length, SONAR_ENGINE_NAME, sizeof(SONAR_ENGINE_NAME));
+    return buffer;
+}
+
+// O(1) append while building the sample list
+static void append_sample(audio_sample_node_t **head, audio_sample_node_t **tail, audio_sample_node_t *sample)
+{
+    if (*tail) {
+        (*tail)->next = sample;
+    } else {
+        *head = sample;
+    }
+    *tail = sample;
+}
+
+// Tones come from the payload in memory, or are streamed from the file through the window
+static void sonar_tones_begin(sonar_tone_iter_t *tones, const unsigned char *payload, unsigned int payload_size,
+                              mojibake_target_t *target, unsigned int index, unsigned char *window,
+                              sonar_config_t *config)
+{
+    if (payload) {
+        sonar_tone_iter_init(tones, payload, payload_size, config);
+    } else {
+        sonar_tone_iter_init_stream(tones, target, (size_t)index * target->partition_size, payload_size,
+                                    window, SONAR_STREAM_WINDOW, config);
+    }
+}
+
+// Digest of a partition that is only available through mojibake_read
+static bool sonar_stream_digest(mojibake_target_t *target, unsigned int index, unsigned char *window, mbx_digest_t *digest)
+{
+    mbx_digest_state_t state;
+    size_t offset = (size_t)index * target->partition_size;
+    size_t remaining = target->partition_size;
+    
+    mbx_digest_init(&state);
+    while (remaining > 0) {
+        size_t got = mojibake_read(target, offset, window, remaining < SONAR_STREAM_WINDOW ? remaining : SONAR_STREAM_WINDOW);
+        if (got == 0) return false;
+        mbx_digest_update(&state, window, got);
+        offset += got;
+        remaining -= got;
+    }
+    mbx_digest_final(&state, digest);
+    return true;
+}
+
 bool mbx_sonar(mojibake_target_t *target, unsigned int index, void *arg)
 {
-    if (target == NULL || target->block == NULL || index >= target->partition_count)
+    if (target == NULL || index >= target->partition_count)
         return false;
 
-    unsigned char *partition = MOJIBAKE_BLOCK_OFFSET(target, index);
+    // Without a block the target is under a memory budget and partitions are streamed
+    unsigned char *partition = target->block ? MOJIBAKE_BLOCK_OFFSET(target, index) : NULL;
     sonar_config_t *config = arg ? (sonar_config_t*)arg : &default_config;
+    unsigned char *window = NULL;
     
     printf("=== SONAR Partition %d Audio Analysis ===\n", index);
-    printf("Converting %d bytes to audio frequencies...\n", target->partition_size);
     
-    // Initialize linked list for audio samples
-    audio_sample_node_t *audio_head = NULL;
+    if (!partition) {
+        window = malloc(SONAR_STREAM_WINDOW);
+        if (!window) {
+            printf("[ERROR] Could not allocate SONAR stream window\n");
+            return false;
+        }
+    }
+    
+    // Record partition digest so dSONAR can verify reconstructions
+    char digest_filename[256];
+    mbx_digest_t digest;
+    sprintf(digest_filename, "sonar_partition_%d.digest", index);
+    if (partition) {
+        mbx_digest_compute(partition, target->partition_size, &digest);
+    } else if (!sonar_stream_digest(target, index, window, &digest)) {
+        printf("[ERROR] Failed reading partition %d\n", index);
+        free(window);
+        return false;
+    }
+    if (mbx_digest_write(digest_filename, &digest)) {
+        printf("Digest saved to: %s (CRC32C %08X, XXH64 %016llX)\n", digest_filename,
+               (unsigned int)digest.crc32c, (unsigned long long)digest.xxh64);
+    }
+    
+    // A checkpointed partition is skipped if its input and WAV still match the manifest
+    char wav_filename[256];
+    sprintf(wav_filename, "sonar_partition_%d.wav", index);
+    if (config->checkpoint && config->resume && mbx_checkpoint_verify(config->checkpoint, index, &digest)) {
+        printf("[RESUME] Partition %d already complete, digests verified: skipping\n\n", index);
+        free(window);
+        return true;
+    }
+    
+    // Optionally compress the partition; the payload header lets dSONAR expand it again
+    unsigned char *payload = partition;
+    unsigned int payload_size = target->partition_size;
+    unsigned char *compressed = NULL;
+    unsigned char *loaded = NULL;
     
-    // Convert each byte to audio sample
-    for (int i = 0; i < target->partition_size; i++) {
-        audio_sample_node_t *sample = create_audio_sample(partition[i], config);
-        if (sample) {
-            add_sample_to_list(&audio_head, sample);
+    if (config->compress) {
+        size_t capacity = mbx_lz_bound(target->partition_size);
+        
+        // Compression needs the whole partition in memory, so a budget may rule it out
+        if (!partition && (size_t)target->partition_size + capacity > target->max_memory) {
+            printf("Compression: partition exceeds memory budget, sending raw bytes\n");
+        } else {
+            if (!partition) {
+                loaded = malloc(target->partition_size);
+                if (loaded && mojibake_read(target, (size_t)index * target->partition_size, loaded,
+                                            target->partition_size) != target->partition_size) {
+                    free(loaded);
+                    loaded = NULL;
+                }
+            }
+            
+            const unsigned char *source = partition ? partition : loaded;
+            compressed = source ? malloc(capacity) : NULL;
+            size_t compressed_size = compressed ?
+                mbx_lz_compress(source, target->partition_size, compressed, capacity) : 0;
+            
+            if (compressed_size > 0 && compressed_size < target->partition_size) {
+                printf("Compression: %d -> %zu bytes (%.1f%%)\n", target->partition_size, compressed_size,
+                       compressed_size * 100.0 / target->partition_size);
+                payload = compressed;
+                payload_size = (unsigned int)compressed_size;
+            } else {
+                printf("Compression: partition not compressible, sending raw bytes\n");
+            }
+            
+            free(loaded);
+            loaded = NULL;
         }
     }
     
+    printf("Converting %d bytes to audio frequencies...\n", payload_size);
+    
     // Try to load dynamic audio library
     audio_lib_t audio_lib = {0};
     bool lib_loaded = false;
     
     if (config->use_dynamic_lib) {
-        lib_loaded = load_audio_library(&audio_lib, "c:/Users/Usama/Downloads/Sonar2/mojibake/lib/audio_engine.dll"); 
+        char path[4096];
+        lib_loaded = load_audio_library(&audio_lib, engine_path(config, path, sizeof(path)));
         if (lib_loaded) {
             printf("Dynamic audio library loaded successfully!\n");
         } else {
@@ -65,8 +216,58 @@ bool mbx_sonar(mojibake_target_t *target, unsigned int index, void *arg)
         }
     }
     
+    sonar_tone_iter_t tones;
+    audio_sample_node_t tone;
+    bool use_engine = lib_loaded;
+    bool rendered = false;
+    
+    // The engine API consumes a sample list; under a memory budget it must fit
+    if (use_engine && target->max_memory > 0) {
+        size_t list_size = 0;
+        sonar_tones_begin(&tones, payload, payload_size, target, index, window, config);
+        while (sonar_tone_iter_next(&tones, config, &tone)) {
+            list_size += sizeof(audio_sample_node_t);
+        }
+        if (list_size > target->max_memory) {
+            printf("Sample list would exceed memory budget, using built-in audio generation.\n");
+            use_engine = false;
+        }
+    }
+    
+    // Shaped synthesis and coherent modulation are only implemented by the built-in renderer; the engine's
+    // envelope fades over a tenth of each tone, which blurs the lengths that carry merged runs
+    if (use_engine && (config->shape_rolloff > 0.0 || config->qam || config->merge_runs)) {
+        printf("%s requested, using built-in audio generation.\n",
+               config->qam ? "Coherent modulation" : config->merge_runs ? "Run merging" : "Shaped synthesis");
+        use_engine = false;
+    }
+    
     // Generate audio output
-    if (lib_loaded) {
+    if (config->qam) {
+        // Bytes go out several per symbol on the coherent carriers
+        sonar_tones_begin(&tones, payload, payload_size, target, index, window, config);
+        rendered = generate_wav_qam(&tones, payload_size, wav_filename, config);
+        if (rendered) {
+            size_t symbol_count = mbx_qam_symbol_count(config->qam, payload_size);
+            printf("Audio saved to: %s\n", wav_filename);
+            printf("Coherent %d-%s: %zu symbols x %d bytes, %.2f seconds\n", config->qam->order,
+                   config->qam->order == 4 ? "PSK" : "QAM", symbol_count, config->qam->symbol_bytes,
+                   (double)symbol_count * config->qam->symbol_samples / config->sample_rate);
+        }
+    } else if (use_engine) {
+        // The engine API consumes a sample list, so build it up front
+        audio_sample_node_t *audio_head = NULL;
+        audio_sample_node_t *audio_tail = NULL;
+        
+        sonar_tones_begin(&tones, payload, payload_size, target, index, window, config);
+        while (sonar_tone_iter_next(&tones, config, &tone)) {
+            audio_sample_node_t *sample = malloc(sizeof(audio_sample_node_t));
+            if (sample) {
+                *sample = tone;
+                append_sample(&audio_head, &audio_tail, sample);
+            }
+        }
+        
         // Use dynamic library for audio playback
         play_audio_list(audio_head, &audio_lib);
         
@@ -74,64 +275,102 @@ bool mbx_sonar(mojibake_target_t *target, unsigned int index, void *arg)
         char base_filename[256];
         sprintf(base_filename, "sonar_partition_%d", index);
         
+        // Sidecars are written in one pass on the engine's worker thread while the WAV is synthesized
+        bool sidecars_async = audio_lib.begin_sidecars && audio_lib.end_sidecars &&
+                              audio_lib.begin_sidecars(audio_head, base_filename, SONAR_SIDECAR_ALL) == 0;
+        if (sidecars_async) {
+            printf("Writing sidecars in one pass alongside the WAV\n");
+        }
+        
         // Generate WAV file using shared library
         if (audio_lib.generate_wav) {
-            char wav_filename[256];
-            sprintf(wav_filename, "%s.wav", base_filename);
-            audio_lib.generate_wav(wav_filename, audio_head);
+            rendered = audio_lib.generate_wav(wav_filename, audio_head) == 0;
         }
         
-        // Generate analysis report
-        if (audio_lib.generate_analysis_report) {
-            audio_lib.generate_analysis_report(audio_head, base_filename);
+        if (sidecars_async) {
+            audio_lib.end_sidecars();
+        } else {
+            // Generate analysis report
+            if (audio_lib.generate_analysis_report) {
+                audio_lib.generate_analysis_report(audio_head, base_filename);
+            }
+            
+            // Generate frequency data CSV
+            if (audio_lib.generate_frequency_data) {
+                audio_lib.generate_frequency_data(audio_head, base_filename);
+            }
+            
+            // Generate metadata JSON
+            if (audio_lib.generate_metadata_json) {
+                audio_lib.generate_metadata_json(audio_head, base_filename);
+            }
         }
         
-        // Generate frequency data CSV
-        if (audio_lib.generate_frequency_data) {
-            audio_lib.generate_frequency_data(audio_head, base_filename);
+        free_audio_list(audio_head);
+    } else {
+        // Use built-in WAV generation: tones stream through the staged pipeline without a sample list
+        sonar_tones_begin(&tones, payload, payload_size, target, index, window, config);
+        rendered = generate_wav_pipelined(&tones, wav_filename, config);
+        if (rendered) {
+            printf("Audio saved to: %s\n", wav_filename);
         }
+    }
+    
+    // Display frequency analysis (coherent symbols carry no per-byte tones)
+    if (!config->qam) {
+        printf("\nFrequency Analysis:\n");
+        int sample_count = 0;
+        unsigned int tone_count = 0;
+        double total_freq = 0.0, total_duration = 0.0;
+        double min_freq = 999999.0, max_freq = 0.0;
         
-        // Generate metadata JSON
-        if (audio_lib.generate_metadata_json) {
-            audio_lib.generate_metadata_json(audio_head, base_filename);
-        }
-    } else {
-        // Use built-in WAV file generation
-        char filename[256];
-        sprintf(filename, "sonar_partition_%d.wav", index);
-        generate_wav_file(audio_head, filename, config);
-        printf("Audio saved to: %s\n", filename);
-    }
-    
-    // Display frequency analysis
-    printf("\nFrequency Analysis:\n");
-    audio_sample_node_t *current = audio_head;
-    int sample_count = 0;
-    double total_freq = 0.0;
-    double min_freq = 999999.0, max_freq = 0.0;
-    
-    while (current && sample_count < 10) { // Show first 10 samples
-        printf("Byte 0x%02X -> %.2f Hz (Amp: %.2f)\n", 
-               current->source_byte, current->frequency, current->amplitude);
+        sonar_tones_begin(&tones, payload, payload_size, target, index, window, config);
+        while (sonar_tone_iter_next(&tones, config, &tone)) {
+            total_duration += tone.duration;
+            if (tone.amplitude <= 0.0) continue; // Skip run-merging gaps
+            tone_count++;
         
-        total_freq += current->frequency;
-        if (current->frequency < min_freq) min_freq = current->frequency;
-        if (current->frequency > max_freq) max_freq = current->frequency;
+            if (sample_count < 10) { // Show first 10 samples
+                printf("Byte 0x%02X -> %.2f Hz (Amp: %.2f)\n", 
+                       tone.source_byte, tone.frequency, tone.amplitude);
+            
+                total_freq += tone.frequency;
+                if (tone.frequency < min_freq) min_freq = tone.frequency;
+                if (tone.frequency > max_freq) max_freq = tone.frequency;
+                sample_count++;
+            }
+        }
         
-        current = current->next;
-        sample_count++;
+        if (sample_count > 0) {
+            printf("\nStatistics:\n");
+            printf("Average frequency: %.2f Hz\n", total_freq / sample_count);
+            printf("Frequency range: %.2f - %.2f Hz\n", min_freq, max_freq);
+            printf("Total audio duration: %.2f seconds\n", total_duration);
+            if (config->merge_runs) {
+                printf("Run merging: %u bytes -> %u tones\n", payload_size, tone_count);
+            }
+        }
     }
     
-    if (sample_count > 0) {
-        printf("\nStatistics:\n");
-        printf("Average frequency: %.2f Hz\n", total_freq / sample_count);
-        printf("Frequency range: %.2f - %.2f Hz\n", min_freq, max_freq);
-        printf("Total audio duration: %.2f seconds\n", 
-               target->partition_size * config->sample_duration);
+    // Record the partition only once its outputs are on stable storage
+    if (config->checkpoint && rendered) {
+        mbx_checkpoint_sync_file(digest_filename);
+        if (use_engine) {
+            const char *sidecars[] = {"_analysis.txt", "_frequencies.csv", "_metadata.json"};
+            for (size_t i = 0; i < sizeof(sidecars) / sizeof(sidecars[0]); i++) {
+                char sidecar_filename[256];
+                sprintf(sidecar_filename, "sonar_partition_%d%s", index, sidecars[i]);
+                mbx_checkpoint_sync_file(sidecar_filename);
+            }
+        }
+        if (mbx_checkpoint_commit(config->checkpoint, index, &digest, wav_filename)) {
+            printf("Checkpoint: partition %d recorded in %s\n", index, config->checkpoint->filename);
+        }
     }
     
     // Cleanup
-    free_audio_list(audio_head);
+    free(compressed);
+    free(window);
     if (lib_loaded) {
         unload_audio_library(&audio_lib);
     }
@@ -140,6 +379,91 @@ bool mbx_sonar(mojibake_target_t *target, unsigned int index, void *arg)
     return true;
 }
 
+void sonar_tone_iter_init(sonar_tone_iter_t *iter, const unsigned char *data, unsigned int size, sonar_config_t *config)
+{
+    iter->data = data;
+    iter->size = size;
+    iter->position = 0;
+    iter->gap_pending = config->merge_runs; // Merged streams lead with a gap so dSONAR can recognize them
+    iter->source = NULL;
+    iter->source_offset = 0;
+    iter->source_end = 0;
+    iter->window = NULL;
+    iter->window_size = 0;
+    iter->read_error = false;
+}
+
+void sonar_tone_iter_init_stream(sonar_tone_iter_t *iter, mojibake_target_t *source, size_t offset, size_t length,
+                                 unsigned char *window, unsigned int window_size, sonar_config_t *config)
+{
+    sonar_tone_iter_init(iter, window, 0, config);
+    iter->source = source;
+    iter->source_offset = offset;
+    iter->source_end = offset + length;
+    iter->window = window;
+    iter->window_size = window_size;
+}
+
+// Load the next window of a streaming payload; false at the end or on a read error
+static bool sonar_tone_iter_refill(sonar_tone_iter_t *iter)
+{
+    if (!iter->source || iter->source_offset >= iter->source_end) return false;
+    
+    size_t want = iter->source_end - iter->source_offset;
+    if (want > iter->window_size) want = iter->window_size;
+    
+    size_t got = mojibake_read(iter->source, iter->source_offset, iter->window, want);
+    if (got == 0) {
+        iter->read_error = true;
+        return false;
+    }
+    
+    iter->data = iter->window;
+    iter->size = (unsigned int)got;
+    iter->position = 0;
+    iter->source_offset += got;
+    return true;
+}
+
+bool sonar_tone_iter_next(sonar_tone_iter_t *iter, sonar_config_t *config, audio_sample_node_t *tone)
+{
+    tone->next = NULL;
+    
+    if (iter->gap_pending) {
+        tone->source_byte = 0;
+        tone->frequency = 0.0;
+        tone->amplitude = 0.0;
+        tone->duration = config->run_quantum;
+        iter->gap_pending = false;
+        return true;
+    }
+    
+    if (iter->position >= iter->size && !sonar_tone_iter_refill(iter)) return false;
+    
+    unsigned char byte = iter->data[iter->position++];
+    unsigned int run = 1;
+    if (config->merge_runs) {
+        // Runs may continue across streaming windows
+        for (;;) {
+            while (iter->position < iter->size && iter->data[iter->position] == byte) {
+                iter->position++;
+                run++;
+            }
+            if (iter->position < iter->size || !sonar_tone_iter_refill(iter)) break;
+        }
+        iter->gap_pending = true; // Every merged tone is terminated by a gap
+    }
+    
+    tone->source_byte = byte;
+    tone->frequency = map_byte_to_frequency(byte, config);
+    tone->amplitude = map_byte_to_amplitude(byte);
+    tone->duration = config->sample_duration;
+    if (run > 1) {
+        tone->duration += (double)(run - 1) * config->run_quantum;
+    }
+    return true;
+}
+
 audio_sample_node_t* create_audio_sample(unsigned char byte, sonar_config_t *config)
 {
     audio_sample_node_t *sample = malloc(sizeof(audio_sample_node_t));
@@ -154,6 +478,32 @@ audio_sample_node_t* create_audio_sample(unsigned char byte, sonar_config_t *con
     return sample;
 }
 
+audio_sample_node_t* create_run_sample(unsigned char byte, unsigned int run_length, sonar_config_t *config)
+{
+    audio_sample_node_t *sample = create_audio_sample(byte, config);
+    if (!sample) return NULL;
+    
+    if (run_length > 1) {
+        sample->duration = config->sample_duration + (double)(run_length - 1) * config->run_quantum;
+    }
+    
+    return sample;
+}
+
+audio_sample_node_t* create_gap_sample(sonar_config_t *config)
+{
+    audio_sample_node_t *sample = malloc(sizeof(audio_sample_node_t));
+    if (!sample) return NULL;
+    
+    sample->source_byte = 0;
+    sample->frequency = 0.0;
+    sample->amplitude = 0.0;
+    sample->duration = config->run_quantum;
+    sample->next = NULL;
+    
+    return sample;
+}
+
 void add_sample_to_list(audio_sample_node_t **head, audio_sample_node_t *new_sample)
 {
     if (!head || !new_sample) return;
@@ -218,6 +568,8 @@ bool load_audio_library(audio_lib_t *audio_lib, const char *lib_path)
     audio_lib->generate_analysis_report = (int(*)(audio_sample_node_t*,const char*))GET_PROC_ADDRESS(audio_lib->lib_handle, "generate_analysis_report");
     audio_lib->generate_frequency_data = (int(*)(audio_sample_node_t*,const char*))GET_PROC_ADDRESS(audio_lib->lib_handle, "generate_frequency_data");
     audio_lib->generate_metadata_json = (int(*)(audio_sample_node_t*,const char*))GET_PROC_ADDRESS(audio_lib->lib_handle, "generate_metadata_json");
+    audio_lib->begin_sidecars = (int(*)(audio_sample_node_t*,const char*,int))GET_PROC_ADDRESS(audio_lib->lib_handle, "begin_sidecars");
+    audio_lib->end_sidecars = (int(*)(void))GET_PROC_ADDRESS(audio_lib->lib_handle, "end_sidecars");
     
     // Check if essential functions are loaded
     printf("[DEBUG] init_audio: %p, play_frequency: %p\n", (void*)audio_lib->init_audio, (void*)audio_lib->play_frequency);
@@ -248,25 +600,9 @@ void unload_audio_library(audio_lib_t *audio_lib)
     memset(audio_lib, 0, sizeof(audio_lib_t));
 }
 
-void generate_wav_file(audio_sample_node_t *head, const char *filename, sonar_config_t *config)
+// WAV header (44 bytes) for mono 16-bit PCM
+static void write_wav_header(FILE *wav_file, int sample_rate, int data_size)
 {
-    // Simple WAV file generation (header + PCM data)
-    FILE *wav_file = fopen(filename, "wb");
-    if (!wav_file) {
-        printf("Error: Could not create WAV file %s\n", filename);
-        return;
-    }
-    
-    // Calculate total samples
-    int total_samples = 0;
-    audio_sample_node_t *current = head;
-    while (current) {
-        total_samples += (int)(current->duration * config->sample_rate);
-        current = current->next;
-    }
-    
-    // WAV header (44 bytes)
-    int data_size = total_samples * 2; // 16-bit samples
     int file_size = data_size + 36;
     
     fwrite("RIFF", 1, 4, wav_file);
@@ -277,7 +613,6 @@ void generate_wav_file(audio_sample_node_t *head, const char *filename, sonar_co
     int fmt_size = 16;
     short audio_format = 1; // PCM
     short channels = 1;
-    int sample_rate = config->sample_rate;
     int byte_rate = sample_rate * channels * 2;
     short block_align = channels * 2;
     short bits_per_sample = 16;
@@ -292,17 +627,43 @@ void generate_wav_file(audio_sample_node_t *head, const char *filename, sonar_co
     
     fwrite("data", 1, 4, wav_file);
     fwrite(&data_size, 4, 1, wav_file);
+}
+
+void generate_wav_file(audio_sample_node_t *head, const char *filename, sonar_config_t *config)
+{
+    // Simple WAV file generation (header + PCM data)
+    FILE *wav_file = fopen(filename, "wb");
+    if (!wav_file) {
+        printf("Error: Could not create WAV file %s\n", filename);
+        return;
+    }
+    
+    // Calculate total samples
+    int total_samples = 0;
+    audio_sample_node_t *current = head;
+    while (current) {
+        total_samples += (int)(current->duration * config->sample_rate);
+        current = current->next;
+    }
+    
+    // WAV header (44 bytes)
+    write_wav_header(wav_file, config->sample_rate, total_samples * 2); // 16-bit samples
     
     // Generate PCM data
+    mbx_synth_t synth;
+    double block[256];
+    mbx_synth_init(&synth, config->sample_rate, config->sample_duration, config->shape_rolloff);
     current = head;
     while (current) {
-        int samples_for_this_note = (int)(current->duration * config->sample_rate);
+        mbx_synth_start(&synth, current->frequency, current->amplitude,
+                        (int)(current->duration * config->sample_rate));
         
-        for (int i = 0; i < samples_for_this_note; i++) {
-            double t = (double)i / config->sample_rate;
-            double sample = current->amplitude * sin(2.0 * M_PI * current->frequency * t);
-            short pcm_sample = (short)(sample * 32767.0);
-            fwrite(&pcm_sample, 2, 1, wav_file);
+        int count;
+        while ((count = mbx_synth_render(&synth, block, 256)) > 0) {
+            for (int i = 0; i < count; i++) {
+                short pcm_sample = (short)(block[i] * 32767.0);
+                fwrite(&pcm_sample, 2, 1, wav_file);
+            }
         }
         
         current = current->next;
@@ -311,8 +672,333 @@ void generate_wav_file(audio_sample_node_t *head, const char *filename, sonar_co
     fclose(wav_file);
 }
 
+// Staged WAV pipeline: map bytes -> synthesize PCM -> encode 16-bit -> write,
+// one thread per stage, connected by bounded lock-free queues
+#define PIPELINE_TONE_BATCH 256
+#define PIPELINE_BLOCK_FRAMES 4096
+#define PIPELINE_DEPTH 8
+
+typedef struct {
+    int count;
+    bool last;
+    audio_sample_node_t tones[PIPELINE_TONE_BATCH];
+} tone_batch_t;
+
+typedef struct {
+    int count;
+    bool last;
+    double samples[PIPELINE_BLOCK_FRAMES];
+} pcm_block_t;
+
+typedef struct {
+    size_t length;
+    bool last;
+    unsigned char bytes[PIPELINE_BLOCK_FRAMES * 2];
+} byte_block_t;
+
+// Each edge pairs a queue of filled blocks with a queue returning empty ones
+typedef struct {
+    sonar_config_t *config;
+    sonar_tone_iter_t *tones;
+    FILE *wav_file;
+    mbx_queue_t tones_full, tones_free;
+    mbx_queue_t pcm_full, pcm_free;
+    mbx_queue_t bytes_full, bytes_free;
+    tone_batch_t tone_pool[PIPELINE_DEPTH];
+    pcm_block_t pcm_pool[PIPELINE_DEPTH];
+    byte_block_t byte_pool[PIPELINE_DEPTH];
+    long long data_size;
+    bool write_error;
+} sonar_pipeline_t;
+
+static void pipeline_map(sonar_pipeline_t *pipe)
+{
+    bool more = true;
+    
+    while (more) {
+        tone_batch_t *batch = mbx_queue_pop(&pipe->tones_free);
+        batch->count = 0;
+        while (batch->count < PIPELINE_TONE_BATCH &&
+               (more = sonar_tone_iter_next(pipe->tones, pipe->config, &batch->tones[batch->count]))) {
+            batch->count++;
+        }
+        batch->last = !more;
+        mbx_queue_push(&pipe->tones_full, batch);
+    }
+}
+
+static void *pipeline_synthesize(void *arg)
+{
+    sonar_pipeline_t *pipe = arg;
+    int sample_rate = pipe->config->sample_rate;
+    tone_batch_t *batch = NULL;
+    int next_tone = 0;
+    mbx_synth_t synth;
+    bool ended = false;
+    
+    mbx_synth_init(&synth, sample_rate, pipe->config->sample_duration, pipe->config->shape_rolloff);
+    
+    while (!ended) {
+        pcm_block_t *block = mbx_queue_pop(&pipe->pcm_free);
+        block->count = 0;
+        
+        while (block->count < PIPELINE_BLOCK_FRAMES) {
+            int rendered = mbx_synth_render(&synth, block->samples + block->count,
+                                            PIPELINE_BLOCK_FRAMES - block->count);
+            if (rendered > 0) {
+                block->count += rendered;
+                continue;
+            }
+            
+            // Current tone finished: take the next one, fetching a new batch when needed
+            if (batch && next_tone < batch->count) {
+                audio_sample_node_t *tone = &batch->tones[next_tone++];
+                mbx_synth_start(&synth, tone->frequency, tone->amplitude, (int)(tone->duration * sample_rate));
+                continue;
+            }
+            if (batch) {
+                bool last = batch->last;
+                mbx_queue_push(&pipe->tones_free, batch);
+                batch = NULL;
+                if (last) {
+                    ended = true;
+                    break;
+                }
+            }
+            batch = mbx_queue_pop(&pipe->tones_full);
+            next_tone = 0;
+        }
+        
+        block->last = ended;
+        mbx_queue_push(&pipe->pcm_full, block);
+    }
+    return NULL;
+}
+
+static void *pipeline_encode(void *arg)
+{
+    sonar_pipeline_t *pipe = arg;
+    bool last = false;
+    
+    while (!last) {
+        pcm_block_t *pcm = mbx_queue_pop(&pipe->pcm_full);
+        byte_block_t *out = mbx_queue_pop(&pipe->bytes_free);
+        
+        for (int i = 0; i < pcm->count; i++) {
+            short pcm_sample = (short)(pcm->samples[i] * 32767.0);
+            out->bytes[2 * i] = (unsigned char)(pcm_sample & 0xFF);
+            out->bytes[2 * i + 1] = (unsigned char)((pcm_sample >> 8) & 0xFF);
+        }
+        out->length = (size_t)pcm->count * 2;
+        out->last = last = pcm->last;
+        
+        mbx_queue_push(&pipe->pcm_free, pcm);
+        mbx_queue_push(&pipe->bytes_full, out);
+    }
+    return NULL;
+}
+
+static void *pipeline_write(void *arg)
+{
+    sonar_pipeline_t *pipe = arg;
+    bool last = false;
+    
+    while (!last) {
+        byte_block_t *block = mbx_queue_pop(&pipe->bytes_full);
+        if (!pipe->write_error && fwrite(block->bytes, 1, block->length, pipe->wav_file) != block->length) {
+            pipe->write_error = true; // Keep draining so upstream stages can finish
+        }
+        pipe->data_size += block->length;
+        last = block->last;
+        mbx_queue_push(&pipe->bytes_free, block);
+    }
+    return NULL;
+}
+
+static bool pipeline_init(sonar_pipeline_t *pipe)
+{
+    mbx_queue_t *queues[] = {&pipe->tones_full, &pipe->tones_free, &pipe->pcm_full,
+                             &pipe->pcm_free, &pipe->bytes_full, &pipe->bytes_free};
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(queues) / sizeof(queues[0]); i++) {
+        if (!mbx_queue_init(queues[i], PIPELINE_DEPTH)) ok = false;
+    }
+    if (!ok) return false;
+    
+    for (int i = 0; i < PIPELINE_DEPTH; i++) {
+        mbx_queue_try_push(&pipe->tones_free, &pipe->tone_pool[i]);
+        mbx_queue_try_push(&pipe->pcm_free, &pipe->pcm_pool[i]);
+        mbx_queue_try_push(&pipe->bytes_free, &pipe->byte_pool[i]);
+    }
+    return true;
+}
+
+static void pipeline_release(sonar_pipeline_t *pipe)
+{
+    mbx_queue_free(&pipe->tones_full);
+    mbx_queue_free(&pipe->tones_free);
+    mbx_queue_free(&pipe->pcm_full);
+    mbx_queue_free(&pipe->pcm_free);
+    mbx_queue_free(&pipe->bytes_full);
+    mbx_queue_free(&pipe->bytes_free);
+}
+
+bool generate_wav_qam(sonar_tone_iter_t *tones, unsigned int payload_size, const char *filename, sonar_config_t *config)
+{
+    const mbx_qam_t *qam = config->qam;
+    size_t symbol_count = mbx_qam_symbol_count(qam, payload_size);
+    long long data_size = (long long)symbol_count * qam->symbol_samples * 2;
+    if (data_size > 0x7FFFFFD3LL) {
+        printf("Error: Audio for %s exceeds the WAV size limit\n", filename);
+        return false;
+    }
+    
+    FILE *wav_file = fopen(filename, "wb");
+    if (!wav_file) {
+        printf("Error: Could not create WAV file %s\n", filename);
+        return false;
+    }
+    
+    double *samples = malloc(qam->symbol_samples * sizeof(double));
+    unsigned char *pcm = malloc((size_t)qam->symbol_samples * 2);
+    if (!samples || !pcm) {
+        printf("Error: Could not allocate QAM symbol buffers\n");
+        free(samples);
+        free(pcm);
+        fclose(wav_file);
+        return false;
+    }
+    
+    write_wav_header(wav_file, config->sample_rate, (int)data_size);
+    
+    // The byte stream is the little-endian payload length, the payload, then zero padding
+    unsigned char prefix[MBX_QAM_LENGTH_PREFIX];
+    for (int i = 0; i < MBX_QAM_LENGTH_PREFIX; i++) {
+        prefix[i] = (unsigned char)(payload_size >> (8 * i));
+    }
+    
+    unsigned int prefix_sent = 0;
+    audio_sample_node_t tone;
+    bool ok = true;
+    for (size_t symbol = 0; ok && symbol < symbol_count; symbol++) {
+        unsigned char bytes[MBX_QAM_MAX_SYMBOL_BYTES] = {0};
+        for (int i = 0; i < qam->symbol_bytes; i++) {
+            if (prefix_sent < MBX_QAM_LENGTH_PREFIX) {
+                bytes[i] = prefix[prefix_sent++];
+            } else if (sonar_tone_iter_next(tones, config, &tone)) {
+                bytes[i] = tone.source_byte;
+            }
+        }
+        
+        mbx_qam_modulate(qam, bytes, samples);
+        for (int i = 0; i < qam->symbol_samples; i++) {
+            short pcm_sample = (short)(samples[i] * 32767.0);
+            pcm[2 * i] = (unsigned char)(pcm_sample & 0xFF);
+            pcm[2 * i + 1] = (unsigned char)((pcm_sample >> 8) & 0xFF);
+        }
+        if (fwrite(pcm, 2, qam->symbol_samples, wav_file) != (size_t)qam->symbol_samples) {
+            printf("Error: Failed writing WAV file %s\n", filename);
+            ok = false;
+        }
+    }
+    
+    if (tones->read_error) {
+        printf("Error: Failed reading payload for %s\n", filename);
+        ok = false;
+    }
+    if (fclose(wav_file) != 0) ok = false;
+    
+    free(samples);
+    free(pcm);
+    return ok;
+}
+
+bool generate_wav_pipelined(sonar_tone_iter_t *tones, const char *filename, sonar_config_t *config)
+{
+    FILE *wav_file = fopen(filename, "wb");
+    if (!wav_file) {
+        printf("Error: Could not create WAV file %s\n", filename);
+        return false;
+    }
+    
+    sonar_pipeline_t *pipe = calloc(1, sizeof(sonar_pipeline_t));
+    if (!pipe || !pipeline_init(pipe)) {
+        printf("Error: Could not allocate audio pipeline\n");
+        if (pipe) pipeline_release(pipe);
+        free(pipe);
+        fclose(wav_file);
+        return false;
+    }
+    pipe->config = config;
+    pipe->tones = tones;
+    pipe->wav_file = wav_file;
+    
+    // Sizes are patched in once the writer knows how much PCM it produced
+    write_wav_header(wav_file, config->sample_rate, 0);
+    
+    // Start stages downstream-first; the calling thread runs the map stage
+    void *(*stages[3])(void*) = {pipeline_write, pipeline_encode, pipeline_synthesize};
+    pthread_t threads[3];
+    int started = 0;
+    while (started < 3 && pthread_create(&threads[started], NULL, stages[started], pipe) == 0) {
+        started++;
+    }
+    
+    bool ok = started == 3;
+    if (ok) {
+        pipeline_map(pipe);
+    } else if (started > 0) {
+        // Shut down the stages already running with an empty final block
+        printf("Error: Could not start audio pipeline threads\n");
+        if (started == 1) {
+            byte_block_t *block = mbx_queue_pop(&pipe->bytes_free);
+            block->length = 0;
+            block->last = true;
+            mbx_queue_push(&pipe->bytes_full, block);
+        } else {
+            pcm_block_t *block = mbx_queue_pop(&pipe->pcm_free);
+            block->count = 0;
+            block->last = true;
+            mbx_queue_push(&pipe->pcm_full, block);
+        }
+    } else {
+        printf("Error: Could not start audio pipeline threads\n");
+    }
+    
+    for (int i = started - 1; i >= 0; i--) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    if (ok && pipe->data_size > 0x7FFFFFD3LL) {
+        printf("Error: Audio for %s exceeds the WAV size limit\n", filename);
+        ok = false;
+    }
+    if (ok) {
+        fseek(wav_file, 0, SEEK_SET);
+        write_wav_header(wav_file, config->sample_rate, (int)pipe->data_size);
+    }
+    if (pipe->write_error) {
+        printf("Error: Failed writing WAV file %s\n", filename);
+        ok = false;
+    }
+    if (tones->read_error) {
+        printf("Error: Failed reading payload for %s\n", filename);
+        ok = false;
+    }
+    if (fclose(wav_file) != 0) ok = false;
+    
+    pipeline_release(pipe);
+    free(pipe);
+    return ok;
+}
+
 double map_byte_to_frequency(unsigned char byte, sonar_config_t *config)
 {
+    // Bin-centered orthogonal tones when a frequency plan is active
+    if (config->plan) {
+        return config->plan->frequency[byte];
+    }
+    
     // Map byte value (0-255) to frequency range
     double normalized = (double)byte / 255.0;
     return config->base_frequency + (normalized * config->frequency_range);
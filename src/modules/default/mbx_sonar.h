@@ -13,6 +13,10 @@
 #define MBX_SONAR_H
 #include <stdbool.h>
 #include "mojibake/mojibake.h"
+#include "mbx_checkpoint.h"
+#include "mbx_freqplan.h"
+#include "mbx_synth.h"
+#include "mbx_qam.h"
 
 /**
  * @brief Audio sample node for linked list storage
@@ -28,6 +32,16 @@ typedef struct audio_sample_node {
     struct audio_sample_node *next; /**< Pointer to next node in linked list */
 } audio_sample_node_t;
 
+/** Sidecar format flags for begin_sidecars (must match audio_engine.h) */
+#define SONAR_SIDECAR_ALL 0x7
+
+/** File name of the audio engine library built by "make engine" */
+#ifdef _WIN32
+#define SONAR_ENGINE_NAME "audio_engine.dll"
+#else
+#define SONAR_ENGINE_NAME "libaudio_engine.so"
+#endif
+
 /**
  * @brief Audio configuration structure
  * 
@@ -40,8 +54,39 @@ typedef struct {
     double frequency_range;    /**< Frequency range in Hz (e.g., 2000 Hz) */
     double sample_duration;    /**< Duration per byte sample in seconds (e.g., 0.05) */
     bool use_dynamic_lib;      /**< Whether to use dynamic audio library for playback */
+    bool merge_runs;           /**< Merge runs of identical bytes into one tone (see create_run_sample) */
+    double run_quantum;        /**< Extra tone duration per repeated byte in seconds (e.g., 0.001) */
+    bool compress;             /**< LZ-compress each partition before sonification (see mbx_lz.h) */
+    mbx_checkpoint_t *checkpoint; /**< Manifest recording finished partitions (NULL = no checkpointing) */
+    bool resume;               /**< Skip partitions the checkpoint lists as complete once their digests verify */
+    const mbx_freqplan_t *plan; /**< Orthogonal frequency plan (NULL = linear base/range mapping) */
+    double shape_rolloff;      /**< Raised-cosine ramp as a fraction of a symbol, phase-continuous (0 = legacy synth, see mbx_synth.h) */
+    const mbx_qam_t *qam;      /**< Coherent multi-carrier PSK/QAM modulation (NULL = one tone per byte) */
+    const char *engine_path;   /**< Audio engine library (NULL = $MOJIBAKE_AUDIO_ENGINE, else SONAR_ENGINE_NAME beside the executable) */
 } sonar_config_t;
 
+/**
+ * @brief Iterator over the tones of a payload
+ * 
+ * Yields the tone sequence SONAR renders for a byte buffer, one
+ * audio_sample_node_t at a time and without allocating: one tone per
+ * byte, or with run merging a leading gap and one tone plus gap per run.
+ * A streaming iterator reads the payload from a mojibake target through a
+ * fixed window instead of holding it in memory.
+ */
+typedef struct {
+    const unsigned char *data; /**< Payload being sonified (current window when streaming) */
+    unsigned int size;         /**< Payload size in bytes (bytes in the window when streaming) */
+    unsigned int position;     /**< Offset of the next unconsumed byte */
+    bool gap_pending;          /**< Next item is a run-merging gap */
+    mojibake_target_t *source; /**< Target streamed through the window, NULL for in-memory payloads */
+    size_t source_offset;      /**< File offset of the next window */
+    size_t source_end;         /**< File offset just past the payload */
+    unsigned char *window;     /**< Caller-owned window buffer */
+    unsigned int window_size;  /**< Window buffer size in bytes */
+    bool read_error;           /**< Set if reading the source failed (the iterator then ends early) */
+} sonar_tone_iter_t;
+
 /**
  * @brief Function pointers for dynamic library loading
  * 
@@ -57,6 +102,8 @@ typedef struct {
     int (*generate_analysis_report)(audio_sample_node_t* samples, const char* filename); /**< Generate analysis report */
     int (*generate_frequency_data)(audio_sample_node_t* samples, const char* filename); /**< Generate CSV frequency data */
     int (*generate_metadata_json)(audio_sample_node_t* samples, const char* filename); /**< Generate JSON metadata */
+    int (*begin_sidecars)(audio_sample_node_t* samples, const char* filename, int formats); /**< Start single-pass sidecar generation in the background */
+    int (*end_sidecars)(void); /**< Wait for background sidecar generation */
 } audio_lib_t;
 
 /**
@@ -84,6 +131,70 @@ bool mbx_sonar(mojibake_target_t *target, unsigned int index, void *arg);
  */
 audio_sample_node_t* create_audio_sample(unsigned char byte, sonar_config_t *config);
 
+/**
+ * @brief Create audio sample for a run of identical bytes
+ * 
+ * Used when run merging is enabled: a run of run_length bytes becomes a
+ * single tone lasting sample_duration + (run_length - 1) * run_quantum.
+ * Every merged tone is followed by a gap sample (see create_gap_sample)
+ * so dSONAR can measure the tone length.
+ * 
+ * @param byte Repeated byte value (0-255)
+ * @param run_length Number of repetitions (at least 1)
+ * @param config Pointer to SONAR configuration structure
+ * @return Pointer to newly created audio sample node, NULL on failure
+ */
+audio_sample_node_t* create_run_sample(unsigned char byte, unsigned int run_length, sonar_config_t *config);
+
+/**
+ * @brief Create silent gap sample
+ * 
+ * Creates a zero-amplitude sample lasting one run quantum. In merged
+ * streams a gap leads the stream and terminates every tone.
+ * 
+ * @param config Pointer to SONAR configuration structure
+ * @return Pointer to newly created audio sample node, NULL on failure
+ */
+audio_sample_node_t* create_gap_sample(sonar_config_t *config);
+
+/**
+ * @brief Start iterating over the tones of a payload
+ * 
+ * @param iter Pointer to iterator to initialize
+ * @param data Payload bytes
+ * @param size Payload size in bytes
+ * @param config Pointer to SONAR configuration structure
+ */
+void sonar_tone_iter_init(sonar_tone_iter_t *iter, const unsigned char *data, unsigned int size, sonar_config_t *config);
+
+/**
+ * @brief Start iterating over the tones of a payload streamed from a file
+ * 
+ * Used when the target is opened with a memory budget (block is NULL):
+ * the payload is read window by window, and runs continue across window
+ * boundaries, so the tones are identical to the in-memory iterator.
+ * 
+ * @param iter Pointer to iterator to initialize
+ * @param source Target to read the payload from (see mojibake_read)
+ * @param offset File offset of the payload
+ * @param length Payload size in bytes
+ * @param window Buffer for one window of payload bytes (caller owned)
+ * @param window_size Size of the window buffer in bytes
+ * @param config Pointer to SONAR configuration structure
+ */
+void sonar_tone_iter_init_stream(sonar_tone_iter_t *iter, mojibake_target_t *source, size_t offset, size_t length,
+                                 unsigned char *window, unsigned int window_size, sonar_config_t *config);
+
+/**
+ * @brief Produce the next tone of a payload
+ * 
+ * @param iter Pointer to initialized iterator
+ * @param config Pointer to SONAR configuration structure (same as for init)
+ * @param tone Pointer to store the tone (its next pointer is set to NULL)
+ * @return true if a tone was produced, false at the end of the payload
+ */
+bool sonar_tone_iter_next(sonar_tone_iter_t *iter, sonar_config_t *config, audio_sample_node_t *tone);
+
 /**
  * @brief Add sample to linked list
  * 
@@ -144,6 +255,36 @@ void unload_audio_library(audio_lib_t *audio_lib);
  */
 void generate_wav_file(audio_sample_node_t *head, const char *filename, sonar_config_t *config);
 
+/**
+ * @brief Generate WAV file from a tone sequence through a staged pipeline
+ * 
+ * Streams the tones through four stages connected by bounded lock-free
+ * queues: map bytes to tones (calling thread), synthesize PCM blocks,
+ * encode them as 16-bit little-endian samples, and write them to disk.
+ * Synthesis and disk I/O overlap, and memory use is fixed regardless of
+ * payload size. Output is identical to generate_wav_file.
+ * 
+ * @param tones Initialized tone iterator (consumed by the call)
+ * @param filename Output WAV filename
+ * @param config Pointer to SONAR configuration structure
+ * @return true if the WAV file was written successfully, false otherwise
+ */
+bool generate_wav_pipelined(sonar_tone_iter_t *tones, const char *filename, sonar_config_t *config);
+
+/**
+ * @brief Generate WAV file with coherent multi-carrier PSK/QAM modulation
+ * 
+ * Sends the length-prefixed payload several bytes per symbol on the
+ * carriers of config->qam (see mbx_qam.h). Run merging does not apply.
+ * 
+ * @param tones Initialized tone iterator over the payload, without run merging (consumed by the call)
+ * @param payload_size Payload size in bytes
+ * @param filename Output WAV filename
+ * @param config Pointer to SONAR configuration structure with qam set
+ * @return true if the WAV file was written successfully, false otherwise
+ */
+bool generate_wav_qam(sonar_tone_iter_t *tones, unsigned int payload_size, const char *filename, sonar_config_t *config);
+
 /**
  * @brief Map byte value to audio frequency
  * 
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mbx_synth.h"
+#include <pthread.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// One sine cycle in 4096 steps; linear interpolation keeps the error below 16-bit resolution
+#define SYNTH_SINE_BITS 12
+#define SYNTH_SINE_SIZE (1 << SYNTH_SINE_BITS)
+#define SYNTH_SINE_FRACTION_BITS (32 - SYNTH_SINE_BITS)
+#define SYNTH_RAMP_SIZE 256
+
+// Both tables carry a guard entry so interpolation never wraps
+static double sine_table[SYNTH_SINE_SIZE + 1];
+static double ramp_table[SYNTH_RAMP_SIZE + 1];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void build_tables(void)
+{
+    for (int i = 0; i <= SYNTH_SINE_SIZE; i++) {
+        sine_table[i] = sin(2.0 * M_PI * i / SYNTH_SINE_SIZE);
+    }
+    // Raised cosine rising from 0 to 1
+    for (int i = 0; i <= SYNTH_RAMP_SIZE; i++) {
+        ramp_table[i] = 0.5 - 0.5 * cos(M_PI * i / SYNTH_RAMP_SIZE);
+    }
+}
+
+void mbx_synth_init(mbx_synth_t *synth, int sample_rate, double symbol_duration, double rolloff)
+{
+    synth->sample_rate = sample_rate;
+    synth->rolloff = rolloff;
+    synth->symbol_samples = (int)(symbol_duration * sample_rate);
+    synth->phase = 0;
+    synth->step = 0;
+    synth->frequency = 0.0;
+    synth->from_amplitude = 0.0; // The stream starts from silence
+    synth->amplitude = 0.0;
+    synth->position = 0;
+    synth->length = 0;
+    synth->ramp = 0;
+
+    if (rolloff > 0.0) {
+        pthread_once(&tables_once, build_tables);
+    }
+}
+
+void mbx_synth_start(mbx_synth_t *synth, double frequency, double amplitude, int samples)
+{
+    synth->from_amplitude = synth->amplitude;
+    synth->frequency = frequency;
+    synth->amplitude = amplitude;
+    synth->position = 0;
+    synth->length = samples > 0 ? samples : 0;
+    synth->step = (uint32_t)llround(frequency / synth->sample_rate * 4294967296.0);
+
+    // Short tones such as run-merging gaps spend at most a quarter of their length ramping
+    int ramp = (int)(synth->rolloff * synth->symbol_samples);
+    if (ramp > synth->length / 4) ramp = synth->length / 4;
+    synth->ramp = ramp;
+}
+
+int mbx_synth_render(mbx_synth_t *synth, double *out, int count)
+{
+    int remaining = synth->length - synth->position;
+    if (count > remaining) count = remaining;
+
+    if (synth->rolloff <= 0.0) {
+        // Legacy renderer: phase restarts with every tone
+        for (int i = 0; i < count; i++) {
+            double t = (double)(synth->position + i) / synth->sample_rate;
+            out[i] = synth->amplitude * sin(2.0 * M_PI * synth->frequency * t);
+        }
+        synth->position += count;
+        return count;
+    }
+
+    uint32_t phase = synth->phase;
+    double delta = synth->amplitude - synth->from_amplitude;
+    double ramp_scale = synth->ramp > 0 ? (double)SYNTH_RAMP_SIZE / synth->ramp : 0.0;
+
+    for (int i = 0; i < count; i++) {
+        int index = (int)(phase >> SYNTH_SINE_FRACTION_BITS);
+        double fraction = (phase & ((1u << SYNTH_SINE_FRACTION_BITS) - 1)) *
+                          (1.0 / (1u << SYNTH_SINE_FRACTION_BITS));
+        double value = sine_table[index] + (sine_table[index + 1] - sine_table[index]) * fraction;
+        phase += synth->step;
+
+        double envelope = synth->amplitude;
+        int position = synth->position + i;
+        if (position < synth->ramp) {
+            double x = position * ramp_scale;
+            int r = (int)x;
+            double shape = ramp_table[r] + (ramp_table[r + 1] - ramp_table[r]) * (x - r);
+            envelope = synth->from_amplitude + delta * shape;
+        }
+        out[i] = envelope * value;
+    }
+
+    synth->phase = phase;
+    synth->position += count;
+    return count;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file mbx_synth.h
+ * @brief Streaming tone synthesizer for built-in WAV generation
+ * @author Mojibake Development Team
+ * @version 1.0.0
+ *
+ * Renders a sequence of tones into PCM one block at a time. Two modes:
+ *
+ * - Legacy (rolloff 0): every tone restarts at phase 0 with a hard
+ *   amplitude step, exactly as SONAR always rendered.
+ * - Shaped (rolloff > 0): a phase accumulator runs across tone
+ *   boundaries, so frequency switches leave no phase jump, and the
+ *   amplitude moves from one tone's level to the next along a
+ *   raised-cosine ramp (to and from silence for run-merging gaps).
+ *   Sine and ramp values come from precomputed tables.
+ *
+ * Removing the clicks at symbol edges narrows the spectrum of each symbol,
+ * so adjacent symbols interfere less and can be packed tighter.
+ */
+
+#ifndef MBX_SYNTH_H
+#define MBX_SYNTH_H
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MBX_SYNTH_DEFAULT_ROLLOFF 0.1 /**< Default ramp length as a fraction of a symbol */
+#define MBX_SYNTH_MAX_ROLLOFF 0.5     /**< Longest ramp allowed as a fraction of a symbol */
+
+/**
+ * @brief Synthesizer state carried from one tone to the next
+ */
+typedef struct {
+    int sample_rate;           /**< Output sample rate in Hz */
+    double rolloff;            /**< Ramp length as a fraction of a symbol (0 = legacy mode) */
+    int symbol_samples;        /**< Samples per symbol; ramps are measured against it */
+    uint32_t phase;            /**< Phase accumulator (2^32 = one cycle), kept across tones */
+    uint32_t step;             /**< Phase increment per sample of the current tone */
+    double frequency;          /**< Frequency of the current tone in Hz */
+    double from_amplitude;     /**< Amplitude at the end of the previous tone */
+    double amplitude;          /**< Amplitude of the current tone */
+    int position;              /**< Samples of the current tone rendered so far */
+    int length;                /**< Samples in the current tone */
+    int ramp;                  /**< Samples over which the amplitude moves to the current level */
+} mbx_synth_t;
+
+/**
+ * @brief Initialize a synthesizer before the first tone
+ *
+ * @param synth Pointer to synthesizer
+ * @param sample_rate Output sample rate in Hz
+ * @param symbol_duration Duration of one symbol in seconds
+ * @param rolloff Ramp length as a fraction of a symbol, 0 for the legacy renderer
+ */
+void mbx_synth_init(mbx_synth_t *synth, int sample_rate, double symbol_duration, double rolloff);
+
+/**
+ * @brief Start the next tone
+ *
+ * @param synth Pointer to synthesizer
+ * @param frequency Tone frequency in Hz (below sample_rate / 2)
+ * @param amplitude Tone amplitude (0.0 for silence)
+ * @param samples Tone length in samples
+ */
+void mbx_synth_start(mbx_synth_t *synth, double frequency, double amplitude, int samples);
+
+/**
+ * @brief Render samples of the current tone
+ *
+ * @param synth Pointer to synthesizer
+ * @param out Output buffer for samples in [-1.0, 1.0]
+ * @param count Capacity of the output buffer
+ * @return Number of samples written, 0 once the current tone is finished
+ */
+int mbx_synth_render(mbx_synth_t *synth, double *out, int count);
+
+#endif
@@ -1,34 +1,85 @@
 #include "mbx_textview.h"
-#include <ctype.h>
+#include "mbx_encoding.h"
 #include <stdio.h>
+#include <string.h>
+
+// Print one decoded character: escapes for line breaks and tabs, dots for the rest of the controls
+static void print_character(uint32_t codepoint)
+{
+    if (codepoint == '\n') {
+        printf("\\n");
+    } else if (codepoint == '\t') {
+        printf("\\t");
+    } else if (codepoint == '\r') {
+        printf("\\r");
+    } else if (codepoint >= 0x20 && mbx_encoding_is_text(codepoint)) {
+        unsigned char utf8[4];
+        fwrite(utf8, 1, mbx_encoding_to_utf8(codepoint, utf8), stdout);
+    } else {
+        printf(".");
+    }
+}
 
 bool mbx_textview(mojibake_target_t *target, unsigned int index, void *arg)
 {
-    if (target == NULL || target->block == NULL || index >= target->partition_count)
+    (void)arg;
+    if (target == NULL || index >= target->partition_count)
+        return false;
+
+    size_t offset = (size_t)index * target->partition_size;
+    size_t remaining = target->partition_size;
+
+    mbx_encoding_result_t detected;
+    if (!mbx_encoding_scan(target, offset, remaining, MBX_ENCODING_DEFAULT_WINDOW, &detected, NULL))
         return false;
+    mbx_encoding_t encoding = detected.encoding;
 
-    unsigned char *partition = MOJIBAKE_BLOCK_OFFSET(target, index);
-    
     printf("=== Partition %d Text Preview ===\n", index);
+    if (encoding == MBX_ENCODING_BINARY) {
+        printf("Encoding: binary (%.1f%% text as %s)\n", detected.runner_up_score * 100.0,
+               mbx_encoding_name(detected.runner_up));
+    } else {
+        printf("Encoding: %s (%.1f%% text)\n", mbx_encoding_name(encoding), detected.score * 100.0);
+    }
     printf("Text content: ");
-    
-    // Display readable characters, replace non-printable with dots
-    for (int i = 0; i < target->partition_size; i++) {
-        unsigned char ch = partition[i];
-        
-        if (isprint(ch)) {
-            printf("%c", ch);
-        } else if (ch == '\n') {
-            printf("\\n");
-        } else if (ch == '\t') {
-            printf("\\t");
-        } else if (ch == '\r') {
-            printf("\\r");
-        } else {
-            printf(".");
+
+    // Skip the byte order mark; UTF-16 code units start at even file offsets
+    offset += detected.bom_length;
+    remaining -= detected.bom_length;
+    if ((encoding == MBX_ENCODING_UTF16LE || encoding == MBX_ENCODING_UTF16BE) && (offset & 1) && remaining > 0) {
+        printf(".");
+        offset++;
+        remaining--;
+    }
+
+    // Characters cut by a chunk boundary carry over to the next chunk
+    unsigned char chunk[MOJIBAKE_READ_CHUNK + 4];
+    size_t carried = 0;
+    while (remaining > 0) {
+        size_t length = mojibake_read(target, offset, chunk + carried,
+                                      remaining < MOJIBAKE_READ_CHUNK ? remaining : MOJIBAKE_READ_CHUNK);
+        if (length == 0) return false;
+        offset += length;
+        remaining -= length;
+
+        size_t available = carried + length;
+        size_t i = 0;
+        while (i < available) {
+            uint32_t codepoint;
+            size_t used = mbx_encoding_decode(encoding, chunk + i, available - i, &codepoint);
+            if (used == 0) {
+                if (remaining > 0) break;
+                // Cut off by the end of the partition
+                codepoint = MBX_ENCODING_INVALID;
+                used = 1;
+            }
+            print_character(codepoint);
+            i += used;
         }
+        carried = available - i;
+        memmove(chunk, chunk + i, carried);
     }
-    
+
     printf("\n\n");
     return true;
-}
\ No newline at end of file
+}